@@ -38,7 +38,8 @@ ConnectionConfig::ConnectionConfig()
   m_customCompressionLevel(-1), m_jpegCompressionLevel(6),
   m_fitWindow(false), m_requestShapeUpdates(true),
   m_ignoreShapeUpdates(false), m_scaleNumerator(1), m_scaleDenominator(1),
-  m_localCursor(DOT_CURSOR), m_allowedCopyRect(true), m_useSsl(true)
+  m_localCursor(DOT_CURSOR), m_allowedCopyRect(true), m_useSsl(true),
+  m_pipelineUpdates(false)
 {
 }
 
@@ -71,6 +72,7 @@ ConnectionConfig& ConnectionConfig::operator=(const ConnectionConfig& other)
   bool ignoreShapeUpdates;
   int localCursor;
   bool useSsl;
+  bool pipelineUpdates;
 
   {
     AutoLock lockOther(&other.m_cs);
@@ -92,6 +94,7 @@ ConnectionConfig& ConnectionConfig::operator=(const ConnectionConfig& other)
     ignoreShapeUpdates = other.m_ignoreShapeUpdates;
     localCursor = other.m_localCursor;
 	useSsl = other.m_useSsl;
+    pipelineUpdates = other.m_pipelineUpdates;
   }
 
   {
@@ -114,6 +117,7 @@ ConnectionConfig& ConnectionConfig::operator=(const ConnectionConfig& other)
     m_ignoreShapeUpdates = ignoreShapeUpdates;
     m_localCursor = localCursor;
 	m_useSsl = useSsl;
+    m_pipelineUpdates = pipelineUpdates;
   }
   return *this;
 }
@@ -396,6 +400,18 @@ void ConnectionConfig::useSsl(bool useSsl)
 	m_useSsl = useSsl;
 }
 
+void ConnectionConfig::pipelineUpdates(bool enabled)
+{
+  AutoLock l(&m_cs);
+  m_pipelineUpdates = enabled;
+}
+
+bool ConnectionConfig::isPipeliningUpdates()
+{
+  AutoLock l(&m_cs);
+  return m_pipelineUpdates;
+}
+
 bool ConnectionConfig::saveToStorage(SettingsManager *sm) const
 {
   AutoLock l(&m_cs);
@@ -416,6 +432,7 @@ bool ConnectionConfig::saveToStorage(SettingsManager *sm) const
   TEST_FAIL(sm->setBoolean(_T("cursorshape"),      m_requestShapeUpdates), saveAllOk);
   TEST_FAIL(sm->setBoolean(_T("noremotecursor"), m_ignoreShapeUpdates), saveAllOk);
   TEST_FAIL(sm->setBoolean(_T("useSsl"), m_useSsl), saveAllOk);
+  TEST_FAIL(sm->setBoolean(_T("pipelineupdates"),  m_pipelineUpdates), saveAllOk);
 
   TEST_FAIL(sm->setByte(_T("preferred_encoding"),  m_preferredEncoding), saveAllOk);
   TEST_FAIL(sm->setInt(_T("compresslevel"),        m_customCompressionLevel), saveAllOk);
@@ -456,6 +473,7 @@ bool ConnectionConfig::loadFromStorage(SettingsManager *sm)
   TEST_FAIL(sm->getBoolean(_T("cursorshape"),      &m_requestShapeUpdates), loadAllOk);
   TEST_FAIL(sm->getBoolean(_T("noremotecursor"), &m_ignoreShapeUpdates), loadAllOk);
   TEST_FAIL(sm->getBoolean(_T("useSsl"), &m_useSsl), loadAllOk);
+  TEST_FAIL(sm->getBoolean(_T("pipelineupdates"),  &m_pipelineUpdates), loadAllOk);
 
   TEST_FAIL(sm->getByte(_T("preferred_encoding"),  (char *)&m_preferredEncoding), loadAllOk);
 
@@ -163,6 +163,11 @@ public:
   bool useSsl();
   void useSsl(bool useSsl);
 
+  // Sets "pipeline updates" flag
+  void pipelineUpdates(bool enabled);
+  // Returns "pipeline updates" flag
+  bool isPipeliningUpdates();
+
   //
   // Serialization / deserialization methods
   //
@@ -242,6 +247,8 @@ protected:
 
   bool m_useSsl;
 
+  bool m_pipelineUpdates;
+
   // Critical section
   mutable LocalMutex m_cs;
 };
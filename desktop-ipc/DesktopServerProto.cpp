@@ -313,6 +313,10 @@ void DesktopServerProto::sendConfigSettings(BlockingGate *gate)
   }
   // Send video recognition interval
   gate->writeUInt32(srvConf->getVideoRecognitionInterval());
+  // Send automatic video detection settings
+  gate->writeUInt8(srvConf->getAutoVideoDetectionFlag());
+  gate->writeUInt32(srvConf->getVideoDetectionRate());
+  gate->writeUInt32(srvConf->getVideoDetectionMinSize());
   // Send socket timeout
   gate->writeUInt32(srvConf->getIdleTimeout());
 }
@@ -354,6 +358,10 @@ void DesktopServerProto::readConfigSettings(BlockingGate *gate)
 
   // Receive video recognition interval
   srvConf->setVideoRecognitionInterval(gate->readUInt32());
+  // Receive automatic video detection settings
+  srvConf->setAutoVideoDetectionFlag(gate->readUInt8() != 0);
+  srvConf->setVideoDetectionRate(gate->readUInt32());
+  srvConf->setVideoDetectionMinSize(gate->readUInt32());
   // Receive socket timeout
   srvConf->setIdleTimeout(gate->readUInt32());
 }
@@ -0,0 +1,127 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "SharedFrameBuffer.h"
+#include "util/Exception.h"
+
+SharedFrameBuffer::SharedFrameBuffer(const TCHAR *name, const Dimension *dim,
+                                     const PixelFormat *pf)
+: m_name(name),
+  m_memory(name, getSegmentSize(dim, pf), false)
+{
+  m_header = (Header *)m_memory.getMemPointer();
+  // The creator sees the memory filled by zeroes.
+  if (m_header->width == 0 && m_header->height == 0) {
+    m_header->width = dim->width;
+    m_header->height = dim->height;
+    m_header->bitsPerPixel = pf->bitsPerPixel;
+    m_header->colorDepth = pf->colorDepth;
+    m_header->redMax = pf->redMax;
+    m_header->greenMax = pf->greenMax;
+    m_header->blueMax = pf->blueMax;
+    m_header->redShift = pf->redShift;
+    m_header->greenShift = pf->greenShift;
+    m_header->blueShift = pf->blueShift;
+    m_header->bigEndian = pf->bigEndian;
+  }
+  if (!isCompatible(dim, pf)) {
+    throw Exception(_T("The shared frame buffer has unexpected properties"));
+  }
+
+  m_frameBuffer.setProperties(dim, pf);
+  m_frameBuffer.setBuffer((UINT8 *)m_header + PIXELS_OFFSET);
+}
+
+SharedFrameBuffer::~SharedFrameBuffer()
+{
+  m_frameBuffer.setBuffer(0);
+}
+
+bool SharedFrameBuffer::isCompatible(const Dimension *dim,
+                                     const PixelFormat *pf) const
+{
+  PixelFormat headerPf = getHeaderPixelFormat();
+  return m_header->width == (UINT32)dim->width &&
+         m_header->height == (UINT32)dim->height &&
+         headerPf.isEqualTo(pf);
+}
+
+PixelFormat SharedFrameBuffer::getHeaderPixelFormat() const
+{
+  PixelFormat pf;
+  pf.bitsPerPixel = m_header->bitsPerPixel;
+  pf.colorDepth = m_header->colorDepth;
+  pf.redMax = m_header->redMax;
+  pf.greenMax = m_header->greenMax;
+  pf.blueMax = m_header->blueMax;
+  pf.redShift = m_header->redShift;
+  pf.greenShift = m_header->greenShift;
+  pf.blueShift = m_header->blueShift;
+  pf.bigEndian = m_header->bigEndian != 0;
+  return pf;
+}
+
+UINT32 SharedFrameBuffer::write(const FrameBuffer *srcFb,
+                                const std::vector<Rect> *rects)
+{
+  // Odd sequence means the pixels are being changed. The interlocked
+  // functions also keep the pixel writes between the two increments.
+  InterlockedIncrement(&m_header->sequence);
+
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = rects->begin(); iRect < rects->end(); iRect++) {
+    m_frameBuffer.copyFrom(&(*iRect), srcFb, iRect->left, iRect->top);
+  }
+
+  return (UINT32)InterlockedIncrement(&m_header->sequence);
+}
+
+bool SharedFrameBuffer::read(FrameBuffer *dstFb,
+                             const std::vector<Rect> *rects, UINT32 sequence)
+{
+  if (getSequence() != sequence) {
+    return false;
+  }
+
+  std::vector<Rect>::const_iterator iRect;
+  for (iRect = rects->begin(); iRect < rects->end(); iRect++) {
+    dstFb->copyFrom(&(*iRect), &m_frameBuffer, iRect->left, iRect->top);
+  }
+
+  return getSequence() == sequence;
+}
+
+UINT32 SharedFrameBuffer::getSequence()
+{
+  // Reads the value with a full memory barrier.
+  return (UINT32)InterlockedCompareExchange(&m_header->sequence, 0, 0);
+}
+
+size_t SharedFrameBuffer::getSegmentSize(const Dimension *dim,
+                                         const PixelFormat *pf)
+{
+  return PIXELS_OFFSET +
+         (size_t)dim->width * dim->height * (pf->bitsPerPixel / 8);
+}
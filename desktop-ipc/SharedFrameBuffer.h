@@ -0,0 +1,104 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __SHAREDFRAMEBUFFER_H__
+#define __SHAREDFRAMEBUFFER_H__
+
+#include "util/CommonHeader.h"
+#include "win-system/SharedMemory.h"
+#include "rfb/FrameBuffer.h"
+#include "region/Rect.h"
+
+#include <vector>
+
+// Frame buffer placed in a named shared memory segment, so the desktop
+// server process can pass pixels to the service without sending them
+// through the pipe. Only the segment name, the changed rectangles and the
+// sequence number go through the pipe.
+//
+// The segment starts with a header holding a sequence number (seqlock).
+// The writer makes it odd before changing pixels and even again after
+// that. A reader that has copied pixels of the sequence number it was told
+// checks the number again to make sure the pixels were not changing
+// meanwhile. A change of the frame buffer properties makes the writer
+// create a new segment with another name (the next generation).
+class SharedFrameBuffer
+{
+public:
+  // Creates the segment or opens the existing one. The opening side must
+  // pass the same properties the segment has been created with.
+  // @throw Exception
+  SharedFrameBuffer(const TCHAR *name, const Dimension *dim,
+                    const PixelFormat *pf);
+  virtual ~SharedFrameBuffer();
+
+  const TCHAR *getName() const { return m_name.getString(); }
+  // Returns true if the segment holds a frame buffer of these dimension and
+  // pixel format.
+  bool isCompatible(const Dimension *dim, const PixelFormat *pf) const;
+
+  // Copies the rectangles of srcFb to the segment and returns the new
+  // sequence number.
+  UINT32 write(const FrameBuffer *srcFb, const std::vector<Rect> *rects);
+
+  // Copies the rectangles from the segment to dstFb. Returns false if the
+  // segment does not hold pixels of the given sequence number any longer.
+  bool read(FrameBuffer *dstFb, const std::vector<Rect> *rects,
+            UINT32 sequence);
+
+private:
+  struct Header
+  {
+    volatile LONG sequence;
+    UINT32 width;
+    UINT32 height;
+    // The whole pixel format of the frame buffer.
+    UINT16 bitsPerPixel;
+    UINT16 colorDepth;
+    UINT16 redMax;
+    UINT16 greenMax;
+    UINT16 blueMax;
+    UINT16 redShift;
+    UINT16 greenShift;
+    UINT16 blueShift;
+    UINT32 bigEndian;
+  };
+  // Pixels start after the header at this offset.
+  static const size_t PIXELS_OFFSET = 64;
+
+  static size_t getSegmentSize(const Dimension *dim, const PixelFormat *pf);
+
+  // Returns the pixel format stored in the header.
+  PixelFormat getHeaderPixelFormat() const;
+
+  UINT32 getSequence();
+
+  StringStorage m_name;
+  SharedMemory m_memory;
+  Header *m_header;
+  FrameBuffer m_frameBuffer;
+};
+
+#endif // __SHAREDFRAMEBUFFER_H__
@@ -32,7 +32,9 @@ UpdateHandlerClient::UpdateHandlerClient(BlockingGate *forwGate,
                                          LogWriter *log)
 : DesktopServerProto(forwGate),
   m_externalUpdateListener(externalUpdateListener),
-  m_log(log)
+  m_log(log),
+  m_sharedFb(0),
+  m_sharedFbFailed(false)
 {
   dispatcher->registerNewHandle(UPDATE_DETECTED, this);
 
@@ -49,6 +51,7 @@ UpdateHandlerClient::UpdateHandlerClient(BlockingGate *forwGate,
 
 UpdateHandlerClient::~UpdateHandlerClient()
 {
+  delete m_sharedFb;
 }
 
 void UpdateHandlerClient::onRequest(UINT8 reqCode, BlockingGate *backGate)
@@ -76,6 +79,7 @@ void UpdateHandlerClient::extract(UpdateContainer *updateContainer)
   try {
     m_log->info(_T("UpdateHandlerClient: send EXTRACT_REQ"));
     m_forwGate->writeUInt8(EXTRACT_REQ); // query for extract
+    m_forwGate->writeUInt8(!m_sharedFbFailed);
 
     // Get screen size changed
     updCont.screenSizeChanged = m_forwGate->readUInt8() != 0;
@@ -105,9 +109,37 @@ void UpdateHandlerClient::extract(UpdateContainer *updateContainer)
         AutoLock al(&m_fbLocMut);
         m_backupFrameBuffer.setProperties(&newDim, &newPf);
       }
+    }
+    // The server sends the whole frame buffer again when pixels have been
+    // lost, the frame buffer properties stay the same.
+    bool fbResent = m_forwGate->readUInt8() != 0;
+    if (fbResent) {
+      m_log->info(_T("UpdateHandlerClient: the whole frame buffer is resent"));
+    }
+
+    // Rectangles to be read from the shared memory.
+    std::vector<Rect> sharedRects;
+    UINT32 sharedSequence = 0;
+    bool useSharedFb = m_forwGate->readUInt8() != 0;
+    if (useSharedFb) {
+      StringStorage sharedFbName;
+      m_forwGate->readUTF8(&sharedFbName);
+      sharedSequence = m_forwGate->readUInt32();
+      openSharedFrameBuffer(&sharedFbName);
+    }
+
+    if (updCont.screenSizeChanged || fbResent) {
       // Equalizing this frame buffer by other side frame buffer.
       Rect fbRect = m_backupFrameBuffer.getDimension().getRect();
-      readFrameBuffer(&m_backupFrameBuffer, &fbRect, m_forwGate);
+      if (useSharedFb) {
+        sharedRects.push_back(fbRect);
+      } else {
+        readFrameBuffer(&m_backupFrameBuffer, &fbRect, m_forwGate);
+      }
+      // Clients have got the lost pixels, they get the whole screen.
+      if (!updCont.screenSizeChanged) {
+        updCont.changedRegion.addRect(&fbRect);
+      }
     }
 
     // Get video region
@@ -118,17 +150,32 @@ void UpdateHandlerClient::extract(UpdateContainer *updateContainer)
     for (unsigned int i = 0; i < countChangedRect; i++) {
       Rect r = readRect(m_forwGate);
       updCont.changedRegion.addRect(&r);
-      readFrameBuffer(&m_backupFrameBuffer, &r, m_forwGate);
+      if (useSharedFb) {
+        sharedRects.push_back(r);
+      } else {
+        readFrameBuffer(&m_backupFrameBuffer, &r, m_forwGate);
+      }
     }
 
-    // Get "copyrect"
-    unsigned char hasCopyRect = m_forwGate->readUInt8();
-    if (hasCopyRect) {
-      m_log->info(_T("UpdateHandlerClient: has \"CopyRect\""));
-      updCont.copySrc = readPoint(m_forwGate);
+    // Get "copyrect" operations
+    unsigned int countCopiedRect = m_forwGate->readUInt32();
+    if (countCopiedRect != 0) {
+      m_log->info(_T("UpdateHandlerClient: count \"CopyRect\" = %u"),
+                  countCopiedRect);
+    }
+    for (unsigned int i = 0; i < countCopiedRect; i++) {
+      Point src = readPoint(m_forwGate);
       Rect r = readRect(m_forwGate);
-      updCont.copiedRegion.addRect(&r);
-      readFrameBuffer(&m_backupFrameBuffer, &r, m_forwGate);
+      updCont.addCopy(&r, &src);
+      if (useSharedFb) {
+        sharedRects.push_back(r);
+      } else {
+        readFrameBuffer(&m_backupFrameBuffer, &r, m_forwGate);
+      }
+    }
+
+    if (useSharedFb && !sharedRects.empty()) {
+      readSharedFrameBuffer(&sharedRects, sharedSequence);
     }
 
     // Get cursor position if it has been changed.
@@ -165,6 +212,46 @@ void UpdateHandlerClient::extract(UpdateContainer *updateContainer)
   *updateContainer = updCont;
 }
 
+void UpdateHandlerClient::openSharedFrameBuffer(const StringStorage *name)
+{
+  if (m_sharedFb != 0 && name->isEqualTo(m_sharedFb->getName())) {
+    return;
+  }
+  delete m_sharedFb;
+  m_sharedFb = 0;
+  if (m_sharedFbFailed) {
+    return;
+  }
+
+  Dimension dim = m_backupFrameBuffer.getDimension();
+  PixelFormat pf = m_backupFrameBuffer.getPixelFormat();
+  try {
+    m_sharedFb = new SharedFrameBuffer(name->getString(), &dim, &pf);
+    m_log->info(_T("UpdateHandlerClient: frame buffer is shared by the %s")
+                _T(" memory segment"), name->getString());
+  } catch (Exception &e) {
+    m_log->error(_T("UpdateHandlerClient: cannot open the shared frame")
+                 _T(" buffer: %s"), e.getMessage());
+    m_sharedFbFailed = true;
+  }
+}
+
+void UpdateHandlerClient::readSharedFrameBuffer(const std::vector<Rect> *rects,
+                                                UINT32 sequence)
+{
+  if (m_sharedFb == 0 ||
+      !m_sharedFb->read(&m_backupFrameBuffer, rects, sequence)) {
+    // The pixels are lost. Asking for the pipe makes the server send the
+    // whole frame buffer with the next update.
+    m_log->error(_T("UpdateHandlerClient: cannot read pixels of the")
+                 _T(" update #%u from the shared memory"),
+                 (unsigned int)sequence);
+    m_sharedFbFailed = true;
+    delete m_sharedFb;
+    m_sharedFb = 0;
+  }
+}
+
 void UpdateHandlerClient::setFullUpdateRequested(const Region *region)
 {
   AutoLock al(m_forwGate);
@@ -204,6 +291,12 @@ void UpdateHandlerClient::getScreenProperties(PixelFormat *pf, Dimension *dim)
 void UpdateHandlerClient::sendInit(BlockingGate *gate)
 {
   AutoLock al(gate);
+
+  // It may be a new server, give the shared memory another chance.
+  delete m_sharedFb;
+  m_sharedFb = 0;
+  m_sharedFbFailed = false;
+
   gate->writeUInt8(FRAME_BUFFER_INIT);
 
   sendPixelFormat(&m_backupFrameBuffer.getPixelFormat(), gate);
@@ -29,6 +29,7 @@
 #include "DesktopServerProto.h"
 #include "DesktopSrvDispatcher.h"
 #include "log-writer/LogWriter.h"
+#include "SharedFrameBuffer.h"
 
 class UpdateHandlerClient : public UpdateHandler, public DesktopServerProto,
                             public ClientListener
@@ -50,9 +51,21 @@ protected:
   // To catch update event
   virtual void onRequest(UINT8 reqCode, BlockingGate *backGate);
 
+  // Maps the shared frame buffer segment with the name unless it is
+  // already mapped.
+  void openSharedFrameBuffer(const StringStorage *name);
+  // Copies the rectangles from the shared frame buffer to
+  // m_backupFrameBuffer.
+  void readSharedFrameBuffer(const std::vector<Rect> *rects, UINT32 sequence);
+
   UpdateListener *m_externalUpdateListener;
 
   LogWriter *m_log;
+
+  SharedFrameBuffer *m_sharedFb;
+  // Set when the shared memory can not be used, so the pixels are sent
+  // through the pipe.
+  bool m_sharedFbFailed;
 };
 
 #endif // __UPDATEHANDLERCLIENT_H__
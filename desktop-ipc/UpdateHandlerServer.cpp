@@ -31,7 +31,10 @@ UpdateHandlerServer::UpdateHandlerServer(BlockingGate *forwGate,
 : DesktopServerProto(forwGate),
   m_extTerminationListener(extTerminationListener),
   m_log(log),
-  m_scrDriverFactory(Configurator::getInstance()->getServerConfig())
+  m_scrDriverFactory(Configurator::getInstance()->getServerConfig()),
+  m_sharedFb(0),
+  m_sharedFbGeneration(0),
+  m_usedSharedFb(false)
 {
   m_updateHandler = new UpdateHandlerImpl(this, &m_scrDriverFactory, log);
 
@@ -45,6 +48,7 @@ UpdateHandlerServer::UpdateHandlerServer(BlockingGate *forwGate,
 UpdateHandlerServer::~UpdateHandlerServer()
 {
   delete m_updateHandler;
+  delete m_sharedFb;
 }
 
 void UpdateHandlerServer::onUpdate()
@@ -90,6 +94,9 @@ void UpdateHandlerServer::onRequest(UINT8 reqCode, BlockingGate *backGate)
 
 void UpdateHandlerServer::extractReply(BlockingGate *backGate)
 {
+  // The client tells whether it can read pixels from the shared memory.
+  bool sharedFbAllowed = backGate->readUInt8() != 0;
+
   UpdateContainer updCont;
   m_updateHandler->extract(&updCont);
 
@@ -102,43 +109,80 @@ void UpdateHandlerServer::extractReply(BlockingGate *backGate)
     m_oldPf = newPf;
   }
 
+  bool useSharedFb = sharedFbAllowed && prepareSharedFrameBuffer(fb);
+  // Pixels sent by the shared memory the client could not read are lost,
+  // so the whole frame buffer is sent again.
+  bool fbResent = m_usedSharedFb && !useSharedFb;
+  m_usedSharedFb = useSharedFb;
+  bool sendWholeFb = updCont.screenSizeChanged || fbResent;
+
+  Dimension fbDim = fb->getDimension();
+  Rect fbRect = fbDim.getRect();
+  std::vector<Rect> changedRects;
+  updCont.changedRegion.getRectVector(&changedRects);
+
+  UINT32 sequence = 0;
+  if (useSharedFb) {
+    std::vector<Rect> rects;
+    if (sendWholeFb) {
+      rects.push_back(fbRect);
+    } else {
+      rects = changedRects;
+      std::vector<CopiedRect>::iterator iCopy;
+      for (iCopy = updCont.copiedRects.begin();
+           iCopy < updCont.copiedRects.end(); iCopy++) {
+        rects.push_back(iCopy->dst);
+      }
+    }
+    sequence = m_sharedFb->write(fb, &rects);
+  }
+
   backGate->writeUInt8(updCont.screenSizeChanged);
   if (updCont.screenSizeChanged) {
     // Send new screen properties
     sendPixelFormat(&newPf, backGate);
-    Dimension fbDim = fb->getDimension();
-    Rect fbRect = fbDim.getRect();
     sendDimension(&fbDim, backGate);
+  }
+  // The whole frame buffer is sent without a change of its properties.
+  backGate->writeUInt8(fbResent);
+
+  // Send the way the pixels are passed
+  backGate->writeUInt8(useSharedFb);
+  if (useSharedFb) {
+    backGate->writeUTF8(m_sharedFb->getName());
+    backGate->writeUInt32(sequence);
+  } else if (sendWholeFb) {
     sendFrameBuffer(fb, &fbRect, backGate);
   }
 
   // Send video region
   sendRegion(&updCont.videoRegion, backGate);
   // Send changed region
-  std::vector<Rect> rects;
   std::vector<Rect>::iterator iRect;
-  updCont.changedRegion.getRectVector(&rects);
-  unsigned int countChangedRect = (unsigned int)rects.size();
-  _ASSERT(countChangedRect == rects.size());
+  unsigned int countChangedRect = (unsigned int)changedRects.size();
+  _ASSERT(countChangedRect == changedRects.size());
   backGate->writeUInt32(countChangedRect);
 
-  for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
+  for (iRect = changedRects.begin(); iRect < changedRects.end(); iRect++) {
     Rect *rect = &(*iRect);
     sendRect(rect, backGate);
-    sendFrameBuffer(fb, rect, backGate);
+    if (!useSharedFb) {
+      sendFrameBuffer(fb, rect, backGate);
+    }
   }
 
-  // Send "copyrect"
-  bool hasCopyRect = !updCont.copiedRegion.isEmpty();
-  backGate->writeUInt8(hasCopyRect);
-  if (hasCopyRect) {
-    sendPoint(&updCont.copySrc, backGate);
-    updCont.copiedRegion.getRectVector(&rects);
-    iRect = rects.begin();
-    sendRect(&(*iRect), backGate);
-    sendFrameBuffer(fb, &(*iRect), backGate);
+  // Send "copyrect" operations in the order they must be applied
+  unsigned int countCopiedRect = (unsigned int)updCont.copiedRects.size();
+  backGate->writeUInt32(countCopiedRect);
+  std::vector<CopiedRect>::iterator iCopy;
+  for (iCopy = updCont.copiedRects.begin(); iCopy < updCont.copiedRects.end();
+       iCopy++) {
+    sendPoint(&iCopy->src, backGate);
+    sendRect(&iCopy->dst, backGate);
+    if (!useSharedFb) {
+      sendFrameBuffer(fb, &iCopy->dst, backGate);
+    }
   }
-
   // Send cursor position if it has been changed.
   backGate->writeUInt8(updCont.cursorPosChanged);
   sendPoint(&updCont.cursorPos, backGate);
@@ -159,6 +203,34 @@ void UpdateHandlerServer::extractReply(BlockingGate *backGate)
   }
 }
 
+bool UpdateHandlerServer::prepareSharedFrameBuffer(const FrameBuffer *fb)
+{
+  Dimension dim = fb->getDimension();
+  PixelFormat pf = fb->getPixelFormat();
+  if (m_sharedFb != 0 && m_sharedFb->isCompatible(&dim, &pf)) {
+    return true;
+  }
+
+  delete m_sharedFb;
+  m_sharedFb = 0;
+
+  // Every generation of the segment has its own name, so the client can
+  // not confuse it with the previous one.
+  StringStorage name;
+  name.format(_T("Global\\TvnFrameBuffer_%u_%u"),
+              (unsigned int)GetCurrentProcessId(), ++m_sharedFbGeneration);
+  try {
+    m_sharedFb = new SharedFrameBuffer(name.getString(), &dim, &pf);
+    m_log->info(_T("Frame buffer is shared by the %s memory segment"),
+                name.getString());
+    return true;
+  } catch (Exception &e) {
+    m_log->error(_T("Cannot share the frame buffer, pixels will be sent")
+                 _T(" through the pipe: %s"), e.getMessage());
+    return false;
+  }
+}
+
 void UpdateHandlerServer::screenPropReply(BlockingGate *backGate)
 {
   const FrameBuffer *fb = m_updateHandler->getFrameBuffer();
@@ -191,4 +263,5 @@ void UpdateHandlerServer::serverInit(BlockingGate *backGate)
 
   readFrameBuffer(&fb, &dim.getRect(), backGate);
   m_updateHandler->initFrameBuffer(&fb);
+  m_usedSharedFb = false;
 }
@@ -30,6 +30,7 @@
 #include "DesktopSrvDispatcher.h"
 #include "log-writer/LogWriter.h"
 #include "desktop/Win32ScreenDriverFactory.h"
+#include "SharedFrameBuffer.h"
 
 class UpdateHandlerServer: public DesktopServerProto, public ClientListener,
                            public UpdateListener
@@ -55,10 +56,20 @@ protected:
   void receiveFullReqReg(BlockingGate *backGate);
   void receiveExcludingReg(BlockingGate *backGate);
 
+  // Makes sure m_sharedFb can hold the frame buffer, creating the next
+  // generation of the segment if needed. Returns false if the shared
+  // memory can not be used.
+  bool prepareSharedFrameBuffer(const FrameBuffer *fb);
+
   Win32ScreenDriverFactory m_scrDriverFactory;
 
   PixelFormat m_oldPf;
 
+  SharedFrameBuffer *m_sharedFb;
+  unsigned int m_sharedFbGeneration;
+  // Pixels of the previous update were passed by the shared memory.
+  bool m_usedSharedFb;
+
   UpdateHandlerImpl *m_updateHandler;
   AnEventListener *m_extTerminationListener;
 
@@ -0,0 +1,252 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "DirtyBlockDetector.h"
+#include "util/CpuFeatures.h"
+
+#include <intrin.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+
+//------------------------------- Kernels ----------------------------------//
+
+static bool differScalar(const UINT8 *a, const UINT8 *b, size_t len)
+{
+  return memcmp(a, b, len) != 0;
+}
+
+static bool differSse2(const UINT8 *a, const UINT8 *b, size_t len)
+{
+  size_t i = 0;
+  for (; i + 64 <= len; i += 64) {
+    __m128i c0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                                _mm_loadu_si128((const __m128i *)(b + i)));
+    __m128i c1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 16)),
+                                _mm_loadu_si128((const __m128i *)(b + i + 16)));
+    __m128i c2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 32)),
+                                _mm_loadu_si128((const __m128i *)(b + i + 32)));
+    __m128i c3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i + 48)),
+                                _mm_loadu_si128((const __m128i *)(b + i + 48)));
+    __m128i all = _mm_and_si128(_mm_and_si128(c0, c1), _mm_and_si128(c2, c3));
+    if (_mm_movemask_epi8(all) != 0xFFFF) {
+      return true;
+    }
+  }
+  for (; i + 16 <= len; i += 16) {
+    __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                               _mm_loadu_si128((const __m128i *)(b + i)));
+    if (_mm_movemask_epi8(c) != 0xFFFF) {
+      return true;
+    }
+  }
+  return i < len && memcmp(a + i, b + i, len - i) != 0;
+}
+
+static bool differAvx2(const UINT8 *a, const UINT8 *b, size_t len)
+{
+  size_t i = 0;
+  for (; i + 128 <= len; i += 128) {
+    __m256i c0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                   _mm256_loadu_si256((const __m256i *)(b + i)));
+    __m256i c1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 32)),
+                                   _mm256_loadu_si256((const __m256i *)(b + i + 32)));
+    __m256i c2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 64)),
+                                   _mm256_loadu_si256((const __m256i *)(b + i + 64)));
+    __m256i c3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i + 96)),
+                                   _mm256_loadu_si256((const __m256i *)(b + i + 96)));
+    __m256i all = _mm256_and_si256(_mm256_and_si256(c0, c1),
+                                   _mm256_and_si256(c2, c3));
+    if (_mm256_movemask_epi8(all) != -1) {
+      _mm256_zeroupper();
+      return true;
+    }
+  }
+  for (; i + 32 <= len; i += 32) {
+    __m256i c = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                  _mm256_loadu_si256((const __m256i *)(b + i)));
+    if (_mm256_movemask_epi8(c) != -1) {
+      _mm256_zeroupper();
+      return true;
+    }
+  }
+  _mm256_zeroupper();
+  return i < len && differSse2(a + i, b + i, len - i);
+}
+
+static int findFirstDiffScalar(const UINT8 *a, const UINT8 *b, size_t len)
+{
+  for (size_t i = 0; i < len; i++) {
+    if (a[i] != b[i]) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+static int findLastDiffScalar(const UINT8 *a, const UINT8 *b, size_t len)
+{
+  for (size_t i = len; i > 0; i--) {
+    if (a[i - 1] != b[i - 1]) {
+      return (int)(i - 1);
+    }
+  }
+  return -1;
+}
+
+static int findFirstDiffSse2(const UINT8 *a, const UINT8 *b, size_t len)
+{
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                               _mm_loadu_si128((const __m128i *)(b + i)));
+    unsigned long mask = ~_mm_movemask_epi8(c) & 0xFFFF;
+    if (mask != 0) {
+      unsigned long index;
+      _BitScanForward(&index, mask);
+      return (int)(i + index);
+    }
+  }
+  int tail = findFirstDiffScalar(a + i, b + i, len - i);
+  return tail < 0 ? -1 : (int)i + tail;
+}
+
+static int findLastDiffSse2(const UINT8 *a, const UINT8 *b, size_t len)
+{
+  size_t i = len;
+  for (; i >= 16; i -= 16) {
+    __m128i c = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i - 16)),
+                               _mm_loadu_si128((const __m128i *)(b + i - 16)));
+    unsigned long mask = ~_mm_movemask_epi8(c) & 0xFFFF;
+    if (mask != 0) {
+      unsigned long index;
+      _BitScanReverse(&index, mask);
+      return (int)(i - 16 + index);
+    }
+  }
+  return findLastDiffScalar(a, b, i);
+}
+
+//--------------------------- DirtyBlockDetector ----------------------------//
+
+DirtyBlockDetector::DirtyBlockDetector()
+: m_differ(differScalar),
+  m_findFirstDiff(findFirstDiffScalar),
+  m_findLastDiff(findLastDiffScalar)
+{
+  if (CpuFeatures::hasSse2()) {
+    m_differ = differSse2;
+    m_findFirstDiff = findFirstDiffSse2;
+    m_findLastDiff = findLastDiffSse2;
+  }
+  if (CpuFeatures::hasAvx2()) {
+    m_differ = differAvx2;
+  }
+}
+
+DirtyBlockDetector::~DirtyBlockDetector()
+{
+}
+
+bool DirtyBlockDetector::differ(const UINT8 *a, const UINT8 *b,
+                                size_t len) const
+{
+  return m_differ(a, b, len);
+}
+
+int DirtyBlockDetector::findFirstDiff(const UINT8 *a, const UINT8 *b,
+                                      size_t len) const
+{
+  return m_findFirstDiff(a, b, len);
+}
+
+int DirtyBlockDetector::findLastDiff(const UINT8 *a, const UINT8 *b,
+                                     size_t len) const
+{
+  return m_findLastDiff(a, b, len);
+}
+
+void DirtyBlockDetector::findDirtyBlocks(const FrameBuffer *oldFb,
+                                         const FrameBuffer *newFb,
+                                         const Rect *rect,
+                                         std::vector<Rect> *blockRuns)
+{
+  if (rect->isEmpty()) {
+    return;
+  }
+
+  const size_t bytesPerPixel = oldFb->getBytesPerPixel();
+  const size_t oldBytesPerRow = oldFb->getBytesPerRow();
+  const size_t newBytesPerRow = newFb->getBytesPerRow();
+  const size_t blockBytes = BLOCK_SIZE * bytesPerPixel;
+  const int width = rect->getWidth();
+  const int numBlocks = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  const size_t lastBlockBytes = (width - (numBlocks - 1) * BLOCK_SIZE) *
+                                bytesPerPixel;
+
+  m_rowFlags.resize(numBlocks);
+
+  const UINT8 *oldBase = (const UINT8 *)oldFb->getBufferPtr(rect->left, rect->top);
+  const UINT8 *newBase = (const UINT8 *)newFb->getBufferPtr(rect->left, rect->top);
+
+  for (int y = rect->top; y < rect->bottom; y += BLOCK_SIZE) {
+    const int blockBottom = min(y + BLOCK_SIZE, rect->bottom);
+    memset(&m_rowFlags.front(), 0, numBlocks);
+    int numDirty = 0;
+
+    // Compare the block row line by line, skipping blocks that are already
+    // known to be changed. Stop as soon as all the blocks are changed.
+    const UINT8 *oldRow = oldBase + (y - rect->top) * oldBytesPerRow;
+    const UINT8 *newRow = newBase + (y - rect->top) * newBytesPerRow;
+    for (int line = y; line < blockBottom && numDirty < numBlocks; line++) {
+      for (int bx = 0; bx < numBlocks; bx++) {
+        if (m_rowFlags[bx] != 0) {
+          continue;
+        }
+        size_t offset = bx * blockBytes;
+        size_t len = bx == numBlocks - 1 ? lastBlockBytes : blockBytes;
+        if (m_differ(oldRow + offset, newRow + offset, len)) {
+          m_rowFlags[bx] = 1;
+          numDirty++;
+        }
+      }
+      oldRow += oldBytesPerRow;
+      newRow += newBytesPerRow;
+    }
+
+    // Convert the flags into horizontal runs of blocks.
+    for (int bx = 0; bx < numBlocks; bx++) {
+      if (m_rowFlags[bx] == 0) {
+        continue;
+      }
+      int runStart = bx;
+      while (bx + 1 < numBlocks && m_rowFlags[bx + 1] != 0) {
+        bx++;
+      }
+      int left = rect->left + runStart * BLOCK_SIZE;
+      int right = min(rect->left + (bx + 1) * BLOCK_SIZE, rect->right);
+      blockRuns->push_back(Rect(left, y, right, blockBottom));
+    }
+  }
+}
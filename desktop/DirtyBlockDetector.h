@@ -0,0 +1,76 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __DIRTYBLOCKDETECTOR_H__
+#define __DIRTYBLOCKDETECTOR_H__
+
+#include <vector>
+
+#include "rfb/FrameBuffer.h"
+#include "region/Rect.h"
+#include "util/inttypes.h"
+
+// DirtyBlockDetector compares two frame buffers and finds blocks of pixels
+// which differ. Comparison kernels are vectorized with SSE2 or AVX2,
+// depending on what the processor supports; plain memcmp() and byte loops
+// are used as a fallback. The implementation is selected in the
+// constructor.
+class DirtyBlockDetector
+{
+public:
+  static const int BLOCK_SIZE = 32;
+
+  DirtyBlockDetector();
+  virtual ~DirtyBlockDetector();
+
+  // Compares `rect' in two frame buffers of equal dimension and pixel format
+  // in one pass and adds to `blockRuns' horizontal runs of changed
+  // BLOCK_SIZE x BLOCK_SIZE blocks. The block grid starts at the top left
+  // corner of `rect'; the blocks at the right and bottom edges are cropped
+  // by `rect'.
+  void findDirtyBlocks(const FrameBuffer *oldFb, const FrameBuffer *newFb,
+                       const Rect *rect, std::vector<Rect> *blockRuns);
+
+  // Returns true if `len' bytes at `a' and `b' differ.
+  bool differ(const UINT8 *a, const UINT8 *b, size_t len) const;
+
+  // Return the index of the first (last) differing byte of the two buffers
+  // of `len' bytes, or -1 if the buffers are equal.
+  int findFirstDiff(const UINT8 *a, const UINT8 *b, size_t len) const;
+  int findLastDiff(const UINT8 *a, const UINT8 *b, size_t len) const;
+
+private:
+  typedef bool (*DifferFunc)(const UINT8 *a, const UINT8 *b, size_t len);
+  typedef int (*FindDiffFunc)(const UINT8 *a, const UINT8 *b, size_t len);
+
+  DifferFunc m_differ;
+  FindDiffFunc m_findFirstDiff;
+  FindDiffFunc m_findLastDiff;
+
+  // Dirty flags for the blocks of the current block row.
+  std::vector<UINT8> m_rowFlags;
+};
+
+#endif // __DIRTYBLOCKDETECTOR_H__
@@ -0,0 +1,231 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "MotionEstimator.h"
+
+#include <algorithm>
+#include <limits.h>
+#include <string.h>
+
+// Hashes which occur more often than this in the old frame buffer are
+// ignored (e.g. rows of a plain background).
+static const size_t MAX_HASH_MATCHES = 4;
+
+static const UINT32 FNV_OFFSET = 2166136261U;
+static const UINT32 FNV_PRIME = 16777619U;
+
+MotionEstimator::MotionEstimator()
+: m_votes(2 * MAX_SHIFT + 1)
+{
+}
+
+MotionEstimator::~MotionEstimator()
+{
+}
+
+bool MotionEstimator::findMove(const FrameBuffer *oldFb,
+                               const FrameBuffer *newFb,
+                               const Rect *area, Rect *dst, Point *src)
+{
+  if (area->getWidth() < MIN_AREA_WIDTH ||
+      area->getHeight() < MIN_AREA_HEIGHT) {
+    return false;
+  }
+  // Scrolling is vertical much more often than horizontal.
+  return findVerticalMove(oldFb, newFb, area, dst, src) ||
+         findHorizontalMove(oldFb, newFb, area, dst, src);
+}
+
+bool MotionEstimator::findVerticalMove(const FrameBuffer *oldFb,
+                                       const FrameBuffer *newFb,
+                                       const Rect *area, Rect *dst, Point *src)
+{
+  const int fbHeight = newFb->getDimension().height;
+  const size_t rowLen = area->getWidth() * newFb->getBytesPerPixel();
+  const int oldTop = max(area->top - MAX_SHIFT, 0);
+  const int oldBottom = min(area->bottom + MAX_SHIFT, fbHeight);
+
+  m_newHashes.resize(area->getHeight());
+  for (int y = area->top; y < area->bottom; y++) {
+    m_newHashes[y - area->top] =
+      hashRow((const UINT8 *)newFb->getBufferPtr(area->left, y), rowLen);
+  }
+  m_oldHashes.resize(oldBottom - oldTop);
+  for (int y = oldTop; y < oldBottom; y++) {
+    m_oldHashes[y - oldTop] =
+      hashRow((const UINT8 *)oldFb->getBufferPtr(area->left, y), rowLen);
+  }
+
+  int shift = findBestShift(area->top, oldTop);
+  if (shift == 0) {
+    return false;
+  }
+
+  // Find the longest run of rows which are really equal to the shifted ones.
+  int top = max(area->top, shift);
+  int bottom = min(area->bottom, fbHeight + shift);
+  int bestStart = 0, bestLength = 0;
+  int runStart = top;
+  for (int y = top; y <= bottom; y++) {
+    bool equal = y < bottom &&
+      memcmp(newFb->getBufferPtr(area->left, y),
+             oldFb->getBufferPtr(area->left, y - shift), rowLen) == 0;
+    if (!equal) {
+      if (y - runStart > bestLength) {
+        bestStart = runStart;
+        bestLength = y - runStart;
+      }
+      runStart = y + 1;
+    }
+  }
+  if (bestLength < MIN_MOVE_LENGTH) {
+    return false;
+  }
+
+  dst->setRect(area->left, bestStart, area->right, bestStart + bestLength);
+  src->setPoint(area->left, bestStart - shift);
+  return true;
+}
+
+bool MotionEstimator::findHorizontalMove(const FrameBuffer *oldFb,
+                                         const FrameBuffer *newFb,
+                                         const Rect *area, Rect *dst,
+                                         Point *src)
+{
+  const int fbWidth = newFb->getDimension().width;
+  const int bytesPerPixel = newFb->getBytesPerPixel();
+  Rect oldArea(max(area->left - MAX_SHIFT, 0), area->top,
+               min(area->right + MAX_SHIFT, fbWidth), area->bottom);
+
+  hashColumns(newFb, area, &m_newHashes);
+  hashColumns(oldFb, &oldArea, &m_oldHashes);
+
+  int shift = findBestShift(area->left, oldArea.left);
+  if (shift == 0) {
+    return false;
+  }
+
+  // Find the longest run of columns with matching hashes.
+  int left = max(area->left, shift);
+  int right = min(area->right, fbWidth + shift);
+  int bestStart = 0, bestLength = 0;
+  int runStart = left;
+  for (int x = left; x <= right; x++) {
+    bool equal = x < right &&
+      m_newHashes[x - area->left] == m_oldHashes[x - shift - oldArea.left];
+    if (!equal) {
+      if (x - runStart > bestLength) {
+        bestStart = runStart;
+        bestLength = x - runStart;
+      }
+      runStart = x + 1;
+    }
+  }
+  if (bestLength < MIN_MOVE_LENGTH) {
+    return false;
+  }
+
+  // Equal hashes do not guarantee equal pixels, verify them.
+  const size_t rowLen = bestLength * bytesPerPixel;
+  for (int y = area->top; y < area->bottom; y++) {
+    if (memcmp(newFb->getBufferPtr(bestStart, y),
+               oldFb->getBufferPtr(bestStart - shift, y), rowLen) != 0) {
+      return false;
+    }
+  }
+
+  dst->setRect(bestStart, area->top, bestStart + bestLength, area->bottom);
+  src->setPoint(bestStart - shift, area->top);
+  return true;
+}
+
+int MotionEstimator::findBestShift(int newPos, int oldPos)
+{
+  m_index.resize(m_oldHashes.size());
+  for (size_t i = 0; i < m_oldHashes.size(); i++) {
+    m_index[i].hash = m_oldHashes[i];
+    m_index[i].pos = oldPos + (int)i;
+  }
+  std::sort(m_index.begin(), m_index.end());
+
+  std::fill(m_votes.begin(), m_votes.end(), 0);
+  for (size_t i = 0; i < m_newHashes.size(); i++) {
+    HashEntry key = { m_newHashes[i], INT_MIN };
+    std::vector<HashEntry>::iterator first =
+      std::lower_bound(m_index.begin(), m_index.end(), key);
+    std::vector<HashEntry>::iterator last = first;
+    while (last != m_index.end() && last->hash == key.hash &&
+           (size_t)(last - first) <= MAX_HASH_MATCHES) {
+      last++;
+    }
+    if ((size_t)(last - first) > MAX_HASH_MATCHES) {
+      continue;
+    }
+    int pos = newPos + (int)i;
+    for (; first != last; first++) {
+      int shift = pos - first->pos;
+      if (shift != 0 && shift >= -MAX_SHIFT && shift <= MAX_SHIFT) {
+        m_votes[shift + MAX_SHIFT]++;
+      }
+    }
+  }
+
+  int bestShift = 0;
+  int bestVotes = MIN_MOVE_LENGTH - 1;
+  for (int shift = -MAX_SHIFT; shift <= MAX_SHIFT; shift++) {
+    if (m_votes[shift + MAX_SHIFT] > bestVotes) {
+      bestShift = shift;
+      bestVotes = m_votes[shift + MAX_SHIFT];
+    }
+  }
+  return bestShift;
+}
+
+UINT32 MotionEstimator::hashRow(const UINT8 *row, size_t len)
+{
+  UINT32 hash = FNV_OFFSET;
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ row[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+void MotionEstimator::hashColumns(const FrameBuffer *fb, const Rect *rect,
+                                  std::vector<UINT32> *hashes)
+{
+  const int bytesPerPixel = fb->getBytesPerPixel();
+  const int width = rect->getWidth();
+
+  hashes->assign(width, FNV_OFFSET);
+  UINT32 *hash = &hashes->front();
+  for (int y = rect->top; y < rect->bottom; y++) {
+    const UINT8 *pixel = (const UINT8 *)fb->getBufferPtr(rect->left, y);
+    for (int x = 0; x < width; x++) {
+      for (int i = 0; i < bytesPerPixel; i++) {
+        hash[x] = (hash[x] ^ *pixel++) * FNV_PRIME;
+      }
+    }
+  }
+}
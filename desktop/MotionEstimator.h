@@ -0,0 +1,98 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __MOTIONESTIMATOR_H__
+#define __MOTIONESTIMATOR_H__
+
+#include <vector>
+
+#include "rfb/FrameBuffer.h"
+#include "region/Rect.h"
+#include "region/Point.h"
+#include "util/inttypes.h"
+
+// MotionEstimator looks for scrolled or moved content by comparing pixels
+// of two frame buffers, so that it does not depend on window messages or
+// on a particular screen driver. Rows (columns) of the new frame buffer
+// are hashed and matched against hashes of the old one, every match votes
+// for a vertical (horizontal) shift, and the best shift is verified pixel
+// by pixel.
+class MotionEstimator
+{
+public:
+  // Areas smaller than this are not worth searching.
+  static const int MIN_AREA_WIDTH = 64;
+  static const int MIN_AREA_HEIGHT = 32;
+  // Maximal shift in pixels in either direction.
+  static const int MAX_SHIFT = 256;
+  // Minimal number of rows (columns) of a found move.
+  static const int MIN_MOVE_LENGTH = 16;
+
+  MotionEstimator();
+  virtual ~MotionEstimator();
+
+  // Searches `area' of newFb for a rectangle equal to the rectangle of the
+  // same size shifted vertically or horizontally in oldFb. Both frame
+  // buffers must have equal dimension and pixel format. On success returns
+  // true, `dst' lies inside `area' and `src' is the top left corner of the
+  // source rectangle.
+  bool findMove(const FrameBuffer *oldFb, const FrameBuffer *newFb,
+                const Rect *area, Rect *dst, Point *src);
+
+private:
+  struct HashEntry
+  {
+    UINT32 hash;
+    int pos;
+
+    bool operator<(const HashEntry &other) const
+    {
+      return hash < other.hash || (hash == other.hash && pos < other.pos);
+    }
+  };
+
+  bool findVerticalMove(const FrameBuffer *oldFb, const FrameBuffer *newFb,
+                        const Rect *area, Rect *dst, Point *src);
+  bool findHorizontalMove(const FrameBuffer *oldFb, const FrameBuffer *newFb,
+                          const Rect *area, Rect *dst, Point *src);
+
+  // Matches m_newHashes (the first one belongs to `newPos') against
+  // m_oldHashes (the first one belongs to `oldPos'). Returns the shift that
+  // got the most votes and is not zero, or zero if there is no good one.
+  int findBestShift(int newPos, int oldPos);
+
+  // Hashes `len' bytes of a row.
+  static UINT32 hashRow(const UINT8 *row, size_t len);
+  // Hashes columns of `rect' of the frame buffer into `hashes'.
+  static void hashColumns(const FrameBuffer *fb, const Rect *rect,
+                          std::vector<UINT32> *hashes);
+
+  std::vector<UINT32> m_newHashes;
+  std::vector<UINT32> m_oldHashes;
+  std::vector<HashEntry> m_index;
+  std::vector<int> m_votes;
+};
+
+#endif // __MOTIONESTIMATOR_H__
@@ -31,15 +31,16 @@ Poller::Poller(UpdateKeeper *updateKeeper,
                UpdateListener *updateListener,
                ScreenGrabber *screenGrabber,
                FrameBuffer *backupFrameBuffer,
+               TileHashMap *backupTileHashes,
                LocalMutex *frameBufferCriticalSection,
                LogWriter *log)
 : UpdateDetector(updateKeeper, updateListener),
   m_screenGrabber(screenGrabber),
   m_backupFrameBuffer(backupFrameBuffer),
+  m_backupTileHashes(backupTileHashes),
   m_fbMutex(frameBufferCriticalSection),
   m_log(log)
 {
-  m_pollingRect.setRect(0, 0, 16, 16);
 }
 
 Poller::~Poller()
@@ -81,23 +82,11 @@ void Poller::execute()
 				m_screenGrabber->grab();
 				m_log->info(_T("end of grabbing screen for polling"));
 
-				// Polling
-				int pollingWidth = m_pollingRect.getWidth();
-				int pollingHeight = m_pollingRect.getHeight();
-				int screenWidth = screenFrameBuffer->getDimension().width;
-				int screenHeight = screenFrameBuffer->getDimension().height;
-
-				Rect scanRect;
-				for (int iRow = 0; iRow < screenHeight; iRow += pollingHeight) {
-					for (int iCol = 0; iCol < screenWidth; iCol += pollingWidth) {
-						scanRect.setRect(iCol, iRow, min(iCol + pollingWidth, screenWidth),
-							min(iRow + pollingHeight, screenHeight));
-						if (!screenFrameBuffer->cmpFrom(&scanRect, m_backupFrameBuffer,
-							scanRect.left, scanRect.top)) {
-							region.addRect(&scanRect);
-						}
-					}
-				}
+				// Polling. Tiles of the screen are compared by their hashes against
+				// the hashes of the backup frame buffer, which is read only where
+				// the update filter has written it since the previous poll.
+				m_backupTileHashes->compare(screenFrameBuffer, m_backupFrameBuffer,
+				                            &region);
 
 				m_updateKeeper->addChangedRegion(&region);
 			}
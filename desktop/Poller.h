@@ -27,6 +27,7 @@
 
 #include "UpdateDetector.h"
 #include "ScreenGrabber.h"
+#include "TileHashMap.h"
 #include "rfb/FrameBuffer.h"
 #include "region/Rect.h"
 #include "win-system/WindowsEvent.h"
@@ -41,6 +42,7 @@ public:
          UpdateListener *updateListener,
          ScreenGrabber *screenGrabber,
          FrameBuffer *backupFrameBuffer,
+         TileHashMap *backupTileHashes,
          LocalMutex *frameBufferCriticalSection,
          LogWriter *log);
 
@@ -53,8 +55,9 @@ protected:
 private:
   ScreenGrabber *m_screenGrabber;
   FrameBuffer *m_backupFrameBuffer;
+  // Hashes of the tiles of the backup frame buffer.
+  TileHashMap *m_backupTileHashes;
   LocalMutex *m_fbMutex;
-  Rect m_pollingRect;
   WindowsEvent m_intervalWaiter;
 
   LogWriter *m_log;
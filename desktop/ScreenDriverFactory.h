@@ -28,14 +28,18 @@
 #include "ScreenDriver.h"
 #include "UpdateKeeper.h"
 #include "UpdateListener.h"
+#include "TileHashMap.h"
 #include "log-writer/LogWriter.h"
 
 class ScreenDriverFactory
 {
 public:
+  // The fbTileHashes object holds the tile hashes of the fb frame buffer,
+  // both are protected by fbLocalMutex.
   virtual ScreenDriver *createScreenDriver(UpdateKeeper *updateKeeper,
                                              UpdateListener *updateListener,
                                              FrameBuffer *fb,
+                                             TileHashMap *fbTileHashes,
                                              LocalMutex *fbLocalMutex,
                                              LogWriter *log) = 0;
 private:
@@ -0,0 +1,170 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "TileHashMap.h"
+
+#include <string.h>
+
+static const UINT64 HASH_SEED  = 0x27D4EB2F165667C5ULL;
+static const UINT64 HASH_PRIME1 = 0x9E3779B185EBCA87ULL;
+static const UINT64 HASH_PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+
+static inline UINT64 rotateLeft(UINT64 value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+TileHashMap::TileHashMap(int tileWidth, int tileHeight)
+: m_tileWidth(tileWidth),
+  m_tileHeight(tileHeight),
+  m_isValid(false),
+  m_tilesInRow(0),
+  m_tilesInColumn(0)
+{
+}
+
+TileHashMap::~TileHashMap()
+{
+}
+
+void TileHashMap::reset()
+{
+  m_isValid = false;
+}
+
+void TileHashMap::invalidate(const Rect *rect)
+{
+  if (!m_isValid || rect->isEmpty()) {
+    return;
+  }
+  int left = max(rect->left, 0) / m_tileWidth;
+  int top = max(rect->top, 0) / m_tileHeight;
+  int right = min((rect->right + m_tileWidth - 1) / m_tileWidth, m_tilesInRow);
+  int bottom = min((rect->bottom + m_tileHeight - 1) / m_tileHeight,
+                   m_tilesInColumn);
+  for (int row = top; row < bottom; row++) {
+    for (int i = left; i < right; i++) {
+      m_isStale[(size_t)row * m_tilesInRow + i] = 1;
+    }
+  }
+}
+
+UINT64 TileHashMap::hashBytes(UINT64 hash, const UINT8 *data, size_t len)
+{
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    UINT64 word;
+    memcpy(&word, data + i, 8);
+    hash = rotateLeft(hash ^ (word * HASH_PRIME2), 31) * HASH_PRIME1;
+  }
+  for (; i < len; i++) {
+    hash = rotateLeft(hash ^ (data[i] * HASH_PRIME1), 11) * HASH_PRIME2;
+  }
+  return hash;
+}
+
+UINT64 TileHashMap::hashRect(const FrameBuffer *frameBuffer, const Rect *rect)
+{
+  size_t len = (size_t)rect->getWidth() * frameBuffer->getBytesPerPixel();
+  int stride = frameBuffer->getBytesPerRow();
+  const UINT8 *line =
+    (const UINT8 *)frameBuffer->getBufferPtr(rect->left, rect->top);
+
+  UINT64 hash = HASH_SEED;
+  for (int y = rect->top; y < rect->bottom; y++, line += stride) {
+    hash = hashBytes(hash, line, len);
+  }
+  return hash;
+}
+
+void TileHashMap::compare(const FrameBuffer *screenFb,
+                          const FrameBuffer *backupFb,
+                          Region *changedRegion)
+{
+  Dimension dim = screenFb->getDimension();
+  PixelFormat pf = screenFb->getPixelFormat();
+
+  if (!m_isValid || !m_dim.cmpDim(&dim) || !m_pf.isEqualTo(&pf)) {
+    m_dim = dim;
+    m_pf = pf;
+    m_tilesInRow = (dim.width + m_tileWidth - 1) / m_tileWidth;
+    m_tilesInColumn = (dim.height + m_tileHeight - 1) / m_tileHeight;
+    m_hashes.assign((size_t)m_tilesInRow * m_tilesInColumn, 0);
+    m_isStale.assign((size_t)m_tilesInRow * m_tilesInColumn, 1);
+    m_rowHashes.resize(m_tilesInRow);
+    m_isValid = true;
+  }
+
+  if (dim.width <= 0 || dim.height <= 0) {
+    return;
+  }
+
+  size_t bytesPerPixel = screenFb->getBytesPerPixel();
+  size_t bytesPerRow = screenFb->getBytesPerRow();
+  size_t tileBytes = m_tileWidth * bytesPerPixel;
+  size_t lineBytes = dim.width * bytesPerPixel;
+  const UINT8 *buffer = (const UINT8 *)screenFb->getBuffer();
+
+  UINT64 *storedHashes = &m_hashes.front();
+  UINT8 *staleFlags = &m_isStale.front();
+  UINT64 *rowHashes = &m_rowHashes.front();
+
+  for (int top = 0, tileRow = 0; top < dim.height;
+       top += m_tileHeight, tileRow++) {
+    int bottom = min(top + m_tileHeight, dim.height);
+
+    for (int i = 0; i < m_tilesInRow; i++) {
+      rowHashes[i] = HASH_SEED;
+    }
+    // Walk the frame buffer line by line so that it is read sequentially,
+    // feeding each line segment into the hash of its tile.
+    for (int y = top; y < bottom; y++) {
+      const UINT8 *line = buffer + y * bytesPerRow;
+      size_t offset = 0;
+      for (int i = 0; i < m_tilesInRow; i++, offset += tileBytes) {
+        size_t len = min(tileBytes, lineBytes - offset);
+        rowHashes[i] = hashBytes(rowHashes[i], line + offset, len);
+      }
+    }
+
+    // Compare with the hashes of the backup, only the tiles written to the
+    // backup since the previous call are read from it.
+    size_t rowStart = (size_t)tileRow * m_tilesInRow;
+    UINT64 *stored = storedHashes + rowStart;
+    UINT8 *stale = staleFlags + rowStart;
+    for (int i = 0; i < m_tilesInRow; i++) {
+      Rect tile(i * m_tileWidth, top,
+                min((i + 1) * m_tileWidth, dim.width), bottom);
+      if (stale[i]) {
+        stored[i] = hashRect(backupFb, &tile);
+        stale[i] = 0;
+      }
+      if (stored[i] != rowHashes[i]) {
+        m_changedTiles.addRect(&tile);
+      }
+    }
+  }
+  m_changedTiles.flushTo(changedRegion);
+}
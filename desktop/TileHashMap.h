@@ -0,0 +1,89 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __TILEHASHMAP_H__
+#define __TILEHASHMAP_H__
+
+#include <vector>
+
+#include "rfb/FrameBuffer.h"
+#include "region/RegionBuilder.h"
+#include "util/inttypes.h"
+
+// TileHashMap keeps a 64-bit hash of every tile of the backup frame buffer,
+// the copy of the screen the clients have been sent. This lets a polling
+// detector find the tiles where the screen differs from the backup reading
+// only the screen, once and in memory order. Whoever writes pixels of the
+// backup frame buffer invalidates their tiles, and the hashes of those tiles
+// are taken from the backup again on the next compare().
+//
+// The object is not thread safe, it's used under the lock of the backup
+// frame buffer.
+class TileHashMap
+{
+public:
+  TileHashMap(int tileWidth, int tileHeight);
+  virtual ~TileHashMap();
+
+  // Hashes all tiles of `screenFb' and adds the tiles whose hashes differ
+  // from the hashes of `backupFb' to `changedRegion'. Both frame buffers must
+  // have the same dimension and pixel format.
+  void compare(const FrameBuffer *screenFb, const FrameBuffer *backupFb,
+               Region *changedRegion);
+
+  // Marks the tiles overlapping `rect' as changed in the backup frame buffer.
+  void invalidate(const Rect *rect);
+
+  // Marks all tiles as changed in the backup frame buffer.
+  void reset();
+
+  // Returns the hash of the pixels of `rect', which must lie within
+  // `frameBuffer'. Equal pixels give equal hashes in any frame buffer.
+  static UINT64 hashRect(const FrameBuffer *frameBuffer, const Rect *rect);
+
+private:
+  // Mixes `len' bytes at `data' into the running hash `hash'.
+  static UINT64 hashBytes(UINT64 hash, const UINT8 *data, size_t len);
+
+  int m_tileWidth;
+  int m_tileHeight;
+
+  Dimension m_dim;
+  PixelFormat m_pf;
+  bool m_isValid;
+
+  int m_tilesInRow;
+  int m_tilesInColumn;
+  // Hashes of the backup tiles in row-major order.
+  std::vector<UINT64> m_hashes;
+  // Nonzero for the tiles whose hashes must be taken from the backup again.
+  std::vector<UINT8> m_isStale;
+  // Running hashes of the tiles of the current tile row.
+  std::vector<UINT64> m_rowHashes;
+  // Collects changed tiles in scan order.
+  RegionBuilder m_changedTiles;
+};
+
+#endif // __TILEHASHMAP_H__
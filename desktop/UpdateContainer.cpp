@@ -24,6 +24,13 @@
 
 #include "UpdateContainer.h"
 
+Rect CopiedRect::getSrcRect() const
+{
+  Rect srcRect(&dst);
+  srcRect.setLocation(src.x, src.y);
+  return srcRect;
+}
+
 UpdateContainer::UpdateContainer()
 {
   clear();
@@ -35,25 +42,24 @@ UpdateContainer::~UpdateContainer(void)
 
 void UpdateContainer::clear()
 {
-  copiedRegion.clear();
+  clearCopies();
   changedRegion.clear();
   videoRegion.clear();
   screenSizeChanged = false;
   cursorPosChanged = false;
   cursorShapeChanged = false;
-  copySrc.clear();
   //cursorPos.clear();
 }
 
 UpdateContainer& UpdateContainer::operator=(const UpdateContainer& src)
 {
   copiedRegion        = src.copiedRegion;
+  copiedRects         = src.copiedRects;
   changedRegion       = src.changedRegion;
   videoRegion         = src.videoRegion;
   screenSizeChanged   = src.screenSizeChanged;
   cursorPosChanged    = src.cursorPosChanged;
   cursorShapeChanged  = src.cursorShapeChanged;
-  copySrc             = src.copySrc;
   cursorPos           = src.cursorPos;
 
   return *this;
@@ -68,3 +74,44 @@ bool UpdateContainer::isEmpty() const
          !cursorPosChanged &&
          !cursorShapeChanged;
 }
+
+void UpdateContainer::addCopy(const Rect *dst, const Point *src)
+{
+  copiedRects.push_back(CopiedRect(dst, src));
+  copiedRegion.addRect(dst);
+}
+
+void UpdateContainer::clearCopies()
+{
+  copiedRegion.clear();
+  copiedRects.clear();
+}
+
+void UpdateContainer::declineCopies()
+{
+  changedRegion.add(&copiedRegion);
+  clearCopies();
+}
+
+void UpdateContainer::translateCopies(int dx, int dy)
+{
+  copiedRegion.translate(dx, dy);
+  std::vector<CopiedRect>::iterator iCopy;
+  for (iCopy = copiedRects.begin(); iCopy < copiedRects.end(); iCopy++) {
+    iCopy->dst.move(dx, dy);
+    iCopy->src.move(dx, dy);
+  }
+}
+
+bool UpdateContainer::copiesInside(const Region *region) const
+{
+  Region outside;
+  std::vector<CopiedRect>::const_iterator iCopy;
+  for (iCopy = copiedRects.begin(); iCopy < copiedRects.end(); iCopy++) {
+    outside.addRect(&iCopy->dst);
+    Rect srcRect = iCopy->getSrcRect();
+    outside.addRect(&srcRect);
+  }
+  outside.subtract(region);
+  return outside.isEmpty();
+}
@@ -28,6 +28,22 @@
 #include "region/Region.h"
 #include "region/Point.h"
 
+#include <vector>
+
+// Single CopyRect operation: the destination rectangle receives the pixels
+// of the rectangle of the same size located at the source point.
+struct CopiedRect
+{
+  CopiedRect() {}
+  CopiedRect(const Rect *dstRect, const Point *srcPoint)
+  : dst(dstRect), src(*srcPoint) {}
+
+  Rect getSrcRect() const;
+
+  Rect dst;
+  Point src;
+};
+
 class UpdateContainer
 {
 public:
@@ -37,17 +53,32 @@ public:
   UpdateContainer(const UpdateContainer& updateContainer) { *this = updateContainer; }
   UpdateContainer &operator=(const UpdateContainer& src);
 
+  // Union of the destination rectangles of copiedRects.
   Region copiedRegion;
+  // CopyRect operations in the order they must be applied. Changed pixels
+  // are applied after all the copies.
+  std::vector<CopiedRect> copiedRects;
   Region changedRegion;
   Region videoRegion;
   bool screenSizeChanged;
   bool cursorPosChanged;
   bool cursorShapeChanged;
-  Point copySrc;
   Point cursorPos;
 
   void clear();
   bool isEmpty() const;
+
+  // Appends a CopyRect operation to the end of the copy list.
+  void addCopy(const Rect *dst, const Point *src);
+  // Forgets all copies.
+  void clearCopies();
+  // Converts all copies to changed pixels.
+  void declineCopies();
+  // Moves destinations and sources of all copies by (dx, dy).
+  void translateCopies(int dx, int dy);
+  // Returns true if both destinations and sources of all copies lie
+  // inside the region.
+  bool copiesInside(const Region *region) const;
 };
 
 #endif // __UPDATECONTAINER_H__
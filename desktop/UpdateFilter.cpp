@@ -25,14 +25,27 @@
 #include "UpdateFilter.h"
 #include "util/CommonHeader.h"
 
-static const int BLOCK_SIZE = 32;
+#include <algorithm>
+
+static bool isLargerRect(const Rect &a, const Rect &b)
+{
+  return a.area() > b.area();
+}
+
+static bool isTooSmallForMove(const Rect &r)
+{
+  return r.getWidth() < MotionEstimator::MIN_AREA_WIDTH ||
+         r.getHeight() < MotionEstimator::MIN_AREA_HEIGHT;
+}
 
 UpdateFilter::UpdateFilter(ScreenDriver *screenDriver,
                            FrameBuffer *frameBuffer,
+                           TileHashMap *frameBufferTileHashes,
                            LocalMutex *frameBufferCriticalSection,
                            LogWriter *log)
 : m_screenDriver(screenDriver),
   m_frameBuffer(frameBuffer),
+  m_fbTileHashes(frameBufferTileHashes),
   m_fbMutex(frameBufferCriticalSection),
   m_grabOptimizator(log),
   m_log(log)
@@ -61,11 +74,12 @@ void UpdateFilter::filter(UpdateContainer *updateContainer)
   std::vector<Rect> rects;
   std::vector<Rect>::iterator iRect;
 
-  // Reproduce CopyRect operations in m_frameBuffer.
-  updateContainer->copiedRegion.getRectVector(&rects);
-  Point *src = &updateContainer->copySrc;
-  for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
-    m_frameBuffer->move(&(*iRect), src->x, src->y);
+  // Reproduce CopyRect operations in m_frameBuffer in their order.
+  std::vector<CopiedRect>::iterator iCopy;
+  for (iCopy = updateContainer->copiedRects.begin();
+       iCopy < updateContainer->copiedRects.end(); iCopy++) {
+    m_frameBuffer->move(&iCopy->dst, iCopy->src.x, iCopy->src.y);
+    m_fbTileHashes->invalidate(&iCopy->dst);
   }
 
 
@@ -87,196 +101,135 @@ void UpdateFilter::filter(UpdateContainer *updateContainer)
     getChangedRegion(&updateContainer->changedRegion, rect);
   }
 
+  detectMoves(updateContainer);
+
   // Copy actually changed pixels into m_frameBuffer.
   updateContainer->changedRegion.getRectVector(&rects);
   for (iRect = rects.begin(); iRect < rects.end(); iRect++) {
     rect = &(*iRect);
     m_frameBuffer->copyFrom(rect, screenFrameBuffer, rect->left, rect->top);
+    m_fbTileHashes->invalidate(rect);
   }
 }
 
-void UpdateFilter::getChangedRegion(Region *rgn, const Rect *rect)
+void UpdateFilter::detectMoves(UpdateContainer *updateContainer)
 {
-  
-  const UINT bytesPerPixel = m_frameBuffer->getBytesPerPixel();
-  const int bytes_per_scanline = (rect->right - rect->left) * bytesPerPixel;
-
-  const int bytesPerRow = m_frameBuffer->getBytesPerRow();
-  const int offset = rect->top * bytesPerRow + rect->left * bytesPerPixel;
-  unsigned char *o_ptr = (unsigned char *)m_frameBuffer->getBuffer() + offset;
-  unsigned char *n_ptr = (unsigned char *)m_screenDriver->getScreenBuffer()->getBuffer() + offset;
-
-  Rect new_rect = rect;
+  FrameBuffer *screenFrameBuffer = m_screenDriver->getScreenBuffer();
 
-  // Fast processing for small rectangles
-  if ( rect->right - rect->left <= BLOCK_SIZE &&
-       rect->bottom - rect->top <= BLOCK_SIZE ) {
-      for (int y = rect->top; y < rect->bottom; y++) {
-        if (memcmp(o_ptr, n_ptr, bytes_per_scanline) != 0) {
-          new_rect.top = y;
-          updateChangedSubRect(rgn, &new_rect);
-          break;
-        }
-        o_ptr += bytesPerRow;
-        n_ptr += bytesPerRow;
-      }
-      return;
+  m_movedAreas.clear();
+  updateContainer->changedRegion.getRectVector(&m_movedAreas);
+
+  // Every search hashes the rows around the rectangle under the frame
+  // buffer lock, so only the largest rectangles are searched.
+  m_movedAreas.erase(std::remove_if(m_movedAreas.begin(), m_movedAreas.end(),
+                                    isTooSmallForMove),
+                     m_movedAreas.end());
+  if (m_movedAreas.size() > MAX_MOVE_SEARCHES_PER_UPDATE) {
+    std::partial_sort(m_movedAreas.begin(),
+                      m_movedAreas.begin() + MAX_MOVE_SEARCHES_PER_UPDATE,
+                      m_movedAreas.end(), isLargerRect);
+    m_movedAreas.resize(MAX_MOVE_SEARCHES_PER_UPDATE);
   }
 
-  // Process bigger rectangles
-  new_rect.top = -1;
-  for (int y = rect->top; y < rect->bottom; y++) {
-    if (memcmp(o_ptr, n_ptr, bytes_per_scanline) != 0) {
-      if (new_rect.top == -1) {
-        new_rect.top = y;
-      }
-      // Skip a number of lines after a non-matched one
-      int n = BLOCK_SIZE / 2 - 1;
-      y += n;
-      o_ptr += n * bytesPerRow;
-      n_ptr += n * bytesPerRow;
-    } else {
-      if (new_rect.top != -1) {
-        new_rect.bottom = y;
-        updateChangedRect(rgn, &new_rect);
-        new_rect.top = -1;
-      }
+  int movesFound = 0;
+  std::vector<Rect>::iterator iRect;
+  for (iRect = m_movedAreas.begin();
+       iRect < m_movedAreas.end() && movesFound < MAX_MOVES_PER_UPDATE;
+       iRect++) {
+    Rect dst;
+    Point src;
+    // m_frameBuffer already has the previous moves applied, the same way
+    // the client will have, so each found move is exact.
+    if (m_motionEstimator.findMove(m_frameBuffer, screenFrameBuffer,
+                                   &(*iRect), &dst, &src)) {
+      m_frameBuffer->move(&dst, src.x, src.y);
+      m_fbTileHashes->invalidate(&dst);
+      updateContainer->addCopy(&dst, &src);
+      Region dstRegion(&dst);
+      updateContainer->changedRegion.subtract(&dstRegion);
+      movesFound++;
     }
-    o_ptr += bytesPerRow;
-    n_ptr += bytesPerRow;
   }
-  if (new_rect.top != -1) {
-    new_rect.bottom = rect->bottom;
-    updateChangedRect(rgn, &new_rect);
+  if (movesFound != 0) {
+    m_log->debug(_T("detected %d moved rectangles"), movesFound);
   }
 }
 
-void UpdateFilter::updateChangedRect(Region *rgn, const Rect *rect)
+void UpdateFilter::getChangedRegion(Region *rgn, const Rect *rect)
 {
-  // Pass small rectangles directly to updateChangedSubRect
-  if ( rect->right - rect->left <= BLOCK_SIZE &&
-       rect->bottom - rect->top <= BLOCK_SIZE ) {
-      updateChangedSubRect(rgn, rect);
-      return;
-  }
-
-  const UINT bytesPerPixel = m_frameBuffer->getBytesPerPixel();
-
-  Rect new_rect;
-  int x, y, ay;
-
-  // Scan down the rectangle
-  const int bytesPerRow = m_frameBuffer->getBytesPerRow();
-  const int offset = rect->top * bytesPerRow + rect->left * bytesPerPixel;
-  unsigned char *o_topleft_ptr = (unsigned char *)m_frameBuffer->getBuffer() + offset;
-  unsigned char *n_topleft_ptr = (unsigned char *)m_screenDriver->getScreenBuffer()->getBuffer() + offset;
-
-  for (y = rect->top; y < rect->bottom; y += BLOCK_SIZE)
-  {
-    // Work out way down the bitmap
-    unsigned char *o_row_ptr = o_topleft_ptr;
-    unsigned char *n_row_ptr = n_topleft_ptr;
-
-    const int blockbottom = min(y + BLOCK_SIZE, rect->bottom);
-    new_rect.bottom = blockbottom;
-    new_rect.left = -1;
-
-    for (x = rect->left; x < rect->right; x += BLOCK_SIZE)
-    {
-      // Work our way across the row
-      unsigned char *n_block_ptr = n_row_ptr;
-      unsigned char *o_block_ptr = o_row_ptr;
-
-      const UINT blockright = min(x + BLOCK_SIZE, rect->right);
-      const UINT bytesPerBlockRow = (blockright-x) * bytesPerPixel;
-
-      // Scan this block
-      for (ay = y; ay < blockbottom; ay++) {
-        if (memcmp(n_block_ptr, o_block_ptr, bytesPerBlockRow) != 0)
-          break;
-        n_block_ptr += bytesPerRow;
-        o_block_ptr += bytesPerRow;
-      }
-      if (ay < blockbottom) {
-        // There were changes, so this block will need to be updated
-        if (new_rect.left == -1) {
-          new_rect.left = x;
-          new_rect.top = ay;
-        } else if (ay < new_rect.top) {
-          new_rect.top = ay;
-        }
-      } else {
-        // No changes in this block, process previous changed blocks if any
-        if (new_rect.left != -1) {
-          new_rect.right = x;
-          updateChangedSubRect(rgn, &new_rect);
-          new_rect.left = -1;
-        }
-      }
+  FrameBuffer *screenFrameBuffer = m_screenDriver->getScreenBuffer();
 
-      o_row_ptr += bytesPerBlockRow;
-      n_row_ptr += bytesPerBlockRow;
-    }
+  // Find changed blocks in one pass over the rectangle, then shrink every
+  // run of changed blocks to the actually changed pixels.
+  m_blockRuns.clear();
+  m_blockDetector.findDirtyBlocks(m_frameBuffer, screenFrameBuffer, rect,
+                                  &m_blockRuns);
 
-    if (new_rect.left != -1) {
-      new_rect.right = rect->right;
-      updateChangedSubRect(rgn, &new_rect);
-    }
-
-    o_topleft_ptr += bytesPerRow * BLOCK_SIZE;
-    n_topleft_ptr += bytesPerRow * BLOCK_SIZE;
+  m_changedRects.clear();
+  std::vector<Rect>::iterator iRect;
+  for (iRect = m_blockRuns.begin(); iRect < m_blockRuns.end(); iRect++) {
+    updateChangedSubRect(&m_changedRects, &(*iRect));
   }
+  rgn->addRects(&m_changedRects);
 }
 
-void UpdateFilter::updateChangedSubRect(Region *rgn, const Rect *rect)
+void UpdateFilter::updateChangedSubRect(std::vector<Rect> *changedRects,
+                                        const Rect *rect)
 {
   const UINT bytesPerPixel = m_frameBuffer->getBytesPerPixel();
-  int bytes_in_row = (rect->right - rect->left) * bytesPerPixel;
-  int y, i;
+  const int bytes_in_row = (rect->right - rect->left) * bytesPerPixel;
+  const FrameBuffer *screenFb = m_screenDriver->getScreenBuffer();
+  const int o_stride = m_frameBuffer->getBytesPerRow();
+  const int n_stride = screenFb->getBytesPerRow();
+  const UINT8 *o_base = (const UINT8 *)m_frameBuffer->getBufferPtr(rect->left, 0);
+  const UINT8 *n_base = (const UINT8 *)screenFb->getBufferPtr(rect->left, 0);
+  Rect final_rect = rect;
+  int y;
+
+  // Exclude unchanged scan lines at the top
+  for (y = rect->top; y < rect->bottom - 1; y++) {
+    if (m_blockDetector.differ(o_base + y * o_stride,
+                               n_base + y * n_stride, bytes_in_row)) {
+      break;
+    }
+  }
+  final_rect.top = y;
 
   // Exclude unchanged scan lines at the bottom
-  const int bytesPerRow = m_frameBuffer->getBytesPerRow();
-  int offset = (rect->bottom - 1) * bytesPerRow + rect->left * bytesPerPixel;
-  unsigned char *o_ptr = (unsigned char *)m_frameBuffer->getBuffer() + offset;
-  unsigned char *n_ptr = (unsigned char *)m_screenDriver->getScreenBuffer()->getBuffer() + offset;
-  Rect final_rect = rect;
-  final_rect.bottom = rect->top + 1;
-  for (y = rect->bottom - 1; y > rect->top; y--) {
-    if (memcmp(o_ptr, n_ptr, bytes_in_row) != 0) {
-      final_rect.bottom = y + 1;
+  for (y = rect->bottom - 1; y > final_rect.top; y--) {
+    if (m_blockDetector.differ(o_base + y * o_stride,
+                               n_base + y * n_stride, bytes_in_row)) {
       break;
     }
-    n_ptr -= bytesPerRow;
-    o_ptr -= bytesPerRow;
   }
+  final_rect.bottom = y + 1;
 
   // Exclude unchanged pixels at left and right sides
-  offset = final_rect.top * bytesPerRow + final_rect.left * bytesPerPixel;
-  o_ptr = (unsigned char *)m_frameBuffer->getBuffer() + offset;
-  n_ptr = (unsigned char *)m_screenDriver->getScreenBuffer()->getBuffer() + offset;
   int left_delta = bytes_in_row - 1;
   int right_delta = 0;
   for (y = final_rect.top; y < final_rect.bottom; y++) {
-    for (i = 0; i < bytes_in_row - 1; i++) {
-      if (n_ptr[i] != o_ptr[i]) {
-        if (i < left_delta)
-          left_delta = i;
-        break;
-      }
+    const UINT8 *o_ptr = o_base + y * o_stride;
+    const UINT8 *n_ptr = n_base + y * n_stride;
+    int first = m_blockDetector.findFirstDiff(o_ptr, n_ptr, left_delta);
+    if (first >= 0) {
+      left_delta = first;
+    }
+    int last = m_blockDetector.findLastDiff(o_ptr + right_delta + 1,
+                                            n_ptr + right_delta + 1,
+                                            bytes_in_row - right_delta - 1);
+    if (last >= 0) {
+      right_delta += last + 1;
     }
-    for (i = bytes_in_row - 1; i > 0; i--) {
-      if (n_ptr[i] != o_ptr[i]) {
-        if (i > right_delta)
-          right_delta = i;
-        break;
-      }
+    if (left_delta == 0 && right_delta == bytes_in_row - 1) {
+      break;
     }
-    n_ptr += bytesPerRow;
-    o_ptr += bytesPerRow;
+  }
+  if (right_delta < left_delta) {
+    right_delta = left_delta;
   }
   final_rect.right = final_rect.left + right_delta / bytesPerPixel + 1;
   final_rect.left += left_delta / bytesPerPixel;
 
   // Update the rectangle
-  rgn->addRect(&final_rect);
+  changedRects->push_back(final_rect);
 }
@@ -31,12 +31,16 @@
 #include "thread/LocalMutex.h"
 #include "UpdateContainer.h"
 #include "GrabOptimizator.h"
+#include "DirtyBlockDetector.h"
+#include "MotionEstimator.h"
+#include "TileHashMap.h"
 
 class UpdateFilter
 {
 public:
   UpdateFilter(ScreenDriver *screenDriver,
                FrameBuffer *frameBuffer,
+               TileHashMap *frameBufferTileHashes,
                LocalMutex *frameBufferCriticalSection,
                LogWriter *log);
   ~UpdateFilter();
@@ -44,9 +48,20 @@ public:
   void filter(UpdateContainer *updateContainer);
 
 private:
+  // Maximal number of moves detected by pixels in one update.
+  static const int MAX_MOVES_PER_UPDATE = 8;
+  // Maximal number of changed rectangles searched for moves in one update,
+  // the largest ones are searched.
+  static const size_t MAX_MOVE_SEARCHES_PER_UPDATE = 16;
+
+  // Finds changed rectangles which are moved pixels of m_frameBuffer, turns
+  // them to CopyRect operations and applies them to m_frameBuffer.
+  void detectMoves(UpdateContainer *updateContainer);
+  // Adds changed parts of the rectangle to the region.
   void getChangedRegion(Region *rgn, const Rect *rect);
-  void updateChangedRect(Region *rgn, const Rect *rect);
-  void updateChangedSubRect(Region *rgn, const Rect *rect);
+  // Shrinks a changed rectangle to the bounds of the actually changed
+  // pixels and appends the result to the list.
+  void updateChangedSubRect(std::vector<Rect> *changedRects, const Rect *rect);
 
   // This function update the screen grabber frame buffer.
   // If success the function returns the true.
@@ -56,9 +71,21 @@ private:
 
   ScreenDriver *m_screenDriver;
   FrameBuffer *m_frameBuffer;
+  // Tiles of m_frameBuffer written here are invalidated in this map.
+  TileHashMap *m_fbTileHashes;
   LocalMutex *m_fbMutex;
   GrabOptimizator m_grabOptimizator;
 
+  DirtyBlockDetector m_blockDetector;
+  // Scratch list of changed block runs, kept here to avoid reallocations.
+  std::vector<Rect> m_blockRuns;
+  // Scratch list of the changed rectangles, added to the region at once.
+  std::vector<Rect> m_changedRects;
+
+  MotionEstimator m_motionEstimator;
+  // Scratch list of the areas where moves are searched for.
+  std::vector<Rect> m_movedAreas;
+
   LogWriter *m_log;
 };
 
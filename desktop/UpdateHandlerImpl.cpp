@@ -23,22 +23,27 @@
 //
 
 #include "UpdateHandlerImpl.h"
+#include "server-config-lib/Configurator.h"
+#include "util/DateTime.h"
 
 UpdateHandlerImpl::UpdateHandlerImpl(UpdateListener *externalUpdateListener, ScreenDriverFactory *scrDriverFactory,
                                      LogWriter *log)
-: m_externalUpdateListener(externalUpdateListener),
+: m_backupTileHashes(POLLING_TILE_SIZE, POLLING_TILE_SIZE),
+  m_externalUpdateListener(externalUpdateListener),
   m_fullUpdateRequested(false),
   m_log(log)
 {
   m_screenDriver = scrDriverFactory->createScreenDriver(&m_updateKeeper,
                                                         this,
                                                         &m_backupFrameBuffer,
+                                                        &m_backupTileHashes,
                                                         &m_fbLocMut, log);
   // At this point the screen driver must contain valid screen properties.
   m_backupFrameBuffer.assignProperties(m_screenDriver->getScreenBuffer());
   m_updateKeeper.setBorderRect(&m_screenDriver->getScreenDimension().getRect());
   m_updateFilter = new UpdateFilter(m_screenDriver,
                                     &m_backupFrameBuffer,
+                                    &m_backupTileHashes,
                                     &m_fbLocMut, log);
 
   // At this point all common resources will be covered the mutex for changes.
@@ -79,6 +84,8 @@ void UpdateHandlerImpl::extract(UpdateContainer *updateContainer)
 
   m_updateFilter->filter(updateContainer);
 
+  detectVideoRegion(updateContainer);
+
   if (!m_absoluteRect.isEmpty()) {
     updateContainer->changedRegion.addRect(&m_screenDriver->getScreenBuffer()->
                                            getDimension().getRect());
@@ -101,9 +108,10 @@ void UpdateHandlerImpl::extract(UpdateContainer *updateContainer)
       // may be invoked from other threads and then it shall cover by the mutex.
       AutoLock al(&m_fbLocMut);
       m_backupFrameBuffer.clone(m_screenDriver->getScreenBuffer());
+      m_backupTileHashes.reset();
     }
     updateContainer->changedRegion.clear();
-    updateContainer->copiedRegion.clear();
+    updateContainer->clearCopies();
     m_absoluteRect = m_backupFrameBuffer.getDimension().getRect();
     m_updateKeeper.setBorderRect(&m_absoluteRect);
   }
@@ -121,6 +129,32 @@ void UpdateHandlerImpl::extract(UpdateContainer *updateContainer)
   }
 }
 
+void UpdateHandlerImpl::detectVideoRegion(UpdateContainer *updateContainer)
+{
+  ServerConfig *srvConf = Configurator::getInstance()->getServerConfig();
+  if (!srvConf->getAutoVideoDetectionFlag()) {
+    m_videoRegionDetector.reset();
+    return;
+  }
+  m_videoRegionDetector.setRateThreshold(srvConf->getVideoDetectionRate());
+  m_videoRegionDetector.setMinSize(srvConf->getVideoDetectionMinSize());
+
+  // The changed region still includes the video region here, so a
+  // detected area is dropped as soon as it calms down.
+  Dimension fbDim = m_backupFrameBuffer.getDimension();
+  m_videoRegionDetector.update(&updateContainer->changedRegion, &fbDim,
+                               DateTime::now().getTime());
+
+  Region detectedRegion;
+  m_videoRegionDetector.getVideoRegion(&detectedRegion);
+  if (!detectedRegion.isEmpty()) {
+    m_log->debug(_T("Detected video region, bounds: %dx%d"),
+                 detectedRegion.getBounds().getWidth(),
+                 detectedRegion.getBounds().getHeight());
+    updateContainer->videoRegion.add(&detectedRegion);
+  }
+}
+
 void UpdateHandlerImpl::applyNewScreenProperties()
 {
   int applyTryCount = 3;
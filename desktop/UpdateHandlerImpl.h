@@ -28,6 +28,8 @@
 #include "UpdateHandler.h"
 #include "ScreenDriver.h"
 #include "ScreenDriverFactory.h"
+#include "TileHashMap.h"
+#include "VideoRegionDetector.h"
 
 // This class contain a base architecture implementation of the UpdateHandler class.
 class UpdateHandlerImpl : public UpdateHandler, public UpdateListener
@@ -58,10 +60,19 @@ private:
 
   void applyNewScreenProperties();
 
+  // Adds to the video region the areas that are updated as often as video.
+  void detectVideoRegion(UpdateContainer *updateContainer);
+
+  // Size of the tiles the screen is polled by.
+  static const int POLLING_TILE_SIZE = 16;
+
+  // Hashes of the tiles of m_backupFrameBuffer, protected by m_fbLocMut.
+  TileHashMap m_backupTileHashes;
   UpdateKeeper m_updateKeeper;
   ScreenDriver *m_screenDriver;
   UpdateFilter *m_updateFilter;
   UpdateListener *m_externalUpdateListener;
+  VideoRegionDetector m_videoRegionDetector;
 
   Rect m_absoluteRect;
 
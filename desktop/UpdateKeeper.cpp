@@ -63,8 +63,6 @@ void UpdateKeeper::addCopyRect(const Rect *copyRect, const Point *src)
   }
 
   Region *changedRegion = &m_updateContainer.changedRegion;
-  Region *copiedRegion = &m_updateContainer.copiedRegion;
-  Point *copySrc = &m_updateContainer.copySrc;
   Rect dstCopyRect(copyRect);
 
   // Create copy of copyRect in the source coordinates.
@@ -91,8 +89,7 @@ void UpdateKeeper::addCopyRect(const Rect *copyRect, const Point *src)
     return;
   }
 
-  copySrc->x = srcCopyRect.left;
-  copySrc->y = srcCopyRect.top;
+  Point copySrc(srcCopyRect.left, srcCopyRect.top);
 
   // Adding difference between clipped dstCopyRect and original copyRect
   // to changedRegion. Because without update detectors this information
@@ -102,32 +99,31 @@ void UpdateKeeper::addCopyRect(const Rect *copyRect, const Point *src)
   diff.subtract(&dstCopyRegion);
   addChangedRegion(&diff);
 
-  // Old copiedRegion must be added to changedRegion - (?)
-  if (!copiedRegion->isEmpty()) {
-    changedRegion->add(copiedRegion);
-    copiedRegion->clear();
-    addChangedRect(copyRect);
+  // Too long chain of copies is not worth keeping, send pixels instead.
+  if (m_updateContainer.copiedRects.size() >= MAX_COPIED_RECTS) {
+    addChangedRect(&dstCopyRect);
     return;
   }
 
-  copiedRegion->clear();
-  copiedRegion->addRect(&dstCopyRect);
-
-  // copiedRegion must be substracted from changedRegion
-  changedRegion->subtract(copiedRegion);
-
   // Create region that is intersection of changedRegion and srcCopyRect.
+  // The client copies old pixels there, so the changes must follow the copy.
   Region addonChangedRegion(&srcCopyRect);
   addonChangedRegion.intersect(changedRegion);
 
+  // The copy is applied after the previous ones, and changed pixels are
+  // applied after all the copies.
+  m_updateContainer.addCopy(&dstCopyRect, &copySrc);
+
+  // dstCopyRect must be substracted from changedRegion
+  changedRegion->subtract(&dstCopyRegion);
+
   // Move addonChangedRegion and add it to changedRegion.
-  addonChangedRegion.translate(dstCopyRect.left - copySrc->x,
-                               dstCopyRect.top - copySrc->y);
+  addonChangedRegion.translate(dstCopyRect.left - copySrc.x,
+                               dstCopyRect.top - copySrc.y);
   changedRegion->add(&addonChangedRegion);
 
   // Clipping regions
   m_updateContainer.changedRegion.crop(&m_borderRect);
-  m_updateContainer.copiedRegion.crop(&m_borderRect);
 }
 
 void UpdateKeeper::setBorderRect(const Rect *borderRect)
@@ -165,15 +161,11 @@ void UpdateKeeper::addUpdateContainer(const UpdateContainer *updateContainer)
 {
   AutoLock al(&m_updContLocMut);
 
-  // FIXME: Use addCopyRegion instead of addCopyRect
-  // Add copied region
-  std::vector<Rect> rects;
-  std::vector<Rect>::iterator iRect;
-  updateContainer->copiedRegion.getRectVector(&rects);
-  size_t numRects = rects.size();
-  if (numRects > 0) {
-    iRect = rects.begin();
-    addCopyRect(&(*iRect), &updateContainer->copySrc);
+  // Add copies in the order they must be applied
+  std::vector<CopiedRect>::const_iterator iCopy;
+  for (iCopy = updateContainer->copiedRects.begin();
+       iCopy < updateContainer->copiedRects.end(); iCopy++) {
+    addCopyRect(&iCopy->dst, &iCopy->src);
   }
 
   // Add changed region
@@ -223,17 +215,34 @@ void UpdateKeeper::extract(UpdateContainer *updateContainer)
   {
     AutoLock al(&m_updContLocMut);
 
+    // Copies can not be clipped one by one because the following ones may
+    // read pixels of the previous ones, so either all of them fit or none.
+    Region borderRegion(&m_borderRect);
+    if (!m_updateContainer.copiesInside(&borderRegion)) {
+      m_updateContainer.declineCopies();
+    }
     // Clipping regions
     m_updateContainer.changedRegion.crop(&m_borderRect);
-    m_updateContainer.copiedRegion.crop(&m_borderRect);
 
     *updateContainer = m_updateContainer;
     m_updateContainer.clear();
   }
   {
     AutoLock al(&m_exclRegLocMut);
+    if (!m_excludedRegion.isEmpty()) {
+      Region excludedCopies = updateContainer->copiedRegion;
+      std::vector<CopiedRect>::const_iterator iCopy;
+      for (iCopy = updateContainer->copiedRects.begin();
+           iCopy < updateContainer->copiedRects.end(); iCopy++) {
+        Rect srcRect = iCopy->getSrcRect();
+        excludedCopies.addRect(&srcRect);
+      }
+      excludedCopies.intersect(&m_excludedRegion);
+      if (!excludedCopies.isEmpty()) {
+        updateContainer->declineCopies();
+      }
+    }
     updateContainer->changedRegion.subtract(&m_excludedRegion);
-    updateContainer->copiedRegion.subtract(&m_excludedRegion);
   }
 }
 
@@ -74,6 +74,9 @@ public:
   void extract(UpdateContainer *updateContainer);
 
 private:
+  // Maximal number of CopyRect operations kept in one update.
+  static const size_t MAX_COPIED_RECTS = 16;
+
   Rect m_borderRect;
 
   Region m_excludedRegion;
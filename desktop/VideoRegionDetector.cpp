@@ -0,0 +1,185 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "VideoRegionDetector.h"
+
+#include <math.h>
+
+VideoRegionDetector::VideoRegionDetector()
+: m_cols(0),
+  m_rows(0),
+  m_lastTime(0),
+  m_hasLastTime(false),
+  m_minSize(0)
+{
+  setRateThreshold(10);
+  setMinSize(128);
+}
+
+VideoRegionDetector::~VideoRegionDetector()
+{
+}
+
+void VideoRegionDetector::setRateThreshold(unsigned int updatesPerSecond)
+{
+  m_onRate = updatesPerSecond;
+  m_offRate = m_onRate / 2;
+}
+
+void VideoRegionDetector::setMinSize(unsigned int pixels)
+{
+  m_minSize = (int)pixels;
+}
+
+void VideoRegionDetector::update(const Region *changedRegion,
+                                 const Dimension *fbDim, UINT64 timeMillis)
+{
+  if (!m_fbDim.isEqualTo(fbDim)) {
+    m_fbDim = *fbDim;
+    reset();
+  }
+
+  decayRates(timeMillis);
+  addChanges(changedRegion);
+  updateVideoTiles();
+  findVideoAreas();
+}
+
+void VideoRegionDetector::getVideoRegion(Region *videoRegion) const
+{
+  *videoRegion = m_videoRegion;
+}
+
+void VideoRegionDetector::reset()
+{
+  m_cols = (m_fbDim.width + TILE_SIZE - 1) / TILE_SIZE;
+  m_rows = (m_fbDim.height + TILE_SIZE - 1) / TILE_SIZE;
+  m_rates.assign(m_cols * m_rows, 0.0);
+  m_isVideo.assign(m_cols * m_rows, 0);
+  m_hasLastTime = false;
+  m_videoRegion.clear();
+}
+
+void VideoRegionDetector::decayRates(UINT64 timeMillis)
+{
+  if (m_hasLastTime && timeMillis > m_lastTime) {
+    double factor = exp(-(double)(timeMillis - m_lastTime) / DECAY_TIME);
+    for (size_t i = 0; i < m_rates.size(); i++) {
+      m_rates[i] *= factor;
+    }
+  }
+  m_lastTime = timeMillis;
+  m_hasLastTime = true;
+}
+
+void VideoRegionDetector::addChanges(const Region *changedRegion)
+{
+  // With this increment a tile updated N times per second settles at the
+  // rate of N.
+  const double increment = 1000.0 / DECAY_TIME;
+
+  m_changedRects.clear();
+  changedRegion->getRectVector(&m_changedRects);
+
+  // A tile is counted once per update even if several rectangles touch it.
+  m_visited.assign(m_rates.size(), 0);
+  Rect fbRect = m_fbDim.getRect();
+  std::vector<Rect>::iterator iRect;
+  for (iRect = m_changedRects.begin(); iRect < m_changedRects.end(); iRect++) {
+    Rect rect = iRect->intersection(&fbRect);
+    if (rect.isEmpty()) {
+      continue;
+    }
+    int lastRow = (rect.bottom - 1) / TILE_SIZE;
+    int lastCol = (rect.right - 1) / TILE_SIZE;
+    for (int row = rect.top / TILE_SIZE; row <= lastRow; row++) {
+      for (int col = rect.left / TILE_SIZE; col <= lastCol; col++) {
+        int i = row * m_cols + col;
+        if (!m_visited[i]) {
+          m_visited[i] = 1;
+          m_rates[i] += increment;
+        }
+      }
+    }
+  }
+}
+
+void VideoRegionDetector::updateVideoTiles()
+{
+  for (size_t i = 0; i < m_rates.size(); i++) {
+    if (m_isVideo[i]) {
+      m_isVideo[i] = m_rates[i] >= m_offRate;
+    } else {
+      m_isVideo[i] = m_rates[i] >= m_onRate;
+    }
+  }
+}
+
+void VideoRegionDetector::findVideoAreas()
+{
+  m_videoRegion.clear();
+  m_visited.assign(m_isVideo.size(), 0);
+
+  for (int start = 0; start < (int)m_isVideo.size(); start++) {
+    if (!m_isVideo[start] || m_visited[start]) {
+      continue;
+    }
+    // Flood fill the group of video tiles and find its bounds in tiles.
+    int minCol = m_cols, minRow = m_rows, maxCol = -1, maxRow = -1;
+    m_stack.clear();
+    m_stack.push_back(start);
+    m_visited[start] = 1;
+    while (!m_stack.empty()) {
+      int i = m_stack.back();
+      m_stack.pop_back();
+      int row = i / m_cols;
+      int col = i % m_cols;
+      minCol = min(minCol, col);
+      maxCol = max(maxCol, col);
+      minRow = min(minRow, row);
+      maxRow = max(maxRow, row);
+
+      int neighbours[4] = { col > 0 ? i - 1 : -1,
+                            col < m_cols - 1 ? i + 1 : -1,
+                            row > 0 ? i - m_cols : -1,
+                            row < m_rows - 1 ? i + m_cols : -1 };
+      for (int n = 0; n < 4; n++) {
+        int j = neighbours[n];
+        if (j >= 0 && m_isVideo[j] && !m_visited[j]) {
+          m_visited[j] = 1;
+          m_stack.push_back(j);
+        }
+      }
+    }
+
+    Rect area(minCol * TILE_SIZE, minRow * TILE_SIZE,
+              (maxCol + 1) * TILE_SIZE, (maxRow + 1) * TILE_SIZE);
+    Rect fbRect = m_fbDim.getRect();
+    area = area.intersection(&fbRect);
+    if (area.getWidth() >= m_minSize && area.getHeight() >= m_minSize) {
+      m_videoRegion.addRect(&area);
+    }
+  }
+}
@@ -0,0 +1,102 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __VIDEOREGIONDETECTOR_H__
+#define __VIDEOREGIONDETECTOR_H__
+
+#include <vector>
+
+#include "region/Region.h"
+#include "region/Dimension.h"
+#include "util/inttypes.h"
+
+// VideoRegionDetector finds areas of the screen which are updated as often
+// as video is, only by the changed regions of the frame buffer, so it does
+// not depend on window class names or on the platform.
+//
+// The screen is divided into tiles, and each tile keeps its update rate
+// that decays exponentially with time. A tile becomes a video tile when its
+// rate reaches the threshold and stops being one when the rate falls below
+// the half of the threshold. Bounding rectangles of connected groups of
+// video tiles that are large enough form the video region.
+class VideoRegionDetector
+{
+public:
+  static const int TILE_SIZE = 32;
+  // Time constant of the rate decay, in milliseconds.
+  static const int DECAY_TIME = 1000;
+
+  VideoRegionDetector();
+  virtual ~VideoRegionDetector();
+
+  // Sets the number of updates per second that makes a tile a video tile.
+  void setRateThreshold(unsigned int updatesPerSecond);
+  // Sets the minimal width and height of a video area, in pixels.
+  void setMinSize(unsigned int pixels);
+
+  // Accounts the region changed at the moment `timeMillis' in the frame
+  // buffer of dimension `fbDim' and recomputes the video region. Changing
+  // the dimension forgets all the history.
+  void update(const Region *changedRegion, const Dimension *fbDim,
+              UINT64 timeMillis);
+
+  // Returns the video region found by the last update().
+  void getVideoRegion(Region *videoRegion) const;
+
+  // Forgets all the history.
+  void reset();
+
+private:
+  // Decays the rates for the time passed since the previous update.
+  void decayRates(UINT64 timeMillis);
+  // Adds an update to the tiles touched by the changed region.
+  void addChanges(const Region *changedRegion);
+  // Turns tiles into video tiles and back by their rates.
+  void updateVideoTiles();
+  // Builds m_videoRegion from connected groups of video tiles.
+  void findVideoAreas();
+
+  Dimension m_fbDim;
+  int m_cols;
+  int m_rows;
+
+  UINT64 m_lastTime;
+  bool m_hasLastTime;
+
+  double m_onRate;
+  double m_offRate;
+  int m_minSize;
+
+  std::vector<double> m_rates;
+  std::vector<UINT8> m_isVideo;
+  // Scratch data of findVideoAreas(), kept here to avoid reallocations.
+  std::vector<UINT8> m_visited;
+  std::vector<int> m_stack;
+  std::vector<Rect> m_changedRects;
+
+  Region m_videoRegion;
+};
+
+#endif // __VIDEOREGIONDETECTOR_H__
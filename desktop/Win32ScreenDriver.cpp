@@ -28,9 +28,11 @@
 Win32ScreenDriver::Win32ScreenDriver(UpdateKeeper *updateKeeper,
                                      UpdateListener *updateListener,
                                      FrameBuffer *fb,
+                                     TileHashMap *fbTileHashes,
                                      LocalMutex *fbLocalMutex, LogWriter *log)
 : Win32ScreenDriverBaseImpl(updateKeeper, updateListener, fbLocalMutex, log),
-  m_poller(updateKeeper, updateListener, &m_screenGrabber, fb, fbLocalMutex, log),
+  m_poller(updateKeeper, updateListener, &m_screenGrabber, fb, fbTileHashes,
+           fbLocalMutex, log),
   m_consolePoller(updateKeeper, updateListener, &m_screenGrabber, fb, fbLocalMutex, log),
   m_hooks(updateKeeper, updateListener, log)
 {
@@ -37,6 +37,7 @@ public:
   Win32ScreenDriver(UpdateKeeper *updateKeeper,
                        UpdateListener *updateListener,
                        FrameBuffer *fb,
+                       TileHashMap *fbTileHashes,
                        LocalMutex *fbLocalMutex, LogWriter *log);
   virtual ~Win32ScreenDriver();
 
@@ -40,6 +40,7 @@ ScreenDriver *Win32ScreenDriverFactory::
 createScreenDriver(UpdateKeeper *updateKeeper,
                    UpdateListener *updateListener,
                    FrameBuffer *fb,
+                   TileHashMap *fbTileHashes,
                    LocalMutex *fbLocalMutex,
                    LogWriter *log)
 {
@@ -66,7 +67,7 @@ createScreenDriver(UpdateKeeper *updateKeeper,
   log->info(_T("Using the standart screen driver"));
   return createStandardScreenDriver(updateKeeper,
                                     updateListener,
-                                    fb,
+                                    fb, fbTileHashes,
                                     fbLocalMutex, log);
 }
 
@@ -74,10 +75,12 @@ ScreenDriver *Win32ScreenDriverFactory::
 createStandardScreenDriver(UpdateKeeper *updateKeeper,
                            UpdateListener *updateListener,
                            FrameBuffer *fb,
+                           TileHashMap *fbTileHashes,
                            LocalMutex *fbLocalMutex,
                            LogWriter *log)
 {
-  return new Win32ScreenDriver(updateKeeper, updateListener, fb, fbLocalMutex, log);
+  return new Win32ScreenDriver(updateKeeper, updateListener, fb, fbTileHashes,
+                               fbLocalMutex, log);
 }
 
 ScreenDriver *Win32ScreenDriverFactory::
@@ -39,12 +39,14 @@ public:
   virtual ScreenDriver *createScreenDriver(UpdateKeeper *updateKeeper,
                                              UpdateListener *updateListener,
                                              FrameBuffer *fb,
+                                             TileHashMap *fbTileHashes,
                                              LocalMutex *fbLocalMutex,
                                              LogWriter *log);
 private:
   ScreenDriver *createStandardScreenDriver(UpdateKeeper *updateKeeper,
                                              UpdateListener *updateListener,
                                              FrameBuffer *fb,
+                                             TileHashMap *fbTileHashes,
                                              LocalMutex *fbLocalMutex,
                                              LogWriter *log);
   ScreenDriver *createMirrorScreenDriver(UpdateKeeper *updateKeeper,
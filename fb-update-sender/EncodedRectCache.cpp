@@ -0,0 +1,211 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "EncodedRectCache.h"
+
+#include <string.h>
+
+#include "thread/AutoLock.h"
+#include "rfb/EncodingDefs.h"
+#include "desktop/TileHashMap.h"
+
+EncodedRectCache *volatile EncodedRectCache::m_instance = 0;
+
+EncodedRectCache::EncodedRectCache()
+: m_cachedBytes(0),
+  m_numHits(0),
+  m_numMisses(0)
+{
+}
+
+EncodedRectCache *EncodedRectCache::getInstance()
+{
+  if (m_instance == 0) {
+    EncodedRectCache *cache = new EncodedRectCache;
+    if (InterlockedCompareExchangePointer((PVOID volatile *)&m_instance,
+                                          cache, 0) != 0) {
+      // Another thread has created the cache first.
+      delete cache;
+    }
+  }
+  return m_instance;
+}
+
+bool EncodedRectCache::canCache(int encType)
+{
+  return (encType == EncodingDefs::RAW ||
+          encType == EncodingDefs::RRE ||
+          encType == EncodingDefs::HEXTILE ||
+          encType == EncodingDefs::TIGHT);
+}
+
+static int *putPixelFormat(int *fields, const PixelFormat *pf)
+{
+  *fields++ = pf->bitsPerPixel;
+  *fields++ = pf->colorDepth;
+  *fields++ = pf->redMax;
+  *fields++ = pf->greenMax;
+  *fields++ = pf->blueMax;
+  *fields++ = pf->redShift;
+  *fields++ = pf->greenShift;
+  *fields++ = pf->blueShift;
+  *fields++ = pf->bigEndian ? 1 : 0;
+  return fields;
+}
+
+void EncodedRectCache::makeKey(const Rect *rect,
+                               const FrameBuffer *frameBuffer,
+                               const PixelFormat *dstPf,
+                               int encType, bool jpeg,
+                               const EncodeOptions *options, Key *key)
+{
+  PixelFormat srcPf = frameBuffer->getPixelFormat();
+
+  key->pixelHash = TileHashMap::hashRect(frameBuffer, rect);
+  int *fields = key->fields;
+  // Encoded data does not depend on the position of the rectangle.
+  *fields++ = rect->getWidth();
+  *fields++ = rect->getHeight();
+  fields = putPixelFormat(fields, &srcPf);
+  fields = putPixelFormat(fields, dstPf);
+  *fields++ = jpeg ? -1 : encType;
+  *fields++ = options->getCompressionLevel();
+  _ASSERT(fields + 1 == key->fields + Key::NUM_FIELDS);
+  *fields = options->getJpegQualityLevel();
+}
+
+bool EncodedRectCache::Key::operator<(const Key &other) const
+{
+  if (pixelHash != other.pixelHash) {
+    return pixelHash < other.pixelHash;
+  }
+  return memcmp(fields, other.fields, sizeof(fields)) < 0;
+}
+
+void EncodedRectCache::copyPixels(const Rect *rect,
+                                  const FrameBuffer *frameBuffer,
+                                  std::vector<char> *pixels)
+{
+  size_t rowSize = rect->getWidth() * frameBuffer->getBytesPerPixel();
+  pixels->resize(rowSize * rect->getHeight());
+  for (int y = 0; y < rect->getHeight(); y++) {
+    const char *row =
+      (const char *)frameBuffer->getBufferPtr(rect->left, rect->top + y);
+    if (rowSize != 0) {
+      memcpy(&pixels->front() + y * rowSize, row, rowSize);
+    }
+  }
+}
+
+bool EncodedRectCache::hasPixels(const std::vector<char> *pixels,
+                                 const Rect *rect,
+                                 const FrameBuffer *frameBuffer)
+{
+  size_t rowSize = rect->getWidth() * frameBuffer->getBytesPerPixel();
+  if (pixels->size() != rowSize * rect->getHeight()) {
+    return false;
+  }
+  for (int y = 0; y < rect->getHeight(); y++) {
+    const char *row =
+      (const char *)frameBuffer->getBufferPtr(rect->left, rect->top + y);
+    if (rowSize != 0 &&
+        memcmp(&pixels->front() + y * rowSize, row, rowSize) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool EncodedRectCache::find(const Key *key, const Rect *rect,
+                            const FrameBuffer *frameBuffer,
+                            std::vector<char> *data)
+{
+  AutoLock al(&m_mutex);
+
+  std::map<Key, Entry>::iterator it = m_entries.find(*key);
+  if (it == m_entries.end() ||
+      !hasPixels(&it->second.pixels, rect, frameBuffer)) {
+    m_numMisses++;
+    return false;
+  }
+  m_numHits++;
+  // Make the entry the most recently used one.
+  m_lruList.splice(m_lruList.begin(), m_lruList, it->second.lruPos);
+  *data = it->second.data;
+  return true;
+}
+
+void EncodedRectCache::insert(const Key *key, const Rect *rect,
+                              const FrameBuffer *frameBuffer,
+                              const std::vector<char> *data)
+{
+  size_t numPixelBytes = rect->area() * frameBuffer->getBytesPerPixel();
+  if (data->size() + numPixelBytes > MAX_CACHED_BYTES / 16) {
+    return;
+  }
+
+  AutoLock al(&m_mutex);
+
+  std::map<Key, Entry>::iterator it = m_entries.find(*key);
+  if (it != m_entries.end()) {
+    if (hasPixels(&it->second.pixels, rect, frameBuffer)) {
+      // Another client has encoded the same rectangle meanwhile.
+      return;
+    }
+    // The hashes collide, the new rectangle replaces the old one.
+    m_cachedBytes -= it->second.data.size() + it->second.pixels.size();
+    m_lruList.erase(it->second.lruPos);
+    m_entries.erase(it);
+  }
+  m_lruList.push_front(*key);
+  Entry *entry = &m_entries[*key];
+  entry->data = *data;
+  copyPixels(rect, frameBuffer, &entry->pixels);
+  entry->lruPos = m_lruList.begin();
+  m_cachedBytes += entry->data.size() + entry->pixels.size();
+  evict();
+}
+
+UINT64 EncodedRectCache::getNumHits()
+{
+  AutoLock al(&m_mutex);
+  return m_numHits;
+}
+
+UINT64 EncodedRectCache::getNumMisses()
+{
+  AutoLock al(&m_mutex);
+  return m_numMisses;
+}
+
+void EncodedRectCache::evict()
+{
+  while (m_cachedBytes > MAX_CACHED_BYTES && !m_lruList.empty()) {
+    std::map<Key, Entry>::iterator it = m_entries.find(m_lruList.back());
+    m_cachedBytes -= it->second.data.size() + it->second.pixels.size();
+    m_entries.erase(it);
+    m_lruList.pop_back();
+  }
+}
@@ -0,0 +1,130 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __ENCODEDRECTCACHE_H__
+#define __ENCODEDRECTCACHE_H__
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "rfb/FrameBuffer.h"
+#include "rfb-sconn/EncodeOptions.h"
+#include "thread/LocalMutex.h"
+
+// EncodedRectCache is a process-wide cache of encoded rectangles shared by
+// the update senders of all clients. When several clients with the same
+// pixel format and encoding settings view the same desktop, a rectangle
+// encoded for one of them is sent to the others as is.
+//
+// Only encodings without state between rectangles may be cached: Raw, RRE,
+// Hextile, and Tight (including JPEG) in the stream reset mode (see
+// TightEncoder::setStreamResetMode()). A rectangle is identified by its
+// size, a hash of its pixels (see TileHashMap::hashRect()), the server
+// and client pixel formats, the encoding and the encoding levels. Entries
+// are evicted in the least recently used order when the cached data exceeds
+// MAX_CACHED_BYTES.
+class EncodedRectCache
+{
+public:
+  // Identifies an encoded rectangle, built by makeKey().
+  struct Key
+  {
+    bool operator<(const Key &other) const;
+
+    UINT64 pixelHash;
+    static const int NUM_FIELDS = 23;
+    int fields[NUM_FIELDS];
+  };
+
+  // Returns the cache, creating it on the first call.
+  static EncodedRectCache *getInstance();
+
+  // Returns true if rectangles of the encoding may be cached.
+  static bool canCache(int encType);
+
+  // Builds the key of the rectangle `rect' of `frameBuffer' encoded by the
+  // encoder of type `encType' (or by the JPEG encoder if `jpeg' is true)
+  // into `dstPf' with the given options.
+  static void makeKey(const Rect *rect, const FrameBuffer *frameBuffer,
+                      const PixelFormat *dstPf, int encType, bool jpeg,
+                      const EncodeOptions *options, Key *key);
+
+  // Copies the encoded data of the rectangle `rect' of `frameBuffer' to
+  // `data' and returns true if the rectangle is in the cache, returns false
+  // otherwise. The key only selects the entry, the pixels of the entry are
+  // compared with the rectangle, so a hash collision is a miss.
+  bool find(const Key *key, const Rect *rect, const FrameBuffer *frameBuffer,
+            std::vector<char> *data);
+
+  // Stores the encoded data of the rectangle `rect' of `frameBuffer' along
+  // with its pixels.
+  void insert(const Key *key, const Rect *rect, const FrameBuffer *frameBuffer,
+              const std::vector<char> *data);
+
+  // Numbers of find() calls that have found and have not found data since
+  // the cache was created.
+  UINT64 getNumHits();
+  UINT64 getNumMisses();
+
+private:
+  EncodedRectCache();
+
+  // Both the encoded data and the source pixels are counted.
+  static const size_t MAX_CACHED_BYTES = 48 * 1024 * 1024;
+
+  struct Entry
+  {
+    std::vector<char> data;
+    // Source pixels of the rectangle, row by row.
+    std::vector<char> pixels;
+    // Position in m_lruList.
+    std::list<Key>::iterator lruPos;
+  };
+
+  // Copies the pixels of the rectangle to `pixels' row by row.
+  static void copyPixels(const Rect *rect, const FrameBuffer *frameBuffer,
+                         std::vector<char> *pixels);
+  // Returns true if `pixels' holds the pixels of the rectangle.
+  static bool hasPixels(const std::vector<char> *pixels, const Rect *rect,
+                        const FrameBuffer *frameBuffer);
+
+  // Removes the least recently used entries until the data fits into
+  // MAX_CACHED_BYTES. Must be called with m_mutex held.
+  void evict();
+
+  LocalMutex m_mutex;
+  std::map<Key, Entry> m_entries;
+  // Keys of the entries, the most recently used first.
+  std::list<Key> m_lruList;
+  size_t m_cachedBytes;
+
+  UINT64 m_numHits;
+  UINT64 m_numMisses;
+
+  static EncodedRectCache *volatile m_instance;
+};
+
+#endif // __ENCODEDRECTCACHE_H__
@@ -0,0 +1,207 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "FrameRateGovernor.h"
+
+#include "thread/AutoLock.h"
+
+const double FrameRateGovernor::SAMPLE_WEIGHT = 0.25;
+
+FrameRateGovernor::FrameRateGovernor()
+: m_isSending(false),
+  m_isPipelined(false),
+  m_lastUpdateBytes(0),
+  m_measuring(false),
+  m_measuredBytes(0),
+  m_measuredWriteTime(0),
+  m_measuredFlush(0),
+  m_hasMinDeliveryTime(false),
+  m_minDeliveryTime(0),
+  m_bandwidth(0.0),
+  m_updateSize(0.0),
+  m_updateInterval(0.0),
+  m_hasSentUpdates(false),
+  m_lastUpdateTime(0),
+  m_backlog(0.0),
+  m_backlogTime(0),
+  m_lastVideoTime(0)
+{
+}
+
+void FrameRateGovernor::onUpdateStarted()
+{
+  AutoLock al(&m_lock);
+  m_isSending = true;
+}
+
+void FrameRateGovernor::onUpdateSent(UINT64 numBytes, UINT64 writeTime,
+                                     UINT64 flushTime)
+{
+  AutoLock al(&m_lock);
+
+  m_isSending = false;
+  if (numBytes == 0) {
+    return;
+  }
+
+  if (m_hasSentUpdates) {
+    double interval = (double)(flushTime - m_lastUpdateTime);
+    m_updateInterval += (interval - m_updateInterval) * SAMPLE_WEIGHT;
+    m_updateSize += ((double)numBytes - m_updateSize) * SAMPLE_WEIGHT;
+  } else {
+    m_updateSize = (double)numBytes;
+    m_hasSentUpdates = true;
+  }
+  m_lastUpdateTime = flushTime;
+
+  m_backlog = getBacklog(flushTime) + numBytes;
+  m_backlogTime = flushTime;
+  m_lastUpdateBytes = numBytes;
+
+  // The measurement completes on the next request.
+  m_measuring = !m_isPipelined;
+  m_measuredBytes = numBytes;
+  m_measuredWriteTime = writeTime;
+  m_measuredFlush = flushTime;
+}
+
+void FrameRateGovernor::onUpdateRequest(UINT64 time)
+{
+  AutoLock al(&m_lock);
+
+  if (m_isSending) {
+    // The client has received the updates sent before the current one, but
+    // requests updates before receiving them.
+    m_isPipelined = true;
+    m_measuring = false;
+    m_backlog = 0.0;
+    m_backlogTime = time;
+    return;
+  }
+  // The client has received the updates sent before the last one, the
+  // request may come from the header of the last one.
+  double backlog = getBacklog(time);
+  m_backlog = backlog < m_lastUpdateBytes ? backlog : m_lastUpdateBytes;
+  m_backlogTime = time;
+
+  // Requests sent by the client before it has received the update tell
+  // nothing about the delivery time. A request coming much sooner than the
+  // round trip time must be one of those.
+  if (!m_measuring || time < m_measuredFlush) {
+    return;
+  }
+  UINT64 deliveryTime = m_measuredWriteTime + (time - m_measuredFlush);
+  if (m_hasMinDeliveryTime && deliveryTime < m_minDeliveryTime / 2) {
+    return;
+  }
+  m_measuring = false;
+
+  if (m_measuredBytes <= SMALL_UPDATE_SIZE) {
+    if (!m_hasMinDeliveryTime || deliveryTime < m_minDeliveryTime) {
+      m_minDeliveryTime = deliveryTime;
+      m_hasMinDeliveryTime = true;
+    } else if (deliveryTime > m_minDeliveryTime) {
+      m_minDeliveryTime++;
+    }
+  }
+  UINT64 transferTime = deliveryTime;
+  if (m_hasMinDeliveryTime) {
+    transferTime -= deliveryTime < m_minDeliveryTime ? deliveryTime
+                                                     : m_minDeliveryTime;
+  }
+  if (transferTime >= MIN_SAMPLE_TIME) {
+    addBandwidthSample(m_measuredBytes, transferTime);
+  } else if (m_bandwidth > 0.0 &&
+             (double)m_measuredBytes / MIN_SAMPLE_TIME > m_bandwidth) {
+    // Too fast to measure, but faster than estimated.
+    addBandwidthSample(m_measuredBytes, MIN_SAMPLE_TIME);
+  }
+}
+
+unsigned int FrameRateGovernor::getSendDelay(UINT64 now)
+{
+  AutoLock al(&m_lock);
+
+  if (m_bandwidth <= 0.0) {
+    return 0;
+  }
+  double excess = getBacklog(now) - m_bandwidth * TARGET_LATENCY;
+  if (excess <= 0.0) {
+    return 0;
+  }
+  double delay = excess / m_bandwidth;
+  return delay < MAX_SEND_DELAY ? (unsigned int)delay + 1 : MAX_SEND_DELAY;
+}
+
+bool FrameRateGovernor::admitVideoFrame(UINT64 now)
+{
+  AutoLock al(&m_lock);
+
+  double transferTime = m_bandwidth > 0.0 ? m_updateSize / m_bandwidth : 0.0;
+  // While an average update fits into the target latency, send every frame.
+  // Otherwise, give other updates a chance by sending video at most every
+  // other update.
+  if (transferTime > TARGET_LATENCY &&
+      (double)(now - m_lastVideoTime) < 2.0 * transferTime) {
+    return false;
+  }
+  m_lastVideoTime = now;
+  return true;
+}
+
+double FrameRateGovernor::getFrameRate()
+{
+  AutoLock al(&m_lock);
+
+  if (m_updateInterval <= 0.0) {
+    return 0.0;
+  }
+  return 1000.0 / m_updateInterval;
+}
+
+UINT64 FrameRateGovernor::getBandwidth()
+{
+  AutoLock al(&m_lock);
+  return (UINT64)(m_bandwidth * 1000.0);
+}
+
+double FrameRateGovernor::getBacklog(UINT64 now) const
+{
+  if (now <= m_backlogTime) {
+    return m_backlog;
+  }
+  double backlog = m_backlog - m_bandwidth * (double)(now - m_backlogTime);
+  return backlog > 0.0 ? backlog : 0.0;
+}
+
+void FrameRateGovernor::addBandwidthSample(UINT64 numBytes, UINT64 time)
+{
+  double bandwidth = (double)numBytes / (double)time;
+  if (m_bandwidth <= 0.0) {
+    m_bandwidth = bandwidth;
+  } else {
+    m_bandwidth += (bandwidth - m_bandwidth) * SAMPLE_WEIGHT;
+  }
+}
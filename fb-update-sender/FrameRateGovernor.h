@@ -0,0 +1,145 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __FRAMERATEGOVERNOR_H__
+#define __FRAMERATEGOVERNOR_H__
+
+#include "util/inttypes.h"
+#include "thread/LocalMutex.h"
+
+// FrameRateGovernor paces framebuffer updates of one client so that the data
+// queued on the way to the client does not exceed what the connection can
+// deliver within TARGET_LATENCY milliseconds.
+//
+// The bandwidth is estimated from the updates sent. The delivery time of an
+// update is the time spent waiting for the socket to accept its data plus
+// the time from flushing it to the next request of the client. The shortest
+// delivery time of small updates approximates the round trip time and is
+// subtracted from the samples. The governor keeps a model of the data not yet
+// delivered and tells the sender how long to wait before the next update, so
+// that changes arriving meanwhile are coalesced into it. When even an average
+// update takes longer than the target latency to deliver, video frames are
+// dropped to keep the other updates going.
+//
+// A client may pipeline its requests, sending the next one as soon as it
+// reads the header of an update and before the rest of the update has
+// arrived. The header of a streamed update is flushed ahead of its
+// rectangles, so such a request says nothing about the delivery of the
+// update. A request arriving while an update is being written can only come
+// from such a client, and after one the delivery time is not measured for
+// this client anymore. Its pace is then set by its own requests and the TCP
+// flow control. Since the governor can't tell a pipelined request arriving
+// after a flush from a normal one, a request is not taken as a proof that
+// the last update has been delivered, only the updates before it.
+//
+// All times are in milliseconds, as returned by DateTime::now().getTime().
+// The object may be used from any threads.
+class FrameRateGovernor
+{
+public:
+  FrameRateGovernor();
+
+  // Records the start of writing an update.
+  void onUpdateStarted();
+
+  // Records an update of numBytes bytes flushed to the output at flushTime,
+  // after waiting for the output for writeTime in total. Must follow
+  // onUpdateStarted(), numBytes is zero if nothing has been written.
+  void onUpdateSent(UINT64 numBytes, UINT64 writeTime, UINT64 flushTime);
+
+  // Records the arrival of a framebuffer update request.
+  void onUpdateRequest(UINT64 time);
+
+  // Returns the number of milliseconds to wait before sending the next
+  // update, zero to send it right away.
+  unsigned int getSendDelay(UINT64 now);
+
+  // Returns true if the video rectangles of the update being prepared should
+  // be sent, false if this video frame should be dropped. A true result
+  // counts as a sent video frame.
+  bool admitVideoFrame(UINT64 now);
+
+  // Returns the current estimate of the number of updates per second.
+  double getFrameRate();
+  // Returns the current estimate of the bandwidth, in bytes per second, or
+  // zero if it's unknown yet.
+  UINT64 getBandwidth();
+
+protected:
+  static const unsigned int TARGET_LATENCY = 100;
+  static const unsigned int MAX_SEND_DELAY = 1000;
+  // A sample of the delivery time shorter than this is too inaccurate to
+  // estimate the bandwidth.
+  static const unsigned int MIN_SAMPLE_TIME = 10;
+  // Updates up to this size are delivered in about the round trip time.
+  static const unsigned int SMALL_UPDATE_SIZE = 4096;
+  // Weight of a new sample in the running averages.
+  static const double SAMPLE_WEIGHT;
+
+  // Returns the number of bytes not delivered yet by the model, must be
+  // called with m_lock held.
+  double getBacklog(UINT64 now) const;
+
+  void addBandwidthSample(UINT64 numBytes, UINT64 time);
+
+  LocalMutex m_lock;
+
+  // Set between onUpdateStarted() and onUpdateSent().
+  bool m_isSending;
+  // Set when the client has sent a request while an update was being
+  // written to it.
+  bool m_isPipelined;
+  // Size of the last update sent.
+  UINT64 m_lastUpdateBytes;
+
+  // The last update waiting for the next request to complete the
+  // measurement of its delivery time.
+  bool m_measuring;
+  UINT64 m_measuredBytes;
+  UINT64 m_measuredWriteTime;
+  UINT64 m_measuredFlush;
+
+  // Shortest delivery time of a small update, an approximation of the round
+  // trip time. It slowly grows back to follow changes of the connection.
+  bool m_hasMinDeliveryTime;
+  UINT64 m_minDeliveryTime;
+
+  // Bandwidth in bytes per millisecond, zero if unknown.
+  double m_bandwidth;
+  // Average update size, in bytes.
+  double m_updateSize;
+  // Average interval between updates.
+  double m_updateInterval;
+  bool m_hasSentUpdates;
+  UINT64 m_lastUpdateTime;
+
+  // Bytes not delivered yet, as of m_backlogTime.
+  double m_backlog;
+  UINT64 m_backlogTime;
+
+  UINT64 m_lastVideoTime;
+};
+
+#endif // __FRAMERATEGOVERNOR_H__
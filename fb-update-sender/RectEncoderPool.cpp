@@ -0,0 +1,193 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "RectEncoderPool.h"
+#include "thread/AutoLock.h"
+#include "rfb-sconn/TightEncoder.h"
+
+RectEncoderPool::RectEncoderPool(size_t numThreads, LogWriter *log)
+: m_encType(EncodingDefs::RAW),
+  m_jpeg(false),
+  m_rects(0),
+  m_frameBuffer(0),
+  m_options(0),
+  m_nextRect(0),
+  m_numBusyThreads(0),
+  m_failed(false),
+  m_log(log)
+{
+  for (size_t i = 0; i < numThreads; i++) {
+    m_threads.push_back(new RectEncoderThread(this, i));
+  }
+  m_log->info(_T("Started %d rectangle encoding threads"), (int)numThreads);
+}
+
+RectEncoderPool::~RectEncoderPool()
+{
+  std::vector<RectEncoderThread *>::iterator it;
+  for (it = m_threads.begin(); it != m_threads.end(); it++) {
+    delete *it;
+  }
+}
+
+bool RectEncoderPool::canEncode(int encType)
+{
+  return (encType == EncodingDefs::RAW ||
+          encType == EncodingDefs::RRE ||
+          encType == EncodingDefs::HEXTILE ||
+          encType == EncodingDefs::TIGHT);
+}
+
+void RectEncoderPool::encodeRectangles(int encType, bool jpeg,
+                                       const std::vector<Rect> *rects,
+                                       const FrameBuffer *frameBuffer,
+                                       const EncodeOptions *options,
+                                       const PixelFormat *dstPf)
+{
+  {
+    AutoLock al(&m_jobMutex);
+    m_encType = encType;
+    m_jpeg = jpeg;
+    m_rects = rects;
+    m_frameBuffer = frameBuffer;
+    m_options = options;
+    m_dstPf = *dstPf;
+    m_results.resize(rects->size());
+    m_nextRect = 0;
+    m_numBusyThreads = m_threads.size();
+    m_failed = false;
+    m_bandEnds.clear();
+    if (encType == EncodingDefs::TIGHT) {
+      splitIntoBands();
+    }
+  }
+
+  std::vector<RectEncoderThread *>::iterator it;
+  for (it = m_threads.begin(); it != m_threads.end(); it++) {
+    (*it)->startJob();
+  }
+
+  bool finished = false;
+  while (!finished) {
+    m_jobDoneEvent.waitForEvent();
+    AutoLock al(&m_jobMutex);
+    finished = m_numBusyThreads == 0;
+  }
+
+  if (m_failed) {
+    throw Exception(m_errorMessage.getString());
+  }
+}
+
+const std::vector<char> *RectEncoderPool::getEncodedRect(size_t index) const
+{
+  return &m_results[index];
+}
+
+void RectEncoderPool::processJob(RectEncoderThread *thread)
+{
+  try {
+    if (!m_bandEnds.empty()) {
+      size_t band = thread->getIndex();
+      if (band < m_bandEnds.size()) {
+        size_t index = band == 0 ? 0 : m_bandEnds[band - 1];
+        for (; index < m_bandEnds[band] && !isFailed(); index++) {
+          thread->encode(m_encType, m_jpeg, &m_rects->at(index),
+                         m_frameBuffer, m_options, &m_dstPf,
+                         &m_results[index]);
+        }
+      }
+    } else {
+      size_t index;
+      while (takeNextRect(&index)) {
+        thread->encode(m_encType, m_jpeg, &m_rects->at(index),
+                       m_frameBuffer, m_options, &m_dstPf, &m_results[index]);
+      }
+    }
+  } catch (Exception &e) {
+    m_log->error(_T("Rectangle encoding thread failed: %s"), e.getMessage());
+    onThreadFinished(e.getMessage());
+    return;
+  }
+  onThreadFinished(0);
+}
+
+void RectEncoderPool::splitIntoBands()
+{
+  size_t numRects = m_rects->size();
+  int totalArea = 0;
+  for (size_t i = 0; i < numRects; i++) {
+    totalArea += m_rects->at(i).area();
+  }
+
+  size_t numBands = min(m_threads.size(), MAX_TIGHT_BANDS);
+  if (totalArea < TightEncoder::getMinBandArea(m_options)) {
+    numBands = 1;
+  }
+
+  // Rectangles come in the scan order, so consecutive runs of them of about
+  // equal area form horizontal bands. Every band is given at least one
+  // rectangle while there are enough of them.
+  size_t index = 0;
+  INT64 area = 0;
+  for (size_t band = 0; band < numBands; band++) {
+    INT64 bandLimit = (INT64)totalArea * (band + 1) / numBands;
+    size_t bandsLeft = numBands - band - 1;
+    while (index < numRects - min(bandsLeft, numRects - index) &&
+           (area < bandLimit || band == numBands - 1)) {
+      area += m_rects->at(index++).area();
+    }
+    m_bandEnds.push_back(index);
+  }
+}
+
+bool RectEncoderPool::isFailed()
+{
+  AutoLock al(&m_jobMutex);
+  return m_failed;
+}
+
+bool RectEncoderPool::takeNextRect(size_t *index)
+{
+  AutoLock al(&m_jobMutex);
+  if (m_failed || m_nextRect >= m_rects->size()) {
+    return false;
+  }
+  *index = m_nextRect++;
+  return true;
+}
+
+void RectEncoderPool::onThreadFinished(const TCHAR *errorMessage)
+{
+  AutoLock al(&m_jobMutex);
+  if (errorMessage != 0 && !m_failed) {
+    m_failed = true;
+    m_errorMessage.setString(errorMessage);
+  }
+  _ASSERT(m_numBusyThreads > 0);
+  if (--m_numBusyThreads == 0) {
+    m_jobDoneEvent.notify();
+  }
+}
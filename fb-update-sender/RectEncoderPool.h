@@ -0,0 +1,129 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __RECTENCODERPOOL_H__
+#define __RECTENCODERPOOL_H__
+
+#include <vector>
+
+#include "RectEncoderThread.h"
+#include "thread/LocalMutex.h"
+#include "util/StringStorage.h"
+#include "util/Exception.h"
+#include "log-writer/LogWriter.h"
+
+// RectEncoderPool encodes lists of rectangles produced by
+// Encoder::splitRectangle() on a number of worker threads. Encoded data is
+// collected in per-rectangle buffers so that the caller can send the
+// rectangles in their original order.
+//
+// Raw, RRE and Hextile rectangles are independent of each other and are
+// handed out to the threads as they become free. Tight rectangles are split
+// into up to four horizontal bands of about equal area, and each band is
+// always encoded by the same thread through its own zlib stream id (see
+// TightEncoder::setBandStream()), so the decoder can follow all the streams
+// while the rectangles are sent in their original order. ZRLE uses a single
+// zlib stream for the whole connection and must be encoded serially.
+class RectEncoderPool
+{
+public:
+  // Tight bands are limited by the number of zlib stream ids in the
+  // protocol.
+  static const size_t MAX_TIGHT_BANDS = 4;
+
+  RectEncoderPool(size_t numThreads, LogWriter *log);
+  virtual ~RectEncoderPool();
+
+  // Returns true if rectangles of the specified encoding can be encoded by
+  // the pool.
+  static bool canEncode(int encType);
+
+  // Encodes all the rectangles from `rects' using the encoder of the
+  // specified type, or the JPEG encoder if `jpeg' is true. Pixels are
+  // converted from the frameBuffer format to `dstPf'. Blocks until all the
+  // rectangles are encoded, after that the results can be taken by
+  // getEncodedRect(). The arguments must remain valid during the call.
+  // Throws Exception if any of the worker threads has failed.
+  void encodeRectangles(int encType, bool jpeg,
+                        const std::vector<Rect> *rects,
+                        const FrameBuffer *frameBuffer,
+                        const EncodeOptions *options,
+                        const PixelFormat *dstPf) throw(Exception);
+
+  // Returns the encoded data for the rectangle with the specified index in
+  // the list given to the most recent encodeRectangles() call.
+  const std::vector<char> *getEncodedRect(size_t index) const;
+
+  // Called by worker threads, takes rectangles from the current job until
+  // there are no more rectangles left, or encodes the band of the thread
+  // for Tight jobs.
+  void processJob(RectEncoderThread *thread);
+
+protected:
+  // Splits the rectangles of the current Tight job into bands, filling in
+  // m_bandEnds.
+  void splitIntoBands();
+
+  bool isFailed();
+  // Returns false if there are no more rectangles to encode, otherwise
+  // stores the index of the next rectangle to `index'.
+  bool takeNextRect(size_t *index);
+  void onThreadFinished(const TCHAR *errorMessage);
+
+  std::vector<RectEncoderThread *> m_threads;
+
+  // Current job description. It's set by encodeRectangles() and remains
+  // unchanged until all the threads finish their work.
+  int m_encType;
+  bool m_jpeg;
+  const std::vector<Rect> *m_rects;
+  const FrameBuffer *m_frameBuffer;
+  const EncodeOptions *m_options;
+  PixelFormat m_dstPf;
+
+  // For Tight jobs, the end index (exclusive) of the rectangles of each
+  // band, empty for other encodings.
+  std::vector<size_t> m_bandEnds;
+
+  // Per-rectangle encoded data.
+  std::vector<std::vector<char> > m_results;
+
+  // Job progress, protected by m_jobMutex.
+  size_t m_nextRect;
+  size_t m_numBusyThreads;
+  bool m_failed;
+  StringStorage m_errorMessage;
+  LocalMutex m_jobMutex;
+  WindowsEvent m_jobDoneEvent;
+
+  LogWriter *m_log;
+
+private:
+  // Do not allow copying objects.
+  RectEncoderPool(const RectEncoderPool &other);
+  RectEncoderPool &operator=(const RectEncoderPool &other);
+};
+
+#endif // __RECTENCODERPOOL_H__
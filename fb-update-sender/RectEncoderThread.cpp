@@ -0,0 +1,96 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "RectEncoderThread.h"
+#include "RectEncoderPool.h"
+
+RectEncoderThread::RectEncoderThread(RectEncoderPool *pool, size_t index)
+: m_pool(pool),
+  m_index(index),
+  m_output(&m_buffer),
+  m_enbox(&m_pixelConverter, &m_output)
+{
+  if (m_index < RectEncoderPool::MAX_TIGHT_BANDS) {
+    m_enbox.setTightBandStream((int)m_index);
+  } else {
+    m_enbox.setTightStreamResetMode(true);
+  }
+  resume();
+}
+
+RectEncoderThread::~RectEncoderThread()
+{
+  terminate();
+  wait();
+}
+
+void RectEncoderThread::startJob()
+{
+  m_jobEvent.notify();
+}
+
+size_t RectEncoderThread::getIndex() const
+{
+  return m_index;
+}
+
+void RectEncoderThread::onTerminate()
+{
+  m_jobEvent.notify();
+}
+
+void RectEncoderThread::execute()
+{
+  while (!isTerminating()) {
+    m_jobEvent.waitForEvent();
+    if (!isTerminating()) {
+      m_pool->processJob(this);
+    }
+  }
+}
+
+void RectEncoderThread::encode(int encType, bool jpeg,
+                               const Rect *rect,
+                               const FrameBuffer *frameBuffer,
+                               const EncodeOptions *options,
+                               const PixelFormat *dstPf,
+                               std::vector<char> *dst)
+{
+  PixelFormat srcPf = frameBuffer->getPixelFormat();
+  m_pixelConverter.setPixelFormats(dstPf, &srcPf);
+
+  Encoder *encoder;
+  if (jpeg) {
+    m_enbox.validateJpegEncoder();
+    encoder = m_enbox.getJpegEncoder();
+  } else {
+    m_enbox.selectEncoder(encType);
+    encoder = m_enbox.getEncoder();
+  }
+
+  m_buffer.reset();
+  encoder->sendRectangle(rect, frameBuffer, options);
+  dst->assign(m_buffer.toByteArray(), m_buffer.toByteArray() + m_buffer.size());
+}
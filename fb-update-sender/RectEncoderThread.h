@@ -0,0 +1,83 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __RECTENCODERTHREAD_H__
+#define __RECTENCODERTHREAD_H__
+
+#include <vector>
+
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+#include "io-lib/ByteArrayOutputStream.h"
+#include "io-lib/DataOutputStream.h"
+#include "rfb/PixelConverter.h"
+#include "rfb-sconn/EncoderStore.h"
+
+class RectEncoderPool;
+
+// One worker thread of RectEncoderPool. Each thread owns a complete set of
+// encoders, a pixel converter and an output buffer, so that several threads
+// can encode rectangles of the same framebuffer update at the same time.
+// The first four threads of a pool own one Tight zlib stream id each (see
+// TightEncoder::setBandStream()) and encode Tight bands; Tight encoders of
+// other threads work in the stream reset mode.
+class RectEncoderThread : public Thread
+{
+public:
+  // `index' is the index of this thread in the pool.
+  RectEncoderThread(RectEncoderPool *pool, size_t index);
+  virtual ~RectEncoderThread();
+
+  // Wakes the thread up to take rectangles from the current pool job.
+  void startJob();
+
+  size_t getIndex() const;
+
+  // Encodes a rectangle via the encoder of the specified type (or via the
+  // JPEG encoder if `jpeg' is true) and stores the encoded data to `dst'.
+  // Rectangle header is not included. Should be called only from this
+  // thread.
+  void encode(int encType, bool jpeg,
+              const Rect *rect,
+              const FrameBuffer *frameBuffer,
+              const EncodeOptions *options,
+              const PixelFormat *dstPf,
+              std::vector<char> *dst);
+
+protected:
+  virtual void execute();
+  virtual void onTerminate();
+
+  RectEncoderPool *m_pool;
+  size_t m_index;
+  WindowsEvent m_jobEvent;
+
+  PixelConverter m_pixelConverter;
+  ByteArrayOutputStream m_buffer;
+  DataOutputStream m_output;
+  EncoderStore m_enbox;
+};
+
+#endif // __RECTENCODERTHREAD_H__
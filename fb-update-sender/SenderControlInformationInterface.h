@@ -30,6 +30,11 @@ class SenderControlInformationInterface
 {
 public:
   virtual void onGetViewPort(Rect *viewRect, bool *shareApp, Region *shareAppRegion) = 0;
+
+  // Reports the current estimates of the update rate (updates per second)
+  // and of the bandwidth available to the client (bytes per second, zero if
+  // unknown). Called after each framebuffer update sent.
+  virtual void onUpdateStatistics(double frameRate, UINT64 bandwidth) = 0;
 };
 
 #endif // __SENDERCONTROLINFORMATIONINTERFACE_H__
@@ -29,6 +29,7 @@
 #include <vector>
 #include "util/inttypes.h"
 #include "util/Exception.h"
+#include "server-config-lib/Configurator.h"
 #include "UpdSenderMsgDefs.h"
 
 UpdateSender::UpdateSender(RfbCodeRegistrator *codeRegtor,
@@ -46,6 +47,12 @@ UpdateSender::UpdateSender(RfbCodeRegistrator *codeRegtor,
   m_setColorMapEntr(false),
   m_output(output),
   m_enbox(&m_pixelConverter, m_output),
+  m_encoderPool(0),
+  m_encoderSelector(0),
+  m_encodeTime(0),
+  m_encodedRectCache(0),
+  m_cacheOutput(&m_cacheBuffer),
+  m_cacheEnbox(&m_pixelConverter, &m_cacheOutput),
   m_id(id),
   m_videoFrozen(false),
   m_shareOnlyApp(false),
@@ -55,6 +62,21 @@ UpdateSender::UpdateSender(RfbCodeRegistrator *codeRegtor,
   // FIXME: argument must be defined
   m_updateKeeper = new UpdateKeeper(&Rect());
 
+  unsigned int numEncodingThreads =
+    Configurator::getInstance()->getServerConfig()->getEncodingThreads();
+  if (numEncodingThreads > 1) {
+    // All Tight rectangles are encoded by the pool then, so the zlib
+    // streams of the sender's own Tight encoder are never used.
+    m_encoderPool = new RectEncoderPool(numEncodingThreads, m_log);
+  }
+  if (Configurator::getInstance()->getServerConfig()->getAdaptiveEncodingFlag()) {
+    m_encoderSelector = new EncoderSelector;
+  }
+  if (Configurator::getInstance()->getServerConfig()->getEncodingCacheFlag()) {
+    m_encodedRectCache = EncodedRectCache::getInstance();
+    m_cacheEnbox.setTightStreamResetMode(true);
+  }
+
   // Capabilities
   codeRegtor->addEncCap(EncodingDefs::COPYRECT,          VendorDefs::STANDARD,
                         EncodingDefs::SIG_COPYRECT);
@@ -90,6 +112,12 @@ UpdateSender::~UpdateSender()
 {
   terminate();
   wait();
+  if (m_encoderPool != 0) {
+    delete m_encoderPool;
+  }
+  if (m_encoderSelector != 0) {
+    delete m_encoderSelector;
+  }
 }
 
 void UpdateSender::onTerminate()
@@ -155,8 +183,7 @@ void UpdateSender::addUpdateContainer(const UpdateContainer *updateContainer)
 
   updCont.videoRegion.translate(-viewPort.left, -viewPort.top);
   updCont.changedRegion.translate(-viewPort.left, -viewPort.top);
-  updCont.copiedRegion.translate(-viewPort.left, -viewPort.top);
-  updCont.copySrc.move(-viewPort.left, -viewPort.top);
+  updCont.translateCopies(-viewPort.left, -viewPort.top);
 
   m_updateKeeper->addUpdateContainer(&updCont);
 }
@@ -263,19 +290,16 @@ void UpdateSender::sendCursorPosUpdate()
   sendRectHeader(pos.x, pos.y, 0, 0, PseudoEncDefs::POINTER_POS);
 }
 
-void UpdateSender::sendCopyRect(const std::vector<Rect> *rects, const Point *source)
+void UpdateSender::sendCopyRect(const std::vector<CopiedRect> *copies)
 {
-  std::vector<Rect>::const_iterator iRect;
-
-  for (iRect = rects->begin(); iRect != rects->end(); iRect++) {
-    const Rect *rect = &(*iRect);
+  std::vector<CopiedRect>::const_iterator iCopy;
 
-    sendRectHeader(rect, EncodingDefs::COPYRECT);
+  for (iCopy = copies->begin(); iCopy != copies->end(); iCopy++) {
+    sendRectHeader(&iCopy->dst, EncodingDefs::COPYRECT);
 
     // Send copyRect data
-    // FIXME: Each dest rect should have own source point
-    m_output->writeUInt16(source->x);
-    m_output->writeUInt16(source->y);
+    m_output->writeUInt16(iCopy->src.x);
+    m_output->writeUInt16(iCopy->src.y);
   }
 }
 
@@ -331,6 +355,10 @@ void UpdateSender::sendUpdate()
   FrameBuffer *frameBuffer = &m_frameBuffer;
 
   AutoLock l(m_output);
+  UINT64 startBytes = m_output->getBytesWritten();
+  UINT64 startWriteTime = m_output->getWriteTime();
+  UINT64 startWriteCalls = m_output->getWriteCalls();
+  m_governor.onUpdateStarted();
 
   Dimension clientDim, lastViewPortDim;
   {
@@ -353,7 +381,7 @@ void UpdateSender::sendUpdate()
     updCont.screenSizeChanged = true;
   }
   if (dimensionChanged || viewPortChanged) {
-    updCont.copiedRegion.clear();
+    updCont.clearCopies();
 
     AutoLock al(&m_viewPortMut);
     m_lastViewPortDim.setDim(&viewPort);
@@ -421,8 +449,7 @@ void UpdateSender::sendUpdate()
 
     if (!encodeOptions.copyRectEnabled() || getVideoFrozen()) {
       m_log->debug(_T("CopyRect is disabled, converting to normal updates"));
-      updCont.changedRegion.add(&updCont.copiedRegion);
-      updCont.copiedRegion.clear();
+      updCont.declineCopies();
     }
 
     updCont.changedRegion.add(&m_prevVideoRegion); // This line updates rid video places when
@@ -455,6 +482,15 @@ void UpdateSender::sendUpdate()
     Region videoRegion = updCont.videoRegion;
     Region changedRegion = updCont.changedRegion;
 
+    if (!videoRegion.isEmpty() &&
+        !m_governor.admitVideoFrame(DateTime::now().getTime())) {
+      m_log->debug(_T("Dropping a video frame, the client is too slow"));
+      // If the video goes on, the region will be sent as video next time,
+      // otherwise as a normal update.
+      m_updateKeeper->addChangedRegion(&videoRegion);
+      videoRegion.clear();
+    }
+
     if (shareOnlyApp) {
       Region newOpeningAppRegion = shareAppRegion;
       newOpeningAppRegion.subtract(&prevShareAppRegion);
@@ -473,77 +509,21 @@ void UpdateSender::sendUpdate()
     // At this point, we've got final regions in changedRegion and videoRegion.
     //
 
-    // Convert changedRegion to the final list of rectangles.
-    m_log->debug(_T("Number of normal rectangles before splitting: %d"),
-               changedRegion.getCount());
-    std::vector<Rect> normalRects;
-    splitRegion(m_enbox.getEncoder(), &changedRegion, &normalRects,
-                frameBuffer, &encodeOptions);
-
-    // Do the same for the videoRegion.
-    std::vector<Rect> videoRects;
-    if (!videoRegion.isEmpty()) {
-      m_log->debug(_T("Video region is not empty"));
-      m_enbox.validateJpegEncoder(); // make sure JpegEncoder is allocated
-      splitRegion(m_enbox.getJpegEncoder(), &videoRegion, &videoRects,
-                  frameBuffer, &encodeOptions);
-    }
-
-    // Get the final list of CopyRect rectangles.
-    std::vector<Rect> copyRects;
-    updCont.copiedRegion.getRectVector(&copyRects);
-
-    // Calculate the total number of rectangles and pseudo-rectangles.
-    m_log->debug(_T("Number of normal rectangles: %d"), normalRects.size());
-    m_log->debug(_T("Number of video rectangles: %d"), videoRects.size());
-    m_log->debug(_T("Number of CopyRect rectangles: %d"), copyRects.size());
-    size_t numTotalRects =
-      normalRects.size() + videoRects.size() + copyRects.size();
-
-    if (updCont.cursorPosChanged) {
-      numTotalRects++;
-      m_log->debug(_T("Adding a pseudo-rectangle for cursor position update"));
-    }
-    if (updCont.cursorShapeChanged) {
-      numTotalRects++;
-      m_log->debug(_T("Adding a pseudo-rectangle for cursor shape update"));
-    }
-    m_log->debug(_T("Total number of rectangles and pseudo-rectangles: %d"),
-               numTotalRects);
-
-    // FIXME: Handle this better, e.g. send first 65534 rectangles.
-    _ASSERT(numTotalRects <= 65534);
-
-    if (numTotalRects != 0) {
-      m_log->debug(_T("Sending FramebufferUpdate message header"));
-      // FIXME: Use constant for FramebufferUpdate message type.
-      m_output->writeUInt8(0); // message type
-      m_output->writeUInt8(0); // padding
-      m_output->writeUInt16((UINT16)numTotalRects);
-
-      if (updCont.cursorPosChanged) {
-        m_log->debug(_T("Sending cursor position update"));
-        sendCursorPosUpdate();
-      }
-      if (updCont.cursorShapeChanged) {
-        m_log->debug(_T("Sending cursor shape update"));
-        sendCursorShapeUpdate(&clientPixelFormat,
-                              &cursorShape);
-      }
-      if (copyRects.size() > 0) {
-        m_log->debug(_T("Sending CopyRect rectangles"));
-        sendCopyRect(&copyRects, &updCont.copySrc);
-      }
-
-      m_log->debug(_T("Time between request and a point before send and coding (in milliseconds): %u"),
-                 (unsigned int)(DateTime::now() - reqTimePoint).getTime());
-      m_log->debug(_T("Sending video rectangles"));
-      sendRectangles(m_enbox.getJpegEncoder(), &videoRects, frameBuffer, &encodeOptions);
-      m_log->debug(_T("Sending normal rectangles"));
-      sendRectangles(m_enbox.getEncoder(), &normalRects, frameBuffer, &encodeOptions);
-      m_log->debug(_T("Time between request and answer is (in milliseconds): %u"),
-                 (unsigned int)(DateTime::now() - reqTimePoint).getTime());
+    // Clients supporting LastRect get the rectangles as soon as they are
+    // encoded, the others after all the rectangles have been split.
+    bool updateSent;
+    if (encodeOptions.lastRectEnabled()) {
+      updateSent = sendStreamingUpdate(&updCont, &changedRegion, &videoRegion,
+                                       &clientPixelFormat, &cursorShape,
+                                       frameBuffer, &encodeOptions,
+                                       &reqTimePoint);
     } else {
+      updateSent = sendCountedUpdate(&updCont, &changedRegion, &videoRegion,
+                                     &clientPixelFormat, &cursorShape,
+                                     frameBuffer, &encodeOptions,
+                                     &reqTimePoint);
+    }
+    if (!updateSent) {
       m_log->debug(_T("Nothing to send, restoring requested regions"));
       AutoLock al(&m_reqRectLocMut);
       m_requestedFullReg.add(&requestedFullReg);
@@ -557,6 +537,213 @@ void UpdateSender::sendUpdate()
 
   m_log->debug(_T("Flushing output"));
   m_output->flush();
+
+  UINT64 numBytes = m_output->getBytesWritten() - startBytes;
+  m_log->debug(_T("The update of %u bytes has been sent by %d writes"),
+               (unsigned int)numBytes,
+               (int)(m_output->getWriteCalls() - startWriteCalls));
+  m_governor.onUpdateSent(numBytes,
+                          m_output->getWriteTime() - startWriteTime,
+                          DateTime::now().getTime());
+  if (numBytes != 0) {
+    m_senderControlInformation->onUpdateStatistics(m_governor.getFrameRate(),
+                                                   m_governor.getBandwidth());
+  }
+}
+
+bool UpdateSender::sendCountedUpdate(const UpdateContainer *updCont,
+                                     const Region *changedRegion,
+                                     const Region *videoRegion,
+                                     const PixelFormat *clientPixelFormat,
+                                     const CursorShape *cursorShape,
+                                     const FrameBuffer *frameBuffer,
+                                     const EncodeOptions *encodeOptions,
+                                     const DateTime *reqTimePoint)
+{
+  // Convert changedRegion to the final list of rectangles.
+  m_log->debug(_T("Number of normal rectangles before splitting: %d"),
+             changedRegion->getCount());
+  std::vector<Rect> normalRects;
+  splitRegion(m_enbox.getEncoder(), changedRegion, &normalRects,
+              frameBuffer, encodeOptions);
+
+  // With adaptive encoding, normal rectangles are sent in groups by content
+  // class, each group with its own encoder.
+  std::vector<Rect> classRects[RectClassifier::NUM_CLASSES];
+  Encoder *classEncoders[RectClassifier::NUM_CLASSES];
+  if (m_encoderSelector != 0) {
+    classifyRectangles(&normalRects, classRects, classEncoders,
+                       frameBuffer, encodeOptions);
+    normalRects.clear();
+    for (int i = 0; i < RectClassifier::NUM_CLASSES; i++) {
+      normalRects.insert(normalRects.end(),
+                         classRects[i].begin(), classRects[i].end());
+    }
+  }
+
+  // Do the same for the videoRegion.
+  std::vector<Rect> videoRects;
+  if (!videoRegion->isEmpty()) {
+    m_log->debug(_T("Video region is not empty"));
+    m_enbox.validateJpegEncoder(); // make sure JpegEncoder is allocated
+    splitRegion(m_enbox.getJpegEncoder(), videoRegion, &videoRects,
+                frameBuffer, encodeOptions);
+  }
+
+  // Get the final list of CopyRect rectangles. The client applies them
+  // one by one in this order.
+  const std::vector<CopiedRect> &copyRects = updCont->copiedRects;
+
+  // Calculate the total number of rectangles and pseudo-rectangles.
+  m_log->debug(_T("Number of normal rectangles: %d"), normalRects.size());
+  m_log->debug(_T("Number of video rectangles: %d"), videoRects.size());
+  m_log->debug(_T("Number of CopyRect rectangles: %d"), copyRects.size());
+  size_t numTotalRects =
+    normalRects.size() + videoRects.size() + copyRects.size();
+
+  if (updCont->cursorPosChanged) {
+    numTotalRects++;
+    m_log->debug(_T("Adding a pseudo-rectangle for cursor position update"));
+  }
+  if (updCont->cursorShapeChanged) {
+    numTotalRects++;
+    m_log->debug(_T("Adding a pseudo-rectangle for cursor shape update"));
+  }
+  m_log->debug(_T("Total number of rectangles and pseudo-rectangles: %d"),
+             numTotalRects);
+
+  // FIXME: Handle this better, e.g. send first 65534 rectangles.
+  _ASSERT(numTotalRects <= 65534);
+
+  if (numTotalRects == 0) {
+    return false;
+  }
+
+  m_log->debug(_T("Sending FramebufferUpdate message header"));
+  // FIXME: Use constant for FramebufferUpdate message type.
+  m_output->writeUInt8(0); // message type
+  m_output->writeUInt8(0); // padding
+  m_output->writeUInt16((UINT16)numTotalRects);
+
+  sendPseudoAndCopyRects(updCont, clientPixelFormat, cursorShape);
+
+  m_log->debug(_T("Time between request and a point before send and coding (in milliseconds): %u"),
+             (unsigned int)(DateTime::now() - *reqTimePoint).getTime());
+  m_log->debug(_T("Sending video rectangles"));
+  sendRectangles(m_enbox.getJpegEncoder(), &videoRects, frameBuffer, encodeOptions);
+  m_log->debug(_T("Sending normal rectangles"));
+  if (m_encoderSelector != 0) {
+    sendClassifiedRectangles(classRects, classEncoders,
+                             frameBuffer, encodeOptions);
+  } else {
+    sendRectangles(m_enbox.getEncoder(), &normalRects, frameBuffer, encodeOptions);
+  }
+  m_log->debug(_T("Time between request and answer is (in milliseconds): %u"),
+             (unsigned int)(DateTime::now() - *reqTimePoint).getTime());
+  return true;
+}
+
+bool UpdateSender::sendStreamingUpdate(const UpdateContainer *updCont,
+                                       const Region *changedRegion,
+                                       const Region *videoRegion,
+                                       const PixelFormat *clientPixelFormat,
+                                       const CursorShape *cursorShape,
+                                       const FrameBuffer *frameBuffer,
+                                       const EncodeOptions *encodeOptions,
+                                       const DateTime *reqTimePoint)
+{
+  if (changedRegion->isEmpty() && videoRegion->isEmpty() &&
+      updCont->copiedRects.empty() &&
+      !updCont->cursorPosChanged && !updCont->cursorShapeChanged) {
+    return false;
+  }
+
+  m_log->debug(_T("Sending FramebufferUpdate message header, the update")
+               _T(" will be terminated by LastRect"));
+  m_output->writeUInt8(0); // message type
+  m_output->writeUInt8(0); // padding
+  m_output->writeUInt16(0xffff); // number of rectangles is not known
+
+  sendPseudoAndCopyRects(updCont, clientPixelFormat, cursorShape);
+
+  m_log->debug(_T("Time between request and a point before send and coding (in milliseconds): %u"),
+               (unsigned int)(DateTime::now() - *reqTimePoint).getTime());
+  bool isFirstRect = true;
+  if (!videoRegion->isEmpty()) {
+    m_log->debug(_T("Streaming video rectangles"));
+    m_enbox.validateJpegEncoder(); // make sure JpegEncoder is allocated
+    streamRegion(m_enbox.getJpegEncoder(), false, videoRegion,
+                 frameBuffer, encodeOptions, reqTimePoint, &isFirstRect);
+  }
+  m_log->debug(_T("Streaming normal rectangles"));
+  streamRegion(m_enbox.getEncoder(), m_encoderSelector != 0, changedRegion,
+               frameBuffer, encodeOptions, reqTimePoint, &isFirstRect);
+
+  sendRectHeader(0, 0, 0, 0, PseudoEncDefs::LAST_RECT);
+  m_log->debug(_T("Time between request and answer is (in milliseconds): %u"),
+               (unsigned int)(DateTime::now() - *reqTimePoint).getTime());
+  return true;
+}
+
+void UpdateSender::streamRegion(Encoder *encoder, bool classify,
+                                const Region *region,
+                                const FrameBuffer *frameBuffer,
+                                const EncodeOptions *encodeOptions,
+                                const DateTime *reqTimePoint,
+                                bool *isFirstRect)
+{
+  std::vector<Rect> baseRects;
+  region->getRectVector(&baseRects);
+  UINT64 flushedBytes = m_output->getBytesWritten();
+  for (size_t i = 0; i < baseRects.size(); i++) {
+    // Rectangles are split and encoded only when it is their turn.
+    std::vector<Rect> baseRect(1, baseRects[i]);
+    if (classify) {
+      std::vector<Rect> classRects[RectClassifier::NUM_CLASSES];
+      Encoder *classEncoders[RectClassifier::NUM_CLASSES];
+      classifyRectangles(&baseRect, classRects, classEncoders,
+                         frameBuffer, encodeOptions);
+      sendClassifiedRectangles(classRects, classEncoders,
+                               frameBuffer, encodeOptions);
+    } else {
+      std::vector<Rect> rects;
+      encoder->splitRectangle(&baseRects[i], &rects, frameBuffer,
+                              encodeOptions);
+      sendRectangles(encoder, &rects, frameBuffer, encodeOptions);
+    }
+
+    // Let the client decode the data while the next rectangles are being
+    // encoded. Small rectangles are collected to avoid tiny writes.
+    UINT64 bytesWritten = m_output->getBytesWritten();
+    if (*isFirstRect || bytesWritten - flushedBytes >= MIN_STREAM_FLUSH_SIZE) {
+      m_output->flush();
+      flushedBytes = bytesWritten;
+    }
+    if (*isFirstRect) {
+      m_log->debug(_T("Time between request and the first rectangle is (in milliseconds): %u"),
+                   (unsigned int)(DateTime::now() - *reqTimePoint).getTime());
+      *isFirstRect = false;
+    }
+  }
+}
+
+void UpdateSender::sendPseudoAndCopyRects(const UpdateContainer *updCont,
+                                          const PixelFormat *clientPixelFormat,
+                                          const CursorShape *cursorShape)
+{
+  if (updCont->cursorPosChanged) {
+    m_log->debug(_T("Sending cursor position update"));
+    sendCursorPosUpdate();
+  }
+  if (updCont->cursorShapeChanged) {
+    m_log->debug(_T("Sending cursor shape update"));
+    sendCursorShapeUpdate(clientPixelFormat,
+                          cursorShape);
+  }
+  if (updCont->copiedRects.size() > 0) {
+    m_log->debug(_T("Sending CopyRect rectangles"));
+    sendCopyRect(&updCont->copiedRects);
+  }
 }
 
 void UpdateSender::paintBlack(FrameBuffer *frameBuffer, const Region *blackRegion)
@@ -587,11 +774,168 @@ void UpdateSender::sendRectangles(Encoder *encoder,
                                   const FrameBuffer *frameBuffer,
                                   const EncodeOptions *encodeOptions)
 {
+  // The JPEG encoder is passed with no video rectangles before it has been
+  // allocated.
+  if (rects->empty()) {
+    return;
+  }
+  bool jpeg = encoder == m_enbox.getJpegEncoder();
+  int encType = encoder->getCode();
+  if (m_encodedRectCache != 0 && EncodedRectCache::canCache(encType)) {
+    sendCachedRectangles(encType, jpeg, rects, frameBuffer, encodeOptions);
+    return;
+  }
+  // Tight rectangles go to the pool even if there is only one of them,
+  // because the pool threads own the zlib streams.
+  if (m_encoderPool != 0 && RectEncoderPool::canEncode(encType) &&
+      (rects->size() > 1 || encType == EncodingDefs::TIGHT)) {
+    PixelFormat dstPf = m_pixelConverter.getDstPixelFormat();
+    UINT64 startTime = EncoderSelector::getMicroseconds();
+    m_encoderPool->encodeRectangles(encType, jpeg, rects, frameBuffer,
+                                    encodeOptions, &dstPf);
+    m_encodeTime += EncoderSelector::getMicroseconds() - startTime;
+    for (size_t i = 0; i < rects->size(); i++) {
+      sendRectHeader(&rects->at(i), encType);
+      const std::vector<char> *data = m_encoderPool->getEncodedRect(i);
+      if (!data->empty()) {
+        m_output->writeFully(&data->front(), data->size());
+      }
+    }
+    return;
+  }
+
+  // The encoder writes to m_output directly, so the time the output has
+  // spent writing to the socket is subtracted.
+  UINT64 startTime = EncoderSelector::getMicroseconds();
+  UINT64 startWriteTime = m_output->getWriteTime();
   std::vector<Rect>::const_iterator i;
   for (i = rects->begin(); i != rects->end(); i++) {
-    sendRectHeader(&*i, encoder->getCode());
+    sendRectHeader(&*i, encType);
     encoder->sendRectangle(&*i, frameBuffer, encodeOptions);
   }
+  UINT64 elapsed = EncoderSelector::getMicroseconds() - startTime;
+  UINT64 writeTime = (m_output->getWriteTime() - startWriteTime) * 1000;
+  m_encodeTime += elapsed > writeTime ? elapsed - writeTime : 0;
+}
+
+void UpdateSender::sendCachedRectangles(int encType, bool jpeg,
+                                        const std::vector<Rect> *rects,
+                                        const FrameBuffer *frameBuffer,
+                                        const EncodeOptions *encodeOptions)
+{
+  PixelFormat dstPf = m_pixelConverter.getDstPixelFormat();
+  size_t numRects = rects->size();
+  std::vector<EncodedRectCache::Key> keys(numRects);
+  std::vector<std::vector<char> > data(numRects);
+
+  UINT64 startTime = EncoderSelector::getMicroseconds();
+  std::vector<Rect> missedRects;
+  std::vector<size_t> missedIndexes;
+  for (size_t i = 0; i < numRects; i++) {
+    EncodedRectCache::makeKey(&rects->at(i), frameBuffer, &dstPf, encType,
+                              jpeg, encodeOptions, &keys[i]);
+    if (!m_encodedRectCache->find(&keys[i], &rects->at(i), frameBuffer,
+                                  &data[i])) {
+      missedRects.push_back(rects->at(i));
+      missedIndexes.push_back(i);
+    }
+  }
+  m_log->debug(_T("%d of %d rectangles found in the encoded rectangle cache"),
+               (int)(numRects - missedRects.size()), (int)numRects);
+
+  // Tight rectangles of the pool are encoded via stateful band streams, so
+  // the pool is used for the other encodings only.
+  if (m_encoderPool != 0 && missedRects.size() > 1 &&
+      encType != EncodingDefs::TIGHT && RectEncoderPool::canEncode(encType)) {
+    m_encoderPool->encodeRectangles(encType, jpeg, &missedRects, frameBuffer,
+                                    encodeOptions, &dstPf);
+    for (size_t i = 0; i < missedRects.size(); i++) {
+      data[missedIndexes[i]] = *m_encoderPool->getEncodedRect(i);
+    }
+  } else if (!missedRects.empty()) {
+    Encoder *encoder;
+    if (jpeg) {
+      m_cacheEnbox.validateJpegEncoder();
+      encoder = m_cacheEnbox.getJpegEncoder();
+    } else {
+      encoder = m_cacheEnbox.validateEncoder(encType);
+    }
+    for (size_t i = 0; i < missedRects.size(); i++) {
+      m_cacheBuffer.reset();
+      encoder->sendRectangle(&missedRects[i], frameBuffer, encodeOptions);
+      data[missedIndexes[i]].assign(m_cacheBuffer.toByteArray(),
+                                    m_cacheBuffer.toByteArray() +
+                                    m_cacheBuffer.size());
+    }
+  }
+  m_encodeTime += EncoderSelector::getMicroseconds() - startTime;
+  for (size_t i = 0; i < missedIndexes.size(); i++) {
+    m_encodedRectCache->insert(&keys[missedIndexes[i]],
+                               &rects->at(missedIndexes[i]), frameBuffer,
+                               &data[missedIndexes[i]]);
+  }
+
+  for (size_t i = 0; i < numRects; i++) {
+    sendRectHeader(&rects->at(i), encType);
+    if (!data[i].empty()) {
+      m_output->writeFully(&data[i].front(), data[i].size());
+    }
+  }
+}
+
+void UpdateSender::classifyRectangles(const std::vector<Rect> *rects,
+                                      std::vector<Rect> classRects[],
+                                      Encoder *classEncoders[],
+                                      const FrameBuffer *frameBuffer,
+                                      const EncodeOptions *encodeOptions)
+{
+  std::vector<Rect> unsplitRects[RectClassifier::NUM_CLASSES];
+  std::vector<Rect>::const_iterator it;
+  for (it = rects->begin(); it != rects->end(); it++) {
+    int rectClass = m_encoderSelector->classify(&*it, frameBuffer);
+    unsplitRects[rectClass].push_back(*it);
+  }
+
+  for (int i = 0; i < RectClassifier::NUM_CLASSES; i++) {
+    classEncoders[i] = 0;
+    if (unsplitRects[i].empty()) {
+      continue;
+    }
+    int encType = m_encoderSelector->selectEncoding(i, encodeOptions);
+    Encoder *encoder = m_enbox.validateEncoder(encType);
+    classEncoders[i] = encoder;
+    m_log->debug(_T("%d rectangles of content class %d go with encoding %d"),
+                 (int)unsplitRects[i].size(), i, encoder->getCode());
+    for (it = unsplitRects[i].begin(); it != unsplitRects[i].end(); it++) {
+      encoder->splitRectangle(&*it, &classRects[i], frameBuffer,
+                              encodeOptions);
+    }
+  }
+}
+
+void UpdateSender::sendClassifiedRectangles(const std::vector<Rect> classRects[],
+                                            Encoder *classEncoders[],
+                                            const FrameBuffer *frameBuffer,
+                                            const EncodeOptions *encodeOptions)
+{
+  for (int i = 0; i < RectClassifier::NUM_CLASSES; i++) {
+    if (classRects[i].empty()) {
+      continue;
+    }
+    UINT64 numPixels = 0;
+    std::vector<Rect>::const_iterator it;
+    for (it = classRects[i].begin(); it != classRects[i].end(); it++) {
+      numPixels += (UINT64)it->area();
+    }
+
+    UINT64 startBytes = m_output->getBytesWritten();
+    UINT64 startEncodeTime = m_encodeTime;
+    sendRectangles(classEncoders[i], &classRects[i], frameBuffer,
+                   encodeOptions);
+    m_encoderSelector->addSample(i, classEncoders[i]->getCode(), numPixels,
+                                 m_output->getBytesWritten() - startBytes,
+                                 m_encodeTime - startEncodeTime);
+  }
 }
 
 void UpdateSender::execute()
@@ -602,6 +946,14 @@ void UpdateSender::execute()
     m_newUpdatesEvent.waitForEvent();
     m_busy = true;
     m_log->debug(_T("Update sender thread of client #%d is awake"), m_id);
+    // If the client drains updates slower than they come, wait to coalesce
+    // more changes into the next update.
+    unsigned int delay;
+    while (!isTerminating() &&
+           (delay = m_governor.getSendDelay(DateTime::now().getTime())) != 0) {
+      m_log->debug(_T("Delaying the update for %u ms"), delay);
+      m_newUpdatesEvent.waitForEvent(delay);
+    }
     if (!isTerminating()) {
       try {
         m_log->debug(_T("Trying to call the sendUpdate() function"));
@@ -615,6 +967,13 @@ void UpdateSender::execute()
       }
     }
   }
+
+  if (m_encodedRectCache != 0) {
+    m_log->info(_T("Encoded rectangle cache (shared by all clients): %u hits,")
+                _T(" %u misses"),
+                (unsigned int)m_encodedRectCache->getNumHits(),
+                (unsigned int)m_encodedRectCache->getNumMisses());
+  }
 }
 
 void UpdateSender::readUpdateRequest(RfbInputGate *io)
@@ -638,6 +997,7 @@ void UpdateSender::readUpdateRequest(RfbInputGate *io)
       m_fullUpdIsReq = true;
     }
     m_requestTimePoint = DateTime::now();
+    m_governor.onUpdateRequest(m_requestTimePoint.getTime());
     combinedReqRegions.add(&m_requestedIncrReg);
     combinedReqRegions.add(&m_requestedFullReg);
   }
@@ -798,28 +1158,13 @@ void UpdateSender::cropUpdContForReqRegions(UpdateContainer *updCont,
 void UpdateSender::inscribeCopiedRegionToReqRegion(UpdateContainer *updCont,
                                                    const Region *requestRegion)
 {
-  // Test copied region. If it is fully inside in the requested region then
-  // there is no to change. Otherwise, simply decline copied region.
-  if (!updCont->copiedRegion.isEmpty()) {
-    Region dstCopiedRegion = updCont->copiedRegion;
-    dstCopiedRegion.subtract(requestRegion);
-
-    bool copiedRegionFullyInscribed = dstCopiedRegion.isEmpty();
-    if (copiedRegionFullyInscribed) {
-      // Then see the same at source coordinates.
-      Region copiedRegion = updCont->copiedRegion;
-      Rect dstBounds = copiedRegion.getBounds();
-      int dx = updCont->copySrc.x - dstBounds.left;
-      int dy = updCont->copySrc.y - dstBounds.top;
-      copiedRegion.translate(dx, dy);
-      copiedRegion.subtract(requestRegion);
-      copiedRegionFullyInscribed = copiedRegion.isEmpty();
-    }
-    if (!copiedRegionFullyInscribed) {
-      // Convert copied region to changed region.
-      updCont->changedRegion.add(&updCont->copiedRegion);
-      updCont->copiedRegion.clear();
-    }
+  // Test copies. If all of them are fully inside the requested region (at
+  // both destination and source coordinates) then there is no to change.
+  // Otherwise, simply decline all of them because the following copies
+  // may depend on the previous ones.
+  if (!updCont->copiedRects.empty() && !updCont->copiesInside(requestRegion)) {
+    // Convert copied region to changed region.
+    updCont->declineCopies();
   }
 }
 
@@ -844,8 +1189,7 @@ void UpdateSender::updateFrameBuffer(UpdateContainer *updCont,
 
   Region newOpeningPixels;
   if (shareOnlyApp) {
-    updCont->changedRegion.add(&updCont->copiedRegion);
-    updCont->copiedRegion.clear();
+    updCont->declineCopies();
     m_appRegion = *shareAppRegion;
     newOpeningPixels = m_appRegion;
     newOpeningPixels.subtract(&m_prevAppRegion);
@@ -37,9 +37,14 @@
 #include "rfb-sconn/HextileEncoder.h"
 #include "rfb-sconn/JpegEncoder.h"
 #include "rfb-sconn/EncoderStore.h"
+#include "rfb-sconn/EncoderSelector.h"
 #include "rfb-sconn/RfbCodeRegistrator.h"
 #include "util/DateTime.h"
 #include "CursorUpdates.h"
+#include "RectEncoderPool.h"
+#include "FrameRateGovernor.h"
+#include "EncodedRectCache.h"
+#include "io-lib/ByteArrayOutputStream.h"
 #include "SenderControlInformationInterface.h"
 
 class UpdateSender : public Thread, public RfbDispatcherListener
@@ -78,6 +83,10 @@ public:
   // Return true if the client is ready, false otherwise.
   bool clientIsReady();
 
+  // While streaming an update, the output is flushed when at least this
+  // number of bytes has been collected.
+  static const size_t MIN_STREAM_FLUSH_SIZE = 8192;
+
 protected:
   // Listener function which implements RfbDispatcherListener. It will be
   // called on receiving client messages if we registered as a handler for
@@ -158,14 +167,76 @@ protected:
   void sendCursorShapeUpdate(const PixelFormat *fmt,
                              const CursorShape *cursorShape);
   void sendCursorPosUpdate();
-  void sendCopyRect(const std::vector<Rect> *rects, const Point *source);
-
-  // Encode and send a list of rectangles via the specified encoder.
+  void sendCopyRect(const std::vector<CopiedRect> *copies);
+  // Sends the cursor pseudo-rectangles and the CopyRect rectangles of the
+  // update container.
+  void sendPseudoAndCopyRects(const UpdateContainer *updCont,
+                              const PixelFormat *clientPixelFormat,
+                              const CursorShape *cursorShape);
+
+  // Send the rectangles of the final changed and video regions in a
+  // FramebufferUpdate message. Return false if there is nothing to send.
+  // sendCountedUpdate() splits all the regions first to write the number
+  // of rectangles in the message header. sendStreamingUpdate() is used for
+  // the clients supporting LastRect: it splits and encodes the rectangles
+  // one by one and flushes the output as it goes, so the client can decode
+  // the first rectangles while the rest are being encoded.
+  bool sendCountedUpdate(const UpdateContainer *updCont,
+                         const Region *changedRegion,
+                         const Region *videoRegion,
+                         const PixelFormat *clientPixelFormat,
+                         const CursorShape *cursorShape,
+                         const FrameBuffer *frameBuffer,
+                         const EncodeOptions *encodeOptions,
+                         const DateTime *reqTimePoint);
+  bool sendStreamingUpdate(const UpdateContainer *updCont,
+                           const Region *changedRegion,
+                           const Region *videoRegion,
+                           const PixelFormat *clientPixelFormat,
+                           const CursorShape *cursorShape,
+                           const FrameBuffer *frameBuffer,
+                           const EncodeOptions *encodeOptions,
+                           const DateTime *reqTimePoint);
+  // Splits, encodes and sends the region rectangle by rectangle for
+  // sendStreamingUpdate(). If classify is true, the encoders are chosen by
+  // m_encoderSelector instead of the encoder argument.
+  void streamRegion(Encoder *encoder, bool classify,
+                    const Region *region,
+                    const FrameBuffer *frameBuffer,
+                    const EncodeOptions *encodeOptions,
+                    const DateTime *reqTimePoint,
+                    bool *isFirstRect);
+
+  // Encode and send a list of rectangles via the specified encoder. If the
+  // encoder pool is enabled and supports the encoding, rectangles are
+  // encoded in parallel and sent in the original order.
   void sendRectangles(Encoder *encoder,
                       const std::vector<Rect> *rects,
                       const FrameBuffer *frameBuffer,
                       const EncodeOptions *encodeOptions);
 
+  // Sends rectangles like sendRectangles() but takes the encoded data from
+  // m_encodedRectCache when possible, and stores newly encoded rectangles
+  // there. The encoding must be supported by EncodedRectCache::canCache().
+  void sendCachedRectangles(int encType, bool jpeg,
+                            const std::vector<Rect> *rects,
+                            const FrameBuffer *frameBuffer,
+                            const EncodeOptions *encodeOptions);
+
+  // Distributes rectangles by content class and splits the rectangles of
+  // each class for the encoder m_encoderSelector has chosen for the class.
+  void classifyRectangles(const std::vector<Rect> *rects,
+                          std::vector<Rect> classRects[],
+                          Encoder *classEncoders[],
+                          const FrameBuffer *frameBuffer,
+                          const EncodeOptions *encodeOptions);
+  // Sends rectangles distributed by classifyRectangles() and reports the
+  // output size and the encoding time to m_encoderSelector.
+  void sendClassifiedRectangles(const std::vector<Rect> classRects[],
+                                Encoder *classEncoders[],
+                                const FrameBuffer *frameBuffer,
+                                const EncodeOptions *encodeOptions);
+
   // This function paints black region in framebuffer.
   void paintBlack(FrameBuffer *frameBuffer, const Region *blackRegion);
 
@@ -253,6 +324,33 @@ protected:
   // should be used only by the sender thread.
   EncoderStore m_enbox;
 
+  // Pool of threads encoding rectangles in parallel. It's allocated only if
+  // more than one encoding thread is configured, otherwise it's zero and all
+  // rectangles are encoded in the sender thread via m_enbox.
+  RectEncoderPool *m_encoderPool;
+
+  // Chooses encodings of normal rectangles by their content. It's allocated
+  // only if adaptive encoding is enabled in the server configuration,
+  // otherwise all normal rectangles use the preferred encoder of m_enbox.
+  EncoderSelector *m_encoderSelector;
+  // Microseconds spent encoding rectangles by sendRectangles(), without
+  // the time of waiting for m_output. Samples for m_encoderSelector are
+  // taken from it, so the choice does not follow the network speed.
+  UINT64 m_encodeTime;
+
+  // Paces updates by the rate the client drains them.
+  FrameRateGovernor m_governor;
+
+  // Cache of encoded rectangles shared by all clients, zero if disabled in
+  // the server configuration.
+  EncodedRectCache *m_encodedRectCache;
+  // Encoders writing to m_cacheBuffer, used for rectangles missing from
+  // m_encodedRectCache. The Tight encoder works in the stream reset mode so
+  // its output does not depend on other rectangles.
+  ByteArrayOutputStream m_cacheBuffer;
+  DataOutputStream m_cacheOutput;
+  EncoderStore m_cacheEnbox;
+
   // Information
   // FIXME: Document this properly.
   int m_id;
@@ -24,6 +24,8 @@
 
 #include "DownloadOperation.h"
 
+#include "util/DateTime.h"
+
 DownloadOperation::DownloadOperation(LogWriter *logWriter,
                                      const FileInfo *filesToDownload,
                                      size_t filesCount,
@@ -32,7 +34,13 @@ DownloadOperation::DownloadOperation(LogWriter *logWriter,
 : CopyOperation(logWriter),
   m_file(0),
   m_fos(0),
-  m_fileOffset(0)
+  m_fileOffset(0),
+  m_isDraining(false),
+  m_chunkSize(MIN_CHUNK_SIZE),
+  m_measureStartTime(0),
+  m_measuredBytes(0),
+  m_rttMin(0),
+  m_rttCount(0)
 {
   m_pathToSourceRoot.setString(pathToSourceRoot);
   m_pathToTargetRoot.setString(pathToTargetRoot);
@@ -128,24 +136,31 @@ void DownloadOperation::onDownloadReply(DataInputStream *input)
   }
 
   //
-  // Send first request for file data
+  // Send first requests for file data
   //
 
-  UINT32 dataSize = 1024 * 8;
-  bool compression = m_replyBuffer->isCompressionSupported();
+  m_chunkSize = MIN_CHUNK_SIZE;
+  m_measureStartTime = DateTime::now().getTime();
+  m_measuredBytes = 0;
+  m_rttMin = 0;
+  m_rttCount = 0;
 
-  m_sender->sendDownloadDataRequest(dataSize,
-                                    compression);
+  fillRequestWindow();
 }
 
 void DownloadOperation::onDownloadDataReply(DataInputStream *input)
 {
-  if (isTerminating()) {
-    gotoNext();
+  onDataRequestReplied();
+
+  if (m_isDraining) {
+    finishDrainingIfDone();
     return ;
   }
 
-  UINT32 bufferSize = 1024 * 8;
+  if (isTerminating()) {
+    startDraining();
+    return ;
+  }
 
   try {
     DataOutputStream dos(m_fos);
@@ -155,7 +170,7 @@ void DownloadOperation::onDownloadDataReply(DataInputStream *input)
     }
   } catch (IOException &ioEx) {
     notifyFailedToDownload(ioEx.getMessage());
-    gotoNext();
+    startDraining();
     return ;
   }
 
@@ -170,34 +185,41 @@ void DownloadOperation::onDownloadDataReply(DataInputStream *input)
   }
 
   //
-  // Send next download data request
+  // Send next download data requests
   //
 
-  bool compression = m_replyBuffer->isCompressionSupported();
-
-  m_sender->sendDownloadDataRequest(bufferSize, compression);
+  adaptChunkSize(m_replyBuffer->getDownloadBufferSize());
+  fillRequestWindow();
 }
 
 void DownloadOperation::onDownloadEndReply(DataInputStream *input)
 {
+  onDataRequestReplied();
+
   //
   // Cleanup
   //
 
-  try { m_fos->close(); } catch (...) { }
-  delete m_fos;
-  m_fos = NULL;
+  bool isDownloaded = !m_isDraining;
 
-  try {
-    m_file->setLastModified(m_replyBuffer->getDownloadLastModified());
-  } catch (...) {
-    notifyFailedToDownload(_T("Cannot set modification time"));
+  if (m_fos != NULL) {
+    try { m_fos->close(); } catch (...) { }
+    delete m_fos;
+    m_fos = NULL;
+  }
+
+  if (isDownloaded) {
+    try {
+      m_file->setLastModified(m_replyBuffer->getDownloadLastModified());
+    } catch (...) {
+      notifyFailedToDownload(_T("Cannot set modification time"));
+    }
   }
 
   delete m_file;
   m_file = NULL;
 
-  gotoNext();
+  startDraining();
 }
 
 void DownloadOperation::onLastRequestFailedReply(DataInputStream *input)
@@ -209,6 +231,25 @@ void DownloadOperation::onLastRequestFailedReply(DataInputStream *input)
 
   if (m_foldersToCalcSizeLeft > 0) {
     decFoldersToCalcSizeCount();
+  } else if (!m_requestTimes.empty()) {
+    //
+    // Reply to a download data request. After the end of file it's
+    // expected for the requests that were still in flight.
+    //
+
+    onDataRequestReplied();
+
+    if (!m_isDraining) {
+      StringStorage message;
+
+      m_replyBuffer->getLastErrorMessage(&message);
+
+      notifyFailedToDownload(message.getString());
+
+      startDraining();
+    } else {
+      finishDrainingIfDone();
+    }
   } else {
     // Logging
     StringStorage message;
@@ -420,6 +461,78 @@ void DownloadOperation::notifyFailedToDownload(const TCHAR *errorDescription)
   notifyError(message.getString());
 }
 
+void DownloadOperation::fillRequestWindow()
+{
+  bool compression = m_replyBuffer->isCompressionSupported();
+
+  while (m_requestTimes.size() < WINDOW_SIZE) {
+    m_requestTimes.push_back(DateTime::now().getTime());
+    m_sender->sendDownloadDataRequest(m_chunkSize, compression);
+  }
+}
+
+void DownloadOperation::onDataRequestReplied()
+{
+  if (m_requestTimes.empty()) {
+    return;
+  }
+
+  UINT64 now = DateTime::now().getTime();
+  UINT64 rtt = now > m_requestTimes.front() ? now - m_requestTimes.front() : 0;
+  if (m_rttCount == 0 || rtt < m_rttMin) {
+    m_rttMin = rtt;
+  }
+  m_rttCount++;
+  m_requestTimes.pop_front();
+}
+
+void DownloadOperation::adaptChunkSize(UINT32 bytes)
+{
+  m_measuredBytes += bytes;
+
+  UINT64 now = DateTime::now().getTime();
+  UINT64 elapsed = now > m_measureStartTime ? now - m_measureStartTime : 0;
+  if (elapsed < MEASURE_TIME || m_rttCount == 0) {
+    return;
+  }
+
+  //
+  // Data in flight should cover the bandwidth-delay product. The window
+  // is limited by twice the measured product so it can grow while
+  // the throughput is limited by the window itself. A chunk must also be
+  // sent in MAX_CHUNK_SEND_TIME at the measured bandwidth.
+  //
+
+  UINT64 bdp = m_measuredBytes * m_rttMin / elapsed;
+  UINT64 targetSize = 2 * bdp / WINDOW_SIZE;
+  UINT64 maxSize = m_measuredBytes * MAX_CHUNK_SEND_TIME / elapsed;
+
+  m_chunkSize = MIN_CHUNK_SIZE;
+  while (m_chunkSize < targetSize && m_chunkSize * 2 <= maxSize &&
+         m_chunkSize < MAX_CHUNK_SIZE) {
+    m_chunkSize *= 2;
+  }
+
+  m_measureStartTime = now;
+  m_measuredBytes = 0;
+  m_rttMin = 0;
+  m_rttCount = 0;
+}
+
+void DownloadOperation::startDraining()
+{
+  m_isDraining = true;
+  finishDrainingIfDone();
+}
+
+void DownloadOperation::finishDrainingIfDone()
+{
+  if (m_isDraining && m_requestTimes.empty()) {
+    m_isDraining = false;
+    gotoNext();
+  }
+}
+
 void DownloadOperation::changeFileToDownload(FileInfoList *toDownload)
 {
   m_toCopy = toDownload;
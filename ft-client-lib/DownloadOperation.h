@@ -25,6 +25,8 @@
 #ifndef _DOWNLOAD_OPERATION_H_
 #define _DOWNLOAD_OPERATION_H_
 
+#include <deque>
+
 #include "ft-common/FileInfo.h"
 #include "file-lib/WinFileChannel.h"
 #include "FileInfoList.h"
@@ -33,6 +35,14 @@
 //
 // File transfer operation class for downloading files (and file trees).
 //
+// File data is requested by a sliding window: up to WINDOW_SIZE download
+// data requests are in flight, and a new one is sent on each reply. The
+// chunk size follows the measured bandwidth-delay product of the link.
+// The server answers each request by exactly one reply (data, end of file
+// or last request failed), so after the end of file or an error the
+// operation waits for the replies of the requests still in flight
+// before going to the next file.
+//
 
 class DownloadOperation : public CopyOperation
 {
@@ -108,6 +118,20 @@ private:
   // m_pathToSourceFile, m_pathToTargetFile members
   void changeFileToDownload(FileInfoList *toDownload);
 
+  // Sends download data requests until the window is full
+  void fillRequestWindow() throw(IOException);
+
+  // Called on each reply to a download data request
+  void onDataRequestReplied();
+
+  // Updates the chunk size after receiving a chunk of `bytes' bytes
+  void adaptChunkSize(UINT32 bytes);
+
+  // Stops sending download data requests, the next file is started
+  // when the replies to all requests in flight are received
+  void startDraining() throw(IOException);
+  void finishDrainingIfDone() throw(IOException);
+
 protected:
   // Target local file
   File *m_file;
@@ -120,6 +144,30 @@ protected:
   // Helper member to know how many folders to download left
   // to get their file size
   UINT32 m_foldersToCalcSizeLeft;
+
+  static const UINT32 WINDOW_SIZE = 4;
+  static const UINT32 MIN_CHUNK_SIZE = 8 * 1024;
+  static const UINT32 MAX_CHUNK_SIZE = 1024 * 1024;
+  // Bandwidth and round trip time are measured over this number of
+  // milliseconds
+  static const UINT64 MEASURE_TIME = 200;
+  // Sending a chunk at the measured bandwidth should take no longer than
+  // this number of milliseconds, because the server blocks other messages
+  // to the viewer while it is sending the chunk
+  static const UINT64 MAX_CHUNK_SEND_TIME = 100;
+
+  // Send times of the download data requests in flight
+  std::deque<UINT64> m_requestTimes;
+  // True if no more download data requests are sent for the current file
+  bool m_isDraining;
+  UINT32 m_chunkSize;
+
+  UINT64 m_measureStartTime;
+  UINT64 m_measuredBytes;
+  // Minimal round trip time of the measure period. The replies wait
+  // behind each other, so the minimum is the closest to the link delay
+  UINT64 m_rttMin;
+  UINT32 m_rttCount;
 };
 
 #endif
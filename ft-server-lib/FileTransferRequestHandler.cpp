@@ -777,13 +777,19 @@ void FileTransferRequestHandler::downloadDataRequested()
     throw FileTransferException(_T("No active download at the moment"));
   }
 
-  std::vector<char> buffer(dataSize);
+  if (dataSize > MAX_DOWNLOAD_DATA_SIZE) {
+    dataSize = MAX_DOWNLOAD_DATA_SIZE;
+  }
+  if (m_downloadBuffer.size() < dataSize) {
+    m_downloadBuffer.resize(dataSize);
+  }
 
   DWORD read = 0;
 
   try {
     if (dataSize != 0) {
-      size_t portion = m_fileInputStream->read(&buffer.front(), dataSize);
+      size_t portion = m_fileInputStream->read(&m_downloadBuffer.front(),
+                                               dataSize);
       read = (DWORD)portion;
       _ASSERT(read == portion);
     }
@@ -826,7 +832,7 @@ void FileTransferRequestHandler::downloadDataRequested()
 
   if (compressionLevel != 0) {
     if (dataSize != 0) {
-      m_deflater.setInput(&buffer.front(), uncompressedSize);
+      m_deflater.setInput(&m_downloadBuffer.front(), uncompressedSize);
       m_deflater.deflate();
       _ASSERT((UINT32)m_deflater.getOutputSize() == m_deflater.getOutputSize());
       compressedSize = (UINT32)m_deflater.getOutputSize();
@@ -846,7 +852,7 @@ void FileTransferRequestHandler::downloadDataRequested()
 
   if (compressionLevel == 0) {
     if (dataSize != 0) {
-      m_output->writeFully(&buffer.front(), uncompressedSize);
+      m_output->writeFully(&m_downloadBuffer.front(), uncompressedSize);
     }
   } else {
     m_output->writeFully((const char *)m_deflater.getOutput(), compressedSize);
@@ -25,6 +25,8 @@
 #ifndef _FILE_TRANSFER_REQUEST_HANDLER_H_
 #define _FILE_TRANSFER_REQUEST_HANDLER_H_
 
+#include <vector>
+
 #include "util/inttypes.h"
 #include "network/RfbInputGate.h"
 #include "network/RfbOutputGate.h"
@@ -144,6 +146,13 @@ protected:
   File *m_downloadFile;
   WinFileChannel *m_fileInputStream;
 
+  // Buffer for file data, reused by all download data requests.
+  std::vector<char> m_downloadBuffer;
+
+  // Clients can request big chunks to keep a link busy, but the size of
+  // one reply is limited.
+  static const UINT32 MAX_DOWNLOAD_DATA_SIZE = 4 * 1024 * 1024;
+
   //
   // Upload operation members
   //
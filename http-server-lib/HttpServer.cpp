@@ -36,6 +36,8 @@ HttpServer::HttpServer(const TCHAR *bindHost, unsigned short bindPort, bool lock
 
 HttpServer::~HttpServer()
 {
+  stop();
+
   m_log->message(_T("Http server stopped"));
 }
 
@@ -0,0 +1,110 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "BufferedInputStream.h"
+
+#include <crtdbg.h>
+
+BufferedInputStream::BufferedInputStream(InputStream *input)
+: m_input(input),
+  m_buffer(BUFFER_SIZE),
+  m_begin(0),
+  m_end(0),
+  m_readCalls(0)
+{
+}
+
+BufferedInputStream::~BufferedInputStream()
+{
+}
+
+size_t BufferedInputStream::read(void *buffer, size_t len)
+{
+  if (len == 0) {
+    return 0;
+  }
+
+  if (m_begin == m_end) {
+    if (len >= BUFFER_SIZE) {
+      m_readCalls++;
+      return m_input->read(buffer, len);
+    }
+    fill();
+  }
+
+  size_t portion = m_end - m_begin;
+  if (portion > len) {
+    portion = len;
+  }
+  memcpy(buffer, &m_buffer[m_begin], portion);
+  skip(portion);
+  return portion;
+}
+
+size_t BufferedInputStream::available() const
+{
+  return m_end - m_begin;
+}
+
+void BufferedInputStream::ensureAvailable(size_t len)
+{
+  _ASSERT(len <= BUFFER_SIZE);
+
+  while (m_end - m_begin < len) {
+    fill();
+  }
+}
+
+const UINT8 *BufferedInputStream::peek() const
+{
+  return &m_buffer[m_begin];
+}
+
+void BufferedInputStream::skip(size_t len)
+{
+  _ASSERT(len <= m_end - m_begin);
+
+  m_begin += len;
+  if (m_begin == m_end) {
+    m_begin = m_end = 0;
+  }
+}
+
+UINT64 BufferedInputStream::getReadCalls() const
+{
+  return m_readCalls;
+}
+
+void BufferedInputStream::fill()
+{
+  if (m_begin != 0) {
+    memmove(&m_buffer[0], &m_buffer[m_begin], m_end - m_begin);
+    m_end -= m_begin;
+    m_begin = 0;
+  }
+
+  m_readCalls++;
+  m_end += m_input->read(&m_buffer[m_end], BUFFER_SIZE - m_end);
+}
@@ -0,0 +1,113 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef _BUFFERED_INPUT_STREAM_H_
+#define _BUFFERED_INPUT_STREAM_H_
+
+#include <vector>
+
+#include "InputStream.h"
+#include "util/inttypes.h"
+
+/**
+ * Buffered input stream class (decorator pattern).
+ * Reads the real input stream ahead by large portions, so small reads
+ * are served from the inner buffer. Reads bigger than the buffer go
+ * directly to the real input stream when the buffer is empty.
+ */
+class BufferedInputStream : public InputStream
+{
+public:
+  static const size_t BUFFER_SIZE = 64 * 1024;
+
+  /**
+   * Creates new buffered input stream.
+   * @param input real input stream.
+   */
+  BufferedInputStream(InputStream *input);
+  virtual ~BufferedInputStream();
+
+  /**
+   * Reads data from the inner buffer or from the real input stream.
+   * @throw IOException on error.
+   * @fixme really it can throw any kind of exception.
+   */
+  virtual size_t read(void *buffer, size_t len) throw(IOException);
+
+  /**
+   * Returns count of bytes in the inner buffer.
+   */
+  size_t available() const;
+
+  /**
+   * Reads the real input stream until at least `len' bytes are in the
+   * inner buffer.
+   * @param len count of bytes, must not exceed BUFFER_SIZE.
+   * @throw IOException on error.
+   */
+  void ensureAvailable(size_t len) throw(IOException);
+
+  /**
+   * Returns pointer to the buffered data. It's valid until the next
+   * read() or ensureAvailable() call.
+   */
+  const UINT8 *peek() const;
+
+  /**
+   * Skips buffered data.
+   * @param len count of bytes, must not exceed available().
+   */
+  void skip(size_t len);
+
+  /**
+   * Returns the number of calls of the real input stream since creation.
+   */
+  UINT64 getReadCalls() const;
+
+protected:
+  /**
+   * Moves the buffered data to the beginning of the buffer and reads
+   * the real input stream once into the rest of the buffer.
+   */
+  void fill() throw(IOException);
+
+  InputStream *m_input;
+
+  std::vector<UINT8> m_buffer;
+  /**
+   * Buffered data is located in [m_begin, m_end) of m_buffer.
+   */
+  size_t m_begin;
+  size_t m_end;
+
+  UINT64 m_readCalls;
+
+private:
+  // Do not allow copying objects.
+  BufferedInputStream(const BufferedInputStream &other);
+  BufferedInputStream &operator=(const BufferedInputStream &other);
+};
+
+#endif
@@ -55,7 +55,10 @@ size_t ByteArrayOutputStream::write(const void *buffer, size_t len)
   bool allocateNewBuffer = (m_size + len) > m_max;
 
   if (allocateNewBuffer && m_ownMemory) {
-    size_t reserve = DEFAULT_INNER_BUFFER_CAPACITY;
+    // Grow geometrically so that writing big data by small portions
+    // does not end up in quadratic copying.
+    size_t reserve = m_max > DEFAULT_INNER_BUFFER_CAPACITY ?
+                     m_max : DEFAULT_INNER_BUFFER_CAPACITY;
     // Create new buffer with some reserve
     char *newBuffer = new char[m_size + len + reserve];
     // Copy old buffer content to new
@@ -87,3 +90,8 @@ const char *ByteArrayOutputStream::toByteArray() const
 {
   return m_buffer;
 }
+
+void ByteArrayOutputStream::reset()
+{
+  m_size = 0;
+}
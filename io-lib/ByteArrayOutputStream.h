@@ -70,6 +70,12 @@ public:
    */
   const char *toByteArray() const;
 
+  /**
+   * Discards written data but keeps the allocated memory, so the stream
+   * can be reused without new allocations.
+   */
+  void reset();
+
 protected:
   bool m_ownMemory;
   char *m_buffer;
@@ -0,0 +1,200 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "ChunkedOutputStream.h"
+
+#include "util/DateTime.h"
+
+ChunkedOutputStream::ChunkedOutputStream(OutputStream *output)
+: m_output(output),
+  m_lastChunkLength(0),
+  m_chunkSize(MIN_CHUNK_SIZE),
+  m_measuredBytes(0),
+  m_measuredTime(0),
+  m_bytesWritten(0),
+  m_writeTime(0),
+  m_writeCalls(0)
+{
+}
+
+ChunkedOutputStream::~ChunkedOutputStream()
+{
+  try {
+    flush();
+  } catch (...) {
+  } // try / catch.
+
+  std::vector<std::vector<char> *>::iterator it;
+  for (it = m_chunks.begin(); it != m_chunks.end(); it++) {
+    delete *it;
+  }
+  for (it = m_freeChunks.begin(); it != m_freeChunks.end(); it++) {
+    delete *it;
+  }
+}
+
+size_t ChunkedOutputStream::write(const void *buffer, size_t len)
+{
+  m_bytesWritten += len;
+
+  const char *src = (const char *)buffer;
+  size_t left = len;
+  while (left != 0) {
+    if (m_chunks.empty() || m_lastChunkLength == m_chunkSize) {
+      if (m_chunks.size() >= MAX_CHUNKS) {
+        writeChunks(m_chunks.size());
+      }
+      appendChunk();
+    }
+    size_t portion = m_chunkSize - m_lastChunkLength;
+    if (portion > left) {
+      portion = left;
+    }
+    memcpy(&m_chunks.back()->front() + m_lastChunkLength, src, portion);
+    m_lastChunkLength += portion;
+    src += portion;
+    left -= portion;
+  }
+
+  return len;
+}
+
+void ChunkedOutputStream::flush()
+{
+  writeChunks(m_chunks.size());
+}
+
+UINT64 ChunkedOutputStream::getBytesWritten() const
+{
+  return m_bytesWritten;
+}
+
+UINT64 ChunkedOutputStream::getWriteTime() const
+{
+  return m_writeTime;
+}
+
+UINT64 ChunkedOutputStream::getWriteCalls() const
+{
+  return m_writeCalls;
+}
+
+size_t ChunkedOutputStream::getChunkSize() const
+{
+  return m_chunkSize;
+}
+
+void ChunkedOutputStream::writeChunks(size_t numChunks)
+{
+  if (numChunks == 0) {
+    return;
+  }
+
+  const void *buffers[MAX_CHUNKS];
+  size_t lengths[MAX_CHUNKS];
+  size_t totalLength = 0;
+  for (size_t i = 0; i < numChunks; i++) {
+    buffers[i] = &m_chunks[i]->front();
+    lengths[i] = i == m_chunks.size() - 1 ? m_lastChunkLength : m_chunkSize;
+    totalLength += lengths[i];
+  }
+
+  UINT64 startTime = DateTime::now().getTime();
+  size_t first = 0;
+  while (first < numChunks) {
+    size_t written = m_output->writeGather(&buffers[first], &lengths[first],
+                                           numChunks - first);
+    m_writeCalls++;
+    // Skip the written data.
+    while (first < numChunks && written >= lengths[first]) {
+      written -= lengths[first];
+      first++;
+    }
+    if (first < numChunks) {
+      buffers[first] = (const char *)buffers[first] + written;
+      lengths[first] -= written;
+    }
+  }
+  UINT64 endTime = DateTime::now().getTime();
+  UINT64 writeTime = endTime > startTime ? endTime - startTime : 0;
+  m_writeTime += writeTime;
+
+  // Release the written chunks, the rest is moved to the chain head.
+  bool lastWritten = numChunks == m_chunks.size();
+  for (size_t i = 0; i < numChunks; i++) {
+    if (m_chunks[i]->size() == m_chunkSize) {
+      m_freeChunks.push_back(m_chunks[i]);
+    } else {
+      delete m_chunks[i];
+    }
+  }
+  m_chunks.erase(m_chunks.begin(), m_chunks.begin() + numChunks);
+  if (lastWritten) {
+    m_lastChunkLength = 0;
+  }
+
+  adaptChunkSize(totalLength, writeTime);
+}
+
+void ChunkedOutputStream::appendChunk()
+{
+  std::vector<char> *chunk;
+  if (!m_freeChunks.empty()) {
+    chunk = m_freeChunks.back();
+    m_freeChunks.pop_back();
+  } else {
+    chunk = new std::vector<char>(m_chunkSize);
+  }
+  m_chunks.push_back(chunk);
+  m_lastChunkLength = 0;
+}
+
+void ChunkedOutputStream::adaptChunkSize(size_t bytes, UINT64 millis)
+{
+  m_measuredBytes += bytes;
+  m_measuredTime += millis;
+  if (m_measuredTime < MEASURE_TIME) {
+    return;
+  }
+
+  UINT64 targetSize = m_measuredBytes * TARGET_CHUNK_TIME / m_measuredTime;
+  m_measuredBytes = 0;
+  m_measuredTime = 0;
+
+  // The chunk size is changed only when the chain is empty, so all the
+  // chunks of the chain have the same size.
+  size_t newSize = MIN_CHUNK_SIZE;
+  while (newSize < targetSize && newSize < MAX_CHUNK_SIZE) {
+    newSize *= 2;
+  }
+  if (newSize != m_chunkSize && m_chunks.empty()) {
+    m_chunkSize = newSize;
+    std::vector<std::vector<char> *>::iterator it;
+    for (it = m_freeChunks.begin(); it != m_freeChunks.end(); it++) {
+      delete *it;
+    }
+    m_freeChunks.clear();
+  }
+}
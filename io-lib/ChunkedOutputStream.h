@@ -0,0 +1,149 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef _CHUNKED_OUTPUT_STREAM_H_
+#define _CHUNKED_OUTPUT_STREAM_H_
+
+#include <vector>
+
+#include "OutputStream.h"
+#include "util/inttypes.h"
+
+/**
+ * Chunked output stream class (decorator pattern).
+ * Accumulates written data in a chain of large chunks and writes the
+ * whole chain to the real output stream by writeGather() calls, so a big
+ * update costs a few calls of the real stream instead of thousands.
+ *
+ * Chunk size adapts to the measured throughput of the real stream: it is
+ * chosen so that writing one chunk takes about TARGET_CHUNK_TIME
+ * milliseconds. Released chunks are kept for reuse.
+ */
+class ChunkedOutputStream : public OutputStream
+{
+public:
+  static const size_t MIN_CHUNK_SIZE = 16 * 1024;
+  static const size_t MAX_CHUNK_SIZE = 512 * 1024;
+  /**
+   * When the chain reaches this number of full chunks, they are written
+   * without waiting for flush().
+   */
+  static const size_t MAX_CHUNKS = 16;
+
+  /**
+   * Creates new chunked output stream.
+   * @param output real output stream.
+   */
+  ChunkedOutputStream(OutputStream *output);
+  virtual ~ChunkedOutputStream();
+
+  /**
+   * Writes data to output stream (with buffering).
+   * @throw IOException on error.
+   * @fixme really it can throw any kind of exception.
+   */
+  virtual size_t write(const void *buffer, size_t len) throw(IOException);
+
+  /**
+   * Writes all the chunks to real output stream.
+   * @throws IOException on error.
+   * @fixme really it can throw any kind of exception.
+   */
+  virtual void flush() throw(IOException);
+
+  /**
+   * Returns total number of bytes passed to write() since creation.
+   */
+  UINT64 getBytesWritten() const;
+
+  /**
+   * Returns total time spent writing to the real output stream since
+   * creation, in milliseconds.
+   */
+  UINT64 getWriteTime() const;
+
+  /**
+   * Returns the number of calls of the real output stream since creation.
+   */
+  UINT64 getWriteCalls() const;
+
+  /**
+   * Returns the current chunk size.
+   */
+  size_t getChunkSize() const;
+
+protected:
+  /**
+   * Writes the first `numChunks' chunks to the real output stream and
+   * releases them.
+   */
+  void writeChunks(size_t numChunks) throw(IOException);
+
+  /**
+   * Appends a chunk to the chain taking it from the free chunks if
+   * possible.
+   */
+  void appendChunk();
+
+  /**
+   * Updates the chunk size after writing `bytes' bytes in `millis'
+   * milliseconds.
+   */
+  void adaptChunkSize(size_t bytes, UINT64 millis);
+
+  static const unsigned int TARGET_CHUNK_TIME = 10;
+  /**
+   * Throughput is measured over at least this number of milliseconds.
+   */
+  static const unsigned int MEASURE_TIME = 100;
+
+  OutputStream *m_output;
+
+  /**
+   * Chain of chunks, only the last chunk can be filled partially.
+   * Each chunk has the size of m_chunkSize.
+   */
+  std::vector<std::vector<char> *> m_chunks;
+  /**
+   * Length of data in the last chunk.
+   */
+  size_t m_lastChunkLength;
+  std::vector<std::vector<char> *> m_freeChunks;
+  size_t m_chunkSize;
+
+  UINT64 m_measuredBytes;
+  UINT64 m_measuredTime;
+
+  UINT64 m_bytesWritten;
+  UINT64 m_writeTime;
+  UINT64 m_writeCalls;
+
+private:
+  // Do not allow copying objects.
+  ChunkedOutputStream(const ChunkedOutputStream &other);
+  ChunkedOutputStream &operator=(const ChunkedOutputStream &other);
+};
+
+#endif
@@ -28,6 +28,18 @@ OutputStream::~OutputStream()
 {
 }
 
+size_t OutputStream::writeGather(const void *const *buffers,
+                                 const size_t *lengths,
+                                 size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    if (lengths[i] != 0) {
+      return write(buffers[i], lengths[i]);
+    }
+  }
+  return 0;
+}
+
 void OutputStream::flush()
 {
 }
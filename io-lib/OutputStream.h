@@ -44,6 +44,22 @@ public:
    */
   virtual size_t write(const void *buffer, size_t len) = 0;
 
+  /**
+   * Writes data of several buffers to stream in their order.
+   * @param buffers array of buffers with data to write.
+   * @param lengths array of buffer lengths.
+   * @param count number of buffers.
+   * @return count of written bytes, it can be less than the total length.
+   * @throws any kind of exception (depends on implementation).
+   *
+   * writeGather method of OutputStream writes only the first non-empty
+   * buffer, it can be override by subclasses which can write all the
+   * buffers at once.
+   */
+  virtual size_t writeGather(const void *const *buffers,
+                             const size_t *lengths,
+                             size_t count);
+
   /**
    * Flushes inner buffer to real output stream.
    *
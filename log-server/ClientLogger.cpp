@@ -33,14 +33,17 @@ ClientLogger::ClientLogger(const TCHAR *publicPipeName, const TCHAR *logFileName
   m_levListenChan(0),
   m_logInput(0),
   m_logOutput(0),
+  m_batchOutput(&m_batchBuffer),
   m_logBarrier(0),
   m_logFileName(logFileName),
-  m_publicPipeName(publicPipeName)
+  m_publicPipeName(publicPipeName),
+  m_queue(this)
 {
 }
 
 ClientLogger::~ClientLogger()
 {
+  m_queue.stop();
   freeResources();
 }
 
@@ -51,10 +54,15 @@ void ClientLogger::freeResources()
   resume();
   wait();
   if (m_levListenChan != 0) delete m_levListenChan;
+  m_levListenChan = 0;
 
+  AutoLock al(&m_logWritingMut);
   if (m_logOutput != 0) delete m_logOutput;
   if (m_logInput != 0) delete m_logInput;
   if (m_logSendingChan != 0) delete m_logSendingChan;
+  m_logOutput = 0;
+  m_logInput = 0;
+  m_logSendingChan = 0;
 }
 
 void ClientLogger::connect()
@@ -97,8 +105,11 @@ void ClientLogger::connect()
   int logLevel = getLogBarrier();
   setLogBarrier(9);
   try {
+    // The queued lines must get to the dump first.
+    m_queue.drain();
     AutoLock al(&m_logWritingMut);
     writeLogDump();
+    flushRecords();
   } catch (...) { // "finally"
     setLogBarrier(logLevel);
   }
@@ -110,12 +121,34 @@ void ClientLogger::connect()
 
 void ClientLogger::print(int logLevel, const TCHAR *line)
 {
-  UINT32 processId = GetCurrentProcessId();
-  UINT32 threadId = GetCurrentThreadId();
+  m_queue.push(logLevel, line);
+}
 
+void ClientLogger::writeRecord(unsigned int processId,
+                               unsigned int threadId,
+                               const DateTime *dt,
+                               int level,
+                               const TCHAR *message)
+{
   AutoLock al(&m_logWritingMut);
-  updateLogDumpLines(processId, threadId, &DateTime::now(), logLevel, line);
-  flush(processId, threadId, &DateTime::now(), logLevel, line);
+  updateLogDumpLines(processId, threadId, dt, level, message);
+  flush(processId, threadId, dt, level, message);
+}
+
+void ClientLogger::flushRecords()
+{
+  AutoLock al(&m_logWritingMut);
+  if (m_batchBuffer.size() == 0) {
+    return;
+  }
+  if (m_logOutput != 0) {
+    try {
+      m_logOutput->writeFully(m_batchBuffer.toByteArray(),
+                              m_batchBuffer.size());
+    } catch (...) {
+    }
+  }
+  m_batchBuffer.reset();
 }
 
 bool ClientLogger::acceptsLevel(int logLevel)
@@ -134,11 +167,11 @@ void ClientLogger::flush(unsigned int processId,
   if (level <= getLogBarrier()) {
     if (m_logOutput != 0) {
       try {
-        m_logOutput->writeUInt32(processId);
-        m_logOutput->writeUInt32(threadId);
-        m_logOutput->writeUInt64(dt->getTime());
-        m_logOutput->writeUInt8(level & 0xf);
-        m_logOutput->writeUTF8(message);
+        m_batchOutput.writeUInt32(processId);
+        m_batchOutput.writeUInt32(threadId);
+        m_batchOutput.writeUInt64(dt->getTime());
+        m_batchOutput.writeUInt8(level & 0xf);
+        m_batchOutput.writeUTF8(message);
       } catch (...) {
       }
     }
@@ -147,7 +180,6 @@ void ClientLogger::flush(unsigned int processId,
 
 int ClientLogger::getLogBarrier()
 {
-  AutoLock al(&m_logBarMut);
   return m_logBarrier;
 }
 
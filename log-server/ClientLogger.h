@@ -29,12 +29,17 @@
 #include "io-lib/Channel.h"
 #include "io-lib/DataInputStream.h"
 #include "io-lib/DataOutputStream.h"
+#include "io-lib/ByteArrayOutputStream.h"
 #include "thread/Thread.h"
 #include "log-writer/Logger.h"
 #include "thread/AutoLock.h"
 #include "log-writer/LogDump.h"
+#include "log-writer/LogRecordQueue.h"
 
-class ClientLogger : public Logger, private Thread, public LogDump
+// The log lines are queued and sent to the log server by a background
+// thread in batches.
+class ClientLogger : public Logger, private Thread, public LogDump,
+                     private LogRecordSink
 {
 public:
   // @param logFileName - is a file name for log without extension.
@@ -49,7 +54,7 @@ public:
   // @throw Exception on an error.
   void connect();
 
-  // Sends log line to the log server.
+  // Queues log line to be sent to the log server.
   virtual void print(int logLevel, const TCHAR *line);
 
   virtual bool acceptsLevel(int logLevel);
@@ -62,6 +67,15 @@ private:
                      int level,
                      const TCHAR *message);
 
+  // Implementation of the LogRecordSink interface.
+  virtual void writeRecord(unsigned int processId,
+                           unsigned int threadId,
+                           const DateTime *dt,
+                           int level,
+                           const TCHAR *message);
+  // Sends the batched records by one write.
+  virtual void flushRecords();
+
   void freeResources();
 
   virtual void execute();
@@ -74,13 +88,20 @@ private:
   DataOutputStream *m_logOutput;
   LocalMutex m_logWritingMut;
 
+  // The records are collected here before sending.
+  ByteArrayOutputStream m_batchBuffer;
+  DataOutputStream m_batchOutput;
+
   Channel *m_levListenChan;
 
-  int m_logBarrier;
+  // Is read without locking to make the level check cheap.
+  volatile int m_logBarrier;
   LocalMutex m_logBarMut;
 
   StringStorage m_logFileName;
   StringStorage m_publicPipeName;
+
+  LogRecordQueue m_queue;
 };
 
 #endif // __CLIENTLOGGER_H__
@@ -36,7 +36,8 @@ FileAccount::FileAccount(const TCHAR *logDir,
   m_fileName(fileName),
   m_level(0), // Real initialization must be in the setNewFile() function
   m_asFirstOpen(true),
-  m_file(0)
+  m_file(0),
+  m_buffered(false)
 {
   setNewFile(logLevel, logDir);
 }
@@ -45,7 +46,8 @@ FileAccount::FileAccount(bool logHeadEnabled)
 : LogDump(logHeadEnabled, true), // This constructor enables writing the log to the dump.
   m_level(0), // Real initialization must be in the setNewFile() function
   m_asFirstOpen(true),
-  m_file(0)
+  m_file(0),
+  m_buffered(false)
 {
 }
 
@@ -101,6 +103,31 @@ bool FileAccount::acceptsLevel(int logLevel)
   return logDumpEnabled() || logHeadEnabled() || printsLine(logLevel);
 }
 
+void FileAccount::setBuffered(bool buffered)
+{
+  AutoLock al(&m_logMut);
+  m_buffered = buffered;
+  if (!m_buffered) {
+    flushBuffer();
+  }
+}
+
+void FileAccount::flushBuffer()
+{
+  AutoLock al(&m_logMut);
+  if (m_writeBuffer.empty()) {
+    return;
+  }
+  std::vector<char> buffer;
+  buffer.swap(m_writeBuffer);
+  if (m_file != 0) {
+    m_file->write(&buffer.front(), buffer.size());
+    if (m_level > 9) {
+      m_file->flush();
+    }
+  }
+}
+
 bool FileAccount::printsLine(int level)
 {
   return m_file != 0 && level <= m_level;
@@ -125,6 +152,7 @@ void FileAccount::print(int level, const TCHAR *message)
   unsigned int threadId = GetCurrentThreadId();
   DateTime dt = DateTime::now();
   print(processId, threadId, &dt, level, message);
+  flushBuffer();
 }
 
 void FileAccount::format(unsigned int processId,
@@ -171,7 +199,16 @@ void FileAccount::format(unsigned int processId,
   const TCHAR endLine[] = { 13, 10 };
 
   // Writing string without null-termination symbol.
-  if (m_file != 0) {
+  if (m_file != 0 && m_buffered) {
+    const char *line = (const char *)resultLine.getString();
+    m_writeBuffer.insert(m_writeBuffer.end(), line,
+                         line + resultLine.getSize() - sizeof(TCHAR));
+    m_writeBuffer.insert(m_writeBuffer.end(), (const char *)endLine,
+                         (const char *)endLine + sizeof(endLine));
+    if (m_writeBuffer.size() > WRITE_BUFFER_LIMIT) {
+      flushBuffer();
+    }
+  } else if (m_file != 0) {
     m_file->write(resultLine.getString(), resultLine.getSize() - sizeof(TCHAR));
     m_file->write(endLine, sizeof(endLine));
     if (logBarrier > 9) {
@@ -266,6 +303,7 @@ void FileAccount::openFile()
       } else {
         writeLogHeader();
       }
+      flushBuffer();
     } catch (...) {
       closeFile();
     }
@@ -275,6 +313,11 @@ void FileAccount::openFile()
 void FileAccount::closeFile()
 {
   if (m_file != 0) {
+    try {
+      flushBuffer();
+    } catch (...) {
+    }
+    m_writeBuffer.clear();
     delete m_file;
     m_file = 0;
   }
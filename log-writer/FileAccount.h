@@ -31,6 +31,8 @@
 #include "file-lib/WinFile.h"
 #include "LogDump.h"
 
+#include <vector>
+
 class FileAccount : public LogDump
 {
 public:
@@ -91,6 +93,14 @@ public:
 
   virtual bool acceptsLevel(int logLevel);
 
+  // In the buffered mode the formatted lines are accumulated in memory
+  // and written to the file by flushBuffer() in one piece.
+  void setBuffered(bool buffered);
+
+  // Writes the accumulated lines to the file.
+  // @throw Exception on an error.
+  void flushBuffer();
+
 protected:
   virtual void flush(unsigned int processId,
                      unsigned int threadId,
@@ -140,6 +150,11 @@ private:
   bool m_asFirstOpen;
   WinFile *m_file;
 
+  bool m_buffered;
+  std::vector<char> m_writeBuffer;
+  // The buffer is flushed when it grows over this size.
+  static const size_t WRITE_BUFFER_LIMIT = 64 * 1024;
+
   LocalMutex m_logMut;
 };
 
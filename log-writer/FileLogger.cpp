@@ -26,41 +26,59 @@
 
 FileLogger::FileLogger(const TCHAR *logDir, const TCHAR *fileName,
                        unsigned char logLevel, bool logHeadEnabled)
-: m_fileAccount(logDir, fileName, logLevel, logHeadEnabled)
+: m_fileAccount(logDir, fileName, logLevel, logHeadEnabled),
+  m_queue(this)
 {
+  m_fileAccount.setBuffered(true);
 }
 
 FileLogger::FileLogger(bool logHeadEnabled)
-: m_fileAccount(logHeadEnabled)
+: m_fileAccount(logHeadEnabled),
+  m_queue(this)
 {
+  m_fileAccount.setBuffered(true);
 }
 
 FileLogger::~FileLogger()
 {
+  m_queue.stop();
 }
 
 void FileLogger::init(const TCHAR *logDir, const TCHAR *fileName, unsigned char logLevel)
 {
+  // The lines queued before must get to the log dump.
+  m_queue.drain();
   m_fileAccount.init(logDir, fileName, logLevel);
 }
 
 void FileLogger::storeHeader()
 {
+  m_queue.drain();
   m_fileAccount.storeHeader();
 }
 
 void FileLogger::print(int logLevel, const TCHAR *line)
 {
   try {
-    UINT32 processId = GetCurrentProcessId();
-    UINT32 threadId = GetCurrentThreadId();
-    DateTime currTime = DateTime::now();
-
-    m_fileAccount.print(processId, threadId, &currTime, logLevel, line);
+    m_queue.push(logLevel, line);
   } catch (...) {
   }
 }
 
+void FileLogger::writeRecord(unsigned int processId,
+                             unsigned int threadId,
+                             const DateTime *dt,
+                             int level,
+                             const TCHAR *message)
+{
+  m_fileAccount.print(processId, threadId, dt, level, message);
+}
+
+void FileLogger::flushRecords()
+{
+  m_fileAccount.flushBuffer();
+}
+
 bool FileLogger::acceptsLevel(int logLevel)
 {
   return m_fileAccount.acceptsLevel(logLevel);
@@ -68,5 +86,6 @@ bool FileLogger::acceptsLevel(int logLevel)
 
 void FileLogger::changeLogProps(const TCHAR *newLogDir, unsigned char newLevel)
 {
+  m_queue.drain();
   m_fileAccount.changeLogProps(newLogDir, newLevel);
 }
@@ -27,9 +27,11 @@
 
 #include "FileAccount.h"
 #include "log-writer/Logger.h"
+#include "LogRecordQueue.h"
 
 // This class is an implementation of the Logger class to write the log into a file.
-class FileLogger : public Logger
+// The lines are queued and written to the file by a background thread.
+class FileLogger : public Logger, private LogRecordSink
 {
 public:
   // @param logDir - a valid path to directory for log file.
@@ -68,13 +70,23 @@ public:
   // object creation.
   void changeLogProps(const TCHAR *newLogDir, unsigned char newLevel);
 
-  // Stores a log line to the file.
+  // Queues a log line to be stored to the file.
   virtual void print(int logLevel, const TCHAR *line);
 
   virtual bool acceptsLevel(int logLevel);
 
 private:
+  // Implementation of the LogRecordSink interface.
+  virtual void writeRecord(unsigned int processId,
+                           unsigned int threadId,
+                           const DateTime *dt,
+                           int level,
+                           const TCHAR *message);
+  virtual void flushRecords();
+
   FileAccount m_fileAccount;
+  // Must be destroyed before m_fileAccount.
+  LogRecordQueue m_queue;
 };
 
 #endif // __FILELOGGER_H__
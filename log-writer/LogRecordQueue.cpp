@@ -0,0 +1,319 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "LogRecordQueue.h"
+#include "thread/AutoLock.h"
+
+struct LogRecordQueue::RecordHeader
+{
+  // Total size of the record in bytes, a multiple of RECORD_ALIGNMENT.
+  UINT32 size;
+  UINT32 threadId;
+  UINT64 time;
+  INT32 level;
+  // Message length in characters without the terminating zero, or
+  // WRAP_MARKER if the next record is at the beginning of the ring.
+  UINT32 length;
+};
+
+static const size_t RECORD_ALIGNMENT = 8;
+static const UINT32 WRAP_MARKER = 0xffffffff;
+
+struct LogRecordQueue::Ring
+{
+  UINT8 data[RING_SIZE];
+  // Written by the owner thread only.
+  volatile LONG head;
+  // Written by the draining thread only.
+  volatile LONG tail;
+  HANDLE thread;
+};
+
+struct LogRecordQueue::RingCursor
+{
+  Ring *ring;
+  size_t head;
+  size_t tail;
+};
+
+LogRecordQueue::LogRecordQueue(LogRecordSink *sink)
+: m_sink(sink),
+  m_spaceWaiters(0),
+  m_stopped(false)
+{
+  m_tlsIndex = TlsAlloc();
+  resume();
+}
+
+LogRecordQueue::~LogRecordQueue()
+{
+  stop();
+
+  for (size_t i = 0; i < m_rings.size(); i++) {
+    CloseHandle(m_rings[i]->thread);
+    delete m_rings[i];
+  }
+  TlsFree(m_tlsIndex);
+}
+
+void LogRecordQueue::push(int level, const TCHAR *message)
+{
+  size_t length = _tcslen(message);
+  Ring *ring = 0;
+  if (!m_stopped && length <= MAX_MESSAGE_LENGTH) {
+    ring = getRing();
+  }
+  if (ring == 0) {
+    writeSynchronously(level, message);
+    return;
+  }
+
+  bool halfFull;
+  if (!writeToRing(ring, level, message, length, &halfFull)) {
+    // The ring is full, wait until the queue thread drains it.
+    InterlockedIncrement(&m_spaceWaiters);
+    do {
+      m_wakeEvent.notify();
+      if (m_stopped) {
+        InterlockedDecrement(&m_spaceWaiters);
+        writeSynchronously(level, message);
+        return;
+      }
+      m_spaceEvent.waitForEvent(DRAIN_INTERVAL);
+    } while (!writeToRing(ring, level, message, length, &halfFull));
+    // The event wakes up one thread, pass it to the next waiting one.
+    if (InterlockedDecrement(&m_spaceWaiters) != 0) {
+      m_spaceEvent.notify();
+    }
+    if (m_stopped) {
+      drain();
+      return;
+    }
+  }
+  if (level <= URGENT_LEVEL || halfFull) {
+    m_wakeEvent.notify();
+  }
+}
+
+void LogRecordQueue::drain()
+{
+  AutoLock al(&m_ringsMutex);
+
+  m_cursors.resize(m_rings.size());
+  for (size_t i = 0; i < m_rings.size(); i++) {
+    m_cursors[i].ring = m_rings[i];
+    m_cursors[i].head =
+      (size_t)InterlockedCompareExchange(&m_rings[i]->head, 0, 0);
+    m_cursors[i].tail = (size_t)m_rings[i]->tail;
+  }
+
+  // Merge the records of all the threads by time.
+  unsigned int processId = GetCurrentProcessId();
+  bool written = false;
+  while (true) {
+    RingCursor *earliest = 0;
+    const RecordHeader *record = 0;
+    for (size_t i = 0; i < m_cursors.size(); i++) {
+      const RecordHeader *candidate = peekRecord(&m_cursors[i]);
+      if (candidate != 0 && (record == 0 || candidate->time < record->time)) {
+        earliest = &m_cursors[i];
+        record = candidate;
+      }
+    }
+    if (record == 0) {
+      break;
+    }
+    DateTime dt(record->time);
+    try {
+      m_sink->writeRecord(processId, record->threadId, &dt, record->level,
+                          (const TCHAR *)(record + 1));
+    } catch (...) {
+    }
+    earliest->tail += record->size;
+    written = true;
+  }
+
+  for (size_t i = 0; i < m_cursors.size(); i++) {
+    InterlockedExchange(&m_cursors[i].ring->tail, (LONG)m_cursors[i].tail);
+  }
+  if (InterlockedCompareExchange(&m_spaceWaiters, 0, 0) != 0) {
+    m_spaceEvent.notify();
+  }
+  if (written) {
+    try {
+      m_sink->flushRecords();
+    } catch (...) {
+    }
+  }
+
+  releaseFinishedRings();
+}
+
+void LogRecordQueue::stop()
+{
+  if (!m_stopped) {
+    terminate();
+    wait();
+    m_stopped = true;
+    // The threads waiting for space write synchronously now.
+    m_spaceEvent.notify();
+  }
+  drain();
+}
+
+void LogRecordQueue::execute()
+{
+  while (!isTerminating()) {
+    m_wakeEvent.waitForEvent(DRAIN_INTERVAL);
+    drain();
+  }
+}
+
+void LogRecordQueue::onTerminate()
+{
+  m_wakeEvent.notify();
+}
+
+LogRecordQueue::Ring *LogRecordQueue::getRing()
+{
+  if (m_tlsIndex == TLS_OUT_OF_INDEXES) {
+    return 0;
+  }
+  Ring *ring = (Ring *)TlsGetValue(m_tlsIndex);
+  if (ring != 0) {
+    return ring;
+  }
+
+  // The real handle allows to find out when the thread has finished.
+  HANDLE thread;
+  if (!DuplicateHandle(GetCurrentProcess(), GetCurrentThread(),
+                       GetCurrentProcess(), &thread,
+                       SYNCHRONIZE, FALSE, 0)) {
+    return 0;
+  }
+  ring = new Ring;
+  ring->head = 0;
+  ring->tail = 0;
+  ring->thread = thread;
+  {
+    AutoLock al(&m_ringsMutex);
+    m_rings.push_back(ring);
+  }
+  TlsSetValue(m_tlsIndex, ring);
+  return ring;
+}
+
+bool LogRecordQueue::writeToRing(Ring *ring, int level, const TCHAR *message,
+                                 size_t length, bool *halfFull)
+{
+  size_t head = (size_t)ring->head;
+  size_t tail = (size_t)InterlockedCompareExchange(&ring->tail, 0, 0);
+  size_t used = (head + RING_SIZE - tail) % RING_SIZE;
+  // One alignment unit is kept free to tell a full ring from an empty one.
+  size_t freeSpace = RING_SIZE - used - RECORD_ALIGNMENT;
+
+  size_t size = sizeof(RecordHeader) + (length + 1) * sizeof(TCHAR);
+  size = (size + RECORD_ALIGNMENT - 1) & ~(RECORD_ALIGNMENT - 1);
+
+  size_t start = head;
+  size_t contiguous = RING_SIZE - head;
+  if (contiguous < size) {
+    // The rest of the ring is skipped.
+    if (freeSpace < contiguous + size) {
+      return false;
+    }
+    if (contiguous >= sizeof(RecordHeader)) {
+      RecordHeader *marker = (RecordHeader *)&ring->data[head];
+      marker->size = (UINT32)contiguous;
+      marker->length = WRAP_MARKER;
+    }
+    start = 0;
+  } else if (freeSpace < size) {
+    return false;
+  }
+
+  RecordHeader *record = (RecordHeader *)&ring->data[start];
+  record->size = (UINT32)size;
+  record->threadId = GetCurrentThreadId();
+  record->time = DateTime::now().getTime();
+  record->level = level;
+  record->length = (UINT32)length;
+  memcpy(record + 1, message, (length + 1) * sizeof(TCHAR));
+
+  // Publishes the record with a full memory barrier.
+  InterlockedExchange(&ring->head, (LONG)((start + size) % RING_SIZE));
+  *halfFull = used + size > RING_SIZE / 2;
+  return true;
+}
+
+const LogRecordQueue::RecordHeader *LogRecordQueue::peekRecord(RingCursor *cursor)
+{
+  while (cursor->tail != cursor->head) {
+    size_t contiguous = RING_SIZE - cursor->tail;
+    if (contiguous < sizeof(RecordHeader)) {
+      cursor->tail = 0;
+      continue;
+    }
+    const RecordHeader *record =
+      (const RecordHeader *)&cursor->ring->data[cursor->tail];
+    if (record->length == WRAP_MARKER) {
+      cursor->tail = 0;
+      continue;
+    }
+    return record;
+  }
+  return 0;
+}
+
+void LogRecordQueue::releaseFinishedRings()
+{
+  for (size_t i = 0; i < m_rings.size();) {
+    Ring *ring = m_rings[i];
+    // A finished thread can not add records any longer.
+    if (WaitForSingleObject(ring->thread, 0) == WAIT_OBJECT_0 &&
+        ring->head == ring->tail) {
+      CloseHandle(ring->thread);
+      delete ring;
+      m_rings.erase(m_rings.begin() + i);
+    } else {
+      i++;
+    }
+  }
+}
+
+void LogRecordQueue::writeSynchronously(int level, const TCHAR *message)
+{
+  // The queued records of this thread must go first.
+  drain();
+
+  AutoLock al(&m_ringsMutex);
+  DateTime dt = DateTime::now();
+  try {
+    m_sink->writeRecord(GetCurrentProcessId(), GetCurrentThreadId(), &dt,
+                        level, message);
+    m_sink->flushRecords();
+  } catch (...) {
+  }
+}
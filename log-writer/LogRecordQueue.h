@@ -0,0 +1,127 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __LOGRECORDQUEUE_H__
+#define __LOGRECORDQUEUE_H__
+
+#include "util/CommonHeader.h"
+#include "util/DateTime.h"
+#include "thread/Thread.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+
+#include <vector>
+
+// Receiver of the log records queued by LogRecordQueue.
+class LogRecordSink
+{
+public:
+  virtual ~LogRecordSink() {}
+
+  // Writes a log record. Records are written from one thread at a time.
+  virtual void writeRecord(unsigned int processId,
+                           unsigned int threadId,
+                           const DateTime *dt,
+                           int level,
+                           const TCHAR *message) = 0;
+
+  // Called after a batch of writeRecord() calls, so the sink can send all
+  // the batch at once.
+  virtual void flushRecords() = 0;
+};
+
+// LogRecordQueue takes log lines from any thread and passes them to a sink
+// from its own thread, so formatting and writing the lines do not slow down
+// the logging threads.
+//
+// Every logging thread gets its own ring buffer of binary records (level,
+// thread id, timestamp and message), so pushing a record is lock-free: the
+// only lock is taken once per thread to register its ring. The queue thread
+// wakes up every DRAIN_INTERVAL milliseconds (or at once for errors and
+// when a ring is getting full), merges
+// the records of all the rings by time and passes them to the sink.
+//
+// The message is copied to the record already formatted because arguments
+// like strings may not outlive the logging call.
+class LogRecordQueue : private Thread
+{
+public:
+  static const DWORD DRAIN_INTERVAL = 50;
+  static const size_t RING_SIZE = 32 * 1024;
+  // Longer messages are written synchronously.
+  static const size_t MAX_MESSAGE_LENGTH = 2048;
+  // Records with this or more important level wake up the queue thread.
+  static const int URGENT_LEVEL = 1;
+
+  LogRecordQueue(LogRecordSink *sink);
+  virtual ~LogRecordQueue();
+
+  // Queues a log line.
+  void push(int level, const TCHAR *message);
+
+  // Passes all the queued records to the sink from the calling thread.
+  void drain();
+
+  // Stops the queue thread and drains the queue. After that the records
+  // are passed to the sink synchronously.
+  void stop();
+
+private:
+  struct Ring;
+  struct RingCursor;
+  struct RecordHeader;
+
+  virtual void execute();
+  virtual void onTerminate();
+
+  // Returns the ring of the calling thread, creates it on first call.
+  Ring *getRing();
+  // Writes the record to the ring. Returns false if there is no space.
+  // Sets *halfFull to true if the ring is filled more than a half.
+  bool writeToRing(Ring *ring, int level, const TCHAR *message,
+                   size_t length, bool *halfFull);
+  // Returns the next record of the cursor or 0 if there is no one.
+  const RecordHeader *peekRecord(RingCursor *cursor);
+  // Removes rings of finished threads. Must be called under m_ringsMutex.
+  void releaseFinishedRings();
+
+  void writeSynchronously(int level, const TCHAR *message);
+
+  LogRecordSink *m_sink;
+  DWORD m_tlsIndex;
+
+  std::vector<Ring *> m_rings;
+  std::vector<RingCursor> m_cursors;
+  // Protects m_rings and serializes the draining.
+  LocalMutex m_ringsMutex;
+
+  WindowsEvent m_wakeEvent;
+  // Signaled by drain() when threads wait for space in their rings.
+  WindowsEvent m_spaceEvent;
+  volatile LONG m_spaceWaiters;
+  volatile bool m_stopped;
+};
+
+#endif // __LOGRECORDQUEUE_H__
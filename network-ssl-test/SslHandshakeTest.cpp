@@ -0,0 +1,106 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "SslHandshakeTest.h"
+
+#include "thread/AutoLock.h"
+#include "thread/Thread.h"
+#include "util/DateTime.h"
+
+SslHandshakeTest::SslHandshakeTest()
+: TcpServer(_T("127.0.0.1"), PORT, true),
+  m_acceptedCount(0)
+{
+}
+
+SslHandshakeTest::~SslHandshakeTest()
+{
+  stop();
+}
+
+void SslHandshakeTest::run()
+{
+  start();
+
+  // Connects and never sends the ClientHello, so a handshake thread waits
+  // for it until the handshake times out.
+  SocketIPv4 staller(false);
+  staller.connect(_T("127.0.0.1"), getBindPort());
+
+  // The handshake of the second client must not wait for the first one.
+  DateTime startTime = DateTime::now();
+  SocketIPv4 client(true);
+  client.connect(_T("127.0.0.1"), getBindPort());
+  m_acceptedEvent.waitForEvent(ACCEPT_TIMEOUT);
+  UINT64 elapsedMillis = (DateTime::now() - startTime).getTime();
+
+  if (getAcceptedCount() != 1) {
+    throw Exception(_T("The second client has not been accepted"));
+  }
+  if (elapsedMillis >= SSL_HANDSHAKE_TIMEOUT) {
+    StringStorage message;
+    message.format(_T("The second client has been accepted in %u ms, after")
+                   _T(" the stalled handshake had timed out"),
+                   (unsigned int)elapsedMillis);
+    throw Exception(message.getString());
+  }
+
+  // The staller stays connected, so its handshake can only time out.
+  // Thread is a private base of TcpServer, so it is named from the global
+  // scope.
+  ::Thread::sleep(SSL_HANDSHAKE_TIMEOUT + TIMEOUT_MARGIN);
+
+  SslHandshakeStats stats;
+  if (!getSslHandshakeStats(&stats)) {
+    throw Exception(_T("The server has no SSL handshake statistics"));
+  }
+  if (stats.accepted != 2 || stats.succeeded != 1 || stats.timedOut != 1 ||
+      stats.failed != 0) {
+    StringStorage message;
+    message.format(_T("Unexpected SSL handshake statistics: accepted %u,")
+                   _T(" succeeded %u, timed out %u, failed %u"),
+                   (unsigned int)stats.accepted, (unsigned int)stats.succeeded,
+                   (unsigned int)stats.timedOut, (unsigned int)stats.failed);
+    throw Exception(message.getString());
+  }
+  if (getAcceptedCount() != 1) {
+    throw Exception(_T("The stalled client has been accepted"));
+  }
+}
+
+void SslHandshakeTest::onAcceptConnection(SocketIPv4 *socket)
+{
+  delete socket;
+  {
+    AutoLock al(&m_acceptedMutex);
+    m_acceptedCount++;
+  }
+  m_acceptedEvent.notify();
+}
+
+size_t SslHandshakeTest::getAcceptedCount()
+{
+  AutoLock al(&m_acceptedMutex);
+  return m_acceptedCount;
+}
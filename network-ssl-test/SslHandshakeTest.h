@@ -0,0 +1,69 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _SSL_HANDSHAKE_TEST_H_
+#define _SSL_HANDSHAKE_TEST_H_
+
+#include "network/TcpServer.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+
+//
+// Checks that a client that connects to an SSL TcpServer and never sends
+// its ClientHello does not stop other clients from being accepted, and
+// that its handshake is counted as timed out after
+// TcpServer::SSL_HANDSHAKE_TIMEOUT.
+//
+// The server loads server_certificate.pem and server_key.pem from the folder
+// of the executable, where the network project copies them after the build.
+//
+class SslHandshakeTest : public TcpServer
+{
+public:
+  SslHandshakeTest();
+  virtual ~SslHandshakeTest();
+
+  // Throws Exception if a check fails.
+  void run();
+
+protected:
+  virtual void onAcceptConnection(SocketIPv4 *socket);
+
+private:
+  size_t getAcceptedCount();
+
+  LocalMutex m_acceptedMutex;
+  size_t m_acceptedCount;
+  WindowsEvent m_acceptedEvent;
+
+  static const unsigned short PORT = 15901;
+
+  // Time given to the second client to be accepted.
+  static const unsigned int ACCEPT_TIMEOUT = 5000;
+  // Time given to the server to count the stalled handshake, in addition
+  // to TcpServer::SSL_HANDSHAKE_TIMEOUT.
+  static const unsigned int TIMEOUT_MARGIN = 2000;
+};
+
+#endif
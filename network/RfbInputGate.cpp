@@ -25,10 +25,82 @@
 #include "RfbInputGate.h"
 
 RfbInputGate::RfbInputGate(Channel *stream)
-: DataInputStream(stream)
+: DataInputStream(0)
 {
+  m_tunnel = new BufferedInputStream(stream);
+
+  // Change real input stream for data input stream to our tunnel.
+  m_inputStream = m_tunnel;
 }
 
 RfbInputGate::~RfbInputGate()
 {
+  delete m_tunnel;
+}
+
+void RfbInputGate::ensureAvailable(size_t len)
+{
+  m_tunnel->ensureAvailable(len);
+}
+
+size_t RfbInputGate::available() const
+{
+  return m_tunnel->available();
+}
+
+const UINT8 *RfbInputGate::peek() const
+{
+  return m_tunnel->peek();
+}
+
+void RfbInputGate::skip(size_t len)
+{
+  m_tunnel->skip(len);
+}
+
+UINT64 RfbInputGate::getReadCalls() const
+{
+  return m_tunnel->getReadCalls();
+}
+
+UINT8 RfbInputGate::readUInt8()
+{
+  m_tunnel->ensureAvailable(1);
+  UINT8 x = m_tunnel->peek()[0];
+  m_tunnel->skip(1);
+  return x;
+}
+
+UINT16 RfbInputGate::readUInt16()
+{
+  m_tunnel->ensureAvailable(2);
+  const UINT8 *buf = m_tunnel->peek();
+  UINT16 x = (UINT16)((buf[0] << 8) | buf[1]);
+  m_tunnel->skip(2);
+  return x;
+}
+
+UINT32 RfbInputGate::readUInt32()
+{
+  m_tunnel->ensureAvailable(4);
+  const UINT8 *buf = m_tunnel->peek();
+  UINT32 x = ((UINT32)buf[0] << 24) | ((UINT32)buf[1] << 16) |
+             ((UINT32)buf[2] << 8) | (UINT32)buf[3];
+  m_tunnel->skip(4);
+  return x;
+}
+
+INT8 RfbInputGate::readInt8()
+{
+  return (INT8)readUInt8();
+}
+
+INT16 RfbInputGate::readInt16()
+{
+  return (INT16)readUInt16();
+}
+
+INT32 RfbInputGate::readInt32()
+{
+  return (INT32)readUInt32();
 }
@@ -28,12 +28,64 @@
 #include "io-lib/Channel.h"
 
 #include "io-lib/DataInputStream.h"
+#include "io-lib/BufferedInputStream.h"
 
+/**
+ * Gate for reading rfb messages.
+ *
+ * Data is read from the channel ahead by large portions (see
+ * BufferedInputStream), so reading message headers field by field does not
+ * cost a call of the channel for each field. The integer readers of this
+ * class decode values right from the buffer.
+ */
 class RfbInputGate : public DataInputStream
 {
 public:
   RfbInputGate(Channel *stream);
   virtual ~RfbInputGate();
+
+  /**
+   * Reads the channel until at least `len' bytes are buffered, so the
+   * following reads of these bytes do not access the channel.
+   * @param len count of bytes, must not exceed BufferedInputStream::BUFFER_SIZE.
+   * @throws IOException on error.
+   */
+  void ensureAvailable(size_t len) throw(IOException);
+
+  /**
+   * Returns count of buffered bytes.
+   */
+  size_t available() const;
+
+  /**
+   * Returns pointer to the buffered data, it's valid until the next read.
+   */
+  const UINT8 *peek() const;
+
+  /**
+   * Skips buffered bytes.
+   * @param len count of bytes, must not exceed available().
+   */
+  void skip(size_t len);
+
+  /**
+   * Returns the number of reads from the channel since creation.
+   */
+  UINT64 getReadCalls() const;
+
+  UINT8 readUInt8() throw(IOException);
+  UINT16 readUInt16() throw(IOException);
+  UINT32 readUInt32() throw(IOException);
+
+  INT8 readInt8() throw(IOException);
+  INT16 readInt16() throw(IOException);
+  INT32 readInt32() throw(IOException);
+
+private:
+  /**
+   * Tunnel that adds buffering.
+   */
+  BufferedInputStream *m_tunnel;
 };
 
 #endif
@@ -29,7 +29,7 @@
 RfbOutputGate::RfbOutputGate(OutputStream *stream)
 : DataOutputStream(0)
 {
-  m_tunnel = new BufferedOutputStream(stream);
+  m_tunnel = new ChunkedOutputStream(stream);
 
   // Change real output stream for data output stream to our tunnel.
   m_outStream = m_tunnel;
@@ -44,3 +44,18 @@ void RfbOutputGate::flush()
 {
   m_tunnel->flush();
 }
+
+UINT64 RfbOutputGate::getBytesWritten() const
+{
+  return m_tunnel->getBytesWritten();
+}
+
+UINT64 RfbOutputGate::getWriteTime() const
+{
+  return m_tunnel->getWriteTime();
+}
+
+UINT64 RfbOutputGate::getWriteCalls() const
+{
+  return m_tunnel->getWriteCalls();
+}
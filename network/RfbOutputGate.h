@@ -26,7 +26,7 @@
 #define _RFB_OUTPUT_GATE_H_
 
 #include "io-lib/DataOutputStream.h"
-#include "io-lib/BufferedOutputStream.h"
+#include "io-lib/ChunkedOutputStream.h"
 
 #include "thread/LocalMutex.h"
 
@@ -34,7 +34,7 @@
  * Gate for writting rfb messages.
  *
  * @features: gate is synchonized (can be locked and unlocked, supports data buffering, and writting
- * typized data).
+ * typized data). Data is buffered in a chain of large chunks (see ChunkedOutputStream).
  * @remark: after every message you want to send to must manually call flush() cause
  * "autoflush on unlock" is removed.
  * @author enikey.
@@ -59,11 +59,28 @@ public:
    */
   virtual void flush() throw(IOException);
 
+  /**
+   * Returns total number of bytes written to the gate since creation,
+   * including data not flushed yet.
+   */
+  UINT64 getBytesWritten() const;
+
+  /**
+   * Returns total time spent writing to the real output stream since
+   * creation, in milliseconds.
+   */
+  UINT64 getWriteTime() const;
+
+  /**
+   * Returns the number of calls of the real output stream since creation.
+   */
+  UINT64 getWriteCalls() const;
+
 private:
   /**
    * Tunnel that adds buffering.
    */
-  BufferedOutputStream *m_tunnel;
+  ChunkedOutputStream *m_tunnel;
 };
 
 #endif
@@ -0,0 +1,173 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "SslHandshakePool.h"
+
+#include "thread/AutoLock.h"
+#include "util/DateTime.h"
+
+const unsigned int SslHandshakeStats::LATENCY_BOUNDS[LATENCY_BUCKETS - 1] =
+  { 10, 50, 200, 1000, 5000 };
+
+SslHandshakeStats::SslHandshakeStats()
+: accepted(0),
+  dropped(0),
+  succeeded(0),
+  resumed(0),
+  failed(0),
+  timedOut(0),
+  firstAcceptTime(0),
+  lastAcceptTime(0)
+{
+  memset(latencyHistogram, 0, sizeof(latencyHistogram));
+}
+
+double SslHandshakeStats::getAcceptRate() const
+{
+  if (accepted < 2 || lastAcceptTime <= firstAcceptTime) {
+    return 0.0;
+  }
+  return (double)(accepted - 1) * 1000.0 /
+         (double)(lastAcceptTime - firstAcceptTime);
+}
+
+SslHandshakePool::SslHandshakePool(SslHandshakeListener *listener,
+                                   size_t numThreads,
+                                   unsigned int timeoutMillis,
+                                   size_t maxPendingSockets)
+: m_listener(listener),
+  m_timeoutMillis(timeoutMillis),
+  m_maxPendingSockets(maxPendingSockets)
+{
+  for (size_t i = 0; i < numThreads; i++) {
+    SslHandshakeThread *thread = new SslHandshakeThread(this, timeoutMillis);
+    m_threads.push_back(thread);
+    thread->resume();
+  }
+}
+
+SslHandshakePool::~SslHandshakePool()
+{
+  shutdown();
+}
+
+void SslHandshakePool::shutdown()
+{
+  std::vector<SslHandshakeThread *>::iterator it;
+  for (it = m_threads.begin(); it != m_threads.end(); it++) {
+    (*it)->terminate();
+  }
+  for (it = m_threads.begin(); it != m_threads.end(); it++) {
+    (*it)->wait();
+    delete *it;
+  }
+  m_threads.clear();
+
+  AutoLock al(&m_queueMutex);
+  std::deque<SocketIPv4 *>::iterator sockIt;
+  for (sockIt = m_queue.begin(); sockIt != m_queue.end(); sockIt++) {
+    delete *sockIt;
+  }
+  m_queue.clear();
+}
+
+void SslHandshakePool::addSocket(SocketIPv4 *socket)
+{
+  {
+    AutoLock al(&m_queueMutex);
+    UINT64 now = DateTime::now().getTime();
+    if (m_stats.accepted == 0) {
+      m_stats.firstAcceptTime = now;
+    }
+    m_stats.lastAcceptTime = now;
+    m_stats.accepted++;
+
+    if (m_queue.size() >= m_maxPendingSockets) {
+      m_stats.dropped++;
+    } else {
+      m_queue.push_back(socket);
+      socket = 0;
+    }
+  }
+  if (socket != 0) {
+    delete socket;
+    return;
+  }
+
+  std::vector<SslHandshakeThread *>::iterator it;
+  for (it = m_threads.begin(); it != m_threads.end(); it++) {
+    (*it)->notify();
+  }
+}
+
+void SslHandshakePool::getStats(SslHandshakeStats *stats)
+{
+  AutoLock al(&m_queueMutex);
+  *stats = m_stats;
+}
+
+SocketIPv4 *SslHandshakePool::takeSocket()
+{
+  AutoLock al(&m_queueMutex);
+  if (m_queue.empty()) {
+    return 0;
+  }
+  SocketIPv4 *socket = m_queue.front();
+  m_queue.pop_front();
+  return socket;
+}
+
+void SslHandshakePool::onHandshakeFinished(SocketIPv4 *socket,
+                                           bool succeeded,
+                                           bool resumed,
+                                           UINT64 latencyMillis)
+{
+  {
+    AutoLock al(&m_queueMutex);
+    size_t bucket = 0;
+    while (bucket < SslHandshakeStats::LATENCY_BUCKETS - 1 &&
+           latencyMillis >= SslHandshakeStats::LATENCY_BOUNDS[bucket]) {
+      bucket++;
+    }
+    m_stats.latencyHistogram[bucket]++;
+
+    if (succeeded) {
+      m_stats.succeeded++;
+      if (resumed) {
+        m_stats.resumed++;
+      }
+    } else if (latencyMillis >= m_timeoutMillis) {
+      m_stats.timedOut++;
+    } else {
+      m_stats.failed++;
+    }
+  }
+
+  if (succeeded) {
+    m_listener->onSslHandshakeCompleted(socket);
+  } else {
+    delete socket;
+  }
+}
@@ -0,0 +1,159 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef _SSL_HANDSHAKE_POOL_H_
+#define _SSL_HANDSHAKE_POOL_H_
+
+#include <vector>
+#include <deque>
+
+#include "util/inttypes.h"
+#include "thread/LocalMutex.h"
+
+#include "SslHandshakeThread.h"
+#include "SslHandshakeListener.h"
+
+/**
+ * Statistics of the accepted SSL connections.
+ */
+struct SslHandshakeStats
+{
+  static const size_t LATENCY_BUCKETS = 6;
+  /**
+   * Upper bounds (exclusive) of the latency histogram buckets
+   * in milliseconds. The last bucket has no bound.
+   */
+  static const unsigned int LATENCY_BOUNDS[LATENCY_BUCKETS - 1];
+
+  SslHandshakeStats();
+
+  /**
+   * Returns the average rate of accepted connections per second.
+   */
+  double getAcceptRate() const;
+
+  UINT64 accepted;
+  /**
+   * Connections dropped because the handshake queue was full.
+   */
+  UINT64 dropped;
+  UINT64 succeeded;
+  /**
+   * Succeeded handshakes that have resumed a previous session.
+   */
+  UINT64 resumed;
+  UINT64 failed;
+  UINT64 timedOut;
+  /**
+   * Handshake latency histogram, failed handshakes are included.
+   */
+  UINT64 latencyHistogram[LATENCY_BUCKETS];
+  /**
+   * Times of the first and the last accepted connections in milliseconds.
+   */
+  UINT64 firstAcceptTime;
+  UINT64 lastAcceptTime;
+};
+
+/**
+ * Performs server side SSL handshakes of accepted sockets on a number of
+ * worker threads, so a slow or malicious client cannot stall the thread
+ * that accepts connections. Each handshake is limited by a timeout, sockets
+ * that have passed the handshake are passed to the listener, others are
+ * deleted.
+ */
+class SslHandshakePool
+{
+public:
+  /**
+   * Creates the pool and starts its threads.
+   * @param listener receiver of the sockets with completed handshakes.
+   * @param numThreads number of handshake threads.
+   * @param timeoutMillis maximum duration of one handshake.
+   * @param maxPendingSockets sockets accepted above this number of
+   * queued sockets are dropped.
+   */
+  SslHandshakePool(SslHandshakeListener *listener,
+                   size_t numThreads,
+                   unsigned int timeoutMillis,
+                   size_t maxPendingSockets);
+  /**
+   * Terminates the threads and deletes the sockets left in the queue.
+   */
+  virtual ~SslHandshakePool();
+
+  /**
+   * Terminates and waits for the threads, deletes the queued sockets.
+   * The listener is not called after the method returns, but statistics
+   * are still available.
+   * @remark the method can be called several times.
+   */
+  void shutdown();
+
+  /**
+   * Queues an accepted socket for the handshake.
+   * @param socket socket that has the handshake pending, the pool takes
+   * the ownership.
+   */
+  void addSocket(SocketIPv4 *socket);
+
+  /**
+   * Returns statistics of the connections passed to the pool.
+   */
+  void getStats(SslHandshakeStats *stats);
+
+  /**
+   * Called by handshake threads. Returns the next queued socket or 0 if
+   * the queue is empty.
+   */
+  SocketIPv4 *takeSocket();
+  /**
+   * Called by handshake threads when a handshake is finished. Passes
+   * the socket to the listener on success or deletes it otherwise.
+   */
+  void onHandshakeFinished(SocketIPv4 *socket, bool succeeded,
+                           bool resumed, UINT64 latencyMillis);
+
+protected:
+  SslHandshakeListener *m_listener;
+  unsigned int m_timeoutMillis;
+  size_t m_maxPendingSockets;
+
+  std::vector<SslHandshakeThread *> m_threads;
+
+  /**
+   * Queue of sockets and statistics, protected by m_queueMutex.
+   */
+  std::deque<SocketIPv4 *> m_queue;
+  SslHandshakeStats m_stats;
+  LocalMutex m_queueMutex;
+
+private:
+  // Do not allow copying objects.
+  SslHandshakePool(const SslHandshakePool &other);
+  SslHandshakePool &operator=(const SslHandshakePool &other);
+};
+
+#endif
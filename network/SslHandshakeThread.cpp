@@ -0,0 +1,87 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "SslHandshakeThread.h"
+#include "SslHandshakePool.h"
+
+#include "thread/AutoLock.h"
+#include "util/DateTime.h"
+
+SslHandshakeThread::SslHandshakeThread(SslHandshakePool *pool,
+                                       unsigned int timeoutMillis)
+: m_pool(pool),
+  m_timeoutMillis(timeoutMillis),
+  m_socket(0)
+{
+}
+
+SslHandshakeThread::~SslHandshakeThread()
+{
+}
+
+void SslHandshakeThread::notify()
+{
+  m_queueEvent.notify();
+}
+
+void SslHandshakeThread::execute()
+{
+  while (!isTerminating()) {
+    SocketIPv4 *socket = m_pool->takeSocket();
+    if (socket == 0) {
+      m_queueEvent.waitForEvent();
+      continue;
+    }
+
+    setCurrentSocket(socket);
+    DateTime startTime = DateTime::now();
+    bool succeeded = true;
+    try {
+      socket->acceptSslHandshake(m_timeoutMillis);
+    } catch (...) {
+      succeeded = false;
+    }
+    UINT64 latency = (DateTime::now() - startTime).getTime();
+    setCurrentSocket(0);
+
+    m_pool->onHandshakeFinished(socket, succeeded && !isTerminating(),
+                                socket->isSslSessionReused(), latency);
+  }
+}
+
+void SslHandshakeThread::onTerminate()
+{
+  AutoLock al(&m_socketMutex);
+  if (m_socket != 0) {
+    try { m_socket->shutdown(SD_BOTH); } catch (...) { }
+  }
+  m_queueEvent.notify();
+}
+
+void SslHandshakeThread::setCurrentSocket(SocketIPv4 *socket)
+{
+  AutoLock al(&m_socketMutex);
+  m_socket = socket;
+}
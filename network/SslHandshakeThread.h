@@ -0,0 +1,74 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef _SSL_HANDSHAKE_THREAD_H_
+#define _SSL_HANDSHAKE_THREAD_H_
+
+#include "thread/Thread.h"
+#include "thread/LocalMutex.h"
+#include "win-system/WindowsEvent.h"
+
+#include "socket/SocketIPv4.h"
+
+class SslHandshakePool;
+
+/**
+ * One worker thread of SslHandshakePool. Takes accepted sockets from
+ * the pool queue and performs their SSL handshakes.
+ */
+class SslHandshakeThread : public Thread
+{
+public:
+  SslHandshakeThread(SslHandshakePool *pool, unsigned int timeoutMillis);
+  virtual ~SslHandshakeThread();
+
+  /**
+   * Wakes the thread up to take sockets from the pool queue.
+   */
+  void notify();
+
+protected:
+  virtual void execute();
+
+  /**
+   * Inherited from Thread class.
+   * Shutdowns the socket whose handshake is in progress.
+   */
+  virtual void onTerminate();
+
+  void setCurrentSocket(SocketIPv4 *socket);
+
+  SslHandshakePool *m_pool;
+  unsigned int m_timeoutMillis;
+  WindowsEvent m_queueEvent;
+
+  /**
+   * Socket whose handshake is in progress, protected by m_socketMutex.
+   */
+  SocketIPv4 *m_socket;
+  LocalMutex m_socketMutex;
+};
+
+#endif
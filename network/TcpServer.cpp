@@ -25,11 +25,15 @@
 #include "TcpServer.h"
 
 #include "network/socket/SocketAddressIPv4.h"
+#include "thread/AutoLock.h"
 
 TcpServer::TcpServer(const TCHAR *bindHost, unsigned short bindPort, bool useSsl,
                      bool autoStart,
                      bool lockAddr)
-: m_bindHost(bindHost), m_bindPort(bindPort), m_listenSocket(useSsl)
+: m_bindHost(bindHost), m_bindPort(bindPort), m_listenSocket(useSsl),
+  m_sslHandshakePool(0),
+  m_useSsl(useSsl),
+  m_stopped(false)
 {
   SocketAddressIPv4 bindAddr = SocketAddressIPv4::resolve(bindHost, bindPort);
 
@@ -40,6 +44,13 @@ TcpServer::TcpServer(const TCHAR *bindHost, unsigned short bindPort, bool useSsl
   m_listenSocket.bind(bindAddr);
   m_listenSocket.listen(10);
 
+  if (useSsl) {
+    m_sslHandshakePool = new SslHandshakePool(this,
+                                              SSL_HANDSHAKE_THREADS,
+                                              SSL_HANDSHAKE_TIMEOUT,
+                                              MAX_PENDING_SSL_HANDSHAKES);
+  }
+
   if (autoStart) {
     start();
   }
@@ -47,6 +58,16 @@ TcpServer::TcpServer(const TCHAR *bindHost, unsigned short bindPort, bool useSsl
 
 TcpServer::~TcpServer()
 {
+  stop();
+}
+
+void TcpServer::stop()
+{
+  if (m_stopped) {
+    return;
+  }
+  m_stopped = true;
+
   try { m_listenSocket.shutdown(SD_BOTH); } catch(...) { }
   try { m_listenSocket.close(); } catch (...) { }
 
@@ -54,6 +75,14 @@ TcpServer::~TcpServer()
     Thread::terminate();
     Thread::wait();
   }
+
+  // Shutting the pool down waits for the handshakes in progress.
+  if (m_sslHandshakePool != 0) {
+    m_sslHandshakePool->shutdown();
+    m_sslHandshakePool->getStats(&m_finalSslStats);
+    delete m_sslHandshakePool;
+    m_sslHandshakePool = 0;
+  }
 }
 
 const TCHAR *TcpServer::getBindHost() const
@@ -66,6 +95,19 @@ unsigned short TcpServer::getBindPort() const
   return m_bindPort;
 }
 
+bool TcpServer::getSslHandshakeStats(SslHandshakeStats *stats)
+{
+  if (!m_useSsl) {
+    return false;
+  }
+  if (m_sslHandshakePool != 0) {
+    m_sslHandshakePool->getStats(stats);
+  } else {
+    *stats = m_finalSslStats;
+  }
+  return true;
+}
+
 void TcpServer::start()
 {
   resume();
@@ -77,15 +119,29 @@ void TcpServer::execute()
     SocketIPv4 *clientSocket = NULL;
 
     try {
-      clientSocket = m_listenSocket.accept();
+      clientSocket = m_listenSocket.accept(false);
     } catch (...) {
       clientSocket = NULL;
     }
 
-    if (clientSocket != NULL) {
-      onAcceptConnection(clientSocket);
-    } else {
+    if (clientSocket == NULL) {
       break ;
     }
+    if (clientSocket->isSslHandshakePending()) {
+      m_sslHandshakePool->addSocket(clientSocket);
+    } else {
+      acceptConnection(clientSocket);
+    }
   }
 }
+
+void TcpServer::onSslHandshakeCompleted(SocketIPv4 *socket)
+{
+  acceptConnection(socket);
+}
+
+void TcpServer::acceptConnection(SocketIPv4 *socket)
+{
+  AutoLock al(&m_acceptMutex);
+  onAcceptConnection(socket);
+}
@@ -27,7 +27,9 @@
 
 #include "thread/Thread.h"
 #include "util/Exception.h"
+#include "thread/LocalMutex.h"
 #include "network/socket/SocketIPv4.h"
+#include "network/SslHandshakePool.h"
 
 /**
  * Abstract multithreaded TCP server class.
@@ -35,8 +37,11 @@
  * but don't know what to do with incoming connections.
  * @usage create subclass of TcpServer and call start (or use autoStart flag)
  * in TcpServer constructor.
+ * @remark SSL handshakes are performed by a pool of handshake threads,
+ * so onAcceptConnection() can be called from any of them, but calls are
+ * never concurrent.
  */
-class TcpServer : private Thread
+class TcpServer : private Thread, private SslHandshakeListener
 {
 public:
   /**
@@ -69,12 +74,32 @@ public:
    */
   unsigned short getBindPort() const;
 
+  /**
+   * Returns statistics of accepted SSL connections.
+   * @return false if the server does not use SSL.
+   */
+  bool getSslHandshakeStats(SslHandshakeStats *stats);
+
+  /**
+   * Time in milliseconds given to a client to complete its SSL handshake.
+   */
+  static const unsigned int SSL_HANDSHAKE_TIMEOUT = 10000;
+
 protected:
   /**
    * Starts tcp server thread (listen for incoming connections).
    */
   virtual void start();
 
+  /**
+   * Closes listening socket, waits for the tcp server thread and deletes
+   * the SSL handshake pool, so onAcceptConnection() is not called any more.
+   * Subclasses must call it in their destructors, before they destroy
+   * anything onAcceptConnection() uses.
+   * @remark the method can be called several times.
+   */
+  void stop();
+
   /**
    * Called from tcp server thread when server accepts connection to process it.
    * @param socket incoming connection socket.
@@ -87,7 +112,20 @@ protected:
    */
   virtual void execute();
 
+  /**
+   * Inherited from SslHandshakeListener class.
+   */
+  virtual void onSslHandshakeCompleted(SocketIPv4 *socket);
+
 private:
+  static const size_t SSL_HANDSHAKE_THREADS = 4;
+  static const size_t MAX_PENDING_SSL_HANDSHAKES = 64;
+
+  /**
+   * Calls onAcceptConnection() under m_acceptMutex.
+   */
+  void acceptConnection(SocketIPv4 *socket);
+
   /**
    * Listening socket.
    */
@@ -100,6 +138,26 @@ private:
    * Port to bind.
    */
   unsigned short m_bindPort;
+  /**
+   * Pool of SSL handshake threads, 0 if the server does not use SSL.
+   */
+  SslHandshakePool *m_sslHandshakePool;
+  /**
+   * True if the server uses SSL.
+   */
+  bool m_useSsl;
+  /**
+   * Statistics of the SSL handshake pool at the moment it was deleted.
+   */
+  SslHandshakeStats m_finalSslStats;
+  /**
+   * True if stop() has been called.
+   */
+  bool m_stopped;
+  /**
+   * Serializes onAcceptConnection() calls.
+   */
+  LocalMutex m_acceptMutex;
 };
 
 #endif
@@ -31,6 +31,7 @@
 #include "SocketAddressIPv4.h"
 #include "SocketIPv4.h"
 #include "win-system/Environment.h"
+#include "util/DateTime.h"
 
 #include "thread/AutoLock.h"
 
@@ -51,8 +52,12 @@ SocketIPv4::SocketIPv4(bool useSsl)
 }
 
 bool SocketIPv4::sslInitialized = false;
-int SocketIPv4::sslSocketCount = 0;
-SSL_CTX* SocketIPv4::m_sslCtx = NULL;
+SSL_CTX* SocketIPv4::m_sslServerCtx = NULL;
+SSL_CTX* SocketIPv4::m_sslClientCtx = NULL;
+std::map<StringStorage, SSL_SESSION *> SocketIPv4::m_sslClientSessions;
+UINT64 SocketIPv4::m_fullHandshakes[2] = { 0, 0 };
+UINT64 SocketIPv4::m_resumedHandshakes[2] = { 0, 0 };
+LocalMutex SocketIPv4::m_sslMutex;
 
 SocketIPv4::~SocketIPv4()
 {
@@ -75,29 +80,84 @@ SocketIPv4::~SocketIPv4()
 	}
 }
 
-void SocketIPv4::createSslSocket(bool server)
+void SocketIPv4::newSsl(bool server)
 {
-	if (m_ssl != NULL)
-		return;
+	AutoLock l(&m_sslMutex);
 
-	sslSocketCount++;
-	if (sslSocketCount == 1)
-		initializeSsl(server);
+	initializeSsl(server);
 
-	m_ssl = SSL_new(m_sslCtx);
-	if(m_ssl == NULL)
+	m_ssl = SSL_new(server ? m_sslServerCtx : m_sslClientCtx);
+	if (m_ssl == NULL)
 		throwSslException();
-	SSL_set_fd(m_ssl, m_socket);
-	if (server)
-	{
-		if (SSL_accept(m_ssl) <= 0)
-			throwSslException();
+	SSL_set_fd(m_ssl, (int)m_socket);
+
+	if (!server) {
+		// Offer the session of the previous connection to the same address.
+		std::map<StringStorage, SSL_SESSION *>::iterator it =
+			m_sslClientSessions.find(m_sslSessionKey);
+		if (it != m_sslClientSessions.end()) {
+			SSL_set_session(m_ssl, it->second);
+		}
 	}
-	else
-	{
-		if (SSL_connect(m_ssl) <= 0)
-			throwSslException();
+}
+
+void SocketIPv4::onSslHandshakeDone(bool server, bool succeeded)
+{
+	AutoLock l(&m_sslMutex);
+
+	int side = server ? 1 : 0;
+	if (succeeded) {
+		if (SSL_session_reused(m_ssl)) {
+			m_resumedHandshakes[side]++;
+		} else {
+			m_fullHandshakes[side]++;
+		}
 	}
+	if (server) {
+		return;
+	}
+
+	std::map<StringStorage, SSL_SESSION *>::iterator it =
+		m_sslClientSessions.find(m_sslSessionKey);
+	if (it != m_sslClientSessions.end()) {
+		SSL_SESSION_free(it->second);
+		m_sslClientSessions.erase(it);
+	}
+	// A session that failed to resume is not offered again.
+	if (succeeded) {
+		SSL_SESSION *session = SSL_get1_session(m_ssl);
+		if (session != NULL) {
+			m_sslClientSessions[m_sslSessionKey] = session;
+		}
+	}
+}
+
+bool SocketIPv4::isSslSessionReused()
+{
+	return m_ssl != NULL && SSL_session_reused(m_ssl) != 0;
+}
+
+void SocketIPv4::getSslHandshakeCounts(bool server,
+                                       UINT64 *fullHandshakes,
+                                       UINT64 *resumedHandshakes)
+{
+	AutoLock l(&m_sslMutex);
+
+	int side = server ? 1 : 0;
+	*fullHandshakes = m_fullHandshakes[side];
+	*resumedHandshakes = m_resumedHandshakes[side];
+}
+
+void SocketIPv4::createSslSocket(bool server)
+{
+	if (m_ssl != NULL)
+		return;
+
+	newSsl(server);
+	int ret = server ? SSL_accept(m_ssl) : SSL_connect(m_ssl);
+	onSslHandshakeDone(server, ret > 0);
+	if (ret <= 0)
+		throwSslException();
 }
 
 void SocketIPv4::destroySslSocket()
@@ -105,11 +165,10 @@ void SocketIPv4::destroySslSocket()
 	if (m_ssl == NULL)
 		return;
 
+	AutoLock l(&m_sslMutex);
+
 	SSL_free(m_ssl);
 	m_ssl = NULL;
-	sslSocketCount--;
-	if (sslSocketCount == 0)
-		shutdownSsl();
 }
 
 void SocketIPv4::initializeSsl(bool server)
@@ -123,12 +182,32 @@ void SocketIPv4::initializeSsl(bool server)
 		OpenSSL_add_ssl_algorithms();
 		//OPENSSL_config(NULL);
 	}
-	if (m_sslCtx == NULL)
-		m_sslCtx = createSslContext(server);
+	if (server && m_sslServerCtx == NULL)
+		m_sslServerCtx = createSslContext(true);
+	if (!server && m_sslClientCtx == NULL)
+		m_sslClientCtx = createSslContext(false);
 }
 
 void SocketIPv4::shutdownSsl()
 {
+	AutoLock l(&m_sslMutex);
+
+	std::map<StringStorage, SSL_SESSION *>::iterator it;
+	for (it = m_sslClientSessions.begin(); it != m_sslClientSessions.end(); it++)
+		SSL_SESSION_free(it->second);
+	m_sslClientSessions.clear();
+
+	if (m_sslServerCtx != NULL)
+	{
+		SSL_CTX_free(m_sslServerCtx);
+		m_sslServerCtx = NULL;
+	}
+	if (m_sslClientCtx != NULL)
+	{
+		SSL_CTX_free(m_sslClientCtx);
+		m_sslClientCtx = NULL;
+	}
+
 	//Not really necessary, since resources will be freed on process termination
 	ERR_free_strings();
 	//RAND_cleanup();
@@ -137,12 +216,6 @@ void SocketIPv4::shutdownSsl()
 	//CONF_modules_free();
 	ERR_remove_state(0);
 	sslInitialized = false;
-
-	if (m_sslCtx != NULL)
-	{
-		SSL_CTX_free(m_sslCtx);
-		m_sslCtx = NULL;
-	}
 }
 
 void SocketIPv4::getSslErrors(TCHAR* m, int size)
@@ -178,8 +251,23 @@ SSL_CTX* SocketIPv4::createSslContext(bool server)
 	if (ctx == NULL)
 		throwSslException();
 
-	if (!server)
+	if (!server) {
+		// Sessions are stored by onSslHandshakeDone(), keyed by the server
+		// address.
+		SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT |
+		                                    SSL_SESS_CACHE_NO_INTERNAL_STORE);
 		return ctx;
+	}
+
+	// The context lives as long as the process, so its session cache and
+	// ticket keys let reconnecting viewers resume their sessions.
+	static const unsigned char sessionIdContext[] = "tvnserver";
+	SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+	SSL_CTX_sess_set_cache_size(ctx, SSL_SESSION_CACHE_SIZE);
+	SSL_CTX_set_timeout(ctx, SSL_SESSION_TIMEOUT);
+	if (!SSL_CTX_set_session_id_context(ctx, sessionIdContext,
+	                                    sizeof(sessionIdContext) - 1))
+		throwSslException();
 
 	//#####################create self-signed certificate and key######################
 	//>openssl.exe req -newkey rsa:2048 -config cnf/openssl.cnf  -nodes -keyout key.pem -x509 -days 365 -out certificate.pem
@@ -232,8 +320,10 @@ void SocketIPv4::connect(const SocketAddressIPv4 &addr)
   if (r <= 0)
 	  throw IOException(_T("Failed to recv data from socket."));*/
 
-  if (m_useSsl)
+  if (m_useSsl) {
+	  addr.toString2(&m_sslSessionKey);
 	  createSslSocket(false);
+  }
 
   AutoLock l(&m_mutex);
 
@@ -298,7 +388,7 @@ void SocketIPv4::listen(int backlog)
   }
 }
 
-SocketIPv4 *SocketIPv4::accept()
+SocketIPv4 *SocketIPv4::accept(bool performHandshake)
 {
   struct sockaddr_in addr;
 
@@ -321,9 +411,84 @@ SocketIPv4 *SocketIPv4::accept()
 
   // Fall out with exception, no need to check if accepted is NULL
   accepted->set(result); 
+
+  if (m_useSsl && performHandshake) {
+    try {
+      accepted->createSslSocket(true);
+    } catch (...) {
+      delete accepted;
+      throw;
+    }
+  }
   return accepted; // Valid and initialized
 }
 
+bool SocketIPv4::isSslHandshakePending() const
+{
+  return m_useSsl && m_ssl == NULL;
+}
+
+void SocketIPv4::acceptSslHandshake(unsigned int timeoutMillis)
+{
+  if (!isSslHandshakePending()) {
+    return;
+  }
+
+  newSsl(true);
+  setBlocking(false);
+
+  DateTime deadline = DateTime::now() + DateTime(timeoutMillis);
+  bool succeeded = false;
+  try {
+    while (true) {
+      int ret = SSL_accept(m_ssl);
+      if (ret > 0) {
+        break;
+      }
+      fd_set fds;
+      FD_ZERO(&fds);
+      FD_SET(m_socket, &fds);
+      int error = SSL_get_error(m_ssl, ret);
+      if (error != SSL_ERROR_WANT_READ && error != SSL_ERROR_WANT_WRITE) {
+        onSslHandshakeDone(true, false);
+        throwSslException();
+      }
+
+      DateTime now = DateTime::now();
+      if (now.getTime() >= deadline.getTime()) {
+        throw SocketException(_T("The SSL handshake has timed out"));
+      }
+      UINT64 leftMillis = (deadline - now).getTime();
+      timeval timeout;
+      timeout.tv_sec = (long)(leftMillis / 1000);
+      timeout.tv_usec = (long)(leftMillis % 1000) * 1000;
+
+      fd_set *readFds = error == SSL_ERROR_WANT_READ ? &fds : NULL;
+      fd_set *writeFds = error == SSL_ERROR_WANT_WRITE ? &fds : NULL;
+      if (select((int)m_socket + 1, readFds, writeFds, NULL, &timeout)
+          == SOCKET_ERROR) {
+        throw SocketException();
+      }
+    }
+    succeeded = true;
+    onSslHandshakeDone(true, true);
+    setBlocking(true);
+  } catch (...) {
+    if (!succeeded) {
+      destroySslSocket();
+    }
+    throw;
+  }
+}
+
+void SocketIPv4::setBlocking(bool blocking)
+{
+  u_long nonBlocking = blocking ? 0 : 1;
+  if (ioctlsocket(m_socket, FIONBIO, &nonBlocking) == SOCKET_ERROR) {
+    throw SocketException();
+  }
+}
+
 void SocketIPv4::set(SOCKET socket)
 {
 	AutoLock l(&m_mutex);
@@ -346,9 +511,6 @@ void SocketIPv4::set(SOCKET socket)
 		//if (s <= 0)
 		//	throw IOException(_T("Failed to send data to socket."));
 
-	if (m_useSsl)
-		createSslSocket(true);
-
 	// Set local and peer addresses for new socket
 	struct sockaddr_in addr;
 	socklen_t addrlen = sizeof(struct sockaddr_in);
@@ -420,6 +582,38 @@ int SocketIPv4::send(const char *data, int size, int flags)
 	return result;
 }
 
+size_t SocketIPv4::sendGather(const char *const *buffers,
+                              const size_t *lengths,
+                              size_t count)
+{
+	static const size_t MAX_WSABUFS = 64;
+
+	if (m_useSsl)
+	{
+		size_t total = 0;
+		for (size_t i = 0; i < count; i++) {
+			if (lengths[i] != 0) {
+				total += (size_t)send(buffers[i], (int)lengths[i]);
+			}
+		}
+		return total;
+	}
+
+	WSABUF wsaBufs[MAX_WSABUFS];
+	DWORD bufCount = 0;
+	for (size_t i = 0; i < count && bufCount < MAX_WSABUFS; i++) {
+		wsaBufs[bufCount].buf = (char *)buffers[i];
+		wsaBufs[bufCount].len = (ULONG)lengths[i];
+		bufCount++;
+	}
+
+	DWORD sent = 0;
+	if (WSASend(m_socket, wsaBufs, bufCount, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+		throw IOException(_T("Failed to send data to socket."));
+
+	return (size_t)sent;
+}
+
 int SocketIPv4::recv(char *buffer, int size, int flags)
 {
 	int result;
@@ -35,6 +35,10 @@
 #include "io-lib/IOException.h"
 #include "win-system/WsaStartup.h"
 #include "thread/LocalMutex.h"
+#include "util/inttypes.h"
+#include "util/StringStorage.h"
+
+#include <map>
 
 #pragma comment(lib,"ws2_32.lib")//ssl support
 #pragma comment(lib,"libssl.lib")//ssl support
@@ -109,10 +113,48 @@ public:
 
 	/**
 	 * Accepts incoming connection.
+	 * @param performHandshake if false, the SSL handshake of an SSL socket
+	 * is left to acceptSslHandshake() of the returned socket, so that it
+	 * can be done outside of the accepting thread.
 	 * @throws SocketException on fail.
 	 * @return newly allocated socket that contain incoming connections.
 	 */
-	SocketIPv4 *accept() throw(SocketException);
+	SocketIPv4 *accept(bool performHandshake = true) throw(SocketException);
+
+	/**
+	 * Checks if the socket is an accepted SSL socket whose handshake
+	 * has not been performed yet.
+	 */
+	bool isSslHandshakePending() const;
+	/**
+	 * Performs the server side of the SSL handshake of an accepted socket.
+	 * The socket is switched to non-blocking mode for the handshake, so
+	 * a stalled peer cannot hold the calling thread longer than the timeout.
+	 * @param timeoutMillis maximum duration of the handshake.
+	 * @throws SocketException on fail or timeout.
+	 */
+	void acceptSslHandshake(unsigned int timeoutMillis) throw(SocketException);
+	/**
+	 * Checks if the SSL handshake of the socket has resumed a previous
+	 * session instead of performing the full handshake.
+	 */
+	bool isSslSessionReused();
+
+	/**
+	 * Returns the numbers of full and resumed successful SSL handshakes
+	 * of the process.
+	 * @param server true for handshakes of accepted sockets, false for
+	 * connected ones.
+	 */
+	static void getSslHandshakeCounts(bool server,
+	                                  UINT64 *fullHandshakes,
+	                                  UINT64 *resumedHandshakes);
+	/**
+	 * Frees the SSL contexts and the client session cache. The contexts
+	 * live as long as the process otherwise, so sessions can be resumed
+	 * after all the sockets have been closed.
+	 */
+	static void shutdownSsl();
 
 	/**
 	 * Sends data to socket.
@@ -124,6 +166,18 @@ public:
 	 * @throw IOException on error.
 	 */
 	int send(const char *data, int size, int flags = 0) throw(IOException);
+	/**
+	 * Sends data of several buffers to socket in one call. SSL sockets
+	 * write each buffer by one SSL_write() call.
+	 *
+	 * @param buffers buffers to send.
+	 * @param lengths sizes of the buffers.
+	 * @param count number of buffers.
+	 * @return count of sent bytes, it can be less than the total size.
+	 * @throw IOException on error.
+	 */
+	size_t sendGather(const char *const *buffers, const size_t *lengths,
+	                  size_t count) throw(IOException);
 	/**
 	 * Receives data from socket.
 	 *
@@ -193,11 +247,31 @@ protected:
 	SSL* m_ssl;
 	void createSslSocket(bool server);
 	void destroySslSocket();
-	static SSL_CTX* m_sslCtx;
+	// Creates m_ssl without performing the handshake. A client socket
+	// offers the stored session for m_sslSessionKey.
+	void newSsl(bool server);
+	// Counts the handshake and updates the stored client session.
+	void onSslHandshakeDone(bool server, bool succeeded);
+	// Address of the server for client sockets, the key of the stored
+	// session.
+	StringStorage m_sslSessionKey;
+	// Sets the blocking mode of m_socket.
+	void setBlocking(bool blocking) throw(SocketException);
+	// Protects the static SSL members, handshakes can be done on several
+	// threads at once.
+	static LocalMutex m_sslMutex;
+	static SSL_CTX* m_sslServerCtx;
+	static SSL_CTX* m_sslClientCtx;
+	// Sessions of the last connections to each server address.
+	static std::map<StringStorage, SSL_SESSION *> m_sslClientSessions;
+	// Handshake counters, indexed by 1 for server and 0 for client sockets.
+	static UINT64 m_fullHandshakes[2];
+	static UINT64 m_resumedHandshakes[2];
+	static const long SSL_SESSION_CACHE_SIZE = 1024;
+	// Lifetime of server sessions in seconds.
+	static const long SSL_SESSION_TIMEOUT = 24 * 60 * 60;
 	static void initializeSsl(bool server);
 	static bool sslInitialized;
-	static void shutdownSsl();
-	static int sslSocketCount;
 	static SSL_CTX* createSslContext(bool server);
 	static void getSslErrors(TCHAR* m, int size);
 	static void throwSslException();
@@ -57,6 +57,19 @@ size_t SocketStream::write(const void *buf, size_t size)
   return (size_t)m_socket->send((char *)buf, (int)size);
 }
 
+size_t SocketStream::writeGather(const void *const *buffers,
+                                 const size_t *lengths,
+                                 size_t count)
+{
+  for (size_t i = 0; i < count; i++) {
+    if ((int)lengths[i] < 0) {
+      throw IOException(_T("Size of buffer is too big."));
+    }
+  }
+
+  return m_socket->sendGather((const char *const *)buffers, lengths, count);
+}
+
 void SocketStream::close()
 {
   try {
@@ -47,6 +47,14 @@ public:
 
   virtual size_t write(const void *, size_t) throw(IOException);
 
+  //
+  // Inherited from OutputStream.
+  //
+
+  virtual size_t writeGather(const void *const *buffers,
+                             const size_t *lengths,
+                             size_t count) throw(IOException);
+
   // Closes connection and break all blocked operation.
   // @throw Exception on error.
   virtual void close();
@@ -0,0 +1,273 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "OutputGateTest.h"
+
+#include "io-lib/BufferedOutputStream.h"
+#include "io-lib/ChunkedOutputStream.h"
+#include "network/RfbOutputGate.h"
+#include "network/socket/SocketStream.h"
+#include "rfb/EncodingDefs.h"
+#include "rfb/MsgDefs.h"
+#include "rfb/StandardPixelFormatFactory.h"
+#include "rfb-sconn/EncoderSelector.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+
+#include <stdio.h>
+#include <vector>
+
+OutputGateTest::OutputGateTest()
+: m_clientSocket(0),
+  m_receivedBytes(0)
+{
+  Dimension fbDim(FB_WIDTH, FB_HEIGHT);
+  PixelFormat pf = StandardPixelFormatFactory::create32bppPixelFormat();
+  m_frameBuffer.setProperties(&fbDim, &pf);
+  m_pixelConverter.setPixelFormats(&pf, &pf);
+
+  // Raw data does not depend on the content, but the checksums should see
+  // different bytes at different places.
+  UINT32 *pixels = (UINT32 *)m_frameBuffer.getBuffer();
+  for (size_t i = 0; i < (size_t)FB_WIDTH * FB_HEIGHT; i++) {
+    pixels[i] = (UINT32)(i * 2654435761U);
+  }
+}
+
+OutputGateTest::~OutputGateTest()
+{
+}
+
+void OutputGateTest::run()
+{
+  checkWriteCalls();
+  measureThroughput();
+}
+
+void OutputGateTest::checkWriteCalls()
+{
+  CountingStream gateStream;
+  UINT64 gateCalls;
+  {
+    RfbOutputGate gate(&gateStream);
+    Encoder encoder(&m_pixelConverter, &gate);
+    sendUpdate(&encoder, &gate);
+    gateCalls = gate.getWriteCalls();
+  }
+
+  CountingStream bufferedStream;
+  {
+    BufferedOutputStream buffered(&bufferedStream);
+    DataOutputStream output(&buffered);
+    Encoder encoder(&m_pixelConverter, &output);
+    sendUpdate(&encoder, &output);
+  }
+
+  _tprintf(_T("A Raw update of %u bytes: %u calls through RfbOutputGate,")
+           _T(" %u calls through BufferedOutputStream\n"),
+           (unsigned int)UPDATE_SIZE, (unsigned int)gateStream.calls,
+           (unsigned int)bufferedStream.calls);
+
+  if (gateStream.bytes != UPDATE_SIZE || bufferedStream.bytes != UPDATE_SIZE) {
+    StringStorage errMess;
+    errMess.format(_T("%u bytes have been written through RfbOutputGate and")
+                   _T(" %u through BufferedOutputStream instead of %u"),
+                   (unsigned int)gateStream.bytes,
+                   (unsigned int)bufferedStream.bytes,
+                   (unsigned int)UPDATE_SIZE);
+    throw Exception(errMess.getString());
+  }
+  if (gateStream.checksum != bufferedStream.checksum) {
+    throw Exception(_T("RfbOutputGate and BufferedOutputStream have written")
+                    _T(" different data"));
+  }
+  if (gateCalls != gateStream.calls) {
+    StringStorage errMess;
+    errMess.format(_T("RfbOutputGate reports %u write calls instead of %u"),
+                   (unsigned int)gateCalls, (unsigned int)gateStream.calls);
+    throw Exception(errMess.getString());
+  }
+  // Each call writes a chain of up to MAX_CHUNKS chunks, and the counting
+  // stream is too fast for the chunks to grow beyond MIN_CHUNK_SIZE.
+  size_t chainSize = ChunkedOutputStream::MIN_CHUNK_SIZE *
+                     ChunkedOutputStream::MAX_CHUNKS;
+  size_t maxCalls = (UPDATE_SIZE + chainSize - 1) / chainSize;
+  if (gateStream.calls > maxCalls) {
+    StringStorage errMess;
+    errMess.format(_T("RfbOutputGate has made %u write calls, more than %u"),
+                   (unsigned int)gateStream.calls, (unsigned int)maxCalls);
+    throw Exception(errMess.getString());
+  }
+}
+
+void OutputGateTest::measureThroughput()
+{
+  SocketIPv4 listener(false);
+  listener.bind(_T("127.0.0.1"), PORT);
+  listener.listen(1);
+  SocketIPv4 client(false);
+  client.connect(_T("127.0.0.1"), PORT);
+  SocketIPv4 *serverSocket = listener.accept();
+  m_clientSocket = &client;
+  resume();
+
+  UINT64 gateTime, gateCalls, bufferedTime;
+  try {
+    SocketStream stream(serverSocket);
+    {
+      RfbOutputGate gate(&stream);
+      Encoder encoder(&m_pixelConverter, &gate);
+      gateTime = sendUpdates(&encoder, &gate);
+      gateCalls = gate.getWriteCalls();
+    }
+    {
+      BufferedOutputStream buffered(&stream);
+      DataOutputStream output(&buffered);
+      Encoder encoder(&m_pixelConverter, &output);
+      bufferedTime = sendUpdates(&encoder, &output);
+    }
+  } catch (...) {
+    client.shutdown(SD_BOTH);
+    serverSocket->shutdown(SD_BOTH);
+    wait();
+    delete serverSocket;
+    throw;
+  }
+  // Lets the thread leave its blocking read.
+  client.shutdown(SD_BOTH);
+  serverSocket->shutdown(SD_BOTH);
+  wait();
+  delete serverSocket;
+
+  UINT64 totalBytes = (UINT64)UPDATE_SIZE * UPDATE_COUNT;
+  _tprintf(_T("%d Raw updates over loopback: RfbOutputGate %u MB/s in %u")
+           _T(" calls, BufferedOutputStream %u MB/s\n"),
+           UPDATE_COUNT,
+           (unsigned int)(totalBytes / max(gateTime, (UINT64)1)),
+           (unsigned int)gateCalls,
+           (unsigned int)(totalBytes / max(bufferedTime, (UINT64)1)));
+}
+
+void OutputGateTest::sendUpdate(Encoder *encoder, DataOutputStream *output)
+{
+  Rect rect(FB_WIDTH, FB_HEIGHT);
+  output->writeUInt8(ServerMsgDefs::FB_UPDATE);
+  output->writeUInt8(0); // padding
+  output->writeUInt16(1);
+  output->writeUInt16(rect.left);
+  output->writeUInt16(rect.top);
+  output->writeUInt16(rect.getWidth());
+  output->writeUInt16(rect.getHeight());
+  output->writeInt32(encoder->getCode());
+  encoder->sendRectangle(&rect, &m_frameBuffer, &m_encodeOptions);
+  output->flush();
+}
+
+UINT64 OutputGateTest::sendUpdates(Encoder *encoder, DataOutputStream *output)
+{
+  UINT64 bytes;
+  {
+    AutoLock al(&m_receivedMutex);
+    bytes = m_receivedBytes + (UINT64)UPDATE_SIZE * UPDATE_COUNT;
+  }
+  UINT64 startTime = EncoderSelector::getMicroseconds();
+  for (int i = 0; i < UPDATE_COUNT; i++) {
+    sendUpdate(encoder, output);
+  }
+  waitForReceivedBytes(bytes);
+  return EncoderSelector::getMicroseconds() - startTime;
+}
+
+void OutputGateTest::waitForReceivedBytes(UINT64 bytes)
+{
+  UINT64 deadline = EncoderSelector::getMicroseconds() +
+                    (UINT64)RECEIVE_TIMEOUT * 1000;
+  for (;;) {
+    {
+      AutoLock al(&m_receivedMutex);
+      if (m_receivedBytes >= bytes) {
+        return;
+      }
+    }
+    if (EncoderSelector::getMicroseconds() >= deadline) {
+      throw Exception(_T("The client has not received the updates in time"));
+    }
+    m_receivedEvent.waitForEvent(100);
+  }
+}
+
+void OutputGateTest::execute()
+{
+  std::vector<char> buffer(64 * 1024);
+  try {
+    for (;;) {
+      int received = m_clientSocket->recv(&buffer.front(), (int)buffer.size());
+      if (received <= 0) {
+        break;
+      }
+      {
+        AutoLock al(&m_receivedMutex);
+        m_receivedBytes += received;
+      }
+      m_receivedEvent.notify();
+    }
+  } catch (Exception &) {
+  }
+}
+
+OutputGateTest::CountingStream::CountingStream()
+: calls(0),
+  bytes(0),
+  checksum(0)
+{
+}
+
+size_t OutputGateTest::CountingStream::write(const void *buffer, size_t len)
+{
+  calls++;
+  add(buffer, len);
+  return len;
+}
+
+size_t OutputGateTest::CountingStream::writeGather(const void *const *buffers,
+                                                   const size_t *lengths,
+                                                   size_t count)
+{
+  calls++;
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    add(buffers[i], lengths[i]);
+    total += lengths[i];
+  }
+  return total;
+}
+
+void OutputGateTest::CountingStream::add(const void *buffer, size_t len)
+{
+  const UINT8 *data = (const UINT8 *)buffer;
+  for (size_t i = 0; i < len; i++) {
+    checksum = checksum * 31 + data[i];
+  }
+  bytes += len;
+}
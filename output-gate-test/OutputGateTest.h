@@ -0,0 +1,115 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _OUTPUT_GATE_TEST_H_
+#define _OUTPUT_GATE_TEST_H_
+
+#include "io-lib/DataOutputStream.h"
+#include "network/socket/SocketIPv4.h"
+#include "rfb/FrameBuffer.h"
+#include "rfb/PixelConverter.h"
+#include "rfb-sconn/EncodeOptions.h"
+#include "rfb-sconn/Encoder.h"
+#include "thread/LocalMutex.h"
+#include "thread/Thread.h"
+#include "win-system/WindowsEvent.h"
+
+//
+// Sends a full update of a 3840x2160 frame buffer by the Raw encoder
+// through RfbOutputGate and, for comparison, through the 1400-byte
+// BufferedOutputStream the gate used before. Checks on a counting stream
+// that both deliver the same data, and that the gate calls the real stream
+// no more often than its chunk chain allows. Then sends UPDATE_COUNT such
+// updates over a loopback connection both ways and prints the throughput.
+//
+// The thread reads what the client socket receives.
+//
+class OutputGateTest : public Thread
+{
+public:
+  OutputGateTest();
+  virtual ~OutputGateTest();
+
+  // Throws Exception if a check fails.
+  void run();
+
+protected:
+  virtual void execute();
+
+private:
+  // Counts the calls and the bytes written to it and checksums the data,
+  // which is not stored.
+  class CountingStream : public OutputStream
+  {
+  public:
+    CountingStream();
+
+    virtual size_t write(const void *buffer, size_t len);
+    virtual size_t writeGather(const void *const *buffers,
+                               const size_t *lengths,
+                               size_t count);
+
+    UINT64 calls;
+    UINT64 bytes;
+    UINT32 checksum;
+
+  private:
+    void add(const void *buffer, size_t len);
+  };
+
+  void checkWriteCalls();
+  void measureThroughput();
+
+  // Writes a FramebufferUpdate message with the whole frame buffer as one
+  // Raw rectangle. `encoder' must write to `output'.
+  void sendUpdate(Encoder *encoder, DataOutputStream *output);
+  // Sends UPDATE_COUNT updates and returns the time in microseconds until
+  // the client has received them.
+  UINT64 sendUpdates(Encoder *encoder, DataOutputStream *output);
+  // Waits until the client has received `bytes' bytes since the connection
+  // was made.
+  void waitForReceivedBytes(UINT64 bytes);
+
+  FrameBuffer m_frameBuffer;
+  PixelConverter m_pixelConverter;
+  EncodeOptions m_encodeOptions;
+
+  SocketIPv4 *m_clientSocket;
+  LocalMutex m_receivedMutex;
+  UINT64 m_receivedBytes;
+  WindowsEvent m_receivedEvent;
+
+  static const unsigned short PORT = 15903;
+
+  static const int FB_WIDTH = 3840;
+  static const int FB_HEIGHT = 2160;
+  // The message header, the rectangle header and the pixels.
+  static const size_t UPDATE_SIZE = 4 + 12 + FB_WIDTH * FB_HEIGHT * 4;
+
+  static const int UPDATE_COUNT = 30;
+  // Time given to the client to receive the updates.
+  static const unsigned int RECEIVE_TIMEOUT = 30000;
+};
+
+#endif
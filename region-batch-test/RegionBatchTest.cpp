@@ -0,0 +1,223 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RegionBatchTest.h"
+
+#include "region/RegionBuilder.h"
+#include "util/CommonHeader.h"
+#include "util/Exception.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+RegionBatchTest::RegionBatchTest()
+: m_seed(1)
+{
+}
+
+RegionBatchTest::~RegionBatchTest()
+{
+}
+
+void RegionBatchTest::run()
+{
+  Region empty;
+  std::vector<Rect> rects;
+
+  makeTiles(1000, &rects);
+  checkCase(_T("tiles in scan order"), &empty, &rects);
+  shuffle(&rects);
+  checkCase(_T("shuffled tiles"), &empty, &rects);
+
+  makeBlock(&rects);
+  checkCase(_T("a block of tiles"), &empty, &rects);
+
+  makeOverlappingRects(1000, &rects);
+  checkCase(_T("overlapping rectangles"), &empty, &rects);
+  std::sort(rects.begin(), rects.end(), isAbove);
+  checkCase(_T("overlapping rectangles sorted by top"), &empty, &rects);
+
+  Region initial;
+  std::vector<Rect> initialRects;
+  makeOverlappingRects(50, &initialRects);
+  addOneByOne(&initialRects, &initial);
+  makeTiles(1000, &rects);
+  checkCase(_T("tiles added to a region"), &initial, &rects);
+  makeOverlappingRects(1000, &rects);
+  checkCase(_T("overlapping rectangles added to a region"), &initial,
+            &rects);
+
+  rects.clear();
+  checkCase(_T("no rectangles"), &initial, &rects);
+
+  measure(1000);
+  measure(10000);
+}
+
+void RegionBatchTest::makeTiles(size_t count, std::vector<Rect> *tiles)
+{
+  tiles->clear();
+  for (int y = 0; tiles->size() < count; y += TILE_SIZE) {
+    for (int x = 0; x < TILES_PER_ROW * TILE_SIZE && tiles->size() < count;
+         x += TILE_SIZE) {
+      if (getRandom(2) == 0) {
+        tiles->push_back(Rect(x, y, x + TILE_SIZE, y + TILE_SIZE));
+      }
+    }
+  }
+}
+
+void RegionBatchTest::makeBlock(std::vector<Rect> *tiles)
+{
+  tiles->clear();
+  for (int row = 0; row < BLOCK_SIZE; row++) {
+    for (int col = 0; col < BLOCK_SIZE; col++) {
+      int x = BLOCK_LEFT + col * TILE_SIZE;
+      int y = BLOCK_TOP + row * TILE_SIZE;
+      tiles->push_back(Rect(x, y, x + TILE_SIZE, y + TILE_SIZE));
+    }
+  }
+}
+
+void RegionBatchTest::makeOverlappingRects(size_t count,
+                                           std::vector<Rect> *rects)
+{
+  rects->clear();
+  for (size_t i = 0; i < count; i++) {
+    int left = getRandom(1000);
+    int top = getRandom(1000);
+    rects->push_back(Rect(left, top,
+                          left + getRandom(100), top + getRandom(100)));
+  }
+}
+
+void RegionBatchTest::shuffle(std::vector<Rect> *rects)
+{
+  for (size_t i = rects->size(); i > 1; i--) {
+    std::swap((*rects)[i - 1], (*rects)[getRandom((unsigned int)i)]);
+  }
+}
+
+bool RegionBatchTest::isAbove(const Rect &first, const Rect &second)
+{
+  if (first.top != second.top) {
+    return first.top < second.top;
+  }
+  return first.left < second.left;
+}
+
+unsigned int RegionBatchTest::getRandom(unsigned int range)
+{
+  m_seed = m_seed * 1664525 + 1013904223;
+  return (m_seed >> 8) % range;
+}
+
+void RegionBatchTest::checkCase(const TCHAR *caseName, const Region *initial,
+                                const std::vector<Rect> *rects)
+{
+  Region expected(*initial);
+  addOneByOne(rects, &expected);
+
+  Region batch(*initial);
+  batch.addRects(rects);
+  Region built(*initial);
+  addByBuilder(rects, &built);
+
+  const TCHAR *failed = 0;
+  if (!batch.equals(&expected)) {
+    failed = _T("addRects()");
+  } else if (!built.equals(&expected)) {
+    failed = _T("RegionBuilder");
+  }
+  if (failed != 0) {
+    StringStorage errMess;
+    errMess.format(_T("%s does not build the same region as addRect()")
+                   _T(" for %s"), failed, caseName);
+    throw Exception(errMess.getString());
+  }
+}
+
+void RegionBatchTest::measure(size_t count)
+{
+  std::vector<Rect> tiles;
+  makeTiles(count, &tiles);
+
+  UINT64 bestTimes[3] = { 0, 0, 0 };
+  for (int run = 0; run < MEASURE_RUNS; run++) {
+    for (int way = 0; way < 3; way++) {
+      Region region;
+      UINT64 startTime = getMicroseconds();
+      switch (way) {
+      case 0:
+        addOneByOne(&tiles, &region);
+        break;
+      case 1:
+        region.addRects(&tiles);
+        break;
+      default:
+        addByBuilder(&tiles, &region);
+      }
+      UINT64 time = getMicroseconds() - startTime;
+      if (run == 0 || time < bestTimes[way]) {
+        bestTimes[way] = time;
+      }
+    }
+  }
+  _tprintf(_T("%u tiles: addRect() %u us, addRects() %u us,")
+           _T(" RegionBuilder %u us\n"),
+           (unsigned int)count, (unsigned int)bestTimes[0],
+           (unsigned int)bestTimes[1], (unsigned int)bestTimes[2]);
+}
+
+void RegionBatchTest::addOneByOne(const std::vector<Rect> *rects,
+                                  Region *region)
+{
+  for (std::vector<Rect>::const_iterator iRect = rects->begin();
+       iRect < rects->end(); iRect++) {
+    region->addRect(&(*iRect));
+  }
+}
+
+void RegionBatchTest::addByBuilder(const std::vector<Rect> *rects,
+                                   Region *region)
+{
+  RegionBuilder builder;
+  for (std::vector<Rect>::const_iterator iRect = rects->begin();
+       iRect < rects->end(); iRect++) {
+    builder.addRect(&(*iRect));
+  }
+  builder.flushTo(region);
+}
+
+UINT64 RegionBatchTest::getMicroseconds()
+{
+  LARGE_INTEGER frequency, counter;
+  if (!QueryPerformanceFrequency(&frequency) ||
+      !QueryPerformanceCounter(&counter) || frequency.QuadPart == 0) {
+    return (UINT64)GetTickCount() * 1000;
+  }
+  return (UINT64)(counter.QuadPart / frequency.QuadPart * 1000000 +
+                  counter.QuadPart % frequency.QuadPart * 1000000 /
+                  frequency.QuadPart);
+}
@@ -0,0 +1,92 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _REGION_BATCH_TEST_H_
+#define _REGION_BATCH_TEST_H_
+
+#include "region/Region.h"
+#include "util/inttypes.h"
+
+#include <vector>
+
+//
+// Checks that Region::addRects() and RegionBuilder build the same regions
+// as adding the rectangles one by one with Region::addRect(), for tiles in
+// scan order, shuffled tiles, overlapping rectangles and additions to a
+// region that is not empty. Prints how long each way takes to build a
+// region of 1000 and 10000 tiles.
+//
+class RegionBatchTest
+{
+public:
+  RegionBatchTest();
+  virtual ~RegionBatchTest();
+
+  // Throws Exception if a check fails.
+  void run();
+
+private:
+  // Fills `tiles' with `count' TILE_SIZE x TILE_SIZE tiles in scan order.
+  // About half of the tiles of each row are taken, so neighbouring tiles
+  // are merged in some places and not in others.
+  void makeTiles(size_t count, std::vector<Rect> *tiles);
+  // Fills `tiles' with BLOCK_SIZE x BLOCK_SIZE tiles that make up one
+  // rectangle, so all the rows of tiles merge into one band.
+  void makeBlock(std::vector<Rect> *tiles);
+  // Fills `rects' with `count' rectangles of random size and position that
+  // overlap each other. Some of them are empty.
+  void makeOverlappingRects(size_t count, std::vector<Rect> *rects);
+  void shuffle(std::vector<Rect> *rects);
+  // Orders rectangles by top and then by left.
+  static bool isAbove(const Rect &first, const Rect &second);
+  unsigned int getRandom(unsigned int range);
+
+  // Builds the region of `rects' added to `initial' in all three ways and
+  // throws Exception naming `caseName' if the results differ.
+  static void checkCase(const TCHAR *caseName, const Region *initial,
+                        const std::vector<Rect> *rects);
+
+  // Prints how long it takes to build a region of `count' tiles in scan
+  // order in each way.
+  void measure(size_t count);
+
+  static void addOneByOne(const std::vector<Rect> *rects, Region *region);
+  static void addByBuilder(const std::vector<Rect> *rects, Region *region);
+
+  static UINT64 getMicroseconds();
+
+  UINT32 m_seed;
+
+  static const int TILE_SIZE = 16;
+  static const int TILES_PER_ROW = 160;
+  // The block of tiles does not start at the origin, so its bounds are
+  // checked too.
+  static const int BLOCK_SIZE = 10;
+  static const int BLOCK_LEFT = 100;
+  static const int BLOCK_TOP = 60;
+  // Each time is the best of this many runs.
+  static const int MEASURE_RUNS = 5;
+};
+
+#endif
@@ -79,6 +79,160 @@ void Region::addRect(const Rect *rect)
   }
 }
 
+void Region::addRects(const std::vector<Rect> *rects)
+{
+  RegionRec temp;
+  if (!initFromRects(&temp, rects)) {
+    miRegionUninit(&temp);
+    // Fall back to adding the rectangles one by one.
+    std::vector<Rect>::const_iterator it;
+    for (it = rects->begin(); it != rects->end(); it++) {
+      addRect(&*it);
+    }
+    return;
+  }
+
+  if (isEmpty()) {
+    // Take the new region as is.
+    miRegionUninit(&m_reg);
+    m_reg = temp;
+  } else {
+    miUnion(&m_reg, &m_reg, &temp);
+    miRegionUninit(&temp);
+  }
+}
+
+bool Region::isBanded(const std::vector<Rect> *rects)
+{
+  const Rect *prev = 0;
+  std::vector<Rect>::const_iterator it;
+  for (it = rects->begin(); it != rects->end(); it++) {
+    if (it->isEmpty()) {
+      continue;
+    }
+    if (prev != 0) {
+      bool sameBand = it->top == prev->top && it->bottom == prev->bottom;
+      if (sameBand ? it->left < prev->right : it->top < prev->bottom) {
+        return false;
+      }
+    }
+    prev = &*it;
+  }
+  return true;
+}
+
+bool Region::initFromRects(RegionRec *reg, const std::vector<Rect> *rects)
+{
+  long numRects = 0;
+  std::vector<Rect>::const_iterator it;
+  for (it = rects->begin(); it != rects->end(); it++) {
+    if (!it->isEmpty()) {
+      numRects++;
+    }
+  }
+  if (numRects < 2) {
+    miRegionInit(reg, NullBox, 0);
+    for (it = rects->begin(); it != rects->end(); it++) {
+      if (!it->isEmpty()) {
+        BoxRec box;
+        box.x1 = it->left;
+        box.x2 = it->right;
+        box.y1 = it->top;
+        box.y2 = it->bottom;
+        miRegionInit(reg, &box, 0);
+      }
+    }
+    return true;
+  }
+
+  miRegionInit(reg, NullBox, numRects);
+  if (REGION_SIZE(reg) < numRects) {
+    return false;
+  }
+
+  BoxPtr boxes = REGION_BOXPTR(reg);
+  long count = 0;
+
+  if (!isBanded(rects)) {
+    // Let miRegionValidate() sort the boxes and resolve overlaps.
+    for (it = rects->begin(); it != rects->end(); it++) {
+      if (!it->isEmpty()) {
+        boxes[count].x1 = it->left;
+        boxes[count].x2 = it->right;
+        boxes[count].y1 = it->top;
+        boxes[count].y2 = it->bottom;
+        count++;
+      }
+    }
+    reg->data->numRects = count;
+    reg->extents.x1 = reg->extents.x2 = 0;
+    Bool overlap;
+    return miRegionValidate(reg, &overlap) == TRUE;
+  }
+
+  // The boxes are already banded, copy them merging the boxes that touch
+  // within a band, and merging a band into the previous one if they are
+  // adjacent and have the same horizontal spans.
+  long prevBand = -1;
+  long curBand = 0;
+  int minX = MAXSHORT;
+  int maxX = MINSHORT;
+  for (it = rects->begin(); ; it++) {
+    bool finished = it == rects->end();
+    if (!finished && it->isEmpty()) {
+      continue;
+    }
+    bool newBand = finished ||
+                   (count > curBand && it->top != boxes[curBand].y1);
+    if (newBand && count > curBand) {
+      long bandSize = count - curBand;
+      bool coalesce = prevBand >= 0 &&
+                      curBand - prevBand == bandSize &&
+                      boxes[prevBand].y2 == boxes[curBand].y1;
+      for (long i = 0; coalesce && i < bandSize; i++) {
+        coalesce = boxes[prevBand + i].x1 == boxes[curBand + i].x1 &&
+                   boxes[prevBand + i].x2 == boxes[curBand + i].x2;
+      }
+      if (coalesce) {
+        short y2 = boxes[curBand].y2;
+        for (long i = 0; i < bandSize; i++) {
+          boxes[prevBand + i].y2 = y2;
+        }
+        count = curBand;
+      } else {
+        prevBand = curBand;
+        curBand = count;
+      }
+    }
+    if (finished) {
+      break;
+    }
+    if (count > curBand && boxes[count - 1].x2 == it->left) {
+      boxes[count - 1].x2 = it->right;
+    } else {
+      boxes[count].x1 = it->left;
+      boxes[count].x2 = it->right;
+      boxes[count].y1 = it->top;
+      boxes[count].y2 = it->bottom;
+      count++;
+    }
+    if (it->left < minX) {
+      minX = it->left;
+    }
+    if (it->right > maxX) {
+      maxX = it->right;
+    }
+  }
+  reg->data->numRects = count;
+  reg->extents.x1 = minX;
+  reg->extents.x2 = maxX;
+  reg->extents.y1 = boxes[0].y1;
+  reg->extents.y2 = boxes[count - 1].y2;
+  // With valid extents, this only releases unused memory.
+  Bool overlap;
+  return miRegionValidate(reg, &overlap) == TRUE;
+}
+
 void Region::translate(int dx, int dy)
 {
   miTranslateRegion(&m_reg, dx, dy);
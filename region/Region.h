@@ -85,6 +85,16 @@ public:
    * @param rect rectangle to add.
    */
   void addRect(const Rect *rect);
+  /**
+   * Adds a number of rectangles to this region. This is much faster than
+   * calling addRect() for each rectangle, because the rectangles are first
+   * turned into a region in one pass and then added with a single union.
+   * Rectangles sorted in scan order (top to bottom, bands of equal height
+   * sorted left to right, as RegionBuilder produces) are taken as is,
+   * other input is sorted first. Empty rectangles are ignored.
+   * @param rects rectangles to add.
+   */
+  void addRects(const std::vector<Rect> *rects);
   /**
    * Adds offset to all rectangles in region.
    * @param dx horizontal offset to add.
@@ -151,6 +161,18 @@ public:
   Rect getBounds() const;
 
 private:
+  /**
+   * Initializes `reg' with a region consisting of the given rectangles.
+   * Returns false if memory could not be allocated; `reg' is empty then.
+   */
+  static bool initFromRects(RegionRec *reg, const std::vector<Rect> *rects);
+
+  /**
+   * Checks if the rectangles are sorted in the y-x banded order, so they
+   * can be copied to a region without sorting.
+   */
+  static bool isBanded(const std::vector<Rect> *rects);
+
   /**
    * The underlying X11 region structure.
    */
@@ -0,0 +1,61 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "RegionBuilder.h"
+
+RegionBuilder::RegionBuilder()
+{
+}
+
+RegionBuilder::~RegionBuilder()
+{
+}
+
+void RegionBuilder::addRect(const Rect *rect)
+{
+  if (rect->isEmpty()) {
+    return;
+  }
+  if (!m_rects.empty()) {
+    Rect *last = &m_rects.back();
+    if (last->top == rect->top && last->bottom == rect->bottom &&
+        last->right == rect->left) {
+      last->right = rect->right;
+      return;
+    }
+  }
+  m_rects.push_back(*rect);
+}
+
+void RegionBuilder::flushTo(Region *region)
+{
+  region->addRects(&m_rects);
+  m_rects.clear();
+}
+
+void RegionBuilder::clear()
+{
+  m_rects.clear();
+}
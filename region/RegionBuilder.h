@@ -0,0 +1,67 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __REGION_REGIONBUILDER_H_INCLUDED__
+#define __REGION_REGIONBUILDER_H_INCLUDED__
+
+#include <vector>
+
+#include "Region.h"
+
+/**
+ * Collects rectangles, typically tiles found by a scan of a frame buffer,
+ * and adds them to a Region at once. Rectangles given in scan order (top to
+ * bottom, and left to right within rows of tiles of equal height) are turned
+ * into a region in a single pass; horizontally adjacent tiles of a row are
+ * merged as they are added. Rectangles in any other order are accepted too,
+ * at the cost of sorting them.
+ */
+class RegionBuilder {
+public:
+  RegionBuilder();
+  virtual ~RegionBuilder();
+
+  /**
+   * Adds a rectangle.
+   * @param rect rectangle to add, empty rectangles are ignored.
+   */
+  void addRect(const Rect *rect);
+
+  /**
+   * Adds all the collected rectangles to the region and clears the builder.
+   * @param region region to add the rectangles to.
+   */
+  void flushTo(Region *region);
+
+  /**
+   * Discards the collected rectangles.
+   */
+  void clear();
+
+private:
+  std::vector<Rect> m_rects;
+};
+
+#endif // __REGION_REGIONBUILDER_H_INCLUDED__
@@ -50,6 +50,7 @@ void EncodeOptions::reset()
   m_enableRichCursor = false;
   m_enablePointerPos = false;
   m_enableDesktopSize = false;
+  m_enableLastRect = false;
 }
 
 void EncodeOptions::setEncodings(std::vector<int> *list)
@@ -81,6 +82,8 @@ void EncodeOptions::setEncodings(std::vector<int> *list)
       m_enablePointerPos = true;
     } else if (code == PseudoEncDefs::DESKTOP_SIZE) {
       m_enableDesktopSize = true;
+    } else if (code == PseudoEncDefs::LAST_RECT) {
+      m_enableLastRect = true;
     } else if (code >= PseudoEncDefs::COMPR_LEVEL_0 &&
                code <= PseudoEncDefs::COMPR_LEVEL_9) {
       int level = code - PseudoEncDefs::COMPR_LEVEL_0;
@@ -151,6 +154,11 @@ bool EncodeOptions::desktopSizeEnabled() const
   return m_enableDesktopSize;
 }
 
+bool EncodeOptions::lastRectEnabled() const
+{
+  return m_enableLastRect;
+}
+
 bool EncodeOptions::normalEncoding(int code)
 {
   return (code == EncodingDefs::RAW ||
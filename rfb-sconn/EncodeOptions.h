@@ -78,6 +78,7 @@ public:
   bool richCursorEnabled() const;
   bool pointerPosEnabled() const;
   bool desktopSizeEnabled() const;
+  bool lastRectEnabled() const;
 
 protected:
 
@@ -104,6 +105,7 @@ protected:
   bool m_enableRichCursor;
   bool m_enablePointerPos;
   bool m_enableDesktopSize;
+  bool m_enableLastRect;
 };
 
 #endif // __RFB_ENCODE_OPTIONS_H_INCLUDED__
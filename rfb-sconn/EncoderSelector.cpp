@@ -0,0 +1,166 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "EncoderSelector.h"
+
+#include <string.h>
+
+#include "util/CommonHeader.h"
+#include "rfb/EncodingDefs.h"
+
+const int EncoderSelector::CANDIDATES[NUM_CANDIDATES] = {
+  EncodingDefs::TIGHT,
+  EncodingDefs::ZRLE,
+  EncodingDefs::HEXTILE,
+  EncodingDefs::RRE
+};
+
+const double EncoderSelector::SAMPLE_WEIGHT = 0.25;
+const double EncoderSelector::BYTES_PER_MICROSECOND = 1.25;
+
+EncoderSelector::EncoderSelector()
+{
+  memset(m_stats, 0, sizeof(m_stats));
+  memset(m_numSelections, 0, sizeof(m_numSelections));
+}
+
+RectClassifier::RectClass
+EncoderSelector::classify(const Rect *rect, const FrameBuffer *fb)
+{
+  return m_classifier.classify(rect, fb);
+}
+
+int EncoderSelector::selectEncoding(int rectClass,
+                                    const EncodeOptions *options)
+{
+  Stats *stats = m_stats[rectClass];
+  unsigned int selection = ++m_numSelections[rectClass];
+
+  // Try the preferred encoding of the client first.
+  int preferred = getCandidateIndex(options->getPreferredEncoding());
+  int untried = -1;
+  if (preferred >= 0 && isSuitable(rectClass, preferred) &&
+      stats[preferred].numSamples < MIN_SAMPLES) {
+    untried = preferred;
+  }
+
+  int cheapest = -1;
+  int oldest = -1;
+  double cheapestCost = 0.0;
+  for (int i = 0; i < NUM_CANDIDATES; i++) {
+    if (!isSuitable(rectClass, i) ||
+        !options->encodingEnabled(CANDIDATES[i])) {
+      continue;
+    }
+    if (stats[i].numSamples < MIN_SAMPLES) {
+      if (untried < 0) {
+        untried = i;
+      }
+      continue;
+    }
+    double cost = stats[i].bytesPerPixel +
+                  stats[i].microsecondsPerPixel * BYTES_PER_MICROSECOND;
+    if (cheapest < 0 || cost < cheapestCost) {
+      cheapest = i;
+      cheapestCost = cost;
+    }
+    if (oldest < 0 || stats[i].lastSelection < stats[oldest].lastSelection) {
+      oldest = i;
+    }
+  }
+
+  int chosen = cheapest;
+  if (untried >= 0) {
+    chosen = untried;
+  } else if (selection % EXPLORE_INTERVAL == 0 && oldest >= 0) {
+    chosen = oldest;
+  }
+  if (chosen < 0) {
+    return options->getPreferredEncoding();
+  }
+  stats[chosen].lastSelection = selection;
+  return CANDIDATES[chosen];
+}
+
+void EncoderSelector::addSample(int rectClass, int encType, UINT64 numPixels,
+                                UINT64 numBytes, UINT64 microseconds)
+{
+  int i = getCandidateIndex(encType);
+  if (i < 0 || numPixels == 0) {
+    return;
+  }
+  Stats *stats = &m_stats[rectClass][i];
+  double bytesPerPixel = (double)numBytes / numPixels;
+  double microsecondsPerPixel = (double)microseconds / numPixels;
+  if (stats->numSamples == 0) {
+    stats->bytesPerPixel = bytesPerPixel;
+    stats->microsecondsPerPixel = microsecondsPerPixel;
+  } else {
+    stats->bytesPerPixel +=
+      (bytesPerPixel - stats->bytesPerPixel) * SAMPLE_WEIGHT;
+    stats->microsecondsPerPixel +=
+      (microsecondsPerPixel - stats->microsecondsPerPixel) * SAMPLE_WEIGHT;
+  }
+  if (stats->numSamples < MIN_SAMPLES) {
+    stats->numSamples++;
+  }
+}
+
+UINT64 EncoderSelector::getMicroseconds()
+{
+  LARGE_INTEGER frequency, counter;
+  if (!QueryPerformanceFrequency(&frequency) ||
+      !QueryPerformanceCounter(&counter) || frequency.QuadPart == 0) {
+    return (UINT64)GetTickCount() * 1000;
+  }
+  return (UINT64)(counter.QuadPart / frequency.QuadPart * 1000000 +
+                  counter.QuadPart % frequency.QuadPart * 1000000 /
+                  frequency.QuadPart);
+}
+
+bool EncoderSelector::isSuitable(int rectClass, int candidate)
+{
+  switch (CANDIDATES[candidate]) {
+  case EncodingDefs::RRE:
+    // RRE produces a subrectangle per pixel on anything but plain areas.
+    return rectClass == RectClassifier::SOLID;
+  case EncodingDefs::HEXTILE:
+    // Hextile falls back to raw tiles on content with many colors.
+    return rectClass == RectClassifier::SOLID ||
+           rectClass == RectClassifier::FEW_COLORS;
+  default:
+    return true;
+  }
+}
+
+int EncoderSelector::getCandidateIndex(int encType)
+{
+  for (int i = 0; i < NUM_CANDIDATES; i++) {
+    if (CANDIDATES[i] == encType) {
+      return i;
+    }
+  }
+  return -1;
+}
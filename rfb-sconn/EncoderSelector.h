@@ -0,0 +1,103 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __RFB_ENCODER_SELECTOR_H_INCLUDED__
+#define __RFB_ENCODER_SELECTOR_H_INCLUDED__
+
+#include "util/inttypes.h"
+#include "EncodeOptions.h"
+#include "RectClassifier.h"
+
+//
+// EncoderSelector chooses an encoding for each class of rectangle content
+// (see RectClassifier) among the encodings enabled by the client. For each
+// class and encoding, it keeps running averages of the number of bytes and
+// the encoding time per pixel, fed back by the caller via addSample(), and
+// chooses the encoding with the lowest cost. To notice changes in content,
+// other encodings are tried from time to time.
+//
+// The object is not thread-safe and is meant to be used by the sender
+// thread of one client.
+//
+
+class EncoderSelector
+{
+public:
+  EncoderSelector();
+
+  // Returns the content class of the rectangle (see RectClassifier).
+  RectClassifier::RectClass classify(const Rect *rect, const FrameBuffer *fb);
+
+  // Returns the encoding type to use for the next batch of rectangles of the
+  // given class. If none of the encodings suitable for the class is enabled,
+  // returns the preferred encoding of the client.
+  int selectEncoding(int rectClass, const EncodeOptions *options);
+
+  // Records the result of encoding `numPixels' pixels of the given class
+  // with the given encoding: `numBytes' of output were produced in
+  // `microseconds'.
+  void addSample(int rectClass, int encType, UINT64 numPixels,
+                 UINT64 numBytes, UINT64 microseconds);
+
+  // Returns the current value of a high resolution timer, in microseconds.
+  static UINT64 getMicroseconds();
+
+protected:
+  // Encodings the selector chooses from, in the order of preference used
+  // while there are no statistics.
+  static const int NUM_CANDIDATES = 4;
+  static const int CANDIDATES[NUM_CANDIDATES];
+
+  // Each encoding is tried at least MIN_SAMPLES times before the costs are
+  // compared.
+  static const unsigned int MIN_SAMPLES = 2;
+  // Each EXPLORE_INTERVAL-th selection for a class tries the encoding which
+  // has not been tried for the longest time.
+  static const unsigned int EXPLORE_INTERVAL = 64;
+  // Weight of a new sample in the running averages.
+  static const double SAMPLE_WEIGHT;
+  // Cost of one microsecond of encoding time, in bytes. It corresponds to
+  // sending data over a 10 Mbit/s link.
+  static const double BYTES_PER_MICROSECOND;
+
+  struct Stats {
+    double bytesPerPixel;
+    double microsecondsPerPixel;
+    unsigned int numSamples;
+    // Value of m_numSelections[class] when the encoding was last selected.
+    unsigned int lastSelection;
+  };
+
+  // Returns true if the candidate is worth trying on the content class.
+  static bool isSuitable(int rectClass, int candidate);
+  static int getCandidateIndex(int encType);
+
+  RectClassifier m_classifier;
+
+  Stats m_stats[RectClassifier::NUM_CLASSES][NUM_CANDIDATES];
+  unsigned int m_numSelections[RectClassifier::NUM_CLASSES];
+};
+
+#endif // __RFB_ENCODER_SELECTOR_H_INCLUDED__
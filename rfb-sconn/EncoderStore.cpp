@@ -32,6 +32,8 @@
 EncoderStore::EncoderStore(PixelConverter *pixelConverter, DataOutputStream *output)
 : m_encoder(0),
   m_jpegEncoder(0),
+  m_tightStreamResets(false),
+  m_tightBandStream(-1),
   m_pixelConverter(pixelConverter),
   m_output(output)
 {
@@ -73,6 +75,24 @@ void EncoderStore::validateJpegEncoder()
   }
 }
 
+void EncoderStore::setTightStreamResetMode(bool enabled)
+{
+  m_tightStreamResets = enabled;
+  std::map<int, Encoder *>::iterator it = m_map.find(EncodingDefs::TIGHT);
+  if (it != m_map.end()) {
+    ((TightEncoder *)it->second)->setStreamResetMode(enabled);
+  }
+}
+
+void EncoderStore::setTightBandStream(int streamId)
+{
+  m_tightBandStream = streamId;
+  std::map<int, Encoder *>::iterator it = m_map.find(EncodingDefs::TIGHT);
+  if (it != m_map.end()) {
+    ((TightEncoder *)it->second)->setBandStream(streamId);
+  }
+}
+
 //---------------------------- Internal methods ----------------------------//
 
 Encoder *EncoderStore::validateEncoder(int encType)
@@ -94,6 +114,10 @@ Encoder *EncoderStore::validateEncoder(int encType)
     delete newEncoder;
     throw;
   }
+  if (encType == EncodingDefs::TIGHT) {
+    ((TightEncoder *)newEncoder)->setStreamResetMode(m_tightStreamResets);
+    ((TightEncoder *)newEncoder)->setBandStream(m_tightBandStream);
+  }
   return newEncoder;
 }
 
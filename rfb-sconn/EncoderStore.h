@@ -63,14 +63,25 @@ public:
   void selectEncoder(int encType);
   void validateJpegEncoder();
 
-protected:
+  // Enable or disable the stream reset mode in the Tight encoder (see
+  // TightEncoder::setStreamResetMode()). The mode is applied to the
+  // existing Tight encoder and to one allocated later.
+  void setTightStreamResetMode(bool enabled);
+
+  // Set the band stream of the Tight encoder (see
+  // TightEncoder::setBandStream()). Like the stream reset mode, it is applied
+  // to the existing Tight encoder and to one allocated later.
+  void setTightBandStream(int streamId);
+
   // This function makes sure the specified encoder is allocated and stored in
   // m_map. If it's already there, this function returns a pointer to the
   // existing encoder. If it's not there, it will be allocated, stored in
   // m_map and the pointer to it will be returned. If the encoding type is
-  // unknown, Raw encoder will be assumed.
+  // unknown, Raw encoder will be assumed. The preferred encoder returned by
+  // getEncoder() does not change.
   Encoder *validateEncoder(int encType);
 
+protected:
   // Check if the encoding type code is supported.
   static bool encodingSupported(int encType);
 
@@ -97,6 +108,11 @@ protected:
   // be used to delete JpegEncoder on destruction.
   JpegEncoder *m_jpegEncoder;
 
+  // Stream reset mode for the Tight encoder.
+  bool m_tightStreamResets;
+  // Band stream for the Tight encoder, -1 if not used.
+  int m_tightBandStream;
+
   // This pointer to PixelConverter will be used to construct encoders.
   PixelConverter *m_pixelConverter;
   // This pointer to DataOutputStream will be used to construct encoders.
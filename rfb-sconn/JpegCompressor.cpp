@@ -22,10 +22,19 @@
 //-------------------------------------------------------------------------
 //
 
+// The color converter hook below needs the private declarations of the
+// bundled IJG library.
+#ifndef LIBJPEG_TURBO
+#define JPEG_INTERNALS
+#endif
+
 #include "JpegCompressor.h"
 
 #include "util/AnsiStringStorage.h"
 #include "util/Exception.h"
+#include "util/CpuFeatures.h"
+
+#include <emmintrin.h>
 
 const int StandardJpegCompressor::ALLOC_CHUNK_SIZE = 65536;
 const int StandardJpegCompressor::DEFAULT_JPEG_QUALITY = 75;
@@ -66,6 +75,92 @@ term_destination (j_compress_ptr cinfo)
   dest_ptr->_this->termDestination();
 }
 
+#ifndef LIBJPEG_TURBO
+
+//
+// RGB -> YCbCr color conversion for 32-bit source pixels, replacing the
+// table-driven converter of the IJG library. The coefficients are those of
+// JFIF scaled by 2^14, so they fit the signed 16-bit multipliers of
+// _mm_madd_epi16(). The results may differ by one from the IJG converter.
+//
+
+static const int YCC_SCALE_BITS = 14;
+static const int YCC_ROUND = 1 << (YCC_SCALE_BITS - 1);
+// Centers chroma at 128, rounding down halves to never exceed 255.
+static const int YCC_CHROMA_BIAS = (128 << YCC_SCALE_BITS) + YCC_ROUND - 1;
+
+static const short YCC_COEFS[3][3] = {
+  {  4899,  9617,  1868 },  // Y
+  { -2765, -5427,  8192 },  // Cb
+  {  8192, -6860, -1332 }   // Cr
+};
+static const int YCC_BIAS[3] = { YCC_ROUND, YCC_CHROMA_BIAS, YCC_CHROMA_BIAS };
+
+// Computes one of Y, Cb or Cr for four pixels given as (red | green << 16)
+// and blue values in 32-bit lanes.
+static inline __m128i yccComponent(__m128i rg, __m128i b, int k)
+{
+  __m128i mulRg = _mm_set1_epi32((unsigned short)YCC_COEFS[k][0] |
+                                 (int)YCC_COEFS[k][1] << 16);
+  __m128i mulB = _mm_set1_epi32((unsigned short)YCC_COEFS[k][2]);
+  __m128i sum = _mm_add_epi32(_mm_madd_epi16(rg, mulRg),
+                              _mm_madd_epi16(b, mulB));
+  sum = _mm_add_epi32(sum, _mm_set1_epi32(YCC_BIAS[k]));
+  return _mm_srli_epi32(sum, YCC_SCALE_BITS);
+}
+
+static void
+convert_rgbx_to_ycc(j_compress_ptr cinfo, JSAMPARRAY input_buf,
+                    JSAMPIMAGE output_buf, JDIMENSION output_row,
+                    int num_rows)
+{
+  const int *shifts = (const int *)cinfo->client_data;
+  const __m128i redShift = _mm_cvtsi32_si128(shifts[0]);
+  const __m128i greenShift = _mm_cvtsi32_si128(shifts[1]);
+  const __m128i blueShift = _mm_cvtsi32_si128(shifts[2]);
+  const __m128i mask = _mm_set1_epi32(0xFF);
+  const int width = (int)cinfo->image_width;
+
+  for (int row = 0; row < num_rows; row++) {
+    const UINT32 *src = (const UINT32 *)input_buf[row];
+    JSAMPROW dst[3];
+    for (int k = 0; k < 3; k++) {
+      dst[k] = output_buf[k][output_row + row];
+    }
+
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+      __m128i rg[2], b[2];
+      for (int i = 0; i < 2; i++) {
+        __m128i px = _mm_loadu_si128((const __m128i *)(src + x + i * 4));
+        __m128i r = _mm_and_si128(_mm_srl_epi32(px, redShift), mask);
+        __m128i g = _mm_and_si128(_mm_srl_epi32(px, greenShift), mask);
+        rg[i] = _mm_or_si128(r, _mm_slli_epi32(g, 16));
+        b[i] = _mm_and_si128(_mm_srl_epi32(px, blueShift), mask);
+      }
+      for (int k = 0; k < 3; k++) {
+        __m128i words = _mm_packs_epi32(yccComponent(rg[0], b[0], k),
+                                        yccComponent(rg[1], b[1], k));
+        _mm_storel_epi64((__m128i *)(dst[k] + x),
+                         _mm_packus_epi16(words, words));
+      }
+    }
+    for (; x < width; x++) {
+      UINT32 pixel = src[x];
+      int c[3] = { pixel >> shifts[0] & 0xFF,
+                   pixel >> shifts[1] & 0xFF,
+                   pixel >> shifts[2] & 0xFF };
+      for (int k = 0; k < 3; k++) {
+        int sum = YCC_COEFS[k][0] * c[0] + YCC_COEFS[k][1] * c[1] +
+                  YCC_COEFS[k][2] * c[2] + YCC_BIAS[k];
+        dst[k][x] = (JSAMPLE)(sum >> YCC_SCALE_BITS);
+      }
+    }
+  }
+}
+
+#endif // LIBJPEG_TURBO
+
 //
 // Constructor and destructor.
 //
@@ -100,6 +195,8 @@ StandardJpegCompressor::StandardJpegCompressor()
 
   // We prefer speed over quality.
   m_jpeg.cinfo.dct_method = JDCT_FASTEST;
+
+  m_jpeg.cinfo.client_data = m_inputShifts;
 }
 
 StandardJpegCompressor::~StandardJpegCompressor()
@@ -163,7 +260,7 @@ bool
 StandardJpegCompressor::emptyOutputBuffer()
 {
   size_t oldSize = m_numBytesAllocated;
-  size_t newSize = oldSize + ALLOC_CHUNK_SIZE;
+  size_t newSize = oldSize * 2;
 
   m_outputBuffer = (unsigned char *)realloc(m_outputBuffer, newSize);
   m_numBytesAllocated = newSize;
@@ -222,15 +319,19 @@ StandardJpegCompressor::compress(const void *buf,
     m_quality = m_newQuality;
   }
 
+  bool directInput = setInputFormat(fmt, useQuickConversion);
+
   jpeg_start_compress(&m_jpeg.cinfo, TRUE);
 
-  const char *src = (const char *)buf;
+  if (directInput) {
+    installColorConverter();
+  } else if (m_rowBuffer.size() < (size_t)w * 3 * 8) {
+    // We'll pass up to 8 rows to jpeg_write_scanlines().
+    m_rowBuffer.resize(w * 3 * 8);
+  }
 
-  // We'll pass up to 8 rows to jpeg_write_scanlines().
-  JSAMPLE *rgb = new JSAMPLE[w * 3 * 8];
+  const char *src = (const char *)buf;
   JSAMPROW rowPointer[8];
-  for (int i = 0; i < 8; i++)
-    rowPointer[i] = &rgb[w * 3 * i];
 
   // Feed the pixels to the JPEG library.
   while (m_jpeg.cinfo.next_scanline < m_jpeg.cinfo.image_height) {
@@ -239,21 +340,69 @@ StandardJpegCompressor::compress(const void *buf,
       maxRows = 8;
     }
     for (int dy = 0; dy < maxRows; dy++) {
-      if (useQuickConversion) {
-        convertRow24(rowPointer[dy], src, fmt, w);
+      if (directInput) {
+        rowPointer[dy] = (JSAMPROW)src;
       } else {
-        convertRow(rowPointer[dy], src, fmt, w);
+        rowPointer[dy] = &m_rowBuffer[w * 3 * dy];
+        if (useQuickConversion) {
+          convertRow24(rowPointer[dy], src, fmt, w);
+        } else {
+          convertRow(rowPointer[dy], src, fmt, w);
+        }
       }
       src += stride;
     }
     jpeg_write_scanlines(&m_jpeg.cinfo, rowPointer, maxRows);
   }
 
-  delete[] rgb;
-
   jpeg_finish_compress(&m_jpeg.cinfo);
 }
 
+bool
+StandardJpegCompressor::setInputFormat(const PixelFormat *fmt,
+                                       bool is24BitColor)
+{
+  m_inputShifts[0] = fmt->redShift;
+  m_inputShifts[1] = fmt->greenShift;
+  m_inputShifts[2] = fmt->blueShift;
+
+#ifdef LIBJPEG_TURBO
+  J_COLOR_SPACE colorSpace = JCS_RGB;
+#ifdef JCS_EXTENSIONS
+  // Byte order of 32-bit little-endian pixels in memory.
+  if (is24BitColor) {
+    if (fmt->redShift == 16 && fmt->greenShift == 8 && fmt->blueShift == 0) {
+      colorSpace = JCS_EXT_BGRX;
+    } else if (fmt->redShift == 0 && fmt->greenShift == 8 &&
+               fmt->blueShift == 16) {
+      colorSpace = JCS_EXT_RGBX;
+    } else if (fmt->redShift == 24 && fmt->greenShift == 16 &&
+               fmt->blueShift == 8) {
+      colorSpace = JCS_EXT_XBGR;
+    } else if (fmt->redShift == 8 && fmt->greenShift == 16 &&
+               fmt->blueShift == 24) {
+      colorSpace = JCS_EXT_XRGB;
+    }
+  }
+#endif
+  bool directInput = colorSpace != JCS_RGB;
+  m_jpeg.cinfo.in_color_space = colorSpace;
+  m_jpeg.cinfo.input_components = directInput ? 4 : 3;
+  return directInput;
+#else
+  return is24BitColor && m_jpeg.cinfo.jpeg_color_space == JCS_YCbCr &&
+         CpuFeatures::hasSse2();
+#endif
+}
+
+void
+StandardJpegCompressor::installColorConverter()
+{
+#ifndef LIBJPEG_TURBO
+  m_jpeg.cinfo.cconvert->color_convert = convert_rgbx_to_ycc;
+#endif
+}
+
 size_t StandardJpegCompressor::getOutputLength()
 {
   return m_numBytesReady;
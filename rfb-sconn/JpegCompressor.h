@@ -26,6 +26,7 @@
 #define __RFB_JPEG_COMPRESSOR_H_INCLUDED__
 
 #include <stdio.h>
+#include <vector>
 
 #include "util/CommonHeader.h"
 #include "rfb/PixelFormat.h"
@@ -111,10 +112,31 @@ protected:
   int m_quality;
   int m_newQuality;
 
+  // The output buffer is kept between calls and never shrinks, so it is
+  // normally large enough for the next frame after the first one. When it is
+  // not, it grows by doubling its size.
   unsigned char *m_outputBuffer;
   size_t m_numBytesAllocated;
   size_t m_numBytesReady;
 
+  // Scanlines converted for the JPEG library, up to 8 rows, reused between
+  // calls. It is not used when source rows are passed to the library as is.
+  std::vector<JSAMPLE> m_rowBuffer;
+
+  // Shifts of the red, green and blue components of 32-bit source pixels,
+  // for the color converter installed into the IJG library.
+  int m_inputShifts[3];
+
+  // Configures the library input for the given pixel format. Returns true if
+  // rows of the source buffer can be passed to the library without
+  // conversion. Then the library either reads 32-bit pixels natively
+  // (libjpeg-turbo with its SIMD color conversion) or uses our SSE2 color
+  // converter installed by installColorConverter().
+  bool setInputFormat(const PixelFormat *fmt, bool is24BitColor);
+  // Replaces the color converter of the IJG library for the current image,
+  // must be called after jpeg_start_compress().
+  void installColorConverter();
+
   // Convert one row (scanline) from the specified pixel format to the format
   // supported by the IJG JPEG library (one byte per one color component).
   void convertRow(JSAMPLE *dst, const void *src,
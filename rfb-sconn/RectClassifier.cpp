@@ -0,0 +1,140 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "RectClassifier.h"
+
+#include <stdlib.h>
+
+RectClassifier::RectClassifier()
+: m_palette(MAX_FEW_COLORS)
+{
+}
+
+RectClassifier::RectClass
+RectClassifier::classify(const Rect *rect, const FrameBuffer *fb)
+{
+  switch (fb->getBitsPerPixel()) {
+  case 32:
+    return classifyT<UINT32>(rect, fb);
+  case 16:
+    return classifyT<UINT16>(rect, fb);
+  default:
+    return classifyT<UINT8>(rect, fb);
+  }
+}
+
+template <class PIXEL_T>
+RectClassifier::RectClass
+RectClassifier::classifyT(const Rect *rect, const FrameBuffer *fb)
+{
+  if (countColors<PIXEL_T>(rect, fb)) {
+    return m_palette.getNumColors() <= 1 ? SOLID : FEW_COLORS;
+  }
+  return isSmooth<PIXEL_T>(rect, fb) ? SMOOTH : RICH;
+}
+
+//
+// Fills m_palette with the colors of the rectangle. Returns false if there
+// are more than MAX_FEW_COLORS colors.
+//
+
+template <class PIXEL_T>
+bool RectClassifier::countColors(const Rect *rect, const FrameBuffer *fb)
+{
+  m_palette.reset();
+  m_palette.setMaxColors(MAX_FEW_COLORS);
+
+  int w = rect->getWidth();
+  int h = rect->getHeight();
+  if (w <= 0 || h <= 0) {
+    return true;
+  }
+  const UINT8 *line = (const UINT8 *)fb->getBufferPtr(rect->left, rect->top);
+  const int stride = fb->getBytesPerRow();
+
+  for (int y = 0; y < h; y++, line += stride) {
+    const PIXEL_T *src = (const PIXEL_T *)line;
+    PIXEL_T color = src[0];
+    int runLength = 1;
+    for (int x = 1; x < w; x++) {
+      if (src[x] == color) {
+        runLength++;
+      } else {
+        if (m_palette.insert(color, runLength) == 0) {
+          return false;
+        }
+        color = src[x];
+        runLength = 1;
+      }
+    }
+    if (m_palette.insert(color, runLength) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class PIXEL_T>
+bool RectClassifier::isSmooth(const Rect *rect, const FrameBuffer *fb)
+{
+  const PixelFormat pf = fb->getPixelFormat();
+  const int shift[3] = { pf.redShift, pf.greenShift, pf.blueShift };
+  const int max[3] = { pf.redMax, pf.greenMax, pf.blueMax };
+  int threshold[3];
+  for (int k = 0; k < 3; k++) {
+    // Compare values in the original scale to avoid scaling every pixel.
+    threshold[k] = (EDGE_THRESHOLD * max[k] + 254) / 255;
+    if (threshold[k] < 1) {
+      threshold[k] = 1;
+    }
+  }
+
+  int w = rect->getWidth();
+  int h = rect->getHeight();
+  const UINT8 *base = (const UINT8 *)fb->getBufferPtr(rect->left, rect->top);
+  const int stride = fb->getBytesPerRow();
+
+  size_t numPairs = 0;
+  size_t numEdges = 0;
+  for (int y = 0; y < h; y += SAMPLE_ROW_STEP) {
+    const PIXEL_T *src = (const PIXEL_T *)(base + (size_t)y * stride);
+    for (int x = 1; x < w; x++) {
+      PIXEL_T a = src[x - 1];
+      PIXEL_T b = src[x];
+      if (a == b) {
+        continue;
+      }
+      for (int k = 0; k < 3; k++) {
+        int diff = (int)(a >> shift[k] & max[k]) - (int)(b >> shift[k] & max[k]);
+        if (abs(diff) >= threshold[k]) {
+          numEdges++;
+          break;
+        }
+      }
+    }
+    numPairs += w - 1;
+  }
+  return numEdges * SMOOTH_EDGE_RATIO < numPairs;
+}
@@ -0,0 +1,88 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __RFB_RECT_CLASSIFIER_H_INCLUDED__
+#define __RFB_RECT_CLASSIFIER_H_INCLUDED__
+
+#include "rfb/FrameBuffer.h"
+#include "region/Rect.h"
+#include "TightPalette.h"
+
+//
+// RectClassifier looks at the pixels of a rectangle and tells what kind of
+// content it holds, so that an encoding suited for that content can be
+// chosen. The classification is approximate and cheap: colors are counted
+// via TightPalette only up to a small limit, and smoothness is measured on a
+// subset of rows.
+//
+
+class RectClassifier
+{
+public:
+  enum RectClass {
+    // All pixels have the same color.
+    SOLID = 0,
+    // A few colors, e.g. text or simple user interface elements.
+    FEW_COLORS,
+    // Many colors changing gradually, e.g. photos or video.
+    SMOOTH,
+    // Many colors with a lot of sharp edges, e.g. anti-aliased text over
+    // a picture.
+    RICH,
+
+    NUM_CLASSES
+  };
+
+  RectClassifier();
+
+  // Returns the class of the pixels of the rectangle `rect' of `fb'. The
+  // rectangle must lie within the frame buffer.
+  RectClass classify(const Rect *rect, const FrameBuffer *fb);
+
+protected:
+  // Maximum number of colors in a FEW_COLORS rectangle.
+  static const int MAX_FEW_COLORS = 24;
+  // Smoothness is measured on each SAMPLE_ROW_STEP-th row only.
+  static const int SAMPLE_ROW_STEP = 4;
+  // Difference between neighbour pixels in one color component (scaled to
+  // 0..255) which is considered to be a sharp edge.
+  static const int EDGE_THRESHOLD = 48;
+  // A rectangle is SMOOTH if less than one of each SMOOTH_EDGE_RATIO pairs
+  // of neighbour pixels forms a sharp edge.
+  static const int SMOOTH_EDGE_RATIO = 16;
+
+  template <class PIXEL_T>
+  RectClass classifyT(const Rect *rect, const FrameBuffer *fb);
+
+  template <class PIXEL_T>
+  bool countColors(const Rect *rect, const FrameBuffer *fb);
+
+  template <class PIXEL_T>
+  bool isSmooth(const Rect *rect, const FrameBuffer *fb);
+
+  TightPalette m_palette;
+};
+
+#endif // __RFB_RECT_CLASSIFIER_H_INCLUDED__
@@ -52,6 +52,8 @@ RfbClient::RfbClient(NewConnectionEvents *newConnectionEvents,
   m_extTermListener(extTermListener),
   m_extAuthListener(extAuthListener),
   m_updateSender(0),
+  m_frameRate(0.0),
+  m_bandwidth(0),
   m_clipboardExchange(0),
   m_clientInputHandler(0),
   m_id(id),
@@ -288,6 +290,13 @@ void RfbClient::execute()
   if (m_clientInputHandler) delete m_clientInputHandler;
   if (m_updateSender)       delete m_updateSender;
 
+  double frameRate;
+  UINT64 bandwidth;
+  getUpdateStatistics(&frameRate, &bandwidth);
+  m_log->info(_T("The client has drained %.1f updates per second at")
+              _T(" %u bytes per second (zero if unknown)"),
+              frameRate, (unsigned int)bandwidth);
+
   // Let the client manager remove us from the client lists.
   notifyAbStateChanging(IN_READY_TO_REMOVE);
 }
@@ -383,3 +392,17 @@ void RfbClient::onGetViewPort(Rect *viewRect, bool *shareApp, Region *shareAppRe
   m_desktop->getFrameBufferProperties(&fbDim, &pfStub);
   getViewPortInfo(&fbDim, viewRect, shareApp, shareAppRegion);
 }
+
+void RfbClient::onUpdateStatistics(double frameRate, UINT64 bandwidth)
+{
+  AutoLock al(&m_statisticsMutex);
+  m_frameRate = frameRate;
+  m_bandwidth = bandwidth;
+}
+
+void RfbClient::getUpdateStatistics(double *frameRate, UINT64 *bandwidth)
+{
+  AutoLock al(&m_statisticsMutex);
+  *frameRate = m_frameRate;
+  *bandwidth = m_bandwidth;
+}
@@ -90,6 +90,10 @@ public:
   void changeDynViewPort(const ViewPortState *dynViewPort);
 
   bool clientIsReady() const { return m_updateSender->clientIsReady(); }
+
+  // Returns the latest estimates of the update rate (updates per second) and
+  // the bandwidth (bytes per second, zero if unknown) for this client.
+  void getUpdateStatistics(double *frameRate, UINT64 *bandwidth);
   void sendUpdate(const UpdateContainer *updateContainer,
                   const CursorShape *cursorShape);
   void sendClipboard(const StringStorage *newClipboard);
@@ -116,6 +120,7 @@ private:
 
   Rect getViewPortRect(const Dimension *fbDimension);
   virtual void onGetViewPort(Rect *viewRect, bool *shareApp, Region *shareAppRegion);
+  virtual void onUpdateStatistics(double frameRate, UINT64 bandwidth);
   void getViewPortInfo(const Dimension *fbDimension, Rect *resultRect,
                        bool *shareApp, Region *shareAppRegion);
 
@@ -133,6 +138,9 @@ private:
   LocalMutex m_viewPortMutex;
 
   UpdateSender *m_updateSender;
+  double m_frameRate;
+  UINT64 m_bandwidth;
+  LocalMutex m_statisticsMutex;
   ClipboardExchange *m_clipboardExchange;
   ClientInputHandler *m_clientInputHandler;
   Desktop *m_desktop;
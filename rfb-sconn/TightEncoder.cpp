@@ -27,16 +27,18 @@
 #include "io-lib/ByteArrayOutputStream.h"
 
 TightEncoder::TightEncoder(PixelConverter *conv, DataOutputStream *output)
-: Encoder(conv, output)
+: Encoder(conv, output),
+  m_resetStreams(false),
+  m_bandStream(-1)
 {
-  for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
+  for (int i = 0; i < MAX_ZLIB_STREAMS; i++) {
     m_zsActive[i] = false;
   }
 }
 
 TightEncoder::~TightEncoder()
 {
-  for (int i = 0; i < NUM_ZLIB_STREAMS; i++) {
+  for (int i = 0; i < MAX_ZLIB_STREAMS; i++) {
     if (m_zsActive[i]) {
       deflateEnd(&m_zsStruct[i]);
     }
@@ -48,6 +50,22 @@ int TightEncoder::getCode() const
   return EncodingDefs::TIGHT;
 }
 
+void TightEncoder::setStreamResetMode(bool enabled)
+{
+  m_resetStreams = enabled;
+}
+
+void TightEncoder::setBandStream(int streamId)
+{
+  _ASSERT(streamId < MAX_ZLIB_STREAMS);
+  m_bandStream = streamId < 0 ? -1 : streamId;
+}
+
+int TightEncoder::getMinBandArea(const EncodeOptions *options)
+{
+  return getConf(options).minBandArea;
+}
+
 void TightEncoder::splitRectangle(const Rect *rect,
                                   std::vector<Rect> *rectList,
                                   const FrameBuffer *serverFb,
@@ -171,8 +189,9 @@ void TightEncoder::sendMonoRect(const Rect *rect,
                                 const EncodeOptions *options)
 {
   // Send control info.
-  const int zlibStreamId = ZLIB_STREAM_MONO;
-  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4);
+  const int zlibStreamId = getStreamId(ZLIB_STREAM_MONO);
+  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4 |
+                       getStreamResetFlags(zlibStreamId));
   m_output->writeUInt8(FILTER_PALETTE);
   m_output->writeUInt8(1); // the number of colors minus 1
 
@@ -211,8 +230,9 @@ void TightEncoder::sendIndexedRect(const Rect *rect,
                                    const EncodeOptions *options)
 {
   // Send control info.
-  const int zlibStreamId = ZLIB_STREAM_IDX;
-  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4);
+  const int zlibStreamId = getStreamId(ZLIB_STREAM_IDX);
+  m_output->writeUInt8(EXPLICIT_FILTER | zlibStreamId << 4 |
+                       getStreamResetFlags(zlibStreamId));
   m_output->writeUInt8(FILTER_PALETTE);
   int numColors = m_pal.getNumColors();
   m_output->writeUInt8((UINT8)(numColors - 1));
@@ -251,8 +271,8 @@ void TightEncoder::sendFullColorRect(const Rect *rect,
                                      const EncodeOptions *options)
 {
   // Send control info.
-  const int zlibStreamId = ZLIB_STREAM_RAW;
-  m_output->writeUInt8(zlibStreamId << 4);
+  const int zlibStreamId = getStreamId(ZLIB_STREAM_RAW);
+  m_output->writeUInt8(zlibStreamId << 4 | getStreamResetFlags(zlibStreamId));
 
   // Prepare output buffer.
   int dataLen = rect->area() * sizeof(PIXEL_T);
@@ -466,6 +486,31 @@ void TightEncoder::encodeIndexedRect(const Rect *rect, const FrameBuffer *fb,
   }
 }
 
+int TightEncoder::getStreamId(int streamKind) const
+{
+  return m_bandStream >= 0 ? m_bandStream : streamKind;
+}
+
+UINT8 TightEncoder::getStreamResetFlags(int streamId)
+{
+  if (!m_resetStreams) {
+    // In the band stream mode, the decoder's stream may have been used by
+    // an encoder this one replaces, so we start it from scratch.
+    if (m_bandStream >= 0 && !m_zsActive[streamId]) {
+      return (UINT8)(1 << streamId);
+    }
+    return 0;
+  }
+  // The decoder's stream may have been used by another encoder, so we ask
+  // for the reset even if our own stream has not been initialized yet.
+  if (m_zsActive[streamId]) {
+    if (deflateReset(&m_zsStruct[streamId]) != Z_OK) {
+      throw IOException(_T("Zlib stream reset failed in Tight encoder"));
+    }
+  }
+  return (UINT8)(1 << streamId);
+}
+
 void TightEncoder::sendCompressed(const char *data, size_t dataLen,
                                   int streamId, int zlibLevel)
 {
@@ -554,17 +599,21 @@ void TightEncoder::sendCompactLength(size_t dataLen)
 //        intentionally made small because we do not implement algorithms to
 //        detect areas to be compressed with JPEG yet and thus we would like
 //        to divide areas to avoid compressing too much with JPEG.
+//
+// The last column (minBandArea) is used only in the parallel encoding mode,
+// see setBandStream(). Faster zlib levels need larger updates to gain
+// anything from splitting the work between threads.
 const TightEncoder::Conf TightEncoder::m_conf[10] = {
-  {   512,   32,   6, 0, 0, 0,  4 },
-  {  2048,   64,   6, 1, 1, 1,  8 },
-  {  6144,  128,   8, 3, 3, 2, 24 },
-  {  8192,  128,  12, 5, 5, 3, 32 },
-  {  8192,  128,  12, 6, 6, 4, 32 },
-  {  8192,  128,  12, 7, 7, 5, 32 },
-  {  8192,  128,  16, 7, 7, 6, 48 },
-  { 16384,  256,  16, 8, 8, 7, 64 },
-  { 16384,  256,  32, 9, 9, 8, 64 },
-  { 32768,  256,  32, 9, 9, 9, 96 }
+  {   512,   32,   6, 0, 0, 0,  4, 262144 },
+  {  2048,   64,   6, 1, 1, 1,  8, 196608 },
+  {  6144,  128,   8, 3, 3, 2, 24, 131072 },
+  {  8192,  128,  12, 5, 5, 3, 32,  98304 },
+  {  8192,  128,  12, 6, 6, 4, 32,  65536 },
+  {  8192,  128,  12, 7, 7, 5, 32,  65536 },
+  {  8192,  128,  16, 7, 7, 6, 48,  65536 },
+  { 16384,  256,  16, 8, 8, 7, 64,  49152 },
+  { 16384,  256,  32, 9, 9, 8, 64,  32768 },
+  { 32768,  256,  32, 9, 9, 9, 96,  32768 }
 };
 
 const TightEncoder::Conf &
@@ -53,6 +53,29 @@ public:
                              const FrameBuffer *serverFb,
                              const EncodeOptions *options) throw(IOException);
 
+  // Enable or disable resetting zlib streams on each rectangle. When enabled,
+  // every rectangle that uses a zlib stream tells the decoder to reset that
+  // stream first, so the encoded data does not depend on anything sent
+  // before. This allows a number of TightEncoder objects to encode
+  // rectangles of the same update in parallel, at the cost of some
+  // compression ratio. Disabled by default.
+  void setStreamResetMode(bool enabled);
+
+  // Make this encoder send all its compressed data through the single zlib
+  // stream `streamId' (0..3), or restore the default use of three streams
+  // if `streamId' is negative. With up to four encoders, each owning its own
+  // stream id, the horizontal bands of an update can be compressed in
+  // parallel without resetting the streams on each rectangle, provided that
+  // the rectangles of each band are always encoded by the same encoder and
+  // sent in the order they were encoded. A stream is reset once, when it is
+  // first used by this encoder. Disabled by default.
+  void setBandStream(int streamId);
+
+  // Returns the minimal area of an update, in pixels, that is worth
+  // splitting into bands for parallel compression at the compression level
+  // set in EncodeOptions.
+  static int getMinBandArea(const EncodeOptions *options);
+
 protected:
   // An implementation of sendRectangle() for the given pixel size.
   template <class PIXEL_T>
@@ -122,6 +145,18 @@ protected:
     void encodeIndexedRect(const Rect *rect, const FrameBuffer *fb,
                            DataOutputStream *out) throw(IOException);
 
+  // Return the stream reset bits for the compression control byte of a
+  // rectangle that is going to be compressed via the specified zlib stream.
+  // In the stream reset mode, this function also resets the stream on our
+  // side. In the band stream mode, it asks for the reset while the stream
+  // has not been initialized yet. Otherwise, it always returns 0.
+  UINT8 getStreamResetFlags(int streamId);
+
+  // Return the id of the zlib stream to be used for data of the specified
+  // kind (ZLIB_STREAM_RAW, ZLIB_STREAM_MONO or ZLIB_STREAM_IDX), taking the
+  // band stream mode into account.
+  int getStreamId(int streamKind) const;
+
   // FIXME: Throw ZlibException instead.
   void sendCompressed(const char *data, size_t dataLen,
                       int streamId, int zlibLevel) throw(IOException);
@@ -140,6 +175,7 @@ protected:
     int monoZlibLevel;
     int rawZlibLevel;
     int idxMaxColorsDivisor;
+    int minBandArea;
   } m_conf[10];
 
   // Select a record from the m_conf array which corresponds to the
@@ -163,6 +199,8 @@ protected:
 
   // The number of zlib streams used by TightEncoder (it cannot exceed 4).
   static const int NUM_ZLIB_STREAMS = 3;
+  // The number of zlib stream ids defined by the protocol.
+  static const int MAX_ZLIB_STREAMS = 4;
 
   // Indexes of individual zlib streams.
   static const int ZLIB_STREAM_RAW = 0;
@@ -170,12 +208,20 @@ protected:
   static const int ZLIB_STREAM_IDX = 2;
 
   // The array of zlib stream structures.
-  z_stream m_zsStruct[NUM_ZLIB_STREAMS];
+  z_stream m_zsStruct[MAX_ZLIB_STREAMS];
 
   // The array of flags indicating if corresponding zlib streams were
   // initialized.
-  bool m_zsActive[NUM_ZLIB_STREAMS];
-  int m_zsLevel[NUM_ZLIB_STREAMS];
+  bool m_zsActive[MAX_ZLIB_STREAMS];
+  int m_zsLevel[MAX_ZLIB_STREAMS];
+
+  // True if zlib streams should be reset on each rectangle, see
+  // setStreamResetMode().
+  bool m_resetStreams;
+
+  // The only zlib stream used in the band stream mode, or -1 if the mode is
+  // disabled, see setBandStream().
+  int m_bandStream;
 
   // Color palette which maps color samples to color indexes and keeps track
   // of the number of colors allocated.
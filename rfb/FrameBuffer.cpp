@@ -23,19 +23,21 @@
 //
 
 #include "FrameBuffer.h"
+#include "FrameBufferPool.h"
 #include <string.h>
 
 FrameBuffer::FrameBuffer(void)
-: m_buffer(0)
+: m_buffer(0),
+  m_bufferCapacity(0),
+  m_bytesPerRow(0),
+  m_rowAlignment(1)
 {
   memset(&m_pixelFormat, 0, sizeof(m_pixelFormat));
 }
 
 FrameBuffer::~FrameBuffer(void)
 {
-  if (m_buffer != 0) {
-    delete []m_buffer;
-  }
+  releaseBuffer();
 }
 
 bool FrameBuffer::assignProperties(const FrameBuffer *srcFrameBuffer)
@@ -174,19 +176,18 @@ template<class PIXEL_T> bool FrameBuffer::overlayT(const Rect *dstRect,
     return true;
   }
 
-  PIXEL_T *dstPixels = (PIXEL_T *)getBuffer();
-  PIXEL_T *srcPixels = (PIXEL_T *)srcFrameBuffer->getBuffer();
   int srcWidth = srcFrameBuffer->getDimension().width;
-  int dstWidth = getDimension().width;
   size_t bytesPerRow = (srcWidth + 7) / 8;
   for (int iRow = srcClippedRect.top; iRow < srcClippedRect.bottom; iRow++) {
+    PIXEL_T *srcPixels = (PIXEL_T *)srcFrameBuffer->getBufferPtr(0, iRow);
+    int iDstRow = dstClippedRect.top + iRow - srcY - srcClippedRect.top;
+    PIXEL_T *dstPixels = (PIXEL_T *)getBufferPtr(0, iDstRow);
     for (int iCol = srcClippedRect.left; iCol < srcClippedRect.right; iCol++) {
       unsigned char curByte = andMask[iRow * bytesPerRow + iCol / 8];
       bool andBit = (curByte & 128 >> iCol % 8) != 0;
       if (andBit) {
-        int iDstRow = dstClippedRect.top + iRow - srcY - srcClippedRect.top;
         int iDstCol = dstClippedRect.left + iCol - srcX - srcClippedRect.left;
-        dstPixels[iDstRow * dstWidth + iDstCol] = srcPixels[iRow * srcWidth + iCol];
+        dstPixels[iDstCol] = srcPixels[iCol];
       }
     }
   }
@@ -209,8 +210,8 @@ bool FrameBuffer::copyFrom(const Rect *dstRect, const FrameBuffer *srcFrameBuffe
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytes = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytes = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   int resultHeight = dstClippedRect.getHeight();
   int resultWidthBytes = dstClippedRect.getWidth() * pixelSize;
@@ -245,8 +246,8 @@ bool FrameBuffer::copyFromRotated90(const Rect *dstRect, const FrameBuffer *srcF
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytesByX = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytesByX = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   Rect srcClippedRect, dstClippedRect;
 
@@ -294,8 +295,8 @@ bool FrameBuffer::copyFromRotated180(const Rect *dstRect, const FrameBuffer *src
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytesByX = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytesByX = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   Rect srcClippedRect, dstClippedRect;
 
@@ -345,8 +346,8 @@ bool FrameBuffer::copyFromRotated270(const Rect *dstRect, const FrameBuffer *src
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytesByX = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytesByX = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   Rect srcClippedRect, dstClippedRect;
 
@@ -401,8 +402,8 @@ bool FrameBuffer::cmpFrom(const Rect *dstRect, const FrameBuffer *srcFrameBuffer
 
   // Shortcuts
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int dstStrideBytes = m_dimension.width * pixelSize;
-  int srcStrideBytes = srcFrameBuffer->getDimension().width * pixelSize;
+  int dstStrideBytes = getBytesPerRow();
+  int srcStrideBytes = srcFrameBuffer->getBytesPerRow();
 
   int resultHeight = dstClippedRect.getHeight();
   int resultWidthBytes = dstClippedRect.getWidth() * pixelSize;
@@ -435,7 +436,7 @@ void FrameBuffer::move(const Rect *dstRect, const int srcX, const int srcY)
 
   // Data copy
   int pixelSize = m_pixelFormat.bitsPerPixel / 8;
-  int strideBytes = m_dimension.width * pixelSize;
+  int strideBytes = getBytesPerRow();
 
   int resultHeight = dstClippedRect.getHeight();
   int resultWidthBytes = dstClippedRect.getWidth() * pixelSize;
@@ -469,29 +470,34 @@ void FrameBuffer::move(const Rect *dstRect, const int srcX, const int srcY)
 bool FrameBuffer::setPixelFormat(const PixelFormat *pixelFormat)
 {
   m_pixelFormat = *pixelFormat;
+  updateBytesPerRow();
   return resizeBuffer();
 }
 
 bool FrameBuffer::setDimension(const Dimension *newDim)
 {
   m_dimension = *newDim;
+  updateBytesPerRow();
   return resizeBuffer();
 }
 
 void FrameBuffer::setEmptyDimension(const Rect *dimByRect)
 {
   m_dimension.setDim(dimByRect);
+  updateBytesPerRow();
 }
 
 void FrameBuffer::setEmptyPixelFmt(const PixelFormat *pf)
 {
   m_pixelFormat = *pf;
+  updateBytesPerRow();
 }
 
 void FrameBuffer::setPropertiesWithoutResize(const Dimension *newDim, const PixelFormat *pf)
 {
   m_dimension = *newDim;
   m_pixelFormat = *pf;
+  updateBytesPerRow();
 }
 
 bool FrameBuffer::setProperties(const Dimension *newDim,
@@ -499,6 +505,7 @@ bool FrameBuffer::setProperties(const Dimension *newDim,
 {
   m_pixelFormat = *pixelFormat;
   m_dimension = *newDim;
+  updateBytesPerRow();
   return resizeBuffer();
 }
 
@@ -507,9 +514,29 @@ bool FrameBuffer::setProperties(const Rect *dimByRect,
 {
   m_pixelFormat = *pixelFormat;
   m_dimension.setDim(dimByRect);
+  updateBytesPerRow();
   return resizeBuffer();
 }
 
+void FrameBuffer::setBuffer(void *newBuffer)
+{
+  releaseBuffer();
+  m_rowAlignment = 1;
+  updateBytesPerRow();
+  m_buffer = newBuffer;
+}
+
+bool FrameBuffer::setRowAlignment(int alignment)
+{
+  _ASSERT(alignment > 0);
+  m_rowAlignment = alignment;
+  updateBytesPerRow();
+  if (m_bufferCapacity != 0) {
+    return resizeBuffer();
+  }
+  return true;
+}
+
 UINT8 FrameBuffer::getBitsPerPixel() const
 {
   _ASSERT((UINT8)m_pixelFormat.bitsPerPixel == m_pixelFormat.bitsPerPixel);
@@ -524,23 +551,44 @@ UINT8 FrameBuffer::getBytesPerPixel() const
 void *FrameBuffer::getBufferPtr(int x, int y) const
 {
   char *ptr = (char *)m_buffer;
-  ptr += (y * m_dimension.width + x) * getBytesPerPixel();
+  ptr += y * m_bytesPerRow + x * getBytesPerPixel();
 
   return (void *)ptr;
 }
 
 int FrameBuffer::getBufferSize() const
 { 
-  return (m_dimension.area() * m_pixelFormat.bitsPerPixel) / 8;
+  return m_dimension.height * m_bytesPerRow;
+}
+
+void FrameBuffer::updateBytesPerRow()
+{
+  int packedBytes = m_dimension.width * m_pixelFormat.bitsPerPixel / 8;
+  m_bytesPerRow = (packedBytes + m_rowAlignment - 1) / m_rowAlignment *
+                  m_rowAlignment;
 }
 
 bool FrameBuffer::resizeBuffer()
 {
-  if (m_buffer != 0) {
-    delete []m_buffer;
+  size_t size = getBufferSize();
+  if (m_bufferCapacity != 0 && m_bufferCapacity >= size) {
+    // The current buffer is big enough.
+    return true;
   }
-  if ((m_buffer = new UINT8[getBufferSize()]) == 0) {
+  releaseBuffer();
+  m_buffer = FrameBufferPool::allocate(size, &m_bufferCapacity);
+  if (m_buffer == 0) {
+    m_bufferCapacity = 0;
     return false;
   }
   return true;
 }
+
+void FrameBuffer::releaseBuffer()
+{
+  if (m_bufferCapacity != 0) {
+    FrameBufferPool::release(m_buffer, m_bufferCapacity);
+    m_bufferCapacity = 0;
+  }
+  m_buffer = 0;
+}
@@ -112,9 +112,21 @@ public:
   // Return the number of bytes occupied by one pixel (can be 1, 2 or 4).
   virtual UINT8 getBytesPerPixel() const;
 
-  virtual void setBuffer(void *newBuffer) { m_buffer = newBuffer; }
+  // Makes the frame buffer use external memory with rows packed without
+  // padding (the row alignment is reset to 1). The frame buffer does not
+  // free that memory; the caller should reset the buffer to 0 before
+  // freeing it.
+  virtual void setBuffer(void *newBuffer);
   virtual inline void *getBuffer() const { return m_buffer; }
 
+  // Sets the alignment, in bytes, of the beginning of each row. The default
+  // value 1 means rows are packed one after another without padding, which
+  // is what most code using getBuffer() directly expects. With a larger
+  // alignment (e.g. FrameBufferPool::BUFFER_ALIGNMENT), getBytesPerRow() may
+  // be greater than width * bytesPerPixel, and the buffer is reallocated
+  // if necessary. Returns false if memory cannot be allocated.
+  virtual bool setRowAlignment(int alignment);
+
   // Return a pointer to the pixel data specified by the coordinates of that
   // pixel. getBufferPtr(0, 0) should be equivalent to getBuffer(). This
   // function does not check if the coordinates are within the frame buffer
@@ -122,11 +134,19 @@ public:
   virtual void *getBufferPtr(int x, int y) const;
 
   virtual inline int getBufferSize() const;
-  virtual inline int getBytesPerRow() const { return m_dimension.width *
-                                             m_pixelFormat.bitsPerPixel / 8; }
+  // Return the distance in bytes between the beginnings of two adjacent
+  // rows (the stride).
+  virtual inline int getBytesPerRow() const { return m_bytesPerRow; }
 
 protected:
+  // Makes sure the buffer can hold getBufferSize() bytes. The memory is
+  // taken from FrameBufferPool; the current buffer is kept if it is big
+  // enough.
   bool resizeBuffer();
+  // Releases the buffer if it's owned by this frame buffer.
+  void releaseBuffer();
+  // Recomputes m_bytesPerRow after a dimension or pixel format change.
+  void updateBytesPerRow();
   void clipRect(const Rect *dstRect, const FrameBuffer *srcFrameBuffer,
                 const int srcX, const int srcY,
                 Rect *dstClippedRect, Rect *srcClippedRect);
@@ -143,6 +163,11 @@ protected:
 
   PixelFormat m_pixelFormat;
   void *m_buffer;
+  // Size of the buffer allocated from FrameBufferPool, 0 if the buffer is
+  // not owned by this frame buffer (see setBuffer()).
+  size_t m_bufferCapacity;
+  int m_bytesPerRow;
+  int m_rowAlignment;
 };
 
 #endif // __FRAMEBUFFER_H__
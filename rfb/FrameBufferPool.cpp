@@ -0,0 +1,92 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "FrameBufferPool.h"
+#include "thread/AutoLock.h"
+
+#include <malloc.h>
+
+FrameBufferPool::Cache *volatile FrameBufferPool::m_cache = 0;
+
+FrameBufferPool::Cache *FrameBufferPool::getCache()
+{
+  if (m_cache == 0) {
+    Cache *cache = new Cache;
+    if (InterlockedCompareExchangePointer((PVOID volatile *)&m_cache,
+                                          cache, 0) != 0) {
+      // Another thread has created the cache first.
+      delete cache;
+    }
+  }
+  return m_cache;
+}
+
+size_t FrameBufferPool::getCapacity(size_t size)
+{
+  if (size <= MIN_CAPACITY) {
+    return MIN_CAPACITY;
+  }
+  size_t base = MIN_CAPACITY;
+  while (base <= size / 2) {
+    base *= 2;
+  }
+  size_t step = base / 4;
+  return (size + step - 1) / step * step;
+}
+
+void *FrameBufferPool::allocate(size_t size, size_t *capacity)
+{
+  *capacity = getCapacity(size);
+  {
+    Cache *cache = getCache();
+    AutoLock al(&cache->mutex);
+    std::map<size_t, std::vector<void *> >::iterator it =
+      cache->freeBuffers.find(*capacity);
+    if (it != cache->freeBuffers.end() && !it->second.empty()) {
+      void *buffer = it->second.back();
+      it->second.pop_back();
+      cache->cachedBytes -= *capacity;
+      return buffer;
+    }
+  }
+  return _aligned_malloc(*capacity, BUFFER_ALIGNMENT);
+}
+
+void FrameBufferPool::release(void *buffer, size_t capacity)
+{
+  if (buffer == 0) {
+    return;
+  }
+  {
+    Cache *cache = getCache();
+    AutoLock al(&cache->mutex);
+    if (cache->cachedBytes + capacity <= MAX_CACHED_BYTES) {
+      cache->freeBuffers[capacity].push_back(buffer);
+      cache->cachedBytes += capacity;
+      return;
+    }
+  }
+  _aligned_free(buffer);
+}
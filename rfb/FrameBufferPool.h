@@ -0,0 +1,78 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __FRAMEBUFFERPOOL_H__
+#define __FRAMEBUFFERPOOL_H__
+
+#include <map>
+#include <vector>
+
+#include "thread/LocalMutex.h"
+
+// FrameBufferPool is a process-wide cache of pixel buffers shared by all
+// FrameBuffer objects. Requested sizes are rounded up to size classes
+// spaced by a quarter of a power of two, so buffers released by one frame
+// buffer (e.g. on a resolution change or when a pixel converter is reset)
+// can be reused by another one of a similar size instead of going back to
+// the heap. All buffers are aligned to BUFFER_ALIGNMENT bytes.
+class FrameBufferPool
+{
+public:
+  static const size_t BUFFER_ALIGNMENT = 64;
+
+  // Returns a buffer of at least `size' bytes and stores its actual size to
+  // `capacity'. Returns 0 if memory cannot be allocated.
+  static void *allocate(size_t size, size_t *capacity);
+
+  // Gives the buffer back to the pool. `capacity' must be the value
+  // returned by allocate() for this buffer.
+  static void release(void *buffer, size_t capacity);
+
+private:
+  // Returns the size class for a buffer of `size' bytes.
+  static size_t getCapacity(size_t size);
+
+  // Released buffers are kept while their total size does not exceed this.
+  static const size_t MAX_CACHED_BYTES = 128 * 1024 * 1024;
+  static const size_t MIN_CAPACITY = 256;
+
+  struct Cache
+  {
+    Cache() : cachedBytes(0) {}
+
+    LocalMutex mutex;
+    std::map<size_t, std::vector<void *> > freeBuffers;
+    size_t cachedBytes;
+  };
+
+  // Returns the cache, creating it on the first call. The cache is never
+  // destroyed, so frame buffers may be freed even during static
+  // destruction.
+  static Cache *getCache();
+
+  static Cache *volatile m_cache;
+};
+
+#endif // __FRAMEBUFFERPOOL_H__
@@ -28,6 +28,7 @@
 
 PixelConverter::PixelConverter(void)
 : m_convertMode(NO_CONVERT),
+  m_useRowConverter(false),
   m_dstFrameBuffer(0)
 {
 }
@@ -45,22 +46,23 @@ void PixelConverter::convert(const Rect *rect, FrameBuffer *dstFb,
   } else {
     int rectHeight = rect->getHeight();
     int rectWidth = rect->getWidth();
-    int fbWidth = dstFb->getDimension().width;
     PixelFormat dstPf = dstFb->getPixelFormat();
     PixelFormat srcPf = srcFb->getPixelFormat();
 
     UINT32 dstPixelSize = dstPf.bitsPerPixel / 8;
     UINT32 srcPixelSize = srcPf.bitsPerPixel / 8;
 
-    // FIXME: Make FrameBuffer do the math.
-    UINT8 *dstPixP = (UINT8 *)dstFb->getBuffer() +
-                     (fbWidth * rect->top + rect->left) * dstPixelSize;
-    UINT8 *srcPixP = (UINT8 *)srcFb->getBuffer() +
-                     (fbWidth * rect->top + rect->left) * srcPixelSize;
+    // Pointer increments from the end of a rectangle row to the beginning
+    // of the next one.
+    int dstRowSkip = dstFb->getBytesPerRow() - rectWidth * dstPixelSize;
+    int srcRowSkip = srcFb->getBytesPerRow() - rectWidth * srcPixelSize;
+
+    UINT8 *dstPixP = (UINT8 *)dstFb->getBufferPtr(rect->left, rect->top);
+    UINT8 *srcPixP = (UINT8 *)srcFb->getBufferPtr(rect->left, rect->top);
     if (m_convertMode == CONVERT_FROM_16) {
       for (int i = 0; i < rectHeight; i++,
-           dstPixP += (fbWidth - rectWidth) * dstPixelSize,
-           srcPixP += (fbWidth - rectWidth) * srcPixelSize) {
+           dstPixP += dstRowSkip,
+           srcPixP += srcRowSkip) {
         for (int j = 0; j < rectWidth; j++,
                                        dstPixP += dstPixelSize,
                                        srcPixP += srcPixelSize) {
@@ -74,6 +76,12 @@ void PixelConverter::convert(const Rect *rect, FrameBuffer *dstFb,
           }
         }
       }
+    } else if (m_convertMode == CONVERT_FROM_32 && m_useRowConverter) {
+      for (int i = 0; i < rectHeight; i++,
+           dstPixP += dstFb->getBytesPerRow(),
+           srcPixP += srcFb->getBytesPerRow()) {
+        m_rowConverter.convertRow(dstPixP, srcPixP, rectWidth);
+      }
     } else if (m_convertMode == CONVERT_FROM_32) {
       bool bigEndianDiffs = dstPf.bigEndian != srcPf.bigEndian;
       UINT32 srcRedMax = srcPf.redMax;
@@ -81,8 +89,8 @@ void PixelConverter::convert(const Rect *rect, FrameBuffer *dstFb,
       UINT32 srcBluMax = srcPf.blueMax;
 
       for (int i = 0; i < rectHeight; i++,
-           dstPixP += (fbWidth - rectWidth) * dstPixelSize,
-           srcPixP += (fbWidth - rectWidth) * srcPixelSize) {
+           dstPixP += dstRowSkip,
+           srcPixP += srcRowSkip) {
         for (int j = 0; j < rectWidth; j++,
                                        dstPixP += dstPixelSize,
                                        srcPixP += srcPixelSize) {
@@ -154,6 +162,7 @@ void PixelConverter::setPixelFormats(const PixelFormat *dstPf,
   if (!srcPf->isEqualTo(&m_srcFormat) || !dstPf->isEqualTo(&m_dstFormat)) {
     // Reset both translation tables and the internal frame buffer.
     reset();
+    m_useRowConverter = false;
 
     if (srcPf->isEqualTo(dstPf)) {
       m_convertMode = NO_CONVERT;
@@ -162,7 +171,10 @@ void PixelConverter::setPixelFormats(const PixelFormat *dstPf,
       fillHexBitsTable(dstPf, srcPf);
     } else if (srcPf->bitsPerPixel == 32) { // 32 bit -> N
       m_convertMode = CONVERT_FROM_32;
-      fill32BitsTable(dstPf, srcPf);
+      m_useRowConverter = m_rowConverter.init(dstPf, srcPf);
+      if (!m_useRowConverter) {
+        fill32BitsTable(dstPf, srcPf);
+      }
     }
 
     m_srcFormat = *srcPf;
@@ -180,6 +192,11 @@ size_t PixelConverter::getDstBitsPerPixel() const
   return m_dstFormat.bitsPerPixel;
 }
 
+PixelFormat PixelConverter::getDstPixelFormat() const
+{
+  return m_dstFormat;
+}
+
 void PixelConverter::fillHexBitsTable(const PixelFormat *dstPf,
                                       const PixelFormat *srcPf)
 {
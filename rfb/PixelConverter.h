@@ -26,6 +26,7 @@
 #define __RFB_PIXEL_CONVERTER_H_INCLUDED__
 
 #include "FrameBuffer.h"
+#include "PixelRowConverter.h"
 #include "region/Point.h"
 
 class PixelConverter
@@ -67,6 +68,10 @@ public:
   // Return the number of bits per pixel from the destination pixel format.
   virtual size_t getDstBitsPerPixel() const;
 
+  // Return the destination pixel format set by the most recent
+  // setPixelFormats() call.
+  virtual PixelFormat getDstPixelFormat() const;
+
 protected:
   void reset();
 
@@ -87,6 +92,11 @@ protected:
   std::vector<UINT32> m_grnTable;
   std::vector<UINT32> m_bluTable;
 
+  // Vectorized kernel used instead of the tables in the CONVERT_FROM_32 mode
+  // if m_useRowConverter is true.
+  PixelRowConverter m_rowConverter;
+  bool m_useRowConverter;
+
   PixelFormat m_srcFormat;
   PixelFormat m_dstFormat;
 
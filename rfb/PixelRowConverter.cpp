@@ -0,0 +1,281 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "PixelRowConverter.h"
+#include "util/CpuFeatures.h"
+
+#include <string.h>
+#include <crtdbg.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+//------------------------------- Kernels ----------------------------------//
+
+// Converts one pixel the same way as PixelConverter does via its tables,
+// but without byte swapping.
+static inline UINT32 convertPixel(const PixelRowConverter::Params *p,
+                                  UINT32 pixel)
+{
+  UINT32 result = 0;
+  for (int k = 0; k < 3; k++) {
+    UINT32 c = pixel >> p->srcShift[k] & 0xFF;
+    result |= ((c * p->dstMax[k] + 127) / 255) << p->dstShift[k];
+  }
+  return result;
+}
+
+static inline UINT32 swapUint32(UINT32 value)
+{
+  return value << 24 | (value << 8 & 0xFF0000) |
+         (value >> 8 & 0xFF00) | value >> 24;
+}
+
+// Extracts one 8-bit color component from the eight 32-bit pixels in `lo'
+// and `hi' and scales it to the range 0..dstMax, rounding as
+// (c * dstMax + 127) / 255. Returns eight 16-bit values shifted to the
+// component's place in the destination pixel.
+static inline __m128i scaleComponent(__m128i lo, __m128i hi,
+                                     __m128i srcShift, __m128i dstMax,
+                                     __m128i dstShift)
+{
+  const __m128i byteMask = _mm_set1_epi32(0xFF);
+  __m128i c = _mm_packs_epi32(_mm_and_si128(_mm_srl_epi32(lo, srcShift),
+                                            byteMask),
+                              _mm_and_si128(_mm_srl_epi32(hi, srcShift),
+                                            byteMask));
+  __m128i v = _mm_add_epi16(_mm_mullo_epi16(c, dstMax), _mm_set1_epi16(127));
+  // v / 255 == (v + 1 + (v >> 8)) >> 8 for all v below 65536 - 256.
+  v = _mm_add_epi16(_mm_add_epi16(v, _mm_set1_epi16(1)), _mm_srli_epi16(v, 8));
+  return _mm_sll_epi16(_mm_srli_epi16(v, 8), dstShift);
+}
+
+// Converts eight 32-bit pixels to eight destination pixel values of up to
+// 16 bits.
+static inline __m128i convertTo16(const UINT8 *src,
+                                  const __m128i *srcShift,
+                                  const __m128i *dstMax,
+                                  const __m128i *dstShift)
+{
+  __m128i lo = _mm_loadu_si128((const __m128i *)src);
+  __m128i hi = _mm_loadu_si128((const __m128i *)(src + 16));
+  __m128i r = scaleComponent(lo, hi, srcShift[0], dstMax[0], dstShift[0]);
+  __m128i g = scaleComponent(lo, hi, srcShift[1], dstMax[1], dstShift[1]);
+  __m128i b = scaleComponent(lo, hi, srcShift[2], dstMax[2], dstShift[2]);
+  return _mm_or_si128(_mm_or_si128(r, g), b);
+}
+
+static void convert32to16Sse2(const PixelRowConverter::Params *p,
+                              UINT8 *dst, const UINT8 *src, int count)
+{
+  __m128i srcShift[3], dstMax[3], dstShift[3];
+  for (int k = 0; k < 3; k++) {
+    srcShift[k] = _mm_cvtsi32_si128(p->srcShift[k]);
+    dstMax[k] = _mm_set1_epi16((short)p->dstMax[k]);
+    dstShift[k] = _mm_cvtsi32_si128(p->dstShift[k]);
+  }
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i result = convertTo16(src + i * 4, srcShift, dstMax, dstShift);
+    if (p->swapBytes) {
+      result = _mm_or_si128(_mm_slli_epi16(result, 8),
+                            _mm_srli_epi16(result, 8));
+    }
+    _mm_storeu_si128((__m128i *)(dst + i * 2), result);
+  }
+  for (; i < count; i++) {
+    UINT16 pixel = (UINT16)convertPixel(p, ((const UINT32 *)src)[i]);
+    if (p->swapBytes) {
+      pixel = (UINT16)(pixel << 8 | pixel >> 8);
+    }
+    ((UINT16 *)dst)[i] = pixel;
+  }
+}
+
+static void convert32to8Sse2(const PixelRowConverter::Params *p,
+                             UINT8 *dst, const UINT8 *src, int count)
+{
+  __m128i srcShift[3], dstMax[3], dstShift[3];
+  for (int k = 0; k < 3; k++) {
+    srcShift[k] = _mm_cvtsi32_si128(p->srcShift[k]);
+    dstMax[k] = _mm_set1_epi16((short)p->dstMax[k]);
+    dstShift[k] = _mm_cvtsi32_si128(p->dstShift[k]);
+  }
+
+  int i = 0;
+  for (; i + 16 <= count; i += 16) {
+    __m128i lo = convertTo16(src + i * 4, srcShift, dstMax, dstShift);
+    __m128i hi = convertTo16(src + i * 4 + 32, srcShift, dstMax, dstShift);
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+  }
+  for (; i < count; i++) {
+    dst[i] = (UINT8)convertPixel(p, ((const UINT32 *)src)[i]);
+  }
+}
+
+static void convert32to32Sse2(const PixelRowConverter::Params *p,
+                              UINT8 *dst, const UINT8 *src, int count)
+{
+  const __m128i byteMask = _mm_set1_epi32(0xFF);
+  const __m128i midMask1 = _mm_set1_epi32(0xFF0000);
+  const __m128i midMask2 = _mm_set1_epi32(0xFF00);
+  __m128i srcShift[3], dstShift[3];
+  for (int k = 0; k < 3; k++) {
+    srcShift[k] = _mm_cvtsi32_si128(p->srcShift[k]);
+    dstShift[k] = _mm_cvtsi32_si128(p->dstShift[k]);
+  }
+
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i px = _mm_loadu_si128((const __m128i *)(src + i * 4));
+    __m128i result = _mm_setzero_si128();
+    for (int k = 0; k < 3; k++) {
+      __m128i c = _mm_and_si128(_mm_srl_epi32(px, srcShift[k]), byteMask);
+      result = _mm_or_si128(result, _mm_sll_epi32(c, dstShift[k]));
+    }
+    if (p->swapBytes) {
+      result = _mm_or_si128(
+        _mm_or_si128(_mm_slli_epi32(result, 24), _mm_srli_epi32(result, 24)),
+        _mm_or_si128(_mm_and_si128(_mm_slli_epi32(result, 8), midMask1),
+                     _mm_and_si128(_mm_srli_epi32(result, 8), midMask2)));
+    }
+    _mm_storeu_si128((__m128i *)(dst + i * 4), result);
+  }
+  for (; i < count; i++) {
+    UINT32 pixel = convertPixel(p, ((const UINT32 *)src)[i]);
+    ((UINT32 *)dst)[i] = p->swapBytes ? swapUint32(pixel) : pixel;
+  }
+}
+
+static void convert32to32Ssse3(const PixelRowConverter::Params *p,
+                               UINT8 *dst, const UINT8 *src, int count)
+{
+  const __m128i shuffle = _mm_loadu_si128((const __m128i *)p->shuffle);
+
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    __m128i px = _mm_loadu_si128((const __m128i *)(src + i * 4));
+    _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_shuffle_epi8(px, shuffle));
+  }
+  for (; i < count; i++) {
+    UINT32 pixel = convertPixel(p, ((const UINT32 *)src)[i]);
+    ((UINT32 *)dst)[i] = p->swapBytes ? swapUint32(pixel) : pixel;
+  }
+}
+
+//--------------------------------------------------------------------------//
+
+PixelRowConverter::PixelRowConverter()
+: m_rowFunc(0)
+{
+  memset(&m_params, 0, sizeof(m_params));
+}
+
+PixelRowConverter::~PixelRowConverter()
+{
+}
+
+bool PixelRowConverter::init(const PixelFormat *dstPf,
+                             const PixelFormat *srcPf)
+{
+  m_rowFunc = 0;
+
+  if (!CpuFeatures::hasSse2() || srcPf->bitsPerPixel != 32) {
+    return false;
+  }
+
+  const unsigned short srcMax[3] = {
+    srcPf->redMax, srcPf->greenMax, srcPf->blueMax
+  };
+  const unsigned short srcShift[3] = {
+    srcPf->redShift, srcPf->greenShift, srcPf->blueShift
+  };
+  const unsigned short dstMax[3] = {
+    dstPf->redMax, dstPf->greenMax, dstPf->blueMax
+  };
+  const unsigned short dstShift[3] = {
+    dstPf->redShift, dstPf->greenShift, dstPf->blueShift
+  };
+
+  UINT32 dstBits = dstPf->bitsPerPixel;
+  UINT32 dstLimit = dstBits == 32 ? 0xFFFFFFFF : (1 << dstBits) - 1;
+  bool byteAligned = true;
+  bool fullBytes = true;
+
+  for (int k = 0; k < 3; k++) {
+    if (srcMax[k] != 255 || srcShift[k] % 8 != 0 || srcShift[k] > 24) {
+      return false;
+    }
+    if (dstMax[k] == 0 || dstMax[k] > 255 || dstShift[k] >= dstBits ||
+        (UINT32)dstMax[k] > dstLimit >> dstShift[k]) {
+      return false;
+    }
+    m_params.srcShift[k] = srcShift[k];
+    m_params.dstShift[k] = dstShift[k];
+    m_params.dstMax[k] = dstMax[k];
+    fullBytes = fullBytes && dstMax[k] == 255;
+    byteAligned = byteAligned && dstShift[k] % 8 == 0;
+  }
+  m_params.swapBytes = dstBits != 8 && dstPf->bigEndian != srcPf->bigEndian;
+
+  switch (dstBits) {
+  case 8:
+    m_rowFunc = convert32to8Sse2;
+    break;
+  case 16:
+    m_rowFunc = convert32to16Sse2;
+    break;
+  case 32:
+    if (!fullBytes) {
+      return false;
+    }
+    if (byteAligned && CpuFeatures::hasSsse3()) {
+      // Every destination byte is either a copy of a source byte or zero.
+      memset(m_params.shuffle, 0x80, sizeof(m_params.shuffle));
+      for (int i = 0; i < 4; i++) {
+        for (int k = 0; k < 3; k++) {
+          int dstByte = dstShift[k] / 8;
+          if (m_params.swapBytes) {
+            dstByte = 3 - dstByte;
+          }
+          m_params.shuffle[i * 4 + dstByte] = (UINT8)(i * 4 + srcShift[k] / 8);
+        }
+      }
+      m_rowFunc = convert32to32Ssse3;
+    } else {
+      m_rowFunc = convert32to32Sse2;
+    }
+    break;
+  default:
+    return false;
+  }
+  return true;
+}
+
+void PixelRowConverter::convertRow(void *dst, const void *src, int count) const
+{
+  _ASSERT(m_rowFunc != 0);
+  m_rowFunc(&m_params, (UINT8 *)dst, (const UINT8 *)src, count);
+}
@@ -0,0 +1,72 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __RFB_PIXEL_ROW_CONVERTER_H_INCLUDED__
+#define __RFB_PIXEL_ROW_CONVERTER_H_INCLUDED__
+
+#include "PixelFormat.h"
+#include "util/inttypes.h"
+
+// PixelRowConverter converts rows of 32-bit pixels with 8-bit color
+// components (the usual server frame buffer formats) to 32, 16 or 8 bits per
+// pixel with SSE2 or SSSE3 kernels. This covers the standard formats created
+// by StandardPixelFormatFactory (e.g. RGB565, BGR233) and 32-bit formats
+// differing only in byte order or component placement. The results are
+// exactly the same as PixelConverter produces via its lookup tables.
+class PixelRowConverter
+{
+public:
+  PixelRowConverter();
+  virtual ~PixelRowConverter();
+
+  // Selects a kernel for converting pixels from `srcPf' to `dstPf'. Returns
+  // false if there is no kernel for these formats or the processor does
+  // not support SSE2; convertRow() must not be called in that case.
+  bool init(const PixelFormat *dstPf, const PixelFormat *srcPf);
+
+  // Converts `count' pixels from `src' to `dst'.
+  void convertRow(void *dst, const void *src, int count) const;
+
+  // Kernel parameters, derived from the pixel formats by init().
+  struct Params
+  {
+    int srcShift[3];
+    int dstShift[3];
+    int dstMax[3];
+    // True if destination pixels should be byte-swapped.
+    bool swapBytes;
+    // pshufb mask for 32 -> 32 conversions.
+    UINT8 shuffle[16];
+  };
+
+private:
+  typedef void (*RowFunc)(const Params *params, UINT8 *dst,
+                          const UINT8 *src, int count);
+
+  RowFunc m_rowFunc;
+  Params m_params;
+};
+
+#endif // __RFB_PIXEL_ROW_CONVERTER_H_INCLUDED__
@@ -637,6 +637,15 @@ bool Configurator::saveServerConfig(SettingsManager *sm)
   if (!sm->setUINT(_T("VideoRecognitionInterval"), m_serverConfig.getVideoRecognitionInterval())) {
     saveResult = false;
   }
+  if (!sm->setBoolean(_T("AutoVideoDetection"), m_serverConfig.getAutoVideoDetectionFlag())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("VideoDetectionRate"), m_serverConfig.getVideoDetectionRate())) {
+    saveResult = false;
+  }
+  if (!sm->setUINT(_T("VideoDetectionMinSize"), m_serverConfig.getVideoDetectionMinSize())) {
+    saveResult = false;
+  }
   if (!sm->setBoolean(_T("GrabTransparentWindows"), m_serverConfig.getGrabTransparentWindowsFlag())) {
     saveResult = false;
   }
@@ -649,6 +658,15 @@ bool Configurator::saveServerConfig(SettingsManager *sm)
   if (!sm->setUINT(_T("IdleTimeout"), (UINT)m_serverConfig.getIdleTimeout())) {
     saveResult = false;
   }
+  if (!sm->setUINT(_T("EncodingThreads"), m_serverConfig.getEncodingThreads())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("AdaptiveEncoding"), m_serverConfig.getAdaptiveEncodingFlag())) {
+    saveResult = false;
+  }
+  if (!sm->setBoolean(_T("EncodingCache"), m_serverConfig.getEncodingCacheFlag())) {
+    saveResult = false;
+  }
   return saveResult;
 }
 
@@ -817,12 +835,48 @@ bool Configurator::loadServerConfig(SettingsManager *sm, ServerConfig *config)
     m_isConfigLoadedPartly = true;
     m_serverConfig.setVideoRecognitionInterval(uintVal);
   }
+  if (!sm->getBoolean(_T("AutoVideoDetection"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setAutoVideoDetectionFlag(boolVal);
+  }
+  if (!sm->getUINT(_T("VideoDetectionRate"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setVideoDetectionRate(uintVal);
+  }
+  if (!sm->getUINT(_T("VideoDetectionMinSize"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setVideoDetectionMinSize(uintVal);
+  }
   if (!sm->getUINT(_T("IdleTimeout"), &uintVal)) {
     loadResult = false;
   } else {
     m_isConfigLoadedPartly = true;
     m_serverConfig.setIdleTimeout((int)uintVal);
   }
+  if (!sm->getUINT(_T("EncodingThreads"), &uintVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setEncodingThreads(uintVal);
+  }
+  if (!sm->getBoolean(_T("AdaptiveEncoding"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setAdaptiveEncodingFlag(boolVal);
+  }
+  if (!sm->getBoolean(_T("EncodingCache"), &boolVal)) {
+    loadResult = false;
+  } else {
+    m_isConfigLoadedPartly = true;
+    m_serverConfig.setEncodingCacheFlag(boolVal);
+  }
   if (!sm->getBoolean(_T("GrabTransparentWindows"), &boolVal)) {
     loadResult = false;
   } else {
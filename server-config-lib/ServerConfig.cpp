@@ -42,10 +42,15 @@ ServerConfig::ServerConfig()
 	m_blockLocalInput(false), m_blockRemoteInput(false), m_localInputPriority(false),
 	m_defaultActionAccept(false), m_queryTimeout(30),
 	m_allowLoopbackConnections(false),
-	m_videoRecognitionInterval(3000), m_grabTransparentWindows(true),
+	m_videoRecognitionInterval(3000), m_autoVideoDetection(false),
+	m_videoDetectionRate(10), m_videoDetectionMinSize(128),
+	m_grabTransparentWindows(true),
 	m_saveLogToAllUsersPath(false), m_hasControlPassword(false),
 	m_showTrayIcon(true),
-	m_idleTimeout(0)
+	m_idleTimeout(0),
+	m_encodingThreads(1),
+	m_adaptiveEncoding(false),
+	m_encodingCache(false)
 {
 	memset(m_primaryPassword, 0, sizeof(m_primaryPassword));
 	memset(m_readonlyPassword, 0, sizeof(m_readonlyPassword));
@@ -125,6 +130,9 @@ void ServerConfig::serialize(DataOutputStream *output)
   }
 
   output->writeUInt32(m_videoRecognitionInterval);
+  output->writeInt8(m_autoVideoDetection ? 1 : 0);
+  output->writeUInt32(m_videoDetectionRate);
+  output->writeUInt32(m_videoDetectionMinSize);
   
   output->writeUInt32(m_idleTimeout);
   _ASSERT((UINT32)m_videoRects.size() == m_videoRects.size());
@@ -168,6 +176,10 @@ void ServerConfig::serialize(DataOutputStream *output)
   output->writeInt8(m_logMpegStreamerProcessOutput ? 1 : 0);
 
   output->writeUTF8(m_logFilePath.getString());
+
+  output->writeUInt32(m_encodingThreads);
+  output->writeInt8(m_adaptiveEncoding ? 1 : 0);
+  output->writeInt8(m_encodingCache ? 1 : 0);
 }
 
 void ServerConfig::deserialize(DataInputStream *input)
@@ -218,6 +230,9 @@ void ServerConfig::deserialize(DataInputStream *input)
   }
 
   m_videoRecognitionInterval = input->readUInt32();
+  m_autoVideoDetection = input->readInt8() == 1;
+  m_videoDetectionRate = input->readUInt32();
+  m_videoDetectionMinSize = input->readUInt32();
 
   m_idleTimeout = input->readUInt32();
   m_videoRects.clear();
@@ -261,6 +276,10 @@ void ServerConfig::deserialize(DataInputStream *input)
   m_logMpegStreamerProcessOutput = input->readInt8() == 1;
 
   input->readUTF8(&m_logFilePath);
+
+  m_encodingThreads = input->readUInt32();
+  m_adaptiveEncoding = input->readInt8() == 1;
+  m_encodingCache = input->readInt8() == 1;
 }
 
 bool ServerConfig::getShowTrayIconFlag()
@@ -780,11 +799,89 @@ void ServerConfig::setVideoRecognitionInterval(unsigned int interval)
   m_videoRecognitionInterval = interval;
 }
 
+bool ServerConfig::getAutoVideoDetectionFlag()
+{
+  AutoLock lock(&m_objectCS);
+  return m_autoVideoDetection;
+}
+
+void ServerConfig::setAutoVideoDetectionFlag(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_autoVideoDetection = enabled;
+}
+
+unsigned int ServerConfig::getVideoDetectionRate()
+{
+  AutoLock lock(&m_objectCS);
+  return m_videoDetectionRate;
+}
+
+void ServerConfig::setVideoDetectionRate(unsigned int updatesPerSecond)
+{
+  AutoLock lock(&m_objectCS);
+  m_videoDetectionRate = updatesPerSecond;
+}
+
+unsigned int ServerConfig::getVideoDetectionMinSize()
+{
+  AutoLock lock(&m_objectCS);
+  return m_videoDetectionMinSize;
+}
+
+void ServerConfig::setVideoDetectionMinSize(unsigned int pixels)
+{
+  AutoLock lock(&m_objectCS);
+  m_videoDetectionMinSize = pixels;
+}
+
 std::vector<Rect> *ServerConfig::getVideoRects()
 {
   return &m_videoRects;
 }
 
+unsigned int ServerConfig::getEncodingThreads()
+{
+  AutoLock lock(&m_objectCS);
+  return m_encodingThreads;
+}
+
+void ServerConfig::setEncodingThreads(unsigned int count)
+{
+  AutoLock lock(&m_objectCS);
+  if (count < 1) {
+    m_encodingThreads = 1;
+  } else if (count > MAXIMAL_ENCODING_THREADS) {
+    m_encodingThreads = MAXIMAL_ENCODING_THREADS;
+  } else {
+    m_encodingThreads = count;
+  }
+}
+
+bool ServerConfig::getAdaptiveEncodingFlag()
+{
+  AutoLock lock(&m_objectCS);
+  return m_adaptiveEncoding;
+}
+
+void ServerConfig::setAdaptiveEncodingFlag(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_adaptiveEncoding = enabled;
+}
+
+bool ServerConfig::getEncodingCacheFlag()
+{
+  AutoLock lock(&m_objectCS);
+  return m_encodingCache;
+}
+
+void ServerConfig::setEncodingCacheFlag(bool enabled)
+{
+  AutoLock lock(&m_objectCS);
+  m_encodingCache = enabled;
+}
+
 int ServerConfig::getIdleTimeout()
 {
   AutoLock lock(&m_objectCS);
@@ -47,6 +47,7 @@ public:
 	static const unsigned int MINIMAL_POLLING_INTERVAL = 30;
 	static const unsigned int MINIMAL_LOCAL_INPUT_PRIORITY_TIMEOUT = 1;
 	static const unsigned int MINIMAL_QUERY_TIMEOUT = 1;
+	static const unsigned int MAXIMAL_ENCODING_THREADS = 16;
 
 	//
 	// Enum defines server action when last client disconnects
@@ -265,6 +266,18 @@ public:
 	unsigned int getVideoRecognitionInterval();
 	void setVideoRecognitionInterval(unsigned int interval);
 
+	// Detect video regions automatically by how often parts of the screen
+	// are updated, in addition to the configured ones. Disabled by default,
+	// can be enabled by the AutoVideoDetection registry value.
+	bool getAutoVideoDetectionFlag();
+	void setAutoVideoDetectionFlag(bool enabled);
+	// Number of updates per second that makes a part of the screen video.
+	unsigned int getVideoDetectionRate();
+	void setVideoDetectionRate(unsigned int updatesPerSecond);
+	// Minimal width and height of a detected video region, in pixels.
+	unsigned int getVideoDetectionMinSize();
+	void setVideoDetectionMinSize(unsigned int pixels);
+
 	int  getIdleTimeout();
 	void setIdleTimeout(int timeout);
 
@@ -280,6 +293,26 @@ public:
 	void getLogFileDir(StringStorage *logFileDir);
 	void setLogFileDir(const TCHAR *logFileDir);
 
+	//
+	// Encoding performance
+	//
+
+	// Number of threads encoding rectangles of a framebuffer update for
+	// each client. The value of 1 means encoding in the sender thread only.
+	unsigned int getEncodingThreads();
+	void setEncodingThreads(unsigned int count);
+
+	// Choose the encoding of each rectangle by its content among the
+	// encodings supported by the client, instead of always using the
+	// client's preferred encoding.
+	bool getAdaptiveEncodingFlag();
+	void setAdaptiveEncodingFlag(bool enabled);
+
+	// Share encoded rectangles between clients with the same pixel format
+	// and encoding settings, so identical rectangles are encoded once.
+	bool getEncodingCacheFlag();
+	void setEncodingCacheFlag(bool enabled);
+
 protected:
 
 	//
@@ -400,6 +433,9 @@ protected:
 	//
 
 	unsigned int m_videoRecognitionInterval;
+	bool m_autoVideoDetection;
+	unsigned int m_videoDetectionRate;
+	unsigned int m_videoDetectionMinSize;
 	bool m_grabTransparentWindows;
 
 	// Socket timeout to disconnect inactive clients, in seconds
@@ -411,6 +447,14 @@ protected:
 	bool m_showTrayIcon;
 
 	StringStorage m_logFilePath;
+
+	//
+	// Encoding performance
+	//
+
+	unsigned int m_encodingThreads;
+	bool m_adaptiveEncoding;
+	bool m_encodingCache;
 private:
 
 	//
@@ -0,0 +1,182 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DirtyBlockDetectorTest.h"
+
+#include "rfb/StandardPixelFormatFactory.h"
+#include "util/Exception.h"
+
+#include <string.h>
+
+static const int BLOCK_SIZE = DirtyBlockDetector::BLOCK_SIZE;
+
+static UINT32 getNoise(int x, int y)
+{
+  UINT32 h = (UINT32)x * 73856093 ^ (UINT32)y * 19349663;
+  h ^= h >> 13;
+  h *= 0x5bd1e995;
+  return h ^ (h >> 15);
+}
+
+DirtyBlockDetectorTest::DirtyBlockDetectorTest()
+{
+}
+
+DirtyBlockDetectorTest::~DirtyBlockDetectorTest()
+{
+}
+
+void DirtyBlockDetectorTest::run()
+{
+  checkKernels();
+  checkDirtyBlocks();
+}
+
+void DirtyBlockDetectorTest::checkKernels()
+{
+  // The buffers are used at all offsets within 16 bytes, so the vector loads
+  // are unaligned in every possible way.
+  std::vector<UINT8> a(MAX_LENGTH + 16);
+  std::vector<UINT8> b(MAX_LENGTH + 16);
+  for (size_t i = 0; i < a.size(); i++) {
+    a[i] = b[i] = (UINT8)getNoise((int)i, 0);
+  }
+
+  for (size_t len = 0; len <= MAX_LENGTH; len++) {
+    size_t offset = len % 16;
+    UINT8 *pa = &a[offset];
+    UINT8 *pb = &b[offset];
+    checkKernels(pa, pb, len, -1, -1);
+    for (size_t first = 0; first < len; first++) {
+      pb[first] ^= 0x10;
+      checkKernels(pa, pb, len, (int)first, (int)first);
+      // A second difference anywhere after the first one.
+      for (size_t last = first + 1; last < len; last += 7) {
+        pb[last] ^= 0x01;
+        checkKernels(pa, pb, len, (int)first, (int)last);
+        pb[last] ^= 0x01;
+      }
+      pb[first] ^= 0x10;
+    }
+  }
+}
+
+void DirtyBlockDetectorTest::checkKernels(const UINT8 *a, const UINT8 *b,
+                                          size_t len,
+                                          int firstDiff, int lastDiff)
+{
+  bool differ = m_detector.differ(a, b, len);
+  int first = m_detector.findFirstDiff(a, b, len);
+  int last = m_detector.findLastDiff(a, b, len);
+  if (differ != (firstDiff >= 0) || first != firstDiff || last != lastDiff) {
+    StringStorage errMess;
+    errMess.format(_T("%u bytes differing at %d..%d: differ() returned %d,")
+                   _T(" findFirstDiff() %d, findLastDiff() %d"),
+                   (unsigned int)len, firstDiff, lastDiff, (int)differ,
+                   first, last);
+    throw Exception(errMess.getString());
+  }
+}
+
+void DirtyBlockDetectorTest::checkDirtyBlocks()
+{
+  PixelFormat pf = StandardPixelFormatFactory::create32bppPixelFormat();
+  Dimension dim(FB_WIDTH, FB_HEIGHT);
+  FrameBuffer oldFb;
+  oldFb.setProperties(&dim, &pf);
+  FrameBuffer newFb;
+  newFb.setProperties(&dim, &pf);
+  for (int y = 0; y < FB_HEIGHT; y++) {
+    UINT32 *oldRow = (UINT32 *)oldFb.getBufferPtr(0, y);
+    UINT32 *newRow = (UINT32 *)newFb.getBufferPtr(0, y);
+    for (int x = 0; x < FB_WIDTH; x++) {
+      oldRow[x] = newRow[x] = getNoise(x, y);
+      // Scattered single changed pixels, some on block edges.
+      if (getNoise(y, x) % 97 == 0) {
+        newRow[x] ^= 0x00010000;
+      }
+    }
+  }
+
+  // Rectangles 1 to 17 pixels wide and a few wider ones, at different
+  // positions and heights, so the blocks at the right and bottom edges are
+  // cropped in different ways.
+  for (int width = 1; width <= FB_WIDTH; width += width < 17 ? 1 : 29) {
+    for (int left = 0; left + width <= FB_WIDTH; left += 37) {
+      int top = (width * 7) % 13;
+      int height = FB_HEIGHT - top - width % 5;
+      Rect rect(left, top, left + width, top + height);
+
+      std::vector<Rect> blockRuns;
+      m_detector.findDirtyBlocks(&oldFb, &newFb, &rect, &blockRuns);
+      std::vector<Rect> expectedRuns;
+      findDirtyBlocks(&oldFb, &newFb, &rect, &expectedRuns);
+
+      bool equal = blockRuns.size() == expectedRuns.size();
+      for (size_t i = 0; equal && i < blockRuns.size(); i++) {
+        equal = blockRuns[i].isEqualTo(&expectedRuns[i]);
+      }
+      if (!equal) {
+        StringStorage errMess;
+        errMess.format(_T("Changed blocks of (%d, %d, %d, %d) are wrong:")
+                       _T(" %u runs found, %u expected"),
+                       rect.left, rect.top, rect.right, rect.bottom,
+                       (unsigned int)blockRuns.size(),
+                       (unsigned int)expectedRuns.size());
+        throw Exception(errMess.getString());
+      }
+    }
+  }
+}
+
+void DirtyBlockDetectorTest::findDirtyBlocks(const FrameBuffer *oldFb,
+                                             const FrameBuffer *newFb,
+                                             const Rect *rect,
+                                             std::vector<Rect> *blockRuns)
+{
+  size_t bytesPerPixel = oldFb->getBytesPerPixel();
+  for (int top = rect->top; top < rect->bottom; top += BLOCK_SIZE) {
+    int bottom = min(top + BLOCK_SIZE, rect->bottom);
+    int runLeft = -1;
+    for (int left = rect->left; left < rect->right; left += BLOCK_SIZE) {
+      int right = min(left + BLOCK_SIZE, rect->right);
+      bool changed = false;
+      for (int y = top; y < bottom && !changed; y++) {
+        changed = memcmp(oldFb->getBufferPtr(left, y),
+                         newFb->getBufferPtr(left, y),
+                         (right - left) * bytesPerPixel) != 0;
+      }
+      if (changed && runLeft < 0) {
+        runLeft = left;
+      }
+      if (!changed && runLeft >= 0) {
+        blockRuns->push_back(Rect(runLeft, top, left, bottom));
+        runLeft = -1;
+      }
+    }
+    if (runLeft >= 0) {
+      blockRuns->push_back(Rect(runLeft, top, rect->right, bottom));
+    }
+  }
+}
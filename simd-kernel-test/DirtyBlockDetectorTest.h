@@ -0,0 +1,66 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _DIRTY_BLOCK_DETECTOR_TEST_H_
+#define _DIRTY_BLOCK_DETECTOR_TEST_H_
+
+#include "desktop/DirtyBlockDetector.h"
+
+#include <vector>
+
+//
+// Checks the compare and first/last difference kernels of
+// DirtyBlockDetector against byte loops for every buffer length up to
+// MAX_LENGTH and every position of the differing bytes, and checks the
+// changed blocks it finds in rectangles 1 to 17 pixels wide and wider
+// against a block by block comparison.
+//
+class DirtyBlockDetectorTest
+{
+public:
+  DirtyBlockDetectorTest();
+  virtual ~DirtyBlockDetectorTest();
+
+  // Throws Exception if a check fails.
+  void run();
+
+private:
+  void checkKernels();
+  void checkKernels(const UINT8 *a, const UINT8 *b, size_t len,
+                    int firstDiff, int lastDiff);
+  void checkDirtyBlocks();
+
+  // Finds the changed blocks of `rect' the slow way.
+  void findDirtyBlocks(const FrameBuffer *oldFb, const FrameBuffer *newFb,
+                       const Rect *rect, std::vector<Rect> *blockRuns);
+
+  DirtyBlockDetector m_detector;
+
+  // Longer than the 128-byte steps of the AVX2 kernel plus all its tails.
+  static const size_t MAX_LENGTH = 300;
+  static const int FB_WIDTH = 200;
+  static const int FB_HEIGHT = 100;
+};
+
+#endif
@@ -0,0 +1,196 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "PixelRowConverterTest.h"
+
+#include "rfb/StandardPixelFormatFactory.h"
+#include "util/CpuFeatures.h"
+#include "util/Exception.h"
+
+#include <string.h>
+
+// Widths of the converted rows besides 1..MAX_NARROW_WIDTH.
+static const int WIDE_ROWS[] = { 31, 32, 33, 64, 77 };
+static const int WIDE_ROW_COUNT = sizeof(WIDE_ROWS) / sizeof(WIDE_ROWS[0]);
+
+static UINT32 getNoise(int x, int y)
+{
+  UINT32 h = (UINT32)x * 73856093 ^ (UINT32)y * 19349663;
+  h ^= h >> 13;
+  h *= 0x5bd1e995;
+  return h ^ (h >> 15);
+}
+
+bool PixelRowConverterTest::TestPixelConverter::usesRowConverter() const
+{
+  return m_useRowConverter;
+}
+
+PixelRowConverterTest::PixelRowConverterTest()
+{
+}
+
+PixelRowConverterTest::~PixelRowConverterTest()
+{
+}
+
+void PixelRowConverterTest::run()
+{
+  PixelFormat native = StandardPixelFormatFactory::create32bppPixelFormat();
+  bool be = native.bigEndian;
+
+  PixelFormat srcFormats[] = {
+    native,
+    createPixelFormat(32, 255, 255, 255, 0, 8, 16, be),
+    createPixelFormat(32, 255, 255, 255, 24, 16, 8, be),
+    createPixelFormat(32, 255, 255, 255, 16, 8, 0, !be)
+  };
+  const TCHAR *srcNames[] = {
+    _T("RGB888"), _T("BGR888"), _T("RGBX8888"), _T("RGB888 (swapped)")
+  };
+
+  struct DstFormat
+  {
+    PixelFormat pf;
+    bool hasKernel;
+    const TCHAR *name;
+  };
+  DstFormat dstFormats[] = {
+    { StandardPixelFormatFactory::create16bppPixelFormat(), true,
+      _T("RGB565") },
+    { createPixelFormat(16, 31, 63, 31, 11, 5, 0, !be), true,
+      _T("RGB565 (swapped)") },
+    { createPixelFormat(16, 31, 31, 31, 10, 5, 0, be), true,
+      _T("RGB555") },
+    { StandardPixelFormatFactory::create8bppPixelFormat(), true,
+      _T("BGR233") },
+    { StandardPixelFormatFactory::create6bppPixelFormat(), true,
+      _T("RGB222") },
+    { StandardPixelFormatFactory::create3bppPixelFormat(), true,
+      _T("RGB111") },
+    { native, true, _T("RGB888") },
+    { createPixelFormat(32, 255, 255, 255, 0, 8, 16, be), true,
+      _T("BGR888") },
+    { createPixelFormat(32, 255, 255, 255, 16, 8, 0, !be), true,
+      _T("RGB888 (swapped)") },
+    { createPixelFormat(32, 255, 255, 255, 8, 16, 24, !be), true,
+      _T("XBGR8888 (swapped)") },
+    // Not aligned to bytes, SSSE3 can't shuffle it.
+    { createPixelFormat(32, 255, 255, 255, 20, 10, 2, be), true,
+      _T("RGB888 at bits 20, 10 and 2") },
+    // No kernel, the tables are used in any case.
+    { createPixelFormat(32, 1023, 1023, 1023, 20, 10, 0, be), false,
+      _T("RGB101010") }
+  };
+
+  for (size_t i = 0; i < sizeof(srcFormats) / sizeof(srcFormats[0]); i++) {
+    for (size_t j = 0; j < sizeof(dstFormats) / sizeof(dstFormats[0]); j++) {
+      if (dstFormats[j].pf.isEqualTo(&srcFormats[i])) {
+        continue;
+      }
+      StringStorage name;
+      name.format(_T("%s to %s"), srcNames[i], dstFormats[j].name);
+      check(&dstFormats[j].pf, &srcFormats[i], dstFormats[j].hasKernel,
+            name.getString());
+    }
+  }
+}
+
+void PixelRowConverterTest::check(const PixelFormat *dstPf,
+                                  const PixelFormat *srcPf,
+                                  bool hasKernel, const TCHAR *name)
+{
+  // The tables are filled when no SIMD instruction sets are allowed.
+  CpuFeatures::Level level = CpuFeatures::getMaxLevel();
+  CpuFeatures::setMaxLevel(CpuFeatures::SCALAR);
+  TestPixelConverter tableConverter;
+  tableConverter.setPixelFormats(dstPf, srcPf);
+  CpuFeatures::setMaxLevel(level);
+
+  TestPixelConverter converter;
+  converter.setPixelFormats(dstPf, srcPf);
+  if (converter.usesRowConverter() != (hasKernel && CpuFeatures::hasSse2())) {
+    StringStorage errMess;
+    errMess.format(_T("%s: PixelConverter %s a row kernel"), name,
+                   converter.usesRowConverter() ? _T("uses") : _T("does not use"));
+    throw Exception(errMess.getString());
+  }
+
+  // Each row is converted in its own frame buffer line, at an offset that
+  // changes the alignment of the row.
+  const int rowCount = MAX_NARROW_WIDTH + WIDE_ROW_COUNT;
+  Dimension dim(FB_WIDTH, rowCount);
+  FrameBuffer srcFb;
+  srcFb.setProperties(&dim, srcPf);
+  for (int y = 0; y < rowCount; y++) {
+    UINT32 *row = (UINT32 *)srcFb.getBufferPtr(0, y);
+    for (int x = 0; x < FB_WIDTH; x++) {
+      row[x] = getNoise(x, y);
+    }
+  }
+  FrameBuffer fb;
+  fb.setProperties(&dim, dstPf);
+  memset(fb.getBuffer(), 0x5A, fb.getBufferSize());
+  FrameBuffer expectedFb;
+  expectedFb.setProperties(&dim, dstPf);
+  memset(expectedFb.getBuffer(), 0x5A, expectedFb.getBufferSize());
+
+  for (int y = 0; y < rowCount; y++) {
+    int width = y < MAX_NARROW_WIDTH ? y + 1 : WIDE_ROWS[y - MAX_NARROW_WIDTH];
+    int left = y % 3;
+    Rect rect(left, y, left + width, y + 1);
+    converter.convert(&rect, &fb, &srcFb);
+    tableConverter.convert(&rect, &expectedFb, &srcFb);
+
+    if (memcmp(fb.getBufferPtr(0, y), expectedFb.getBufferPtr(0, y),
+               fb.getBytesPerRow()) != 0) {
+      StringStorage errMess;
+      errMess.format(_T("%s: a row of %d pixels differs from the tables'")
+                     _T(" conversion"), name, width);
+      throw Exception(errMess.getString());
+    }
+  }
+}
+
+PixelFormat PixelRowConverterTest::createPixelFormat(int bitsPerPixel,
+                                                     int redMax,
+                                                     int greenMax,
+                                                     int blueMax,
+                                                     int redShift,
+                                                     int greenShift,
+                                                     int blueShift,
+                                                     bool bigEndian)
+{
+  PixelFormat pf;
+  pf.bitsPerPixel = bitsPerPixel;
+  pf.colorDepth = bitsPerPixel == 32 ? 24 : bitsPerPixel;
+  pf.redMax = redMax;
+  pf.greenMax = greenMax;
+  pf.blueMax = blueMax;
+  pf.redShift = redShift;
+  pf.greenShift = greenShift;
+  pf.blueShift = blueShift;
+  pf.bigEndian = bigEndian;
+  return pf;
+}
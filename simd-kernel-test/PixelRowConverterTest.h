@@ -0,0 +1,69 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _PIXEL_ROW_CONVERTER_TEST_H_
+#define _PIXEL_ROW_CONVERTER_TEST_H_
+
+#include "rfb/FrameBuffer.h"
+#include "rfb/PixelConverter.h"
+
+//
+// Converts rows of 32-bit pixels to the standard client formats and to
+// 32-bit formats of other byte orders by PixelConverter, and checks that
+// the result is the same as the lookup tables give. Rows are 1 to 17
+// pixels wide, and a few are wider, so both the vector loops and the
+// loops over the remaining pixels are run.
+//
+class PixelRowConverterTest
+{
+public:
+  PixelRowConverterTest();
+  virtual ~PixelRowConverterTest();
+
+  // Throws Exception if a check fails.
+  void run();
+
+private:
+  // Tells whether PixelConverter uses a PixelRowConverter kernel.
+  class TestPixelConverter : public PixelConverter
+  {
+  public:
+    bool usesRowConverter() const;
+  };
+
+  // Throws Exception if the kernel, which must exist if `hasKernel' is
+  // true and SSE2 is allowed, converts any row differently.
+  void check(const PixelFormat *dstPf, const PixelFormat *srcPf,
+             bool hasKernel, const TCHAR *name);
+
+  static PixelFormat createPixelFormat(int bitsPerPixel,
+                                       int redMax, int greenMax, int blueMax,
+                                       int redShift, int greenShift,
+                                       int blueShift, bool bigEndian);
+
+  static const int FB_WIDTH = 80;
+  static const int MAX_NARROW_WIDTH = 17;
+};
+
+#endif
@@ -0,0 +1,300 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "RowKernelsTest.h"
+
+#include "rfb/StandardPixelFormatFactory.h"
+#include "util/Exception.h"
+#include "viewer-core/RowKernels.h"
+
+#include <algorithm>
+#include <string.h>
+
+// Row widths besides 1..MAX_NARROW_WIDTH.
+static const int MAX_NARROW_WIDTH = 17;
+static const int WIDE_ROWS[] = { 31, 32, 33, 64 };
+static const int WIDE_ROW_COUNT = sizeof(WIDE_ROWS) / sizeof(WIDE_ROWS[0]);
+
+static UINT32 getNoise(int x, int y)
+{
+  UINT32 h = (UINT32)x * 73856093 ^ (UINT32)y * 19349663;
+  h ^= h >> 13;
+  h *= 0x5bd1e995;
+  return h ^ (h >> 15);
+}
+
+static int getWidth(int index)
+{
+  return index < MAX_NARROW_WIDTH ? index + 1 :
+                                    WIDE_ROWS[index - MAX_NARROW_WIDTH];
+}
+
+RowKernelsTest::RowKernelsTest()
+{
+}
+
+RowKernelsTest::~RowKernelsTest()
+{
+}
+
+void RowKernelsTest::run()
+{
+  PixelFormat formats[] = {
+    StandardPixelFormatFactory::create8bppPixelFormat(),
+    StandardPixelFormatFactory::create16bppPixelFormat(),
+    StandardPixelFormatFactory::create32bppPixelFormat(),
+    StandardPixelFormatFactory::create32bppPixelFormat()
+  };
+  // BGR, so convertRgb() can't expand it as CPIXELs.
+  formats[3].redShift = 0;
+  formats[3].blueShift = 16;
+
+  for (int i = 0; i < MAX_NARROW_WIDTH + WIDE_ROW_COUNT; i++) {
+    int count = getWidth(i);
+    checkCPixels(count, true);
+    checkCPixels(count, false);
+    for (int bytesPerPixel = 1; bytesPerPixel <= 4; bytesPerPixel *= 2) {
+      checkMono(count, bytesPerPixel);
+      checkPalette(count, bytesPerPixel);
+    }
+    for (size_t j = 0; j < sizeof(formats) / sizeof(formats[0]); j++) {
+      checkRgb(count, &formats[j]);
+      checkGradient(count, false, &formats[j]);
+      if (formats[j].bitsPerPixel == 32) {
+        checkGradient(count, true, &formats[j]);
+      }
+    }
+  }
+}
+
+void RowKernelsTest::checkCPixels(int count, bool reverseOrder)
+{
+  std::vector<UINT8> src(count * 3);
+  for (int i = 0; i < count * 3; i++) {
+    src[i] = (UINT8)getNoise(i, count);
+  }
+
+  std::vector<UINT8> expected;
+  prepareDst(&expected, count, 4);
+  for (int i = 0; i < count; i++) {
+    const UINT8 *p = &src[i * 3];
+    putPixel(&expected[i * 4], 4,
+             reverseOrder ? p[0] << 16 | p[1] << 8 | p[2] :
+                            p[2] << 16 | p[1] << 8 | p[0]);
+  }
+
+  std::vector<UINT8> dst;
+  prepareDst(&dst, count, 4);
+  RowKernels::expandCPixels((UINT32 *)&dst.front(), &src.front(), count,
+                            reverseOrder);
+  compare(&dst, &expected, count, 4,
+          reverseOrder ? _T("expandCPixels(), Tight order") :
+                         _T("expandCPixels(), ZRLE order"));
+}
+
+void RowKernelsTest::checkMono(int count, int bytesPerPixel)
+{
+  std::vector<UINT8> bits((count + 7) / 8);
+  for (size_t i = 0; i < bits.size(); i++) {
+    bits[i] = (UINT8)getNoise((int)i, count + 100);
+  }
+  UINT32 color0 = 0x12345678;
+  UINT32 color1 = 0x9ABCDEF0;
+
+  std::vector<UINT8> expected;
+  prepareDst(&expected, count, bytesPerPixel);
+  for (int i = 0; i < count; i++) {
+    bool set = (bits[i / 8] & (0x80 >> (i % 8))) != 0;
+    putPixel(&expected[i * bytesPerPixel], bytesPerPixel,
+             set ? color1 : color0);
+  }
+
+  std::vector<UINT8> dst;
+  prepareDst(&dst, count, bytesPerPixel);
+  RowKernels::expandMono(&dst.front(), bytesPerPixel, &bits.front(), count,
+                         color0, color1);
+  compare(&dst, &expected, count, bytesPerPixel, _T("expandMono()"));
+}
+
+void RowKernelsTest::checkPalette(int count, int bytesPerPixel)
+{
+  std::vector<UINT32> palette(256);
+  for (int i = 0; i < 256; i++) {
+    palette[i] = getNoise(i, 200);
+  }
+  std::vector<UINT8> indices(count);
+  for (int i = 0; i < count; i++) {
+    indices[i] = (UINT8)getNoise(i, count + 300);
+  }
+
+  std::vector<UINT8> expected;
+  prepareDst(&expected, count, bytesPerPixel);
+  for (int i = 0; i < count; i++) {
+    putPixel(&expected[i * bytesPerPixel], bytesPerPixel,
+             palette[indices[i]]);
+  }
+
+  std::vector<UINT8> dst;
+  prepareDst(&dst, count, bytesPerPixel);
+  RowKernels::expandPalette(&dst.front(), bytesPerPixel, &indices.front(),
+                            count, &palette.front());
+  compare(&dst, &expected, count, bytesPerPixel, _T("expandPalette()"));
+}
+
+void RowKernelsTest::checkRgb(int count, const PixelFormat *pf)
+{
+  int bytesPerPixel = pf->bitsPerPixel / 8;
+  std::vector<UINT8> src(count * 3);
+  for (int i = 0; i < count * 3; i++) {
+    src[i] = (UINT8)getNoise(i, count + 400);
+  }
+
+  std::vector<UINT8> expected;
+  prepareDst(&expected, count, bytesPerPixel);
+  for (int i = 0; i < count; i++) {
+    const UINT8 *p = &src[i * 3];
+    UINT32 pixel = (p[0] * pf->redMax + 127) / 255 << pf->redShift |
+                   (p[1] * pf->greenMax + 127) / 255 << pf->greenShift |
+                   (p[2] * pf->blueMax + 127) / 255 << pf->blueShift;
+    putPixel(&expected[i * bytesPerPixel], bytesPerPixel, pixel);
+  }
+
+  std::vector<UINT8> dst;
+  prepareDst(&dst, count, bytesPerPixel);
+  RowKernels::convertRgb(&dst.front(), &src.front(), count, pf);
+  compare(&dst, &expected, count, bytesPerPixel, _T("convertRgb()"));
+}
+
+void RowKernelsTest::checkGradient(int count, bool isCPixel,
+                                   const PixelFormat *pf)
+{
+  int bytesPerPixel = pf->bitsPerPixel / 8;
+  int srcBytesPerPixel = isCPixel ? 3 : bytesPerPixel;
+  const UINT16 max[3] = { pf->redMax, pf->greenMax, pf->blueMax };
+  const UINT16 shift[3] = { pf->redShift, pf->greenShift, pf->blueShift };
+
+  // Color components of the reconstructed rectangle, computed the way the
+  // Tight protocol describes the filter.
+  std::vector<UINT16> components(count * GRADIENT_ROWS * 3);
+  std::vector<UINT8> src(count * GRADIENT_ROWS * srcBytesPerPixel);
+  for (size_t i = 0; i < src.size(); i++) {
+    src[i] = (UINT8)getNoise((int)i, count + 500);
+  }
+  for (int y = 0; y < GRADIENT_ROWS; y++) {
+    for (int x = 0; x < count; x++) {
+      const UINT8 *p = &src[(y * count + x) * srcBytesPerPixel];
+      UINT32 raw = isCPixel ? p[0] << 16 | p[1] << 8 | p[2] :
+                              getPixel(p, bytesPerPixel);
+      for (int k = 0; k < 3; k++) {
+        int left = x > 0 ? components[(y * count + x - 1) * 3 + k] : 0;
+        int up = y > 0 ? components[((y - 1) * count + x) * 3 + k] : 0;
+        int upLeft = x > 0 && y > 0 ?
+                     components[((y - 1) * count + x - 1) * 3 + k] : 0;
+        int predicted = std::min(std::max(left + up - upLeft, 0),
+                                 (int)max[k]);
+        components[(y * count + x) * 3 + k] =
+          (UINT16)((predicted + (raw >> shift[k] & max[k])) & max[k]);
+      }
+    }
+  }
+
+  std::vector<UINT16> prevRow(count * 3 + 3, 0);
+  std::vector<UINT16> thisRow(count * 3 + 3, 0);
+  for (int y = 0; y < GRADIENT_ROWS; y++) {
+    std::vector<UINT8> expected;
+    prepareDst(&expected, count, bytesPerPixel);
+    for (int x = 0; x < count; x++) {
+      const UINT16 *c = &components[(y * count + x) * 3];
+      putPixel(&expected[x * bytesPerPixel], bytesPerPixel,
+               c[0] << shift[0] | c[1] << shift[1] | c[2] << shift[2]);
+    }
+
+    std::vector<UINT8> dst;
+    prepareDst(&dst, count, bytesPerPixel);
+    RowKernels::reconstructGradient(&dst.front(),
+                                    &src[y * count * srcBytesPerPixel],
+                                    count, isCPixel, pf,
+                                    &prevRow.front(), &thisRow.front());
+    compare(&dst, &expected, count, bytesPerPixel,
+            isCPixel ? _T("reconstructGradient(), CPIXELs") :
+                       _T("reconstructGradient()"));
+    prevRow.swap(thisRow);
+  }
+}
+
+void RowKernelsTest::prepareDst(std::vector<UINT8> *dst, int count,
+                                int bytesPerPixel)
+{
+  dst->assign(count * bytesPerPixel + GUARD_SIZE, (UINT8)GUARD_BYTE);
+}
+
+void RowKernelsTest::compare(const std::vector<UINT8> *dst,
+                             const std::vector<UINT8> *expected,
+                             int count, int bytesPerPixel, const TCHAR *what)
+{
+  if (*dst != *expected) {
+    StringStorage errMess;
+    errMess.format(_T("%s: a row of %d %d-bit pixels differs from the")
+                   _T(" expected one"), what, count, bytesPerPixel * 8);
+    throw Exception(errMess.getString());
+  }
+}
+
+void RowKernelsTest::putPixel(UINT8 *dst, int bytesPerPixel, UINT32 pixel)
+{
+  switch (bytesPerPixel) {
+  case 1:
+    *dst = (UINT8)pixel;
+    break;
+  case 2:
+    {
+      UINT16 value = (UINT16)pixel;
+      memcpy(dst, &value, sizeof(value));
+    }
+    break;
+  default:
+    memcpy(dst, &pixel, sizeof(pixel));
+    break;
+  }
+}
+
+UINT32 RowKernelsTest::getPixel(const UINT8 *src, int bytesPerPixel)
+{
+  switch (bytesPerPixel) {
+  case 1:
+    return *src;
+  case 2:
+    {
+      UINT16 value;
+      memcpy(&value, src, sizeof(value));
+      return value;
+    }
+  default:
+    {
+      UINT32 value;
+      memcpy(&value, src, sizeof(value));
+      return value;
+    }
+  }
+}
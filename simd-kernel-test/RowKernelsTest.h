@@ -0,0 +1,75 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _ROW_KERNELS_TEST_H_
+#define _ROW_KERNELS_TEST_H_
+
+#include "rfb/PixelFormat.h"
+#include "util/inttypes.h"
+
+#include <vector>
+
+//
+// Checks the RowKernels used to draw Tight rectangles (CPIXEL expansion,
+// two-color and palette rectangles, JPEG output conversion and the gradient
+// filter) against per-pixel formulas. Rows are 1 to 17 pixels wide, and a
+// few are wider, so both the vector loops and the loops over the remaining
+// pixels are run. The pixels after each row must stay untouched.
+//
+class RowKernelsTest
+{
+public:
+  RowKernelsTest();
+  virtual ~RowKernelsTest();
+
+  // Throws Exception if a check fails.
+  void run();
+
+private:
+  void checkCPixels(int count, bool reverseOrder);
+  void checkMono(int count, int bytesPerPixel);
+  void checkPalette(int count, int bytesPerPixel);
+  void checkRgb(int count, const PixelFormat *pf);
+  // Reconstructs a gradient filtered rectangle of `count' x GRADIENT_ROWS
+  // pixels row by row.
+  void checkGradient(int count, bool isCPixel, const PixelFormat *pf);
+
+  // Fills `dst' with GUARD_BYTE and allocates it to hold `count' pixels of
+  // `bytesPerPixel' bytes and GUARD_SIZE more bytes.
+  static void prepareDst(std::vector<UINT8> *dst, int count,
+                         int bytesPerPixel);
+  // Throws Exception if the `count' pixels in `dst' differ from `expected'
+  // or the bytes after them have been changed.
+  static void compare(const std::vector<UINT8> *dst,
+                      const std::vector<UINT8> *expected,
+                      int count, int bytesPerPixel, const TCHAR *what);
+  static void putPixel(UINT8 *dst, int bytesPerPixel, UINT32 pixel);
+  static UINT32 getPixel(const UINT8 *src, int bytesPerPixel);
+
+  static const int GUARD_SIZE = 16;
+  static const UINT8 GUARD_BYTE = 0xA5;
+  static const int GRADIENT_ROWS = 3;
+};
+
+#endif
@@ -0,0 +1,70 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "DirtyBlockDetectorTest.h"
+#include "PixelRowConverterTest.h"
+#include "RowKernelsTest.h"
+#include "util/CpuFeatures.h"
+#include "util/Exception.h"
+#include <stdio.h>
+
+// Instruction set levels that select different kernels.
+static const CpuFeatures::Level LEVELS[] = {
+  CpuFeatures::SCALAR,
+  CpuFeatures::SSE2,
+  CpuFeatures::SSSE3,
+  CpuFeatures::AVX2
+};
+static const TCHAR *LEVEL_NAMES[] = {
+  _T("scalar"),
+  _T("SSE2"),
+  _T("SSSE3"),
+  _T("AVX2")
+};
+
+int _tmain(int argc, TCHAR *argv[])
+{
+  for (size_t i = 0; i < sizeof(LEVELS) / sizeof(LEVELS[0]); i++) {
+    CpuFeatures::setMaxLevel(LEVELS[i]);
+    if (CpuFeatures::getMaxLevel() != LEVELS[i]) {
+      _tprintf(_T("Skipped %s: not supported by the processor\n"),
+               LEVEL_NAMES[i]);
+      continue;
+    }
+    try {
+      DirtyBlockDetectorTest dirtyBlockDetectorTest;
+      dirtyBlockDetectorTest.run();
+      PixelRowConverterTest pixelRowConverterTest;
+      pixelRowConverterTest.run();
+      RowKernelsTest rowKernelsTest;
+      rowKernelsTest.run();
+    } catch (Exception &e) {
+      _ftprintf(stderr, _T("Error (%s): %s\n"), LEVEL_NAMES[i],
+                e.getMessage());
+      return 1;
+    }
+    _tprintf(_T("Passed %s\n"), LEVEL_NAMES[i]);
+  }
+  return 0;
+}
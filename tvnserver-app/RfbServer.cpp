@@ -51,6 +51,26 @@ RfbServer::RfbServer(const TCHAR *bindHost, unsigned short bindPort, bool useSsl
 
 RfbServer::~RfbServer()
 {
+  // No connections must be accepted while this object is being destroyed.
+  stop();
+
+  SslHandshakeStats stats;
+  if (getSslHandshakeStats(&stats)) {
+    m_log->message(_T("Rfb server at %s:%d accepted %d SSL connections")
+                   _T(" (%.2f per second): %d succeeded (%d resumed),")
+                   _T(" %d failed, %d timed out, %d dropped"),
+                   getBindHost(), (int)getBindPort(), (int)stats.accepted,
+                   stats.getAcceptRate(), (int)stats.succeeded,
+                   (int)stats.resumed, (int)stats.failed, (int)stats.timedOut, (int)stats.dropped);
+    m_log->message(_T("SSL handshake latency: <10 ms: %d, <50 ms: %d,")
+                   _T(" <200 ms: %d, <1 s: %d, <5 s: %d, longer: %d"),
+                   (int)stats.latencyHistogram[0],
+                   (int)stats.latencyHistogram[1],
+                   (int)stats.latencyHistogram[2],
+                   (int)stats.latencyHistogram[3],
+                   (int)stats.latencyHistogram[4],
+                   (int)stats.latencyHistogram[5]);
+  }
   m_log->message(_T("Rfb server at %s:%d stopped"), getBindHost(), (int)getBindPort());
 }
 
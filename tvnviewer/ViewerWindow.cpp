@@ -179,6 +179,7 @@ bool ViewerWindow::viewerCoreSettings()
 
   m_viewerCore->allowCopyRect(m_conConf->isCopyRectAllowed());
   m_viewerCore->setPreferredEncoding(m_conConf->getPreferredEncoding());
+  m_viewerCore->pipelineUpdateRequests(m_conConf->isPipeliningUpdates());
 
   m_viewerCore->ignoreCursorShapeUpdates(m_conConf->isIgnoringShapeUpdates());
   m_viewerCore->enableCursorShapeUpdates(m_conConf->isRequestingShapeUpdates());
@@ -0,0 +1,357 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "UpdateLatencyTest.h"
+
+#include "fb-update-sender/UpdateSender.h"
+#include "log-writer/LogWriter.h"
+#include "network/socket/SocketIPv4.h"
+#include "network/socket/SocketStream.h"
+#include "rfb-sconn/CapContainer.h"
+#include "rfb-sconn/EncoderSelector.h"
+#include "rfb-sconn/RfbCodeRegistrator.h"
+#include "rfb-sconn/RfbDispatcher.h"
+#include "rfb/CursorShape.h"
+#include "rfb/EncodingDefs.h"
+#include "rfb/MsgDefs.h"
+#include "rfb/StandardPixelFormatFactory.h"
+#include "server-config-lib/Configurator.h"
+#include "thread/AutoLock.h"
+#include "util/Exception.h"
+
+#include <algorithm>
+#include <stdio.h>
+
+UpdateLatencyTest::UpdateLatencyTest()
+{
+  Dimension fbDim(FB_WIDTH, FB_HEIGHT);
+  PixelFormat pf = StandardPixelFormatFactory::create32bppPixelFormat();
+  m_frameBuffer.setProperties(&fbDim, &pf);
+  m_frameBuffer.setColor(255, 255, 255);
+}
+
+UpdateLatencyTest::~UpdateLatencyTest()
+{
+}
+
+void UpdateLatencyTest::run()
+{
+  // UpdateSender reads the encoding settings from the server
+  // configuration. The defaults encode all the rectangles in the sender
+  // thread by the encoder the client prefers.
+  Configurator configurator(false);
+  ServerConfig *config = configurator.getServerConfig();
+  config->setEncodingThreads(1);
+  config->setAdaptiveEncodingFlag(false);
+  config->setEncodingCacheFlag(false);
+
+  LogWriter log(0);
+
+  SocketIPv4 listener(false);
+  listener.bind(_T("127.0.0.1"), PORT);
+  listener.listen(1);
+  SocketIPv4 client(false);
+  client.connect(_T("127.0.0.1"), PORT);
+  SocketIPv4 *serverSocket = listener.accept();
+  serverSocket->enableNaggleAlgorithm(false);
+  client.enableNaggleAlgorithm(false);
+
+  Latency medians[2];
+  {
+    // The server side, wired like RfbClient does it.
+    SocketStream serverStream(serverSocket);
+    RfbOutputGate serverOutput(&serverStream);
+    RfbInputGate serverInput(&serverStream);
+    WindowsEvent connClosingEvent;
+    RfbDispatcher dispatcher(&serverInput, &connClosingEvent);
+    CapContainer srvToClCaps, clToSrvCaps, encCaps;
+    RfbCodeRegistrator codeRegtor(&dispatcher, &srvToClCaps, &clToSrvCaps,
+                                  &encCaps);
+    UpdateSender *updateSender = new UpdateSender(&codeRegtor, this, this,
+                                                  &serverOutput, 0, this,
+                                                  &log);
+    Dimension fbDim(FB_WIDTH, FB_HEIGHT);
+    PixelFormat pf = m_frameBuffer.getPixelFormat();
+    updateSender->init(&fbDim, &pf);
+    dispatcher.resume();
+
+    SocketStream clientStream(&client);
+    RfbOutputGate clientOutput(&clientStream);
+    DataInputStream clientInput(&clientStream);
+    CursorShape cursorShape;
+
+    try {
+      int frame = 0;
+      for (int mode = 0; mode < 2; mode++) {
+        bool lastRect = mode == 1;
+        sendSetEncodings(&clientOutput, lastRect);
+
+        std::vector<UINT64> firstRectTimes, wholeUpdateTimes;
+        for (int i = -WARM_UP_COUNT; i < FRAME_COUNT; i++, frame++) {
+          UpdateContainer updCont;
+          drawFrame(frame, &updCont.changedRegion);
+          updateSender->newUpdates(&updCont, &cursorShape);
+
+          UINT64 requestTime = EncoderSelector::getMicroseconds();
+          sendUpdateRequest(&clientOutput);
+          Latency latency;
+          readUpdate(&clientInput, lastRect,
+                     i < 0 ? 0 : updCont.changedRegion.getCount(),
+                     requestTime, &latency);
+          if (i >= 0) {
+            firstRectTimes.push_back(latency.firstRect);
+            wholeUpdateTimes.push_back(latency.wholeUpdate);
+          }
+        }
+        medians[mode].firstRect = getMedian(&firstRectTimes);
+        medians[mode].wholeUpdate = getMedian(&wholeUpdateTimes);
+        _tprintf(_T("%s updates: the first rectangle in %u us, the whole")
+                 _T(" update in %u us (medians of %d updates)\n"),
+                 lastRect ? _T("LastRect") : _T("Counted"),
+                 (unsigned int)medians[mode].firstRect,
+                 (unsigned int)medians[mode].wholeUpdate, FRAME_COUNT);
+      }
+    } catch (...) {
+      delete updateSender;
+      client.shutdown(SD_BOTH);
+      serverSocket->shutdown(SD_BOTH);
+      throw;
+    }
+
+    delete updateSender;
+    // Lets the dispatcher thread leave its blocking read.
+    client.shutdown(SD_BOTH);
+    serverSocket->shutdown(SD_BOTH);
+  }
+  delete serverSocket;
+
+  if (medians[1].firstRect >= medians[0].firstRect) {
+    throw Exception(_T("Streamed updates do not deliver the first rectangle")
+                    _T(" earlier than counted updates"));
+  }
+}
+
+void UpdateLatencyTest::drawFrame(int frame, Region *changedRegion)
+{
+  AutoLock al(&m_frameBufferMutex);
+  // Dark dots on a light background change from frame to frame, so the
+  // data is not trivial for ZRLE but compresses like a desktop does.
+  UINT32 seed = frame * 2654435761U;
+  for (int top = 0; top < FB_HEIGHT; top += BAND_HEIGHT + BAND_GAP) {
+    Rect band(0, top, FB_WIDTH, min(top + BAND_HEIGHT, (int)FB_HEIGHT));
+    for (int y = band.top; y < band.bottom; y++) {
+      UINT32 *row = (UINT32 *)m_frameBuffer.getBufferPtr(0, y);
+      for (int x = 0; x < FB_WIDTH; x++) {
+        seed = seed * 1664525 + 1013904223;
+        row[x] = (seed >> 28) == 0 ? seed >> 8 & 0x3f3f3f : 0xf0f0f0;
+      }
+    }
+    changedRegion->addRect(&band);
+  }
+}
+
+void UpdateLatencyTest::sendSetEncodings(RfbOutputGate *output, bool lastRect)
+{
+  output->writeUInt8(ClientMsgDefs::SET_ENCODINGS);
+  output->writeUInt8(0); // padding
+  output->writeUInt16(lastRect ? 2 : 1);
+  output->writeInt32(EncodingDefs::ZRLE);
+  if (lastRect) {
+    output->writeInt32(PseudoEncDefs::LAST_RECT);
+  }
+  output->flush();
+}
+
+void UpdateLatencyTest::sendUpdateRequest(RfbOutputGate *output)
+{
+  output->writeUInt8(ClientMsgDefs::FB_UPDATE_REQUEST);
+  output->writeUInt8(1); // incremental
+  output->writeUInt16(0);
+  output->writeUInt16(0);
+  output->writeUInt16(FB_WIDTH);
+  output->writeUInt16(FB_HEIGHT);
+  output->flush();
+}
+
+void UpdateLatencyTest::readUpdate(DataInputStream *input, bool lastRect,
+                                   size_t expectedRects, UINT64 requestTime,
+                                   Latency *latency)
+{
+  if (input->readUInt8() != ServerMsgDefs::FB_UPDATE) {
+    throw Exception(_T("A message other than FramebufferUpdate has been")
+                    _T(" received"));
+  }
+  input->readUInt8(); // padding
+  UINT16 numRects = input->readUInt16();
+  if (expectedRects != 0 && (numRects == 0xffff) != lastRect) {
+    throw Exception(lastRect ?
+                    _T("The number of rectangles has been sent to a client")
+                    _T(" supporting LastRect") :
+                    _T("LastRect has been used for a client not supporting")
+                    _T(" it"));
+  }
+
+  size_t rectCount = 0;
+  latency->firstRect = 0;
+  for (;;) {
+    if (numRects != 0xffff && rectCount == numRects) {
+      break;
+    }
+    input->readUInt16(); // x
+    input->readUInt16(); // y
+    input->readUInt16(); // width
+    input->readUInt16(); // height
+    INT32 encodingType = input->readInt32();
+    if (encodingType == PseudoEncDefs::LAST_RECT) {
+      break;
+    }
+    if (encodingType != EncodingDefs::ZRLE) {
+      StringStorage errMess;
+      errMess.format(_T("Unexpected encoding %d"), (int)encodingType);
+      throw Exception(errMess.getString());
+    }
+    if (rectCount == 0) {
+      latency->firstRect = EncoderSelector::getMicroseconds() - requestTime;
+    }
+    UINT32 length = input->readUInt32();
+    m_rectData.resize(max(length, (UINT32)1));
+    input->readFully(&m_rectData.front(), length);
+    rectCount++;
+  }
+  latency->wholeUpdate = EncoderSelector::getMicroseconds() - requestTime;
+
+  if (expectedRects != 0 && rectCount != expectedRects) {
+    StringStorage errMess;
+    errMess.format(_T("%u rectangles have been received instead of %u"),
+                   (unsigned int)rectCount, (unsigned int)expectedRects);
+    throw Exception(errMess.getString());
+  }
+}
+
+UINT64 UpdateLatencyTest::getMedian(std::vector<UINT64> *values)
+{
+  std::sort(values->begin(), values->end());
+  return (*values)[values->size() / 2];
+}
+
+void UpdateLatencyTest::getCurrentUserInfo(StringStorage *desktopName,
+                                           StringStorage *userName)
+{
+}
+
+void UpdateLatencyTest::getFrameBufferProperties(Dimension *dim,
+                                                 PixelFormat *pf)
+{
+  AutoLock al(&m_frameBufferMutex);
+  *dim = m_frameBuffer.getDimension();
+  *pf = m_frameBuffer.getPixelFormat();
+}
+
+void UpdateLatencyTest::getPrimaryDesktopCoords(Rect *rect)
+{
+}
+
+void UpdateLatencyTest::getNormalizedRect(Rect *rect)
+{
+}
+
+void UpdateLatencyTest::getDisplayNumberCoords(Rect *rect,
+                                               unsigned char dispNumber)
+{
+}
+
+void UpdateLatencyTest::getWindowCoords(HWND hwnd, Rect *rect)
+{
+}
+
+HWND UpdateLatencyTest::getWindowHandleByName(const StringStorage *windowName)
+{
+  return 0;
+}
+
+void UpdateLatencyTest::getApplicationRegion(unsigned int procId,
+                                             Region *region)
+{
+}
+
+bool UpdateLatencyTest::isApplicationInFocus(unsigned int procId)
+{
+  return false;
+}
+
+void UpdateLatencyTest::setKeyboardEvent(UINT32 keySym, bool down)
+{
+}
+
+void UpdateLatencyTest::setMouseEvent(UINT16 x, UINT16 y, UINT8 buttonMask)
+{
+}
+
+void UpdateLatencyTest::setNewClipText(const StringStorage *newClipboard)
+{
+}
+
+bool UpdateLatencyTest::updateExternalFrameBuffer(FrameBuffer *fb,
+                                                  const Region *region,
+                                                  const Rect *viewPort)
+{
+  // The same as UpdateHandler::updateExternalFrameBuffer() does.
+  AutoLock al(&m_frameBufferMutex);
+  PixelFormat pf = m_frameBuffer.getPixelFormat();
+  Rect fbRect = m_frameBuffer.getDimension().getRect();
+  Rect resultViewPort = fbRect.intersection(viewPort);
+  PixelFormat dstPf = fb->getPixelFormat();
+  if (!dstPf.isEqualTo(&pf) ||
+      !fb->getDimension().isEqualTo(&Dimension(&resultViewPort)) ||
+      !resultViewPort.isEqualTo(viewPort)) {
+    fb->setProperties(&resultViewPort, &pf);
+    return false;
+  }
+
+  std::vector<Rect> rects;
+  region->getRectVector(&rects);
+  for (std::vector<Rect>::iterator iRect = rects.begin();
+       iRect < rects.end(); iRect++) {
+    fb->copyFrom(&(*iRect), &m_frameBuffer,
+                 iRect->left + viewPort->left, iRect->top + viewPort->top);
+  }
+  return true;
+}
+
+void UpdateLatencyTest::onUpdateRequest(const Rect *rectRequested,
+                                        bool incremental)
+{
+}
+
+void UpdateLatencyTest::onGetViewPort(Rect *viewRect, bool *shareApp,
+                                      Region *shareAppRegion)
+{
+  *viewRect = Rect(FB_WIDTH, FB_HEIGHT);
+  *shareApp = false;
+  shareAppRegion->clear();
+}
+
+void UpdateLatencyTest::onUpdateStatistics(double frameRate, UINT64 bandwidth)
+{
+}
@@ -0,0 +1,132 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _UPDATE_LATENCY_TEST_H_
+#define _UPDATE_LATENCY_TEST_H_
+
+#include "desktop/Desktop.h"
+#include "fb-update-sender/SenderControlInformationInterface.h"
+#include "io-lib/DataInputStream.h"
+#include "network/RfbOutputGate.h"
+#include "thread/LocalMutex.h"
+
+#include <vector>
+
+//
+// Measures on a loopback connection how long a client waits after its
+// update request for the first rectangle and for the whole FramebufferUpdate
+// message. UpdateSender sends counted updates to the client first, then the
+// client enables LastRect and gets streamed updates. Each update changes
+// bands across the whole frame buffer, and the bands are encoded by ZRLE.
+//
+// The test plays the desktop for UpdateSender: it owns the frame buffer
+// and passes the changes to UpdateSender::newUpdates() itself.
+//
+class UpdateLatencyTest : public Desktop,
+                          public SenderControlInformationInterface
+{
+public:
+  UpdateLatencyTest();
+  virtual ~UpdateLatencyTest();
+
+  // Prints the median latencies of both modes. Throws Exception if an
+  // update is malformed or if streaming does not deliver the first
+  // rectangle earlier than counted updates do.
+  void run();
+
+  // Desktop. UpdateSender only uses the frame buffer, the other functions
+  // do nothing.
+  virtual void getCurrentUserInfo(StringStorage *desktopName,
+                                  StringStorage *userName);
+  virtual void getFrameBufferProperties(Dimension *dim, PixelFormat *pf);
+  virtual void getPrimaryDesktopCoords(Rect *rect);
+  virtual void getNormalizedRect(Rect *rect);
+  virtual void getDisplayNumberCoords(Rect *rect,
+                                      unsigned char dispNumber);
+  virtual void getWindowCoords(HWND hwnd, Rect *rect);
+  virtual HWND getWindowHandleByName(const StringStorage *windowName);
+  virtual void getApplicationRegion(unsigned int procId, Region *region);
+  virtual bool isApplicationInFocus(unsigned int procId);
+  virtual void setKeyboardEvent(UINT32 keySym, bool down);
+  virtual void setMouseEvent(UINT16 x, UINT16 y, UINT8 buttonMask);
+  virtual void setNewClipText(const StringStorage *newClipboard);
+  virtual bool updateExternalFrameBuffer(FrameBuffer *fb, const Region *region,
+                                         const Rect *viewPort);
+
+  // UpdateRequestListener, does nothing.
+  virtual void onUpdateRequest(const Rect *rectRequested, bool incremental);
+
+  // SenderControlInformationInterface. The view port is the whole frame
+  // buffer.
+  virtual void onGetViewPort(Rect *viewRect, bool *shareApp,
+                             Region *shareAppRegion);
+  virtual void onUpdateStatistics(double frameRate, UINT64 bandwidth);
+
+private:
+  // Latencies of one update, in microseconds.
+  struct Latency
+  {
+    UINT64 firstRect;
+    UINT64 wholeUpdate;
+  };
+
+  // Changes the bands of the frame buffer for frame number `frame' and
+  // returns the changed region.
+  void drawFrame(int frame, Region *changedRegion);
+
+  void sendSetEncodings(RfbOutputGate *output, bool lastRect);
+  void sendUpdateRequest(RfbOutputGate *output);
+
+  // Reads a FramebufferUpdate message with `expectedRects' rectangles.
+  // The latencies are counted from `requestTime'.
+  void readUpdate(DataInputStream *input, bool lastRect,
+                  size_t expectedRects, UINT64 requestTime,
+                  Latency *latency);
+
+  static UINT64 getMedian(std::vector<UINT64> *values);
+
+  FrameBuffer m_frameBuffer;
+  LocalMutex m_frameBufferMutex;
+
+  // Scratch buffer for the skipped rectangle data.
+  std::vector<UINT8> m_rectData;
+
+  static const unsigned short PORT = 15902;
+
+  static const int FB_WIDTH = 1920;
+  static const int FB_HEIGHT = 1080;
+  // Each update changes bands of BAND_HEIGHT rows separated by BAND_GAP
+  // rows, so the region is a list of rectangles rather than one rectangle.
+  static const int BAND_HEIGHT = 32;
+  static const int BAND_GAP = 8;
+
+  // Updates sent in each mode before the measured ones. The first two
+  // updates of the connection cover the whole frame buffer, and the first
+  // ones after SetEncodings may still use the previous options.
+  static const int WARM_UP_COUNT = 2;
+  // Updates measured in each mode.
+  static const int FRAME_COUNT = 20;
+};
+
+#endif
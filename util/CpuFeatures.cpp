@@ -0,0 +1,112 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "CpuFeatures.h"
+
+#include <intrin.h>
+#include <immintrin.h>
+
+volatile bool CpuFeatures::m_detected = false;
+bool CpuFeatures::m_sse2 = false;
+bool CpuFeatures::m_ssse3 = false;
+bool CpuFeatures::m_sse41 = false;
+bool CpuFeatures::m_avx2 = false;
+CpuFeatures::Level CpuFeatures::m_maxLevel = CpuFeatures::AVX2;
+
+bool CpuFeatures::hasSse2()
+{
+  detect();
+  return m_sse2 && m_maxLevel >= SSE2;
+}
+
+bool CpuFeatures::hasSsse3()
+{
+  detect();
+  return m_ssse3 && m_maxLevel >= SSSE3;
+}
+
+bool CpuFeatures::hasSse41()
+{
+  detect();
+  return m_sse41 && m_maxLevel >= SSE41;
+}
+
+bool CpuFeatures::hasAvx2()
+{
+  detect();
+  return m_avx2 && m_maxLevel >= AVX2;
+}
+
+CpuFeatures::Level CpuFeatures::getMaxLevel()
+{
+  if (hasAvx2() && hasSse41() && hasSsse3() && hasSse2()) {
+    return AVX2;
+  } else if (hasSse41() && hasSsse3() && hasSse2()) {
+    return SSE41;
+  } else if (hasSsse3() && hasSse2()) {
+    return SSSE3;
+  } else if (hasSse2()) {
+    return SSE2;
+  }
+  return SCALAR;
+}
+
+void CpuFeatures::setMaxLevel(Level level)
+{
+  m_maxLevel = level;
+}
+
+void CpuFeatures::detect()
+{
+  // Detection gives the same results in any thread, so it's not a problem
+  // if two threads run it at the same time.
+  if (m_detected) {
+    return;
+  }
+
+  int info[4];
+  __cpuid(info, 0);
+  int maxLeaf = info[0];
+
+  if (maxLeaf >= 1) {
+    __cpuid(info, 1);
+    m_sse2 = (info[3] & (1 << 26)) != 0;
+    m_ssse3 = (info[2] & (1 << 9)) != 0;
+    m_sse41 = (info[2] & (1 << 19)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    if (maxLeaf >= 7 && osxsave && avx) {
+      // Check that the OS has enabled saving of XMM and YMM state.
+      unsigned long long xcr0 = _xgetbv(0);
+      if ((xcr0 & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        m_avx2 = (info[1] & (1 << 5)) != 0;
+      }
+    }
+  }
+
+  m_detected = true;
+}
@@ -0,0 +1,76 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef __CPUFEATURES_H__
+#define __CPUFEATURES_H__
+
+// CpuFeatures reports which SIMD instruction sets may be used on the current
+// processor. The features are detected once, on the first call of any of
+// the functions. Code using the instruction sets must be compiled in any
+// case, so callers select an implementation at run time and keep a plain C++
+// version as a fallback.
+class CpuFeatures
+{
+public:
+  // Instruction set levels, each of which includes the ones before it.
+  enum Level
+  {
+    SCALAR,
+    SSE2,
+    SSSE3,
+    SSE41,
+    AVX2
+  };
+
+  static bool hasSse2();
+  static bool hasSsse3();
+  static bool hasSse41();
+  // Returns true only if both the processor and the operating system
+  // support AVX2 (i.e. the OS saves YMM registers on context switches).
+  static bool hasAvx2();
+
+  // Returns the highest level that the processor supports and that is
+  // allowed by setMaxLevel().
+  static Level getMaxLevel();
+
+  // Makes the functions above report no instruction sets beyond `level',
+  // even if the processor supports them. Tests use it to run every
+  // implementation of a kernel on one machine. Objects that select their
+  // kernels when created or initialized must be set up after the call.
+  static void setMaxLevel(Level level);
+
+private:
+  static void detect();
+
+  static Level m_maxLevel;
+
+  static volatile bool m_detected;
+  static bool m_sse2;
+  static bool m_ssse3;
+  static bool m_sse41;
+  static bool m_avx2;
+};
+
+#endif // __CPUFEATURES_H__
@@ -70,7 +70,61 @@ void Inflater::inflate()
   m_zlibStream.avail_out = (unsigned int)avaliableOutput;
 
   int r = ::inflate(&m_zlibStream, Z_SYNC_FLUSH);
+  checkResult(r);
+  if (m_zlibStream.avail_in != 0) {
+    throw ZLibException(_T("Not enough buffer size for data decompression"));
+  }
+
+  m_outputSize = m_zlibStream.total_out - prevTotalOut;
+}
 
+size_t Inflater::inflate(char *output, size_t size)
+{
+  unsigned long prevTotalOut = m_zlibStream.total_out;
+
+  // Check to overflow.
+  unsigned int constrainedValue = (unsigned int)size;
+  _ASSERT(size == constrainedValue);
+  constrainedValue = (unsigned int)m_inputSize;
+  _ASSERT(m_inputSize == constrainedValue);
+
+  m_zlibStream.next_in = (Bytef *)m_input;
+  m_zlibStream.avail_in = (unsigned int)m_inputSize;
+
+  m_zlibStream.next_out = (Bytef *)output;
+  m_zlibStream.avail_out = (unsigned int)size;
+
+  checkResult(::inflate(&m_zlibStream, Z_SYNC_FLUSH));
+
+  // When the output is filled exactly, zlib may stop before it has
+  // consumed the empty block closing the flushed data. Such a remainder
+  // must not produce any output.
+  if (m_zlibStream.avail_in != 0 && m_zlibStream.avail_out == 0) {
+    char spare[16];
+    m_zlibStream.next_out = (Bytef *)spare;
+    m_zlibStream.avail_out = sizeof(spare);
+    checkResult(::inflate(&m_zlibStream, Z_SYNC_FLUSH));
+    if (m_zlibStream.avail_out != sizeof(spare)) {
+      throw ZLibException(_T("Not enough buffer size for data decompression"));
+    }
+  }
+  if (m_zlibStream.avail_in != 0) {
+    throw ZLibException(_T("Not enough buffer size for data decompression"));
+  }
+
+  m_outputSize = m_zlibStream.total_out - prevTotalOut;
+  return m_outputSize;
+}
+
+void Inflater::reset()
+{
+  if (inflateReset(&m_zlibStream) != Z_OK) {
+    throw ZLibException(_T("ZLib stream error"));
+  }
+}
+
+void Inflater::checkResult(int r)
+{
   if (r == Z_STREAM_END) {
     throw ZLibException(_T("ZLib stream end"));
   }
@@ -86,9 +140,4 @@ void Inflater::inflate()
   if (r == Z_DATA_ERROR) {
     throw ZLibException(_T("Zlib data error"));
   }
-  if (m_zlibStream.avail_in != 0) {
-    throw ZLibException(_T("Not enough buffer size for data decompression"));
-  }
-
-  m_outputSize = m_zlibStream.total_out - prevTotalOut;
 }
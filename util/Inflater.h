@@ -42,7 +42,26 @@ public:
 
   void inflate() throw(ZLibException);
 
+  //
+  // Inflates the input given by setInput() right into the output buffer
+  // which has room for size bytes, so no intermediate buffer is used.
+  // Returns the number of bytes written. Throws ZLibException if the
+  // output does not fit.
+  //
+  size_t inflate(char *output, size_t size) throw(ZLibException);
+
+  //
+  // Discards the state of the stream, so the next input starts a new
+  // stream. Memory allocated by zlib is kept for reuse.
+  //
+  void reset() throw(ZLibException);
+
 protected:
+  //
+  // Throws ZLibException if r is an error code of ::inflate().
+  //
+  void checkResult(int r) throw(ZLibException);
+
   z_stream m_zlibStream;
 
   //
@@ -0,0 +1,180 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "VideoRegionDetectorTest.h"
+
+#include "desktop/VideoRegionDetector.h"
+#include "util/Exception.h"
+
+// The recorded session. A 320x240 video plays at 30 frames per second, not
+// aligned to the tiles of the detector. At the same time the user types a
+// line of text at 8 characters per second, a clock in the corner changes
+// every second and a 32x32 icon is animated at 30 frames per second. After
+// the video a large menu fades in within 150 ms.
+static const UINT64 VIDEO_START = 500;
+static const UINT64 VIDEO_STOP = 3500;
+
+VideoRegionDetectorTest::VideoRegionDetectorTest()
+{
+}
+
+VideoRegionDetectorTest::~VideoRegionDetectorTest()
+{
+}
+
+void VideoRegionDetectorTest::run()
+{
+  const ChangeSource video =
+    { VIDEO_START, VIDEO_STOP, 33, 100, 90, 320, 240, 0, 1 };
+  const ChangeSource others[] = {
+    // Typing, with the caret.
+    { 0, SESSION_LENGTH, 125, 520, 400, 16, 16, 8, 80 },
+    // The clock.
+    { 0, SESSION_LENGTH, 1000, 1200, 700, 64, 16, 0, 1 },
+    // The icon.
+    { 0, SESSION_LENGTH, 33, 20, 20, 32, 32, 0, 1 },
+    // The menu.
+    { 5000, 5150, 16, 760, 40, 240, 320, 0, 1 }
+  };
+  const size_t otherCount = sizeof(others) / sizeof(others[0]);
+
+  VideoRegionDetector detector;
+  detector.setRateThreshold(RATE_THRESHOLD);
+  detector.setMinSize(MIN_SIZE);
+  Dimension fbDim(FB_WIDTH, FB_HEIGHT);
+  Rect videoRect = getBounds(&video);
+
+  int detectedCount = 0;
+  int heldCount = 0;
+  int droppedCount = 0;
+  for (UINT64 time = REQUEST_PERIOD; time <= SESSION_LENGTH;
+       time += REQUEST_PERIOD) {
+    Region changedRegion;
+    addChanges(&video, time - REQUEST_PERIOD, time, &changedRegion);
+    for (size_t i = 0; i < otherCount; i++) {
+      addChanges(&others[i], time - REQUEST_PERIOD, time, &changedRegion);
+    }
+    // The client gets no update, so the detector is not run, while
+    // nothing changes.
+    if (changedRegion.isEmpty()) {
+      continue;
+    }
+    detector.update(&changedRegion, &fbDim, time);
+
+    Region videoRegion;
+    detector.getVideoRegion(&videoRegion);
+    StringStorage errMess;
+    for (size_t i = 0; i < otherCount; i++) {
+      Rect otherRect = getBounds(&others[i]);
+      if (intersects(&videoRegion, &otherRect)) {
+        errMess.format(_T("At %u ms, changes at %dx%d+%d+%d have been")
+                       _T(" taken for video"), (unsigned int)time,
+                       otherRect.getWidth(), otherRect.getHeight(),
+                       otherRect.left, otherRect.top);
+        throw Exception(errMess.getString());
+      }
+    }
+
+    bool isDetected = contains(&videoRegion, &videoRect);
+    if (time < VIDEO_START && !videoRegion.isEmpty()) {
+      errMess.format(_T("At %u ms, a video region has been found before")
+                     _T(" the video started"), (unsigned int)time);
+      throw Exception(errMess.getString());
+    }
+    if (time >= VIDEO_START + DETECTION_TIME && time <= VIDEO_STOP) {
+      if (!isDetected) {
+        errMess.format(_T("At %u ms, the video has not been detected"),
+                       (unsigned int)time);
+        throw Exception(errMess.getString());
+      }
+      detectedCount++;
+    }
+    if (time > VIDEO_STOP && time <= VIDEO_STOP + HOLD_TIME) {
+      if (!isDetected) {
+        errMess.format(_T("At %u ms, the video region has been dropped")
+                       _T(" %u ms after the video stopped"),
+                       (unsigned int)time, (unsigned int)(time - VIDEO_STOP));
+        throw Exception(errMess.getString());
+      }
+      heldCount++;
+    }
+    if (time >= VIDEO_STOP + DROP_TIME) {
+      if (!videoRegion.isEmpty()) {
+        errMess.format(_T("At %u ms, the video region has been kept")
+                       _T(" %u ms after the video stopped"),
+                       (unsigned int)time, (unsigned int)(time - VIDEO_STOP));
+        throw Exception(errMess.getString());
+      }
+      droppedCount++;
+    }
+  }
+
+  if (detectedCount == 0 || heldCount == 0 || droppedCount == 0) {
+    throw Exception(_T("The session does not cover all the checks"));
+  }
+}
+
+void VideoRegionDetectorTest::addChanges(const ChangeSource *source,
+                                         UINT64 fromTime, UINT64 toTime,
+                                         Region *changedRegion)
+{
+  for (UINT64 time = source->startTime; time < source->stopTime;
+       time += source->period) {
+    if (time <= fromTime) {
+      continue;
+    }
+    if (time > toTime) {
+      break;
+    }
+    int step = (int)((time - source->startTime) / source->period) %
+               source->stepCount;
+    Rect rect(source->left + step * source->stepX, source->top,
+              source->left + step * source->stepX + source->width,
+              source->top + source->height);
+    changedRegion->addRect(&rect);
+  }
+}
+
+Rect VideoRegionDetectorTest::getBounds(const ChangeSource *source)
+{
+  return Rect(source->left, source->top,
+              source->left + (source->stepCount - 1) * source->stepX +
+              source->width,
+              source->top + source->height);
+}
+
+bool VideoRegionDetectorTest::contains(const Region *region, const Rect *rect)
+{
+  Region rectRegion(rect);
+  rectRegion.subtract(region);
+  return rectRegion.isEmpty();
+}
+
+bool VideoRegionDetectorTest::intersects(const Region *region,
+                                         const Rect *rect)
+{
+  Region rectRegion(rect);
+  rectRegion.intersect(region);
+  return !rectRegion.isEmpty();
+}
@@ -0,0 +1,94 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _VIDEO_REGION_DETECTOR_TEST_H_
+#define _VIDEO_REGION_DETECTOR_TEST_H_
+
+#include "region/Region.h"
+#include "util/inttypes.h"
+
+//
+// Replays a recorded sequence of frame buffer changes through
+// VideoRegionDetector the way UpdateHandlerImpl feeds it: changes pile up
+// between update requests of a client, and each request hands them to the
+// detector at once. Checks that a video player is detected, that typing, a
+// clock, a small animated icon and a short menu animation are not, and that
+// the video area is dropped some time after the video stops.
+//
+class VideoRegionDetectorTest
+{
+public:
+  VideoRegionDetectorTest();
+  virtual ~VideoRegionDetectorTest();
+
+  // Throws Exception if a check fails.
+  void run();
+
+private:
+  // A source of changes in the recorded session. From `startTime' till
+  // `stopTime' it changes a `width' x `height' rectangle every `period'
+  // milliseconds. Each change moves the rectangle `stepX' pixels to the
+  // right, and it returns to `left' after `stepCount' changes.
+  struct ChangeSource
+  {
+    UINT64 startTime;
+    UINT64 stopTime;
+    unsigned int period;
+    int left;
+    int top;
+    int width;
+    int height;
+    int stepX;
+    int stepCount;
+  };
+
+  // Adds to `changedRegion' the changes `source' made after `fromTime' and
+  // no later than `toTime'.
+  static void addChanges(const ChangeSource *source, UINT64 fromTime,
+                         UINT64 toTime, Region *changedRegion);
+  // Returns the bounds of all the changes of `source'.
+  static Rect getBounds(const ChangeSource *source);
+
+  static bool contains(const Region *region, const Rect *rect);
+  static bool intersects(const Region *region, const Rect *rect);
+
+  static const int FB_WIDTH = 1280;
+  static const int FB_HEIGHT = 720;
+  // Interval between update requests of the client.
+  static const unsigned int REQUEST_PERIOD = 20;
+  static const UINT64 SESSION_LENGTH = 7000;
+
+  // The detector settings, the defaults of ServerConfig.
+  static const unsigned int RATE_THRESHOLD = 10;
+  static const unsigned int MIN_SIZE = 128;
+
+  // Time given to the detector to find the video after it starts.
+  static const unsigned int DETECTION_TIME = 1000;
+  // The video area must be kept during this time after the video stops,
+  // and be dropped after DROP_TIME.
+  static const unsigned int HOLD_TIME = 1500;
+  static const unsigned int DROP_TIME = 2500;
+};
+
+#endif
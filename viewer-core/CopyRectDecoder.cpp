@@ -36,17 +36,12 @@ CopyRectDecoder::~CopyRectDecoder()
 
 void CopyRectDecoder::decode(RfbInputGate *input,
                              FrameBuffer *frameBuffer,
-                             const Rect *dstRect)
+                             const Rect *dstRect,
+                             LocalMutex *fbLock)
 {
   m_sourcePosition.x = input->readInt16();
   m_sourcePosition.y = input->readInt16();
-}
 
-void CopyRectDecoder::copy(FrameBuffer *dstFrameBuffer,
-                           const FrameBuffer *srcFrameBuffer,
-                           const Rect *rect,
-                           LocalMutex *fbLock)
-{
   AutoLock al(fbLock);
-  dstFrameBuffer->move(rect, m_sourcePosition.x, m_sourcePosition.y);
+  frameBuffer->move(dstRect, m_sourcePosition.x, m_sourcePosition.y);
 }
@@ -41,15 +41,8 @@ protected:
   //
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *frameBuffer,
-                      const Rect *dstRect);
-
-  //
-  // This method inherited by DecoderOfRectangle.
-  //
-  virtual void copy(FrameBuffer *dstFrameBuffer,
-                    const FrameBuffer *srcFrameBuffer,
-                    const Rect *rect,
-                    LocalMutex *fbLock);
+                      const Rect *dstRect,
+                      LocalMutex *fbLock);
 
 private:
   // This Point save left-top corner of copy-rectangle.
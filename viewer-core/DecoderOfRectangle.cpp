@@ -37,25 +37,14 @@ DecoderOfRectangle::~DecoderOfRectangle()
 
 void DecoderOfRectangle::process(RfbInputGate *input,
                      FrameBuffer *frameBuffer,
-                     FrameBuffer *secondFrameBuffer,
                      const Rect *rect,
                      LocalMutex *fbLock,
                      FbUpdateNotifier *fbNotifier)
 {
-  decode(input, secondFrameBuffer, rect);
-  copy(frameBuffer, secondFrameBuffer, rect, fbLock);
+  decode(input, frameBuffer, rect, fbLock);
   notify(fbNotifier, rect);
 }
 
-void DecoderOfRectangle::copy(FrameBuffer *dstFrameBuffer,
-                   const FrameBuffer *srcFrameBuffer,
-                   const Rect *rect,
-                   LocalMutex *fbLock)
-{
-  AutoLock al(fbLock);
-  dstFrameBuffer->copyFrom(rect, srcFrameBuffer, rect->left, rect->top);
-}
-
 void DecoderOfRectangle::notify(FbUpdateNotifier *fbNotifier,
                      const Rect *rect)
 {
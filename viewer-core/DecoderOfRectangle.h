@@ -37,17 +37,14 @@ public:
 
   //
   // This function does the following:
-  //   1. read update of dstRect from input
-  //   2. decode rectangle on "secondFrameBuffer"
-  //   3. copy rectangle from secondFrameBuffer to "frameBuffer"
-  //   4. notify fbNotifier
-  // His called decode(), copy() and notify() by order, defined in implementation.
+  //   1. read update of dstRect from input and decode it on "frameBuffer"
+  //   2. notify fbNotifier
+  // His called decode() and notify() by order, defined in implementation.
   //
   // This function is thread-safe for frameBuffer.
   //
   virtual void process(RfbInputGate *input,
                        FrameBuffer *frameBuffer,
-                       FrameBuffer *secondFrameBuffer,
                        const Rect *rect,
                        LocalMutex *fbLock,
                        FbUpdateNotifier *fbNotifier);
@@ -60,19 +57,14 @@ public:
 protected:
   //
   // This method read rectangle-update from input and decode on frameBuffer.
+  // The decoded pixels are written to frameBuffer directly, fbLock must be
+  // locked while writing. Implementations should not hold fbLock while
+  // reading input, so painting of frameBuffer is not blocked by network.
   //
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *frameBuffer,
-                      const Rect *rect) = 0;
-
-  //
-  // This method copy rectangle from srcFrameBuffer to dstFrameBuffer.
-  // This function is thread-safe from dstFrameBuffer.
-  //
-  virtual void copy(FrameBuffer *dstFrameBuffer,
-                    const FrameBuffer *srcFrameBuffer,
-                    const Rect *rect,
-                    LocalMutex *fbLock);
+                      const Rect *rect,
+                      LocalMutex *fbLock) = 0;
 
   //
   // This method notify fbNotifier about update of rect.
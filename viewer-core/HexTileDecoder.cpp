@@ -38,7 +38,8 @@ HexTileDecoder::~HexTileDecoder()
 
 void HexTileDecoder::decode(RfbInputGate *input,
                             FrameBuffer *framebuffer,
-                            const Rect *dstRect)
+                            const Rect *dstRect,
+                            LocalMutex *fbLock)
 {
   // shorcut
   const int bytesPerPixel = framebuffer->getBytesPerPixel();
@@ -58,47 +59,58 @@ void HexTileDecoder::decode(RfbInputGate *input,
       if (!framebuffer->getDimension().getRect().intersection(&tileRect).isEqualTo(&tileRect))
         throw Exception(_T("Error in protocol: incorrect size of tile in hextile-decoder"));
 
+      // The tile data is read before locking of the frame buffer.
       UINT8 flags = input->readUInt8();
       // If tile-coding is RAW.
       if (flags & 0x1) {
-        for (int y = tileRect.top; y < tileRect.bottom; y++)
-          input->readFully(framebuffer->getBufferPtr(tileRect.left, y),
-                           tileRect.getWidth() * bytesPerPixel);
+        size_t bytesPerLine = tileRect.getWidth() * bytesPerPixel;
+        input->readFully(m_tileData, bytesPerLine * tileRect.getHeight());
+
+        AutoLock al(fbLock);
+        const UINT8 *src = m_tileData;
+        for (int y = tileRect.top; y < tileRect.bottom; y++, src += bytesPerLine)
+          memcpy(framebuffer->getBufferPtr(tileRect.left, y), src, bytesPerLine);
       } else {
         if (flags & 0x2) {
           input->readFully(&background, bytesPerPixel);
           backgroundAccepted = true;
         }
 
-        if (backgroundAccepted)
-          framebuffer->fillRect(&tileRect, background);
-
         if (flags & 0x4)
           input->readFully(&foreground, bytesPerPixel);
 
+        int numberOfSubrectangles = 0;
+        bool subrectsColored = (flags & 0x10) && !(flags & 0x4);
+        size_t subrectSize = subrectsColored ? bytesPerPixel + 2 : 2;
         if (flags & 0x8) {
-          UINT8 numberOfSubrectangles = input->readUInt8();
-
-          for (int i = 0; i < numberOfSubrectangles; i++) {
-
-            if (flags & 0x10 && !(flags & 0x4))
-              input->readFully(&foreground, bytesPerPixel);
-
-            UINT8 xy = input->readUInt8();
-            UINT8 wh = input->readUInt8();
-            int x = (xy >> 4) & 0xF;
-            int y = xy & 0xF;
-            int w = ((wh >> 4) & 0xF) + 1;
-            int h = (wh & 0xF) + 1;
-            Rect subRect(x, y, x + w, y + h);
-
-            subRect.move(tileRect.left, tileRect.top);
-            framebuffer->fillRect(&subRect, foreground);
-          }
+          numberOfSubrectangles = input->readUInt8();
+          input->readFully(m_tileData, numberOfSubrectangles * subrectSize);
         } else { // exist subrect
           if (!backgroundAccepted)
             throw Exception(_T("Server error in HexTile encoding: background color not accepted"));
         }
+
+        AutoLock al(fbLock);
+        if (backgroundAccepted)
+          framebuffer->fillRect(&tileRect, background);
+
+        const UINT8 *src = m_tileData;
+        for (int i = 0; i < numberOfSubrectangles; i++, src += subrectSize) {
+          if (subrectsColored)
+            memcpy(&foreground, src, bytesPerPixel);
+
+          UINT8 xy = src[subrectSize - 2];
+          UINT8 wh = src[subrectSize - 1];
+          int x = (xy >> 4) & 0xF;
+          int y = xy & 0xF;
+          int w = ((wh >> 4) & 0xF) + 1;
+          int h = (wh & 0xF) + 1;
+          Rect subRect(x, y, x + w, y + h);
+
+          subRect.move(tileRect.left, tileRect.top);
+          subRect = subRect.intersection(&tileRect);
+          framebuffer->fillRect(&subRect, foreground);
+        }
       } // it tile is not RAW
     } // for each tiles in line
   } // for each line of tile
@@ -36,9 +36,16 @@ public:
 protected:
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *framebuffer,
-                      const Rect *dstRect);
+                      const Rect *dstRect,
+                      LocalMutex *fbLock);
 private:
   static const int TILE_SIZE = 16;
+
+  // Data of the current tile is read here, then the tile is drawn with the
+  // frame buffer locked once. It's enough for a raw tile (1024 bytes) or for
+  // 255 subrectangles with colors (1530 bytes).
+  static const size_t MAX_TILE_DATA_SIZE = 2048;
+  UINT8 m_tileData[MAX_TILE_DATA_SIZE];
 };
 
 #endif
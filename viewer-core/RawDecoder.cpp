@@ -38,7 +38,6 @@ RawDecoder::~RawDecoder()
 
 void RawDecoder::process(RfbInputGate *input,
                          FrameBuffer *frameBuffer,
-                         FrameBuffer *secondFrameBuffer,
                          const Rect *rect,
                          LocalMutex *fbLock,
                          FbUpdateNotifier *fbNotifier)
@@ -61,7 +60,7 @@ void RawDecoder::process(RfbInputGate *input,
   // two last part, if area of last part is less half of AREA_OF_ONE_PART.
   while (deltaRect.bottom + deltaHeight / 2 < rect->bottom) {
     DecoderOfRectangle::process(input,
-                                frameBuffer, secondFrameBuffer, &deltaRect, fbLock,
+                                frameBuffer, &deltaRect, fbLock,
                                 fbNotifier);
 
     // Increment position of rectangle.
@@ -72,19 +71,32 @@ void RawDecoder::process(RfbInputGate *input,
   deltaRect.top = std::max(rect->top, deltaRect.bottom - deltaHeight);
   deltaRect.bottom = rect->bottom;
   DecoderOfRectangle::process(input,
-                              frameBuffer, secondFrameBuffer, &deltaRect, fbLock,
+                              frameBuffer, &deltaRect, fbLock,
                               fbNotifier);
 }
 
 void RawDecoder::decode(RfbInputGate *input,
                      FrameBuffer *frameBuffer,
-                     const Rect *rect)
+                     const Rect *rect,
+                     LocalMutex *fbLock)
 {
   size_t bytesPerPixel = frameBuffer->getPixelFormat().bitsPerPixel / 8;
   size_t bytesPerLine = bytesPerPixel * rect->getWidth();
 
   if (!frameBuffer->getDimension().getRect().intersection(rect).isEqualTo(rect))
     throw Exception(_T("Error in protocol: incorrect size of rectangle"));
-  for (int y = rect->top; y < rect->bottom; y++)
-    input->readFully(frameBuffer->getBufferPtr(rect->left, y), bytesPerLine);
+
+  // The part is read without locking, so the frame buffer is locked only
+  // while the rows are copied.
+  size_t bandSize = bytesPerLine * rect->getHeight();
+  if (bandSize == 0) {
+    return;
+  }
+  m_band.resize(bandSize);
+  input->readFully(&m_band.front(), bandSize);
+
+  AutoLock al(fbLock);
+  const char *src = &m_band.front();
+  for (int y = rect->top; y < rect->bottom; y++, src += bytesPerLine)
+    memcpy(frameBuffer->getBufferPtr(rect->left, y), src, bytesPerLine);
 }
@@ -27,6 +27,8 @@
 
 #include "DecoderOfRectangle.h"
 
+#include <vector>
+
 class RawDecoder : public DecoderOfRectangle
 {
 public:
@@ -38,7 +40,6 @@ public:
   //
   virtual void process(RfbInputGate *input,
                        FrameBuffer *frameBuffer,
-                       FrameBuffer *secondFrameBuffer,
                        const Rect *rect,
                        LocalMutex *fbLock,
                        FbUpdateNotifier *fbNotifier);
@@ -46,10 +47,15 @@ public:
 protected:
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *frameBuffer,
-                      const Rect *rect);
+                      const Rect *rect,
+                      LocalMutex *fbLock);
 
 private:
   static const size_t AREA_OF_ONE_PART = 1024 * 64;
+
+  // Pixels of one part of the rectangle are read here before they are
+  // copied to the frame buffer.
+  std::vector<char> m_band;
 };
 
 #endif
@@ -0,0 +1,153 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "ReadAheadChannel.h"
+
+#include "thread/AutoLock.h"
+
+#include <algorithm>
+
+ReadAheadChannel::ReadAheadChannel(InputStream *source,
+                                   const std::vector<char> *initialData,
+                                   size_t maxBufferedBytes,
+                                   LogWriter *logWriter)
+: m_source(source),
+  m_buffer(std::max(std::max(maxBufferedBytes, (size_t)CHUNK_SIZE),
+                    initialData->size())),
+  m_readPos(0),
+  m_bufferedBytes(initialData->size()),
+  m_readCalls(0),
+  m_isFailed(false),
+  m_logWriter(logWriter)
+{
+  if (!initialData->empty()) {
+    memcpy(&m_buffer.front(), &initialData->front(), initialData->size());
+  }
+  resume();
+}
+
+ReadAheadChannel::~ReadAheadChannel()
+{
+  try {
+    terminate();
+    wait();
+  } catch (...) {
+  }
+}
+
+size_t ReadAheadChannel::read(void *buffer, size_t len)
+{
+  char *dst = (char *)buffer;
+  while (true) {
+    {
+      AutoLock al(&m_queueLock);
+      if (m_bufferedBytes != 0) {
+        size_t copied = 0;
+        while (copied < len && m_bufferedBytes != 0) {
+          size_t n = std::min(len - copied,
+                              std::min(m_bufferedBytes,
+                                       m_buffer.size() - m_readPos));
+          memcpy(dst + copied, &m_buffer[m_readPos], n);
+          copied += n;
+          m_bufferedBytes -= n;
+          m_readPos = (m_readPos + n) % m_buffer.size();
+        }
+        m_spaceEvent.notify();
+        return copied;
+      }
+      if (m_isFailed) {
+        throw IOException(m_errorMessage.getString());
+      }
+    }
+    m_dataEvent.waitForEvent();
+  }
+}
+
+size_t ReadAheadChannel::write(const void *buffer, size_t len)
+{
+  throw IOException(_T("Writing to the read-ahead channel is not supported"));
+}
+
+void ReadAheadChannel::close()
+{
+  terminate();
+}
+
+UINT64 ReadAheadChannel::getReadCalls()
+{
+  AutoLock al(&m_queueLock);
+  return m_readCalls;
+}
+
+void ReadAheadChannel::execute()
+{
+  try {
+    while (!isTerminating()) {
+      size_t writePos, freeSpace;
+      {
+        AutoLock al(&m_queueLock);
+        writePos = (m_readPos + m_bufferedBytes) % m_buffer.size();
+        freeSpace = std::min(m_buffer.size() - m_bufferedBytes,
+                             m_buffer.size() - writePos);
+      }
+      if (freeSpace == 0) {
+        m_spaceEvent.waitForEvent();
+        continue;
+      }
+
+      size_t n = m_source->read(&m_buffer[writePos],
+                                std::min(freeSpace, (size_t)CHUNK_SIZE));
+      if (n == 0) {
+        throw IOException(_T("The end of the stream is reached"));
+      }
+
+      AutoLock al(&m_queueLock);
+      m_bufferedBytes += n;
+      m_readCalls++;
+      m_dataEvent.notify();
+    }
+  } catch (const Exception &ex) {
+    m_logWriter->debug(_T("Read-ahead thread stopped: %s"), ex.getMessage());
+    AutoLock al(&m_queueLock);
+    if (!m_isFailed) {
+      m_isFailed = true;
+      m_errorMessage.setString(ex.getMessage());
+    }
+    m_dataEvent.notify();
+  }
+}
+
+void ReadAheadChannel::onTerminate()
+{
+  {
+    AutoLock al(&m_queueLock);
+    if (!m_isFailed) {
+      m_isFailed = true;
+      m_errorMessage.setString(_T("The read-ahead channel is closed"));
+    }
+  }
+  m_dataEvent.notify();
+  m_spaceEvent.notify();
+}
@@ -0,0 +1,113 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef _READ_AHEAD_CHANNEL_H_
+#define _READ_AHEAD_CHANNEL_H_
+
+#include "io-lib/Channel.h"
+#include "log-writer/LogWriter.h"
+#include "thread/LocalMutex.h"
+#include "thread/Thread.h"
+#include "util/StringStorage.h"
+#include "win-system/WindowsEvent.h"
+
+#include <vector>
+
+//
+// Channel which reads its source stream in a separate thread, so that data
+// arriving from the network is taken from the socket while the consumer is
+// still decoding the previous data. Read data is kept in a ring buffer
+// allocated once, the reading thread stops when the buffer is full.
+//
+// The channel is read-only, it exists to be wrapped into an RfbInputGate.
+//
+class ReadAheadChannel : public Channel, private Thread
+{
+public:
+  //
+  // Starts reading from source. The initialData (if not empty) is returned
+  // before the data of the source, it's for the data a buffer over the
+  // source has read already. At most maxBufferedBytes are read ahead of
+  // the consumer, the buffer for them is allocated here. The source stream is not owned and must remain valid until
+  // this object is destroyed. A blocking read of the source is not
+  // interrupted by this object, the owner of the source should close it.
+  //
+  ReadAheadChannel(InputStream *source, const std::vector<char> *initialData,
+                   size_t maxBufferedBytes, LogWriter *logWriter);
+  virtual ~ReadAheadChannel();
+
+  //
+  // Inherited from Channel.
+  //
+
+  // Returns the data read ahead, blocks until there is any. Throws
+  // IOException when the source failed or ended and all the data read
+  // before has been returned.
+  virtual size_t read(void *buffer, size_t len) throw(IOException);
+
+  // Always throws IOException, writing is not supported.
+  virtual size_t write(const void *buffer, size_t len) throw(IOException);
+
+  // Stops the reading thread, following read() calls throw IOException
+  // when the data read before has been returned.
+  virtual void close() throw(Exception);
+
+  // Returns the number of reads from the source since creation.
+  UINT64 getReadCalls();
+
+private:
+  // Inherited from Thread.
+  virtual void execute();
+  virtual void onTerminate();
+
+  // Maximal size of the blocks requested from the source channel.
+  static const size_t CHUNK_SIZE = 64 * 1024;
+
+  InputStream *m_source;
+
+  // Ring buffer of the data read from the source and not taken by the
+  // consumer yet. It starts at m_readPos and is m_bufferedBytes long. The
+  // reading thread writes behind the data without holding the lock, the
+  // consumer never touches that part.
+  std::vector<char> m_buffer;
+  size_t m_readPos;
+  size_t m_bufferedBytes;
+  UINT64 m_readCalls;
+
+  // Set when the source has failed or ended, m_errorMessage holds the
+  // reason.
+  bool m_isFailed;
+  StringStorage m_errorMessage;
+
+  LocalMutex m_queueLock;
+  // Signaled when new data or an error is put to the queue.
+  WindowsEvent m_dataEvent;
+  // Signaled when the consumer has taken data from the queue.
+  WindowsEvent m_spaceEvent;
+
+  LogWriter *m_logWriter;
+};
+
+#endif
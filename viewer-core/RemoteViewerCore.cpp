@@ -135,11 +135,16 @@ void RemoteViewerCore::init()
   m_wasStarted = false;
   m_wasConnected = false;
   m_isNewPixelFormat = false;
+  m_isDecodingUpdate = false;
   m_isFreeze = false;
   m_isNeedRequestUpdate = true;
   m_forceFullUpdate = false;
 
   m_updateTimeout = 0;
+
+  m_isPipelined = false;
+  m_readAheadChannel = 0;
+  m_readAheadInput = 0;
 }
 
 RemoteViewerCore::~RemoteViewerCore()
@@ -156,6 +161,10 @@ RemoteViewerCore::~RemoteViewerCore()
       m_fbUpdateNotifier.wait();
 	  m_updateRequestSender.wait();
     }
+    // The connection is closed by stop(), so the read-ahead thread is
+    // not blocked by the source anymore.
+    delete m_readAheadInput;
+    delete m_readAheadChannel;
   } catch (...) {
   }
 }
@@ -276,7 +285,7 @@ bool RemoteViewerCore::updatePixelFormat()
   m_logWriter.debug(_T("Check pixel format change..."));
   {
     AutoLock al(&m_pixelFormatLock);
-    if (!m_isNewPixelFormat)
+    if (!m_isNewPixelFormat || m_isDecodingUpdate)
       return false;
     m_isNewPixelFormat = false;
     pxFormat = m_viewerPixelFormat;
@@ -323,6 +332,24 @@ void RemoteViewerCore::deferUpdateRequests(const int& milliseconds)
 	m_updateRequestSender.setTimeout(milliseconds);
 }
 
+void RemoteViewerCore::pipelineUpdateRequests(const bool& pipeline)
+{
+  AutoLock al(&m_pipelineLock);
+  m_isPipelined = pipeline;
+}
+
+bool RemoteViewerCore::isPipelined()
+{
+  AutoLock al(&m_pipelineLock);
+  return m_isPipelined;
+}
+
+bool RemoteViewerCore::isPixelFormatChanging()
+{
+  AutoLock al(&m_pixelFormatLock);
+  return m_isNewPixelFormat;
+}
+
 void RemoteViewerCore::sendFbUpdateRequest(bool incremental)
 {
   {
@@ -797,8 +824,7 @@ void RemoteViewerCore::setFbProperties(const Dimension *fbDimension,
                    fbDimension->width, fbDimension->height);
   m_logWriter.info(_T("Frame buffer pixel format: %s"), pxString.getString());
 
-  if (!m_frameBuffer.setProperties(fbDimension, fbPixelFormat) ||
-      !m_rectangleFb.setProperties(fbDimension, fbPixelFormat)) {
+  if (!m_frameBuffer.setProperties(fbDimension, fbPixelFormat)) {
     StringStorage error;
     error.format(_T("Failed to set property frame buffer. ")
                  _T("Dimension: (%d, %d), Pixel format: %s"),
@@ -806,7 +832,6 @@ void RemoteViewerCore::setFbProperties(const Dimension *fbDimension,
                  pxString.getString());
     throw Exception(error.getString());
   }
-  m_rectangleFb.setColor(0, 0, 0);
   m_frameBuffer.setColor(0, 0, 0);
   refreshFrameBuffer();
   m_fbUpdateNotifier.onPropertiesFb();
@@ -870,6 +895,28 @@ void RemoteViewerCore::execute()
     m_logWriter.info(_T("Protocol stage is \"Working phase\"."));
     sendFbUpdateRequest(false);
 
+    if (isPipelined()) {
+      m_logWriter.detail(_T("Reading of the connection ahead of decoding is started"));
+      // The socket is read directly to avoid copying the data through
+      // the buffer of its gate. The data the gate has buffered already
+      // goes first.
+      InputStream *source = m_input;
+      std::vector<char> bufferedData;
+      Channel *socketChannel = m_tcpConnection.getChannel();
+      if (socketChannel != 0) {
+        size_t bufferedLength = m_input->available();
+        const char *buffered = (const char *)m_input->peek();
+        bufferedData.assign(buffered, buffered + bufferedLength);
+        m_input->skip(bufferedLength);
+        source = socketChannel;
+      }
+      m_readAheadChannel = new ReadAheadChannel(source, &bufferedData,
+                                                READ_AHEAD_BUFFER_SIZE,
+                                                &m_logWriter);
+      m_readAheadInput = new RfbInputGate(m_readAheadChannel);
+      m_input = m_readAheadInput;
+    }
+
     // received server messages
     while (!isTerminating()) {
       UINT32 msgType = receiveServerMessageType();
@@ -975,22 +1022,64 @@ UINT32 RemoteViewerCore::receiveServerMessageType()
   return msgType;
 }
 
+UINT64 RemoteViewerCore::getConnectionReadCalls()
+{
+  // With read-ahead, m_input reads the queue, not the connection.
+  if (m_readAheadChannel != 0) {
+    return m_readAheadChannel->getReadCalls();
+  }
+  return m_input->getReadCalls();
+}
+
 void RemoteViewerCore::receiveFbUpdate()
 {
   // message type is already known: 0
 
+  // Number of reads from the connection is logged for each update.
+  UINT64 readCalls = getConnectionReadCalls();
+
   // read padding: one byte
   m_input->readUInt8();
 
   UINT16 numberOfRectangles = m_input->readUInt16();
   m_logWriter.debug(_T("number of rectangles: %d"), numberOfRectangles);
 
+  {
+    AutoLock al(&m_pixelFormatLock);
+    m_isDecodingUpdate = true;
+  }
+
+  // If updates are pipelined, request the next update before decoding this
+  // one. A pending change of the pixel format must be sent between updates,
+  // so the request is sent after decoding in this case. Such a request does
+  // not mean the update has arrived, the server does not measure the
+  // bandwidth by the requests of a pipelining client (see FrameRateGovernor).
+  bool isRequested = false;
+  if (isPipelined() && !isPixelFormatChanging()) {
+    requestNextUpdate();
+    isRequested = true;
+  }
+
   bool isLastRect = false;
   for (int rectangle = 0; rectangle < numberOfRectangles && !isLastRect; rectangle++) {
     m_logWriter.debug(_T("Receiving rectangle #%d..."), rectangle);
     isLastRect = receiveFbUpdateRectangle();
   }
 
+  {
+    AutoLock al(&m_pixelFormatLock);
+    m_isDecodingUpdate = false;
+  }
+  m_logWriter.debug(_T("Update has been received by %d reads"),
+                    (int)(getConnectionReadCalls() - readCalls));
+
+  if (!isRequested) {
+    requestNextUpdate();
+  }
+}
+
+void RemoteViewerCore::requestNextUpdate()
+{
   {
     AutoLock al(&m_requestUpdateLock);
     m_isNeedRequestUpdate = true;
@@ -1006,6 +1095,10 @@ void RemoteViewerCore::receiveFbUpdate()
 
 bool RemoteViewerCore::receiveFbUpdateRectangle()
 {
+  // The whole rectangle header is buffered at once, so the fields below
+  // are read from the buffer.
+  m_input->ensureAvailable(RECT_HEADER_SIZE);
+
   Rect rect;
   rect.left = m_input->readUInt16();
   rect.top = m_input->readUInt16();
@@ -1030,7 +1123,7 @@ bool RemoteViewerCore::receiveFbUpdateRectangle()
 
       DecoderOfRectangle *rectangleDecoder = dynamic_cast<DecoderOfRectangle *>(decoder);
       rectangleDecoder->process(m_input,
-                                &m_frameBuffer, &m_rectangleFb, &rect, &m_fbLock,
+                                &m_frameBuffer, &rect, &m_fbLock,
                                 &m_fbUpdateNotifier);
 
       m_logWriter.debug(_T("Decoded"));
@@ -40,6 +40,7 @@
 #include "DispatchDataProvider.h"
 #include "DecoderStore.h"
 #include "FbUpdateNotifier.h"
+#include "ReadAheadChannel.h"
 #include "ServerMessageListener.h"
 #include "TcpConnection.h"
 #include "WatermarksController.h"
@@ -342,6 +343,17 @@ public:
   //
   void deferUpdateRequests(const int& milliseconds);
 
+  //
+  // Specifies whether framebuffer updates are pipelined. If they are, the
+  // next update request is sent as soon as an update starts to arrive, so the
+  // server prepares the next update while this one is decoded, and the
+  // connection is read in a separate thread ahead of the decoders.
+  //
+  // Reading ahead is started only if pipelining is enabled before the
+  // working phase of the protocol.
+  //
+  void pipelineUpdateRequests(const bool& pipeline);
+
   //
   // Send a keyboard event. Arguments specify the event as defined in the
   // RFB v.3 protocol specification.
@@ -476,9 +488,31 @@ private:
   //   * receive the number of rectangles in this update,
   //   * then call receiveFrameBufferUpdRectangle() for each rectangle,
   //   * then send FramebufferUpdateRequest client message (code 3).
+  // If updates are pipelined, the request is sent before the rectangles are
+  // received.
   //
   void receiveFbUpdate();
 
+  // Returns the number of reads from the connection since it's established.
+  UINT64 getConnectionReadCalls();
+
+  //
+  // Marks that the next update is needed and sends FramebufferUpdateRequest
+  // unless updating is paused.
+  //
+  void requestNextUpdate();
+
+  //
+  // Returns true if updates are pipelined.
+  //
+  bool isPipelined();
+
+  //
+  // Returns true if the pixel format will be changed by the next update
+  // request.
+  //
+  bool isPixelFormatChanging();
+
   //
   // Receive rectangle, decode it and notify m_fbUpdateNotifier.
   //
@@ -487,6 +521,8 @@ private:
   // (code -224).
   //
   bool receiveFbUpdateRectangle();
+  // Size of the rectangle header: position, size and encoding type.
+  static const size_t RECT_HEADER_SIZE = 12;
 
   //
   // Process a fake rectangle which represents a pseudo-encoding.
@@ -554,6 +590,8 @@ private:
   // This method must be called only from the input thread, otherwise data corruption
   // is possible on the protocol level.
   //
+  // The pixel format is not changed while an update is being decoded.
+  //
   // Returns true if pixel format was actually changed.
   //
   bool updatePixelFormat();
@@ -621,21 +659,19 @@ private:
   // Cursor painted on him before calling CoreEventsAdapter::onFrameBufferUpdate()
   // and erased after (thread FbUpdateNotifier).
   //
+  // Decoders write decoded pixels to this frame buffer directly, locking
+  // m_fbLock only while they write.
+  //
   // Mutex m_fbLock must locked into only this thread, else may be deadlock.
   LocalMutex m_fbLock;
   FrameBuffer m_frameBuffer;
 
-  // Decoder work with this framebuffer. It is not actual frame buffer,
-  // it only easy buffer, common to all decoders. In future this frame buffer 
-  // may be replaced small buffers (e.g. 64KB) into ever decoder.
-  //
-  // After finish of decoding Decoder copy data to m_frameBuffer.
-  // This buffer is not need to blocking: read information is one-thread.
-  FrameBuffer m_rectangleFb;
-
   LocalMutex m_pixelFormatLock;
   bool m_isNewPixelFormat;
   PixelFormat m_viewerPixelFormat;
+  // This flag is set while rectangles of an update are received. It's
+  // protected by m_pixelFormatLock.
+  bool m_isDecodingUpdate;
 
   LocalMutex m_refreshingLock;
   bool m_isRefreshing;
@@ -658,6 +694,17 @@ private:
 
   UpdateRequestSender m_updateRequestSender;
 
+  LocalMutex m_pipelineLock;
+  bool m_isPipelined;
+
+  // Maximum size of data read from the connection ahead of the decoders.
+  static const size_t READ_AHEAD_BUFFER_SIZE = 4 * 1024 * 1024;
+
+  // If updates are pipelined, the input thread reads the connection via
+  // m_readAheadInput in the working phase. Otherwise these are zero.
+  ReadAheadChannel *m_readAheadChannel;
+  RfbInputGate *m_readAheadInput;
+
 private:
   // Do not allow copying objects.
   RemoteViewerCore(const RemoteViewerCore &);
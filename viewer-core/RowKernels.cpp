@@ -0,0 +1,258 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#include "RowKernels.h"
+#include "util/CpuFeatures.h"
+
+#include <string.h>
+#include <emmintrin.h>
+#include <tmmintrin.h>
+
+//------------------------------- Kernels ----------------------------------//
+
+static void expandCPixelsC(UINT32 *dst, const UINT8 *src, int count,
+                           bool reverseOrder)
+{
+  if (reverseOrder) {
+    for (int i = 0; i < count; i++, src += 3) {
+      dst[i] = (UINT32)src[0] << 16 | (UINT32)src[1] << 8 | src[2];
+    }
+  } else {
+    for (int i = 0; i < count; i++, src += 3) {
+      dst[i] = (UINT32)src[2] << 16 | (UINT32)src[1] << 8 | src[0];
+    }
+  }
+}
+
+static void expandCPixelsSsse3(UINT32 *dst, const UINT8 *src, int count,
+                               bool reverseOrder)
+{
+  // Moves three bytes of each of four pixels to the low-order bytes of
+  // 32-bit lanes, the high-order bytes are zeroed (index 0x80).
+  const __m128i shuffle = reverseOrder ?
+    _mm_setr_epi8(2, 1, 0, -128, 5, 4, 3, -128,
+                  8, 7, 6, -128, 11, 10, 9, -128) :
+    _mm_setr_epi8(0, 1, 2, -128, 3, 4, 5, -128,
+                  6, 7, 8, -128, 9, 10, 11, -128);
+
+  int i = 0;
+  // Each iteration loads 16 bytes but uses 12 of them, so the loop stops
+  // while the four extra bytes still belong to the source.
+  for (; i + 6 <= count; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 3));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_shuffle_epi8(v, shuffle));
+  }
+  expandCPixelsC(dst + i, src + i * 3, count - i, reverseOrder);
+}
+
+template<class PIXEL_T>
+static void expandPaletteT(PIXEL_T *dst, const UINT8 *indices, int count,
+                           const UINT32 *palette)
+{
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    dst[i] = (PIXEL_T)palette[indices[i]];
+    dst[i + 1] = (PIXEL_T)palette[indices[i + 1]];
+    dst[i + 2] = (PIXEL_T)palette[indices[i + 2]];
+    dst[i + 3] = (PIXEL_T)palette[indices[i + 3]];
+  }
+  for (; i < count; i++) {
+    dst[i] = (PIXEL_T)palette[indices[i]];
+  }
+}
+
+template<class PIXEL_T>
+static void expandMonoT(PIXEL_T *dst, const UINT8 *bits, int count,
+                        PIXEL_T color0, PIXEL_T color1)
+{
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    UINT8 b = bits[i / 8];
+    for (int k = 0; k < 8; k++) {
+      dst[i + k] = (b & (0x80 >> k)) != 0 ? color1 : color0;
+    }
+  }
+  for (; i < count; i++) {
+    dst[i] = (bits[i / 8] & (0x80 >> (i % 8))) != 0 ? color1 : color0;
+  }
+}
+
+static void expandMono32Sse2(UINT32 *dst, const UINT8 *bits, int count,
+                             UINT32 color0, UINT32 color1)
+{
+  const __m128i maskLo = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+  const __m128i maskHi = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+  const __m128i c0 = _mm_set1_epi32((int)color0);
+  const __m128i diff = _mm_set1_epi32((int)(color0 ^ color1));
+
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i b = _mm_set1_epi32(bits[i / 8]);
+    __m128i lo = _mm_cmpeq_epi32(_mm_and_si128(b, maskLo), maskLo);
+    __m128i hi = _mm_cmpeq_epi32(_mm_and_si128(b, maskHi), maskHi);
+    _mm_storeu_si128((__m128i *)(dst + i),
+                     _mm_xor_si128(c0, _mm_and_si128(diff, lo)));
+    _mm_storeu_si128((__m128i *)(dst + i + 4),
+                     _mm_xor_si128(c0, _mm_and_si128(diff, hi)));
+  }
+  for (; i < count; i++) {
+    dst[i] = (bits[i / 8] & (0x80 >> (i % 8))) != 0 ? color1 : color0;
+  }
+}
+
+template<class PIXEL_T>
+static void convertRgbT(PIXEL_T *dst, const UINT8 *src, int count,
+                        const PixelFormat *pf)
+{
+  for (int i = 0; i < count; i++, src += 3) {
+    dst[i] = (PIXEL_T)(((UINT32)src[0] * pf->redMax + 127) / 255 << pf->redShift |
+                       ((UINT32)src[1] * pf->greenMax + 127) / 255 << pf->greenShift |
+                       ((UINT32)src[2] * pf->blueMax + 127) / 255 << pf->blueShift);
+  }
+}
+
+template<class PIXEL_T>
+static void reconstructGradientT(PIXEL_T *dst, const UINT8 *src, int count,
+                                 bool isCPixel, const PixelFormat *pf,
+                                 const UINT16 *prevRow, UINT16 *thisRow)
+{
+  const UINT16 max[3] = {pf->redMax, pf->greenMax, pf->blueMax};
+  const UINT16 shift[3] = {pf->redShift, pf->greenShift, pf->blueShift};
+
+  for (int x = 0; x < count; x++) {
+    UINT32 rawColor = 0;
+    if (isCPixel) {
+      rawColor = (UINT32)src[0] << 16 | (UINT32)src[1] << 8 | src[2];
+      src += 3;
+    } else {
+      memcpy(&rawColor, src, sizeof(PIXEL_T));
+      src += sizeof(PIXEL_T);
+    }
+
+    UINT32 color = 0;
+    size_t j = (x + 1) * 3;
+    for (int index = 0; index < 3; index++, j++) {
+      INT32 d = prevRow[j] +      // "upper" pixel (from prev row)
+                thisRow[j - 3] -  // prev pixel
+                prevRow[j - 3];   // "diagonal" prev pixel
+      UINT16 predicted = d < 0 ? 0 : d > max[index] ? max[index] : (UINT16)d;
+      UINT16 component = (UINT16)(rawColor >> shift[index] & max[index]);
+      thisRow[j] = (predicted + component) & max[index];
+      color |= (UINT32)thisRow[j] << shift[index];
+    }
+    dst[x] = (PIXEL_T)color;
+  }
+}
+
+//------------------------------ RowKernels --------------------------------//
+
+void RowKernels::expandCPixels(UINT32 *dst, const UINT8 *src, int count,
+                               bool reverseOrder)
+{
+  if (CpuFeatures::hasSsse3()) {
+    expandCPixelsSsse3(dst, src, count, reverseOrder);
+  } else {
+    expandCPixelsC(dst, src, count, reverseOrder);
+  }
+}
+
+void RowKernels::expandPalette(void *dst, int bytesPerPixel,
+                               const UINT8 *indices, int count,
+                               const UINT32 *palette)
+{
+  switch (bytesPerPixel) {
+  case 1:
+    expandPaletteT((UINT8 *)dst, indices, count, palette);
+    break;
+  case 2:
+    expandPaletteT((UINT16 *)dst, indices, count, palette);
+    break;
+  default:
+    expandPaletteT((UINT32 *)dst, indices, count, palette);
+    break;
+  }
+}
+
+void RowKernels::expandMono(void *dst, int bytesPerPixel,
+                            const UINT8 *bits, int count,
+                            UINT32 color0, UINT32 color1)
+{
+  switch (bytesPerPixel) {
+  case 1:
+    expandMonoT((UINT8 *)dst, bits, count, (UINT8)color0, (UINT8)color1);
+    break;
+  case 2:
+    expandMonoT((UINT16 *)dst, bits, count, (UINT16)color0, (UINT16)color1);
+    break;
+  default:
+    if (CpuFeatures::hasSse2()) {
+      expandMono32Sse2((UINT32 *)dst, bits, count, color0, color1);
+    } else {
+      expandMonoT((UINT32 *)dst, bits, count, color0, color1);
+    }
+    break;
+  }
+}
+
+void RowKernels::convertRgb(void *dst, const UINT8 *src, int count,
+                            const PixelFormat *pf)
+{
+  switch (pf->bitsPerPixel) {
+  case 8:
+    convertRgbT((UINT8 *)dst, src, count, pf);
+    break;
+  case 16:
+    convertRgbT((UINT16 *)dst, src, count, pf);
+    break;
+  default:
+    if (pf->redMax == 255 && pf->greenMax == 255 && pf->blueMax == 255 &&
+        pf->redShift == 16 && pf->greenShift == 8 && pf->blueShift == 0) {
+      expandCPixels((UINT32 *)dst, src, count, true);
+    } else {
+      convertRgbT((UINT32 *)dst, src, count, pf);
+    }
+    break;
+  }
+}
+
+void RowKernels::reconstructGradient(void *dst, const UINT8 *src, int count,
+                                     bool isCPixel, const PixelFormat *pf,
+                                     const UINT16 *prevRow, UINT16 *thisRow)
+{
+  switch (pf->bitsPerPixel) {
+  case 8:
+    reconstructGradientT((UINT8 *)dst, src, count, isCPixel, pf,
+                         prevRow, thisRow);
+    break;
+  case 16:
+    reconstructGradientT((UINT16 *)dst, src, count, isCPixel, pf,
+                         prevRow, thisRow);
+    break;
+  default:
+    reconstructGradientT((UINT32 *)dst, src, count, isCPixel, pf,
+                         prevRow, thisRow);
+    break;
+  }
+}
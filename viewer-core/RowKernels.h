@@ -0,0 +1,75 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+
+#ifndef _ROW_KERNELS_H_
+#define _ROW_KERNELS_H_
+
+#include "rfb/PixelFormat.h"
+#include "util/inttypes.h"
+
+// RowKernels write whole rows of decoded pixels to a frame buffer row, so
+// decoders don't have to address each pixel via FrameBuffer::getBufferPtr().
+// Kernels for 32-bit pixels are vectorized with SSE2 or SSSE3 when the
+// processor supports them.
+class RowKernels
+{
+public:
+  // Expands `count' 24-bit pixels (three bytes each) to 32-bit pixels. If
+  // `reverseOrder' is true, the bytes are red, green and blue and the result
+  // is (red << 16 | green << 8 | blue), as Tight sends its CPIXELs.
+  // Otherwise the bytes are the low-order bytes of the result in
+  // little-endian order, as ZRLE sends its CPIXELs.
+  static void expandCPixels(UINT32 *dst, const UINT8 *src, int count,
+                            bool reverseOrder);
+
+  // Writes `count' pixels of `bytesPerPixel' bytes taken from `palette' by
+  // 8-bit indices. The palette must have 256 entries.
+  static void expandPalette(void *dst, int bytesPerPixel,
+                            const UINT8 *indices, int count,
+                            const UINT32 *palette);
+
+  // Writes `count' pixels of `bytesPerPixel' bytes for the bits of `bits',
+  // the most significant bit first. Zero bits are written as color0, other
+  // bits as color1.
+  static void expandMono(void *dst, int bytesPerPixel,
+                         const UINT8 *bits, int count,
+                         UINT32 color0, UINT32 color1);
+
+  // Converts `count' pixels given as red, green and blue bytes to the pixel
+  // format `pf'.
+  static void convertRgb(void *dst, const UINT8 *src, int count,
+                         const PixelFormat *pf);
+
+  // Reconstructs one row of pixels filtered by the Tight "gradient" filter.
+  // The source pixels are three bytes long if `isCPixel' is true, otherwise
+  // they are in the `pf' format. `prevRow' holds color components of the
+  // previous row, `thisRow' receives components of this row; both arrays
+  // hold 3 * (count + 1) values, the first three of which are zeroes.
+  static void reconstructGradient(void *dst, const UINT8 *src, int count,
+                                  bool isCPixel, const PixelFormat *pf,
+                                  const UINT16 *prevRow, UINT16 *thisRow);
+};
+
+#endif
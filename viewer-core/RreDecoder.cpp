@@ -24,6 +24,8 @@
 
 #include "RreDecoder.h"
 
+#include <algorithm>
+
 RreDecoder::RreDecoder(LogWriter *logWriter)
 : DecoderOfRectangle(logWriter)
 {
@@ -36,25 +38,45 @@ RreDecoder::~RreDecoder()
 
 void RreDecoder::decode(RfbInputGate *input,
                         FrameBuffer *frameBuffer,
-                        const Rect *dstRect)
+                        const Rect *dstRect,
+                        LocalMutex *fbLock)
 {
   UINT32 numberRectangle = input->readUInt32();
   size_t bytesPerPixel = frameBuffer->getBytesPerPixel();
 
-  UINT32 backgroundColor;
+  UINT32 backgroundColor = 0;
   input->readFully(&backgroundColor, bytesPerPixel);
+
+  // Each subrectangle is a pixel value followed by x, y, width and height.
+  // All of them are read before drawing, so that the rectangle is never
+  // shown partially drawn.
+  size_t subrectSize = bytesPerPixel + 8;
+  m_subrects.clear();
+  for (UINT32 remaining = numberRectangle; remaining != 0;) {
+    UINT32 portion = std::min(remaining, (UINT32)SUBRECTS_PER_PORTION);
+    remaining -= portion;
+    size_t offset = m_subrects.size();
+    m_subrects.resize(offset + portion * subrectSize);
+    input->readFully(&m_subrects[offset], portion * subrectSize);
+  }
+
+  AutoLock al(fbLock);
   frameBuffer->fillRect(dstRect, backgroundColor);
+  if (numberRectangle != 0) {
+    const UINT8 *src = &m_subrects.front();
+    for (UINT32 i = 0; i < numberRectangle; i++, src += subrectSize) {
+      UINT32 color = 0;
+      memcpy(&color, src, bytesPerPixel);
+      const UINT8 *coords = src + bytesPerPixel;
+      int x = coords[0] << 8 | coords[1];
+      int y = coords[2] << 8 | coords[3];
+      int w = coords[4] << 8 | coords[5];
+      int h = coords[6] << 8 | coords[7];
 
-  while (numberRectangle--) {
-    UINT32 color;
-    input->readFully(&color, bytesPerPixel);
-    UINT32 x = input->readUInt16();
-    UINT32 y = input->readUInt16();
-    UINT32 w = input->readUInt16();
-    UINT32 h = input->readUInt16();
-
-    Rect rect(x, y, x + w, y + h);
-    rect.move(dstRect->left, dstRect->top);
-    frameBuffer->fillRect(&rect, color);
+      Rect rect(x, y, x + w, y + h);
+      rect.move(dstRect->left, dstRect->top);
+      rect = rect.intersection(dstRect);
+      frameBuffer->fillRect(&rect, color);
+    }
   }
 }
@@ -27,6 +27,8 @@
 
 #include "DecoderOfRectangle.h"
 
+#include <vector>
+
 class RreDecoder : public DecoderOfRectangle
 {
 public:
@@ -36,7 +38,16 @@ public:
 protected:
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *framebuffer,
-                      const Rect *dstRect);
+                      const Rect *dstRect,
+                      LocalMutex *fbLock);
+
+private:
+  // Subrectangles are read by portions of this size, so that the buffer
+  // grows only as the data arrives.
+  static const UINT32 SUBRECTS_PER_PORTION = 4096;
+
+  // Raw data of the subrectangles of the current rectangle.
+  std::vector<UINT8> m_subrects;
 };
 
 #endif
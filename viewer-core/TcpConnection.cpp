@@ -108,6 +108,15 @@ void TcpConnection::connect()
         m_socketOwner = true;
         m_socket->connect(ipAddress);
         m_socket->enableNaggleAlgorithm(false);
+        if (m_useSsl) {
+          UINT64 full, resumed;
+          SocketIPv4::getSslHandshakeCounts(false, &full, &resumed);
+          m_logWriter->detail(_T("SSL session %s (full handshakes: %d,")
+                              _T(" resumed: %d)"),
+                              m_socket->isSslSessionReused() ?
+                                _T("resumed") : _T("established"),
+                              (int)full, (int)resumed);
+        }
       } else {
         throw Exception(_T("Connection parameters (host, port, socket, gates) is empty."));
       }
@@ -148,6 +157,17 @@ RfbInputGate *TcpConnection::getInput() const
   return m_input;
 }
 
+Channel *TcpConnection::getChannel() const
+{
+  {
+    AutoLock al(&m_connectLock);
+    if (!m_isEstablished) {
+      throw Exception(_T("Connection has not been established"));
+    }
+  }
+  return m_socketStream;
+}
+
 RfbOutputGate *TcpConnection::getOutput() const
 {
   {
@@ -47,6 +47,9 @@ public:
 
   RfbInputGate *getInput() const;
   RfbOutputGate *getOutput() const;
+  // Returns the socket channel the input gate reads, or zero if the
+  // connection has been bound to external gates.
+  Channel *getChannel() const;
 private:
 	bool m_useSsl;
   StringStorage m_host;
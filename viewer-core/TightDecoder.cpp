@@ -26,6 +26,10 @@
 
 #include "rfb/StandardPixelFormatFactory.h"
 
+#include "RowKernels.h"
+
+#include <algorithm>
+
 TightDecoder::TightDecoder(LogWriter *logWriter)
 : DecoderOfRectangle(logWriter),
   m_isCPixel(false)
@@ -50,7 +54,8 @@ TightDecoder::~TightDecoder()
 
 void TightDecoder::decode(RfbInputGate *input,
                           FrameBuffer *fb,
-                          const Rect *dstRect)
+                          const Rect *dstRect,
+                          LocalMutex *fbLock)
 {
  // The width of any Tight-encoded rectangle cannot exceed 2048
  // pixels. If a rectangle is wider, it must be split into several rectangles
@@ -78,32 +83,12 @@ void TightDecoder::decode(RfbInputGate *input,
 
   if (compressionType == FILL_TYPE) {
     UINT32 color = readTightPixel(input, bytesPerCPixel);
+    AutoLock al(fbLock);
     fb->fillRect(dstRect, color);
   } else if (compressionType == JPEG_TYPE) {
-    processJpeg(input, fb, dstRect);
+    processJpeg(input, fb, dstRect, fbLock);
   } else
-    processBasicTypes(input, fb, dstRect, compressionControl);
-}
-
-UINT32 TightDecoder::transformPixelToTight(UINT32 color)
-{
-  UINT32 result = 0;
-  result |= (color & 0xFF) << 16;
-  result |= color & 0xFF00;
-  result |= (color >> 16);
-  return result;
-}
-
-vector<UINT8> TightDecoder::transformArray(const vector<UINT8> &buffer)
-{
-  vector<UINT8> result(buffer.size() * 4 / 3);
-  for (size_t bi = 0, ri = 0; bi < buffer.size(); bi += 3, ri += 4) {
-    result[ri] = buffer[bi + 2];
-    result[ri + 1] = buffer[bi + 1];
-    result[ri + 2] = buffer[bi];
-    result[ri + 3] = 0;
-  }
-  return result;
+    processBasicTypes(input, fb, dstRect, compressionControl, fbLock);
 }
 
 UINT32 TightDecoder::readTightPixel(RfbInputGate *input, int bytesPerCPixel)
@@ -125,8 +110,7 @@ UINT32 TightDecoder::readTightPixel(RfbInputGate *input, int bytesPerCPixel)
 void TightDecoder::reset()
 {
   for (int i = 0; i < DECODERS_NUM; i++) {
-    delete m_inflater[i];
-    m_inflater[i] = new Inflater;
+    m_inflater[i]->reset();
   }
 }
 
@@ -134,8 +118,7 @@ void TightDecoder::resetDecoders(UINT8 compressionControl)
 {
   for (int i = 0; i < DECODERS_NUM; i++)
     if (compressionControl & (0x01 << i)) {
-        delete m_inflater[i];
-        m_inflater[i] = new Inflater;
+        m_inflater[i]->reset();
     }
 }
 
@@ -155,26 +138,25 @@ int TightDecoder::readCompactSize(RfbInputGate *input)
 
 void TightDecoder::processJpeg(RfbInputGate *input,
                                FrameBuffer *frameBuffer,
-                               const Rect *dstRect)
+                               const Rect *dstRect,
+                               LocalMutex *fbLock)
 {
   UINT32 jpegBufLen = readCompactSize(input);
   if (jpegBufLen == 0)
     throw Exception(_T("Error in protocol: empty byffer of jpeg (tight-decoder)"));
-  vector<UINT8> buffer;
-  buffer.resize(jpegBufLen);
-  input->readFully(&buffer.front(), jpegBufLen);
+  m_compressed.resize(jpegBufLen);
+  input->readFully(&m_compressed.front(), jpegBufLen);
 
   if (dstRect->area() != 0) {
-    vector<UINT8> pixels;
-    pixels.resize(dstRect->area() * JpegDecompressor::BYTES_PER_PIXEL);
+    m_pixels.resize(dstRect->area() * JpegDecompressor::BYTES_PER_PIXEL);
 
     try {
-      m_jpeg.decompress(buffer, jpegBufLen, pixels, dstRect);
+      m_jpeg.decompress(m_compressed, jpegBufLen, m_pixels, dstRect);
+      AutoLock al(fbLock);
       if (m_isCPixel) {
-        pixels = transformArray(pixels);
-        drawTightBytes(frameBuffer, &pixels, dstRect);
+        drawTightBytes(frameBuffer, &m_pixels, dstRect);
       } else {
-        drawJpegBytes(frameBuffer, &pixels, dstRect);
+        drawJpegBytes(frameBuffer, &m_pixels, dstRect);
       }
     } catch (const Exception &ex) {
       StringStorage error;
@@ -188,7 +170,8 @@ void TightDecoder::processJpeg(RfbInputGate *input,
 void TightDecoder::processBasicTypes(RfbInputGate *input,
                                      FrameBuffer *fb,
                                      const Rect *dstRect,
-                                     UINT8 compressionControl)
+                                     UINT8 compressionControl,
+                                     LocalMutex *fbLock)
 {
   int decoderId = (compressionControl & STREAM_ID_MASK) >> 4;
   int filterId = COPY_FILTER;
@@ -202,15 +185,13 @@ void TightDecoder::processBasicTypes(RfbInputGate *input,
     lengthCurrentBpp = dstRect->area() * 3;
   }
 
-  vector<UINT8> buffer;
-
   switch (filterId) {
   case COPY_FILTER:
-    readTightData(input, buffer, lengthCurrentBpp, decoderId);
-    if (m_isCPixel) {
-      buffer = transformArray(buffer);
+    readTightData(input, m_pixels, lengthCurrentBpp, decoderId);
+    {
+      AutoLock al(fbLock);
+      drawTightBytes(fb, &m_pixels, dstRect);
     }
-    drawTightBytes(fb, &buffer, dstRect);
     break;
 
   // The "gradient" filter and "jpeg" compression may be used only
@@ -218,19 +199,23 @@ void TightDecoder::processBasicTypes(RfbInputGate *input,
   case PALETTE_FILTER:
     {
       int paletteSize = input->readUInt8() + 1;
-      vector<UINT32> palette = readPalette(input, paletteSize, bytesPerCPixel);
+      readPalette(input, paletteSize, bytesPerCPixel);
       size_t dataLength = dstRect->area();
       if (paletteSize == 2) {
         dataLength = (dstRect->getWidth() + 7) / 8 * dstRect->getHeight();
       }
-      readTightData(input, buffer, dataLength, decoderId);
-      drawPalette(fb, palette, buffer, dstRect);
+      readTightData(input, m_pixels, dataLength, decoderId);
+      AutoLock al(fbLock);
+      drawPalette(fb, paletteSize, m_pixels, dstRect);
     }
     break;
 
   case GRADIENT_FILTER:
-    readTightData(input, buffer, lengthCurrentBpp, decoderId);
-    drawGradient(fb, buffer, dstRect);
+    readTightData(input, m_pixels, lengthCurrentBpp, decoderId);
+    {
+      AutoLock al(fbLock);
+      drawGradient(fb, m_pixels, dstRect);
+    }
     break;
 
   default:
@@ -238,15 +223,16 @@ void TightDecoder::processBasicTypes(RfbInputGate *input,
   }
 }
 
-vector<UINT32> TightDecoder::readPalette(RfbInputGate *input,
-                                      int paletteSize,
-                                      int bytesPerCPixel)
+void TightDecoder::readPalette(RfbInputGate *input,
+                               int paletteSize,
+                               int bytesPerCPixel)
 {
-  vector<UINT32> palette(paletteSize);
   for (int i = 0; i < paletteSize; i++) {
-    palette[i] = readTightPixel(input, bytesPerCPixel);
+    m_palette[i] = readTightPixel(input, bytesPerCPixel);
   }
-  return palette;
+  // Invalid indices are drawn by zero pixels.
+  memset(&m_palette[paletteSize], 0,
+         (MAX_PALETTE_SIZE - paletteSize) * sizeof(UINT32));
 }
 
 void TightDecoder::readTightData(RfbInputGate *input,
@@ -271,21 +257,17 @@ void TightDecoder::readCompressedData(RfbInputGate *input,
 {
   size_t rawDataLength = readCompactSize(input);
 
-  vector<char> compressed(rawDataLength);
-
-  // read compressed (raw) data behind space allocated for decompressed data
   if (rawDataLength != 0) {
-    input->readFully(&compressed.front(), rawDataLength);
+    m_compressed.resize(rawDataLength);
+    input->readFully(&m_compressed.front(), rawDataLength);
 
+    // The data is inflated right into the caller's buffer. Both buffers
+    // only grow, so no memory is allocated once they are big enough.
+    buffer.resize(expectedLength);
     Inflater *decoder = m_inflater[decoderId];
-    decoder->setInput(&compressed.front(), rawDataLength);
-    decoder->setUnpackedSize(expectedLength);
-    decoder->inflate();
-
-    size_t size = decoder->getOutputSize();
-    const char *output = decoder->getOutput();
+    decoder->setInput((const char *)&m_compressed.front(), rawDataLength);
+    size_t size = decoder->inflate((char *)&buffer.front(), expectedLength);
     buffer.resize(size);
-    buffer.assign(output, output + size);
   } else {
     _ASSERT(rawDataLength != 0);
     m_logWriter->debug(_T("Tight decoder: Length of Raw compressed data is 0"));
@@ -294,41 +276,39 @@ void TightDecoder::readCompressedData(RfbInputGate *input,
 }
 
 void TightDecoder::drawPalette(FrameBuffer *fb,
-                               const vector<UINT32> &palette,
+                               int paletteSize,
                                const vector<UINT8> &pixels,
                                const Rect *dstRect)
 {
-  // TODO: removed duplicate code (draw Tight bytes)
   int width = dstRect->getWidth();
   int height = dstRect->getHeight();
-
   int bytesPerPixel = fb->getBytesPerPixel();
 
-  int dstLength = dstRect->area();
-
-  int x = dstRect->left;
-  int y = dstRect->top;
-  if (palette.size() == 2) {
-    int offset = 8;
-    int index = -1;
-    for (int i = 0; i < dstLength; i++) {
-      void *pixelPtr = fb->getBufferPtr(x + i % width, y + i / width);
-      if (offset == 0 || i % width == 0) {
-        offset = 8;
-        index++;
-      }
-      offset--;
-      memcpy(pixelPtr, &palette[(pixels[index] >> offset) & 0x01], bytesPerPixel);
-
+  if (paletteSize == 2) {
+    // Each row of the mask starts with a new byte.
+    size_t bytesPerRow = (width + 7) / 8;
+    if (pixels.size() < bytesPerRow * height) {
+      m_logWriter->error(_T("Tight decoder: Not enough data for the rectangle."));
+      return;
+    }
+    for (int y = 0; y < height; y++) {
+      RowKernels::expandMono(fb->getBufferPtr(dstRect->left, dstRect->top + y),
+                             bytesPerPixel, &pixels[y * bytesPerRow], width,
+                             m_palette[0], m_palette[1]);
     }
   } else { // size of palette != 2
-    for (int i = 0; i < dstLength; i++) {
-      void *pixelPtr = fb->getBufferPtr(x + i % width, y + i / width);
-      if (pixels[i] < palette.size()) {
-        memcpy(pixelPtr, &palette[pixels[i]], bytesPerPixel);
-      } else {
-        m_logWriter->error(_T("Tight decoder: Invalid index in palette."));
-      }
+    if (pixels.size() < (size_t)dstRect->area()) {
+      m_logWriter->error(_T("Tight decoder: Not enough data for the rectangle."));
+      return;
+    }
+    if (*std::max_element(pixels.begin(), pixels.begin() + dstRect->area()) >=
+        paletteSize) {
+      m_logWriter->error(_T("Tight decoder: Invalid index in palette."));
+    }
+    for (int y = 0; y < height; y++) {
+      RowKernels::expandPalette(fb->getBufferPtr(dstRect->left, dstRect->top + y),
+                                bytesPerPixel, &pixels[y * width], width,
+                                m_palette);
     }
   }
 }
@@ -337,19 +317,24 @@ void TightDecoder::drawTightBytes(FrameBuffer *fb,
                                   const vector<UINT8> *pixels,
                                   const Rect *dstRect)
 {
-  // TODO: removed duplicate code (zrle)
   int width = dstRect->getWidth();
   int height = dstRect->getHeight();
 
-  int bytesPerPixel = fb->getBytesPerPixel();
-
-  int dstLength = dstRect->area();
+  // CPIXELs are three bytes long, other pixels are in the frame buffer format.
+  size_t bytesPerRow = width * (m_isCPixel ? 3 : fb->getBytesPerPixel());
+  if (pixels->size() < bytesPerRow * height) {
+    m_logWriter->error(_T("Tight decoder: Not enough data for the rectangle."));
+    return;
+  }
 
-  int x = dstRect->left;
-  int y = dstRect->top;
-  for (int i = 0; i < dstLength; i++) {
-    void *pixelPtr = fb->getBufferPtr(x + i % width, y + i / width);
-    memcpy(pixelPtr, &pixels->operator [](i * bytesPerPixel), bytesPerPixel);
+  const UINT8 *src = pixels->empty() ? 0 : &pixels->front();
+  for (int y = dstRect->top; y < dstRect->bottom; y++, src += bytesPerRow) {
+    void *dst = fb->getBufferPtr(dstRect->left, y);
+    if (m_isCPixel) {
+      RowKernels::expandCPixels((UINT32 *)dst, src, width, true);
+    } else {
+      memcpy(dst, src, bytesPerRow);
+    }
   }
 }
 
@@ -357,27 +342,14 @@ void TightDecoder::drawJpegBytes(FrameBuffer *fb,
                                  const vector<UINT8> *pixels,
                                  const Rect *dstRect)
 {
-  // TODO: removed duplicate code (draw tight bytes)
   int width = dstRect->getWidth();
-  int height = dstRect->getHeight();
-
-  int fbBytesPerPixel = fb->getBytesPerPixel();
-  int bytesPerCPixel = 3;
+  size_t bytesPerRow = width * JpegDecompressor::BYTES_PER_PIXEL;
   PixelFormat pxFormat = fb->getPixelFormat();
 
-  int dstLength = dstRect->area();
-
-  int x = dstRect->left;
-  int y = dstRect->top;
-  for (int i = 0; i < dstLength; i++) {
-    UINT8 color[4] = {0, 0, 0, 0};
-    memcpy(&color, &pixels->operator [](i * bytesPerCPixel), bytesPerCPixel);
-    UINT32 pixel = (((UINT32)color[0] * pxFormat.redMax + 127) / 255 << pxFormat.redShift | 
-                   ((UINT32)color[1] * pxFormat.greenMax + 127) / 255 << pxFormat.greenShift |
-                   ((UINT32)color[2] * pxFormat.blueMax + 127) / 255 << pxFormat.blueShift);
-
-    void *pixelPtr = fb->getBufferPtr(x + i % width, y + i / width);
-    memcpy(pixelPtr, &pixel, fbBytesPerPixel);
+  const UINT8 *src = &pixels->front();
+  for (int y = dstRect->top; y < dstRect->bottom; y++, src += bytesPerRow) {
+    RowKernels::convertRgb(fb->getBufferPtr(dstRect->left, y), src, width,
+                           &pxFormat);
   }
 }
 
@@ -402,73 +374,26 @@ void TightDecoder::drawGradient(FrameBuffer *fb,
                                 const vector<UINT8> &pixels,
                                 const Rect *dstRect)
 {
-  typedef vector<UINT16> RowType;
-  size_t opRowLength = dstRect->getWidth() * 3 + 3;
-
-  vector<RowType> opRows(2);
-  opRows[0].resize(opRowLength);
-  opRows[1].resize(opRowLength);
-
-  memset(&opRows[0].front(), 0, opRowLength * sizeof(UINT16));
-  memset(&opRows[1].front(), 0, opRowLength * sizeof(UINT16));
-  
+  int width = dstRect->getWidth();
   PixelFormat pxFormat = fb->getPixelFormat();
-  int fbBytesPerPixel = fb->getBytesPerPixel();
-  int bytesPerCPixel = fbBytesPerPixel;
-  if (m_isCPixel) {
-    bytesPerCPixel = 3;
-  }
-
-  int opRowIndex = 0;
-  UINT16 max[3] = {pxFormat.redMax, pxFormat.greenMax, pxFormat.blueMax};
-  UINT16 shift[3] = {pxFormat.redShift, pxFormat.greenShift, pxFormat.blueShift};
-  size_t pixelOffset = 0;
-
-  for (int i = 0; i < dstRect->getHeight(); ++i) {
-    // exchange thisRow and prevRow:
-    RowType &thisRow = opRows[opRowIndex];
-    RowType &prevRow = opRows[opRowIndex = (opRowIndex + 1) % 2];
-
-    for (size_t j = 3; j < opRowLength; j += 3, pixelOffset += bytesPerCPixel) {
-      UINT8 rawColor[3];
-      fillRawComponents(&pxFormat, rawColor, pixels, pixelOffset);
-      UINT32 color = 0;
-      for (int index = 0; index < 3; index++) {
-        INT32 d = prevRow[j + index] +      // "upper" pixel (from prev row)
-                  thisRow[j + index - 3] -  // prev pixel
-                  prevRow[j + index - 3];   // "diagonal" prev pixel
-        UINT16 converted = d < 0 ? 0 : d > max[index] ? max[index] : d;
-        thisRow[j + index] = (converted + rawColor[index]) & max[index];
-        color |= (thisRow[j + index] & max[index]) << shift[index];
-      }
-      void *pixelPtr = fb->getBufferPtr(static_cast<int>(dstRect->left + j/3 - 1),
-                                        dstRect->top + i);
-      memcpy(pixelPtr, &color, fbBytesPerPixel);
-    }
+  size_t bytesPerRow = width * (m_isCPixel ? 3 : fb->getBytesPerPixel());
+  if (pixels.size() < bytesPerRow * dstRect->getHeight()) {
+    m_logWriter->error(_T("Tight decoder: Not enough data for the rectangle."));
+    return;
   }
-}
 
-UINT32 TightDecoder::getRawTightColor(const PixelFormat *pxFormat,
-                                      const vector<UINT8> &pixels,
-                                      const size_t offset)
-{
-  if (m_isCPixel) {
-    return pixels[offset] << 16 |
-           pixels[offset + 1] << 8 |
-           pixels[offset + 2];
+  // Color components of the previous and this rows, each row starts with
+  // a zero pixel left of the rectangle.
+  size_t opRowLength = width * 3 + 3;
+  m_gradientRows.assign(opRowLength * 2, 0);
+  UINT16 *prevRow = &m_gradientRows[0];
+  UINT16 *thisRow = &m_gradientRows[opRowLength];
+
+  const UINT8 *src = pixels.empty() ? 0 : &pixels.front();
+  for (int y = dstRect->top; y < dstRect->bottom; y++, src += bytesPerRow) {
+    RowKernels::reconstructGradient(fb->getBufferPtr(dstRect->left, y),
+                                    src, width, m_isCPixel, &pxFormat,
+                                    prevRow, thisRow);
+    std::swap(prevRow, thisRow);
   }
-  UINT32 rawColor = 0;
-  memcpy(&rawColor, &pixels[offset], pxFormat->bitsPerPixel / 8);
-  return rawColor;
-}
-
-void TightDecoder::fillRawComponents(const PixelFormat *pxFormat,
-                                     UINT8 components[],
-                                     const vector<UINT8> &pixels,
-                                     const size_t pixelOffset)
-{
-  int rawColor = getRawTightColor(pxFormat, pixels, pixelOffset);
-  components[0] = rawColor >> pxFormat->redShift & pxFormat->redMax;
-  components[1] = rawColor >> pxFormat->greenShift & pxFormat->greenMax;
-  components[2] = rawColor >> pxFormat->blueShift & pxFormat->blueMax;
 }
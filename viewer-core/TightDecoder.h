@@ -41,23 +41,27 @@ public:
 protected:
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *frameBuffer,
-                      const Rect *dstRect);
+                      const Rect *dstRect,
+                      LocalMutex *fbLock);
 
 private:
   void reset();
   void resetDecoders(UINT8 compControl);
   UINT32 readTightPixel(RfbInputGate *input, int bytesPerCPixel);
   int readCompactSize(RfbInputGate *input);
-  vector<UINT32> readPalette(RfbInputGate *input,
-                          int paletteSize,
-                          int bytesPerCPixel);
+  // Reads the palette to m_palette.
+  void readPalette(RfbInputGate *input,
+                   int paletteSize,
+                   int bytesPerCPixel);
   void processJpeg(RfbInputGate *input,
                    FrameBuffer *frameBuffer,
-                   const Rect *dstRect);
+                   const Rect *dstRect,
+                   LocalMutex *fbLock);
   void processBasicTypes(RfbInputGate *input,
                          FrameBuffer *frameBuffer,
                          const Rect *dstRect,
-                         UINT8 compControl);
+                         UINT8 compControl,
+                         LocalMutex *fbLock);
   void readTightData(RfbInputGate *input,
                      vector<UINT8> &buffer,
                      size_t expectedLength,
@@ -67,7 +71,7 @@ private:
                           size_t expectedLength,
                           const int decoderId);
   void drawPalette(FrameBuffer *fb,
-                   const vector<UINT32> &palette,
+                   int paletteSize,
                    const vector<UINT8> &pixels,
                    const Rect *dstRect);
   void drawGradient(FrameBuffer *fb,
@@ -80,20 +84,15 @@ private:
                      const vector<UINT8> *pixels,
                      const Rect *dstRect);
 
-  UINT32 getRawTightColor(const PixelFormat *pxFormat,
-                          const vector<UINT8> &pixels,
-                          size_t offset);
-  void fillRawComponents(const PixelFormat *pxFormat,
-                         UINT8 components[],
-                         const vector<UINT8> &pixels,
-                         size_t pixelOffset);
-
-  UINT32 transformPixelToTight(UINT32 color);
-  vector<UINT8> TightDecoder::transformArray(const vector<UINT8> &buffer);
-
   vector<Inflater *> m_inflater;
   JpegDecompressor m_jpeg;
 
+  // Scratch buffers reused for all rectangles. They only grow, so decoding
+  // does not allocate memory once they are big enough.
+  vector<UINT8> m_compressed;
+  vector<UINT8> m_pixels;
+  vector<UINT16> m_gradientRows;
+
   bool m_isCPixel;
 private:
   static const int MAX_SUBENCODING = 0x09;
@@ -110,6 +109,10 @@ private:
 
   static const int DECODERS_NUM = 4;
 
+  static const int MAX_PALETTE_SIZE = 256;
+  // The current palette, unused entries are zeroes.
+  UINT32 m_palette[MAX_PALETTE_SIZE];
+
   static const int MIN_SIZE_TO_COMPRESS = 12;
 };
 
@@ -115,20 +115,19 @@ void WatermarksController::loadFromfile()
 
 	int pad = 4 - ((m_width * 3) % 4);
 
-	int bufferSize = m_width * m_height * 4;
-
-	UINT8* buffer = new UINT8[bufferSize];
-
-
 	Dimension dim(m_width, m_height);
 	PixelFormat pf = StandardPixelFormatFactory::create32bppPixelFormat();
-	m_frameBuffer.setPropertiesWithoutResize(&dim, &pf);
+	// The frame buffer owns the pixels.
+	m_frameBuffer.setProperties(&dim, &pf);
 	m_overlay.setPropertiesWithoutResize(&m_overlay.getDimension(), &pf);
 
+	UINT8* buffer = (UINT8*)m_frameBuffer.getBuffer();
+	int bytesPerRow = m_frameBuffer.getBytesPerRow();
+
 	for (int i = 0; i < m_height; ++i)
 	{
 		int vi = m_width * i * 3 + i * pad + pixelsOfset;
-		int vb = m_width * (m_height - i - 1) * 4;
+		int vb = bytesPerRow * (m_height - i - 1);
 		for(int j = 0; j < m_width; ++j)
 		{
 			int hi = vi + j*3;
@@ -140,8 +139,6 @@ void WatermarksController::loadFromfile()
 			buffer[hb + 3] = 255;							//A
 		}
 	}
-
-	m_frameBuffer.setBuffer(buffer);
 }
 
 bool WatermarksController::isEmpty()
@@ -26,6 +26,8 @@
 
 #include "io-lib/ByteArrayInputStream.h"
 
+#include "RowKernels.h"
+
 #include <vector>
 #include <algorithm>
 
@@ -41,7 +43,8 @@ ZrleDecoder::~ZrleDecoder()
 
 void ZrleDecoder::decode(RfbInputGate *input,
                          FrameBuffer *frameBuffer,
-                         const Rect *dstRect)
+                         const Rect *dstRect,
+                         LocalMutex *fbLock)
 {
   size_t maxUnpackedSize = getMaxSizeOfRectangle(dstRect);
   readAndInflate(input, maxUnpackedSize);
@@ -127,6 +130,7 @@ void ZrleDecoder::decode(RfbInputGate *input,
         readPaletteRleTile(&unpackedDataStream, pixels, &tileRect, type);
       }
 
+      AutoLock al(fbLock);
       drawTile(frameBuffer, &tileRect, &pixels);
     } // tile(x, y)
   } // tile(..., y)
@@ -319,23 +323,16 @@ void ZrleDecoder::drawTile(FrameBuffer *fb,
                            const vector<char> *pixels)
 {
   int width = tileRect->getWidth();
-  size_t fbBytesPerPixel = m_bytesPerPixel;
-
-  if (fbBytesPerPixel == 3) {
-    fbBytesPerPixel = 4;
-  }
-
-  int tileLength = tileRect->area();
-
-  int x = tileRect->left;
-  int y = tileRect->top;
-   
-  const char *pixelsPtr = &pixels->front();
-  char *bufferPtr = 0;
-  for (int i = 0; i < tileLength; i++) {
-    bufferPtr = (char*)fb->getBufferPtr(x + i % width, y + i / width);
-    memset(bufferPtr, 0, fbBytesPerPixel);
-    memcpy(bufferPtr, pixelsPtr, m_bytesPerPixel);
-    pixelsPtr+=m_bytesPerPixel;
+  size_t bytesPerRow = width * m_bytesPerPixel;
+
+  const UINT8 *src = reinterpret_cast<const UINT8 *>(&pixels->front());
+  for (int y = tileRect->top; y < tileRect->bottom; y++, src += bytesPerRow) {
+    void *dst = fb->getBufferPtr(tileRect->left, y);
+    // CPIXELs are expanded to the 32-bit pixels of the frame buffer.
+    if (m_bytesPerPixel == 3) {
+      RowKernels::expandCPixels((UINT32 *)dst, src, width, false);
+    } else {
+      memcpy(dst, src, bytesPerRow);
+    }
   }
 }
@@ -42,7 +42,8 @@ protected:
 protected:
   virtual void decode(RfbInputGate *input,
                       FrameBuffer *frameBuffer,
-                      const Rect *dstRect);
+                      const Rect *dstRect,
+                      LocalMutex *fbLock);
 
 
   void readAndInflate(RfbInputGate *input, size_t maximalUnpackedSize);
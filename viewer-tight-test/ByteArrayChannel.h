@@ -0,0 +1,54 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _BYTE_ARRAY_CHANNEL_H_
+#define _BYTE_ARRAY_CHANNEL_H_
+
+#include "io-lib/Channel.h"
+#include "io-lib/ByteArrayInputStream.h"
+
+/**
+ * Read-only channel that reads data from memory, so a recorded stream can be
+ * given to the code that reads from a channel.
+ */
+class ByteArrayChannel : public Channel
+{
+public:
+  ByteArrayChannel(const char *buffer, size_t bufferSize);
+  virtual ~ByteArrayChannel();
+
+  virtual size_t read(void *buffer, size_t len);
+
+  /**
+   * Throws IOException, the channel is read-only.
+   */
+  virtual size_t write(const void *buffer, size_t len);
+
+  virtual void close() throw(Exception);
+
+private:
+  ByteArrayInputStream m_input;
+};
+
+#endif
@@ -0,0 +1,445 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#include "TightDecoderTest.h"
+#include "ByteArrayChannel.h"
+#include "ReferenceTightDecoder.h"
+
+#include "io-lib/ByteArrayOutputStream.h"
+#include "rfb/EncodingDefs.h"
+#include "rfb/PixelConverter.h"
+#include "rfb/StandardPixelFormatFactory.h"
+#include "rfb-sconn/EncodeOptions.h"
+#include "rfb-sconn/TightEncoder.h"
+#include "util/Exception.h"
+
+#include <crtdbg.h>
+#include <stdio.h>
+
+#ifdef _DEBUG
+// Heap allocations made while s_countAllocations is set.
+static size_t s_allocations = 0;
+static bool s_countAllocations = false;
+
+static int countAllocations(int allocType, void *userData, size_t size,
+                            int blockType, long requestNumber,
+                            const unsigned char *fileName, int lineNumber)
+{
+  // Allocations of the CRT itself must be ignored.
+  if (s_countAllocations && blockType != _CRT_BLOCK &&
+      (allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)) {
+    s_allocations++;
+  }
+  return TRUE;
+}
+#endif
+
+// Kinds of content of the test frames.
+enum ContentKind
+{
+  SOLID_CONTENT,
+  MONO_CONTENT,
+  PALETTE_CONTENT,
+  PHOTO_CONTENT,
+  GRADIENT_CONTENT
+};
+
+// The top of the strip of narrow rectangles, each content kind but the
+// solid one has its row of NARROW_HEIGHT pixels.
+static const int NARROW_TOP = 160;
+static const int NARROW_HEIGHT = 10;
+static const int MAX_NARROW_WIDTH = 17;
+
+static ContentKind getContentKind(int x, int y)
+{
+  if (y < 40) {
+    return SOLID_CONTENT;
+  } else if (y < 100) {
+    return x < 160 ? MONO_CONTENT : PALETTE_CONTENT;
+  } else if (y < NARROW_TOP) {
+    return x < 160 ? PHOTO_CONTENT : GRADIENT_CONTENT;
+  }
+  return (ContentKind)(MONO_CONTENT + (y - NARROW_TOP) / NARROW_HEIGHT);
+}
+
+static UINT32 getNoise(int x, int y, int frameIndex)
+{
+  UINT32 h = (UINT32)x * 73856093 ^ (UINT32)y * 19349663 ^
+             (UINT32)(frameIndex + 1) * 83492791;
+  h ^= h >> 13;
+  h *= 0x5bd1e995;
+  return h ^ (h >> 15);
+}
+
+static UINT32 getPixel(int x, int y, int frameIndex)
+{
+  UINT32 noise = getNoise(x, y, frameIndex);
+  if (frameIndex == 0) {
+    return noise & 0xFFFFFF;
+  }
+  int k = frameIndex;
+  UINT32 r, g, b;
+  switch (getContentKind(x, y)) {
+  case SOLID_CONTENT:
+    // TightEncoder sends a solid rectangle of a non-zero color as a
+    // two-color one, so the area is black to get the "fill" subencoding.
+    r = g = b = 0;
+    break;
+  case MONO_CONTENT:
+    if (((x + k) / 3 + y / 2) % 3 == 0) {
+      r = g = b = 255;
+    } else {
+      r = k * 10; g = 0; b = 80;
+    }
+    break;
+  case PALETTE_CONTENT:
+    {
+      UINT32 index = ((x + 2 * k) / 5 + (y / 4) * 7) % 12;
+      r = index * 20; g = 255 - index * 15; b = index * 97;
+    }
+    break;
+  default:
+    r = x + k * 5 + (noise & 15);
+    g = y * 2 + (noise >> 4 & 15);
+    b = (x + y) / 2 + (noise >> 8 & 15);
+    break;
+  }
+  return (r & 0xFF) << 16 | (g & 0xFF) << 8 | (b & 0xFF);
+}
+
+TightDecoderTest::TestTightDecoder::TestTightDecoder(LogWriter *logWriter)
+: TightDecoder(logWriter)
+{
+}
+
+void TightDecoderTest::TestTightDecoder::decodeRect(RfbInputGate *input,
+                                                    FrameBuffer *frameBuffer,
+                                                    const Rect *rect,
+                                                    LocalMutex *fbLock)
+{
+  decode(input, frameBuffer, rect, fbLock);
+}
+
+TightDecoderTest::TightDecoderTest()
+: m_log(0)
+{
+}
+
+TightDecoderTest::~TightDecoderTest()
+{
+}
+
+void TightDecoderTest::run()
+{
+  PixelFormat pf32 = StandardPixelFormatFactory::create32bppPixelFormat();
+  PixelFormat pf16 = StandardPixelFormatFactory::create16bppPixelFormat();
+
+#ifdef _DEBUG
+  _CRT_ALLOC_HOOK prevHook = _CrtSetAllocHook(countAllocations);
+#else
+  _tprintf(_T("Allocations are counted only in debug builds\n"));
+#endif
+  try {
+    runCase(&pf32, false, true);
+    runCase(&pf16, false, true);
+    // libjpeg allocates its pools for each image, so allocations are not
+    // counted with JPEG.
+    runCase(&pf32, true, false);
+    runCase(&pf16, true, false);
+  } catch (...) {
+#ifdef _DEBUG
+    _CrtSetAllocHook(prevHook);
+#endif
+    throw;
+  }
+#ifdef _DEBUG
+  _CrtSetAllocHook(prevHook);
+#endif
+}
+
+void TightDecoderTest::runCase(const PixelFormat *clientPf, bool useJpeg,
+                               bool countAllocations)
+{
+  Recording recording;
+  record(clientPf, useJpeg, &recording);
+
+  Dimension dim(FB_WIDTH, FB_HEIGHT);
+  Rect fbRect = dim.getRect();
+  FrameBuffer fb;
+  FrameBuffer referenceFb;
+  fb.setProperties(&dim, clientPf);
+  referenceFb.setProperties(&dim, clientPf);
+  fb.fillRect(&fbRect, 0);
+  referenceFb.fillRect(&fbRect, 0);
+
+  // Source frames in the client format, to check lossless decoding.
+  PixelFormat serverPf = StandardPixelFormatFactory::create32bppPixelFormat();
+  FrameBuffer serverFb;
+  serverFb.setProperties(&dim, &serverPf);
+  PixelConverter converter;
+  converter.setPixelFormats(clientPf, &serverPf);
+
+  ByteArrayChannel channel(&recording.data.front(), recording.data.size());
+  ByteArrayChannel referenceChannel(&recording.data.front(),
+                                    recording.data.size());
+  RfbInputGate input(&channel);
+  RfbInputGate referenceInput(&referenceChannel);
+  TestTightDecoder decoder(&m_log);
+  ReferenceTightDecoder referenceDecoder(&m_log);
+  LocalMutex fbLock;
+
+  size_t allocations = 0;
+  size_t rectIndex = 0;
+  for (int frameIndex = 0; frameIndex < FRAME_COUNT; frameIndex++) {
+    size_t frameBegin = rectIndex;
+    size_t frameEnd = recording.frameEnds[frameIndex];
+#ifdef _DEBUG
+    s_allocations = 0;
+    s_countAllocations = countAllocations && frameIndex >= WARM_UP_FRAMES;
+#endif
+    for (; rectIndex < frameEnd; rectIndex++) {
+      decoder.decodeRect(&input, &fb, &recording.rects[rectIndex], &fbLock);
+    }
+#ifdef _DEBUG
+    s_countAllocations = false;
+    allocations += s_allocations;
+#endif
+    for (size_t i = frameBegin; i < frameEnd; i++) {
+      referenceDecoder.decode(&referenceInput, &referenceFb,
+                              &recording.rects[i]);
+    }
+
+    compare(&fb, &referenceFb, _T("the reference decoder's output"),
+            frameIndex);
+    if (!useJpeg) {
+      drawFrame(&serverFb, frameIndex);
+      compare(&fb, converter.convert(&fbRect, &serverFb),
+              _T("the source frame"), frameIndex);
+    }
+  }
+
+  if (allocations != 0) {
+    StringStorage errMess;
+    errMess.format(_T("%d bpp: %u allocations after the warm-up frames"),
+                   (int)clientPf->bitsPerPixel, (unsigned int)allocations);
+    throw Exception(errMess.getString());
+  }
+  _tprintf(_T("%d bpp%s: %u rectangles of %u bytes decoded\n"),
+           (int)clientPf->bitsPerPixel, useJpeg ? _T(", JPEG") : _T(""),
+           (unsigned int)recording.rects.size(),
+           (unsigned int)recording.data.size());
+}
+
+void TightDecoderTest::record(const PixelFormat *clientPf, bool useJpeg,
+                              Recording *recording)
+{
+  Dimension dim(FB_WIDTH, FB_HEIGHT);
+  PixelFormat serverPf = StandardPixelFormatFactory::create32bppPixelFormat();
+  FrameBuffer serverFb;
+  serverFb.setProperties(&dim, &serverPf);
+
+  PixelConverter converter;
+  converter.setPixelFormats(clientPf, &serverPf);
+  PixelConverter gradientConverter;
+  gradientConverter.setPixelFormats(clientPf, &serverPf);
+
+  ByteArrayOutputStream stream;
+  DataOutputStream output(&stream);
+  TightEncoder encoder(&converter, &output);
+  Deflater gradientDeflater;
+
+  std::vector<int> encodings;
+  encodings.push_back(EncodingDefs::TIGHT);
+  encodings.push_back(PseudoEncDefs::COMPR_LEVEL_6);
+  if (useJpeg) {
+    encodings.push_back(PseudoEncDefs::QUALITY_LEVEL_6);
+  }
+  EncodeOptions options;
+  options.setEncodings(&encodings);
+
+  std::vector<Rect> encoderRects;
+  std::vector<Rect> gradientRects;
+  getFrameRects(&encoderRects, &gradientRects);
+
+  for (int frameIndex = 0; frameIndex < FRAME_COUNT; frameIndex++) {
+    drawFrame(&serverFb, frameIndex);
+
+    std::vector<Rect>::iterator it;
+    for (it = encoderRects.begin(); it != encoderRects.end(); it++) {
+      std::vector<Rect> splitRects;
+      encoder.splitRectangle(&(*it), &splitRects, &serverFb, &options);
+      std::vector<Rect>::iterator splitIt;
+      for (splitIt = splitRects.begin(); splitIt != splitRects.end();
+           splitIt++) {
+        encoder.sendRectangle(&(*splitIt), &serverFb, &options);
+        recording->rects.push_back(*splitIt);
+      }
+    }
+    for (it = gradientRects.begin(); it != gradientRects.end(); it++) {
+      const FrameBuffer *clientFb = gradientConverter.convert(&(*it),
+                                                              &serverFb);
+      writeGradientRect(&output, &gradientDeflater, clientFb, &(*it));
+      recording->rects.push_back(*it);
+    }
+    recording->frameEnds.push_back(recording->rects.size());
+  }
+
+  const char *data = stream.toByteArray();
+  recording->data.assign(data, data + stream.size());
+}
+
+void TightDecoderTest::drawFrame(FrameBuffer *fb, int frameIndex)
+{
+  for (int y = 0; y < FB_HEIGHT; y++) {
+    UINT32 *row = (UINT32 *)fb->getBufferPtr(0, y);
+    for (int x = 0; x < FB_WIDTH; x++) {
+      row[x] = getPixel(x, y, frameIndex);
+    }
+  }
+}
+
+void TightDecoderTest::getFrameRects(std::vector<Rect> *encoderRects,
+                                     std::vector<Rect> *gradientRects)
+{
+  encoderRects->push_back(Rect(0, 0, FB_WIDTH, 40));
+  encoderRects->push_back(Rect(0, 40, 160, 100));
+  encoderRects->push_back(Rect(160, 40, FB_WIDTH, 100));
+  encoderRects->push_back(Rect(0, 100, 160, NARROW_TOP));
+  gradientRects->push_back(Rect(160, 100, FB_WIDTH, NARROW_TOP));
+
+  for (int kind = MONO_CONTENT; kind <= GRADIENT_CONTENT; kind++) {
+    int top = NARROW_TOP + (kind - MONO_CONTENT) * NARROW_HEIGHT;
+    int left = 0;
+    for (int width = 1; width <= MAX_NARROW_WIDTH; width++) {
+      Rect rect(left, top, left + width, top + NARROW_HEIGHT);
+      if (kind == GRADIENT_CONTENT) {
+        gradientRects->push_back(rect);
+      } else {
+        encoderRects->push_back(rect);
+      }
+      left += width;
+    }
+    // The rest of the row.
+    Rect rect(left, top, FB_WIDTH, top + NARROW_HEIGHT);
+    if (kind == GRADIENT_CONTENT) {
+      gradientRects->push_back(rect);
+    } else {
+      encoderRects->push_back(rect);
+    }
+  }
+}
+
+void TightDecoderTest::writeGradientRect(DataOutputStream *output,
+                                         Deflater *deflater,
+                                         const FrameBuffer *clientFb,
+                                         const Rect *rect)
+{
+  PixelFormat pf = clientFb->getPixelFormat();
+  bool isCPixel = pf.bitsPerPixel == 32 && pf.colorDepth == 24 &&
+                  pf.redMax == 255 && pf.greenMax == 255 && pf.blueMax == 255;
+  int bytesPerPixel = pf.bitsPerPixel / 8;
+  UINT16 max[3] = { pf.redMax, pf.greenMax, pf.blueMax };
+  UINT16 shift[3] = { pf.redShift, pf.greenShift, pf.blueShift };
+
+  // Each color component is sent as the difference between its value and
+  // the value predicted from the left, upper and upper left pixels.
+  int width = rect->getWidth();
+  int height = rect->getHeight();
+  std::vector<int> prevRow((width + 1) * 3, 0);
+  std::vector<int> thisRow((width + 1) * 3, 0);
+  std::vector<UINT8> data;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      UINT32 pixel = 0;
+      memcpy(&pixel, clientFb->getBufferPtr(rect->left + x, rect->top + y),
+             bytesPerPixel);
+      UINT32 diffPixel = 0;
+      for (int i = 0; i < 3; i++) {
+        int j = (x + 1) * 3 + i;
+        int value = pixel >> shift[i] & max[i];
+        int prediction = prevRow[j] + thisRow[j - 3] - prevRow[j - 3];
+        prediction = prediction < 0 ? 0 :
+                     prediction > max[i] ? max[i] : prediction;
+        thisRow[j] = value;
+        UINT32 diff = (value - prediction) & max[i];
+        if (isCPixel) {
+          data.push_back((UINT8)diff);
+        } else {
+          diffPixel |= diff << shift[i];
+        }
+      }
+      if (!isCPixel) {
+        UINT8 *bytes = (UINT8 *)&diffPixel;
+        data.insert(data.end(), bytes, bytes + bytesPerPixel);
+      }
+    }
+    prevRow.swap(thisRow);
+  }
+
+  output->writeUInt8(0x40 | GRADIENT_STREAM_ID << 4);
+  output->writeUInt8(0x02);
+
+  if (data.size() < MIN_SIZE_TO_COMPRESS) {
+    output->writeFully(&data.front(), data.size());
+    return;
+  }
+  deflater->setInput((const char *)&data.front(), data.size());
+  deflater->deflate();
+  writeCompactSize(output, deflater->getOutputSize());
+  output->writeFully(deflater->getOutput(), deflater->getOutputSize());
+}
+
+void TightDecoderTest::writeCompactSize(DataOutputStream *output, size_t size)
+{
+  if (size > 0x3FFF) {
+    output->writeUInt8((UINT8)(size & 0x7F | 0x80));
+    output->writeUInt8((UINT8)(size >> 7 & 0x7F | 0x80));
+    output->writeUInt8((UINT8)(size >> 14));
+  } else if (size > 0x7F) {
+    output->writeUInt8((UINT8)(size & 0x7F | 0x80));
+    output->writeUInt8((UINT8)(size >> 7));
+  } else {
+    output->writeUInt8((UINT8)size);
+  }
+}
+
+void TightDecoderTest::compare(const FrameBuffer *fb,
+                               const FrameBuffer *expectedFb,
+                               const TCHAR *what, int frameIndex)
+{
+  int bytesPerPixel = fb->getBytesPerPixel();
+  for (int y = 0; y < FB_HEIGHT; y++) {
+    const UINT8 *row = (const UINT8 *)fb->getBufferPtr(0, y);
+    const UINT8 *expectedRow = (const UINT8 *)expectedFb->getBufferPtr(0, y);
+    for (int x = 0; x < FB_WIDTH; x++) {
+      if (memcmp(row + x * bytesPerPixel, expectedRow + x * bytesPerPixel,
+                 bytesPerPixel) != 0) {
+        StringStorage errMess;
+        errMess.format(_T("%d bpp, frame %d: pixel (%d, %d) differs from %s"),
+                       bytesPerPixel * 8, frameIndex, x, y, what);
+        throw Exception(errMess.getString());
+      }
+    }
+  }
+}
@@ -0,0 +1,111 @@
+// Copyright (C) 2009,2010,2011,2012 GlavSoft LLC.
+// All rights reserved.
+//
+//-------------------------------------------------------------------------
+// This file is part of the CisteraVNC software.  Please visit our Web site:
+//
+//                       http://www.cistera.com/
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//-------------------------------------------------------------------------
+//
+
+#ifndef _TIGHT_DECODER_TEST_H_
+#define _TIGHT_DECODER_TEST_H_
+
+#include "io-lib/DataOutputStream.h"
+#include "log-writer/LogWriter.h"
+#include "rfb/FrameBuffer.h"
+#include "util/Deflater.h"
+#include "viewer-core/TightDecoder.h"
+
+#include <vector>
+
+//
+// Records a Tight stream of a few frames, encoded by the server's
+// TightEncoder, and decodes it by TightDecoder and by ReferenceTightDecoder.
+// Checks that both decoders draw the same frame buffer, that lossless
+// frames are decoded exactly, and (in debug builds) that TightDecoder does
+// not allocate memory once it has decoded the warm-up frames.
+//
+class TightDecoderTest
+{
+public:
+  TightDecoderTest();
+  virtual ~TightDecoderTest();
+
+  // Throws Exception if a check fails.
+  void run();
+
+private:
+  // Gives access to TightDecoder::decode().
+  class TestTightDecoder : public TightDecoder
+  {
+  public:
+    TestTightDecoder(LogWriter *logWriter);
+
+    void decodeRect(RfbInputGate *input,
+                    FrameBuffer *frameBuffer,
+                    const Rect *rect,
+                    LocalMutex *fbLock);
+  };
+
+  // A recorded stream: the rectangles in order they were sent, the number
+  // of rectangles sent by the end of each frame and the Tight data.
+  struct Recording
+  {
+    std::vector<Rect> rects;
+    std::vector<size_t> frameEnds;
+    std::vector<char> data;
+  };
+
+  void runCase(const PixelFormat *clientPf, bool useJpeg,
+               bool countAllocations);
+
+  void record(const PixelFormat *clientPf, bool useJpeg,
+              Recording *recording);
+
+  // Draws the frame on the 32-bit server frame buffer. The first frame is
+  // filled with noise, so its rectangles need the most memory to decode.
+  void drawFrame(FrameBuffer *fb, int frameIndex);
+
+  // Fills the lists of rectangles sent by the encoder and by
+  // writeGradientRect(). Widths of the narrow rectangles run from 1 to 17
+  // pixels, so both the vector and the tail loops of the row kernels are
+  // used.
+  void getFrameRects(std::vector<Rect> *encoderRects,
+                     std::vector<Rect> *gradientRects);
+
+  // Writes the rectangle with the "gradient" filter, which TightEncoder
+  // never uses.
+  void writeGradientRect(DataOutputStream *output, Deflater *deflater,
+                         const FrameBuffer *clientFb, const Rect *rect);
+  void writeCompactSize(DataOutputStream *output, size_t size);
+
+  // Throws Exception if the frame buffers differ.
+  void compare(const FrameBuffer *fb, const FrameBuffer *expectedFb,
+               const TCHAR *what, int frameIndex);
+
+  LogWriter m_log;
+
+  static const int FB_WIDTH = 320;
+  static const int FB_HEIGHT = 200;
+  static const int FRAME_COUNT = 6;
+  static const int WARM_UP_FRAMES = 2;
+  static const int GRADIENT_STREAM_ID = 3;
+  static const int MIN_SIZE_TO_COMPRESS = 12;
+};
+
+#endif
@@ -26,12 +26,13 @@
 #include "util/Exception.h"
 #include <Aclapi.h>
 
-SharedMemory::SharedMemory(const TCHAR *name, size_t size)
+SharedMemory::SharedMemory(const TCHAR *name, size_t size,
+                           bool allowAllAccess)
 : m_hToMap(0),
   m_memory(0)
 {
   try {
-    bool needToInit = createFile(name, size);
+    bool needToInit = createFile(name, size, allowAllAccess);
     mapViewOfFile();
     if (needToInit) {
       memset(m_memory, 0, size);
@@ -59,7 +60,8 @@ void SharedMemory::freeRes()
   }
 }
 
-bool SharedMemory::createFile(const TCHAR *name, size_t size)
+bool SharedMemory::createFile(const TCHAR *name, size_t size,
+                              bool allowAllAccess)
 {
   DWORD lowSize = size & 0xffffffff;
   DWORD highSize = (DWORD64)size >> 32 & 0xffffffff;
@@ -79,7 +81,7 @@ bool SharedMemory::createFile(const TCHAR *name, size_t size)
   // The first process to attach initializes memory
   bool needToInit = GetLastError() != ERROR_ALREADY_EXISTS;
 
-  if (needToInit) {
+  if (needToInit && allowAllAccess) {
     setAllAccess(m_hToMap);
   }
 
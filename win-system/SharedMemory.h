@@ -30,15 +30,17 @@
 class SharedMemory
 {
 public:
+  // If allowAllAccess is true, the memory created by this object can be
+  // opened by any process, otherwise the default security is used.
   // @throw Exception
-  SharedMemory(const TCHAR *name, size_t size);
+  SharedMemory(const TCHAR *name, size_t size, bool allowAllAccess = true);
   virtual ~SharedMemory();
 
   void *getMemPointer() { return m_memory; }
 
 protected:
   // Return true if need to init
-  bool createFile(const TCHAR *name, size_t size);
+  bool createFile(const TCHAR *name, size_t size, bool allowAllAccess);
   void mapViewOfFile();
   void setAllAccess(HANDLE objHandle);
 